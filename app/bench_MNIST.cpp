@@ -0,0 +1,282 @@
+#include "Tensor.hpp"
+#include "readCSV.hpp"
+#include "nn/modules.hpp"
+#include "nn/Sequential.hpp"
+#include "nn/Graph.hpp"
+#include "nn/QuantizedLinear.hpp"
+#include "nn/Int4Linear.hpp"
+#include "readMNIST.hpp"
+#include "Memory.hpp"
+#include "../tensorLib/bench/Benchmark.hpp"
+#include <functional>
+#include "iostream"
+
+/**
+ * End-to-end benchmark of the MNIST models: float Linear, Conv2d + Linear, the same with
+ * the fixed-size StaticConv2d + StaticLinear or as an optimized nn::Graph, and the
+ * int8 QuantizedLinear or the 4 bit weight-only Int4Linear, over batch
+ * sizes and thread counts. For every configuration reports images/sec, per-batch
+ * p50/p95/p99 latency, peak Tensor memory above the loaded test set, and accuracy, as a
+ * table and optionally as JSON.
+ *
+ * The test set is decoded once up front, the timings cover the forward pass and argmax.
+ *
+ * usage:
+ *     bench_MNIST --models float,conv,static,graph,quantize,int4 --batch-sizes 1,100,1000 --threads 1,2,4 --json mnist.json
+ */
+
+std::string testImgPath = "../dataset/MNIST/raw/t10k-images-idx3-ubyte.gz";
+std::string testLabelsPath = "../dataset/MNIST/raw/t10k-labels-idx1-ubyte.gz";
+
+const std::string conv1WeightPath = "../weights/conv1_weight.csv";
+const std::string fcWeightPath = "../weights/fc_weight.csv";
+
+struct Model {
+    std::string name;
+    // (B, 784) uint8 pixels -> (B) predicted labels
+    std::function<Tensor<int>(const Tensor<uint8_t>&)> predict;
+};
+
+struct Config {
+    std::string model;
+    int batch_size;
+    int threads;
+    int images;
+    double seconds;            // total over all batches
+    std::vector<double> batch_seconds;
+    int64_t peak_bytes;        // Tensor memory above what was live before the run
+    float accuracy;
+
+    double imagesPerSecond() const { return images / seconds; }
+    double latency(double q) const {
+        bench::Result r;
+        r.seconds = batch_seconds;
+        return r.quantile(q);
+    }
+};
+
+struct Options {
+    std::vector<std::string> models = {"float", "conv", "static", "graph", "quantize"};
+    std::vector<int> batch_sizes = {1, 100, 1000};
+    std::vector<int> threads;
+    int images = 0;  // 0 for the whole test set
+    int warmup = 2;  // batches
+    std::string json_path;
+};
+
+static std::vector<std::string> splitNames(const std::string& s) {
+    std::vector<std::string> names;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        names.push_back(item);
+    }
+    return names;
+}
+
+static Options parseArgs(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + arg);
+        }
+        std::string value = argv[++i];
+
+        if (arg == "--models") {
+            options.models = splitNames(value);
+        } else if (arg == "--batch-sizes") {
+            options.batch_sizes = bench::parseList(value);
+        } else if (arg == "--threads") {
+            options.threads = bench::parseList(value);
+        } else if (arg == "--images") {
+            options.images = std::stoi(value);
+        } else if (arg == "--warmup") {
+            options.warmup = std::stoi(value);
+        } else if (arg == "--json") {
+            options.json_path = value;
+        } else {
+            throw std::invalid_argument("Unknown argument " + arg);
+        }
+    }
+    return options;
+}
+
+Config runConfig(const Model& model, const Tensor<uint8_t>& images, const Tensor<int>& labels,
+                 int batch_size, int threads, int warmup) {
+    parallel::setNumThreads(threads);
+    int N = images.shape()[0];
+
+    for (int i = 0; i < warmup && i * batch_size < N; i++) {
+        int start = i * batch_size;
+        model.predict(images.slice(start, std::min(N, start + batch_size), 0));
+    }
+
+    Config config{model.name, batch_size, threads, N, 0, {}, 0, 0};
+    int64_t live_before = memory::stats().live_bytes;
+    memory::resetPeak();
+
+    int correct = 0;
+    for (int start = 0; start < N; start += batch_size) {
+        int end = std::min(N, start + batch_size);
+        auto X = images.slice(start, end, 0);
+
+        auto t0 = std::chrono::steady_clock::now();
+        Tensor<int> pred = model.predict(X);
+        auto t1 = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(t1 - t0).count();
+        config.batch_seconds.push_back(seconds);
+        config.seconds += seconds;
+
+        // labels is a slice of the whole set, compare through getData which honors its offset.
+        for (int i = 0; i < end - start; i++) {
+            correct += pred.getData({i}) == labels.getData({start + i});
+        }
+    }
+
+    config.peak_bytes = memory::stats().peak_bytes - live_before;
+    config.accuracy = static_cast<float>(correct) / N;
+    return config;
+}
+
+void printHeader() {
+    std::cout << std::left << std::setw(10) << "model"
+              << std::right << std::setw(8) << "batch" << std::setw(9) << "threads"
+              << std::setw(12) << "images/s" << std::setw(11) << "p50(ms)"
+              << std::setw(11) << "p95(ms)" << std::setw(11) << "p99(ms)"
+              << std::setw(11) << "peak(MB)" << std::setw(10) << "accuracy" << std::endl;
+}
+
+void printConfig(const Config& c) {
+    auto flags = std::cout.flags();
+    std::cout << std::left << std::setw(10) << c.model
+              << std::right << std::setw(8) << c.batch_size << std::setw(9) << c.threads
+              << std::fixed << std::setprecision(1) << std::setw(12) << c.imagesPerSecond()
+              << std::setprecision(3) << std::setw(11) << c.latency(0.5) * 1e3
+              << std::setw(11) << c.latency(0.95) * 1e3 << std::setw(11) << c.latency(0.99) * 1e3
+              << std::setw(11) << c.peak_bytes / (1024.0 * 1024.0)
+              << std::setprecision(4) << std::setw(10) << c.accuracy << std::endl;
+    std::cout.flags(flags);
+}
+
+void writeJson(const std::string& path, const std::vector<Config>& configs) {
+    std::ofstream os(path);
+    if (!os.is_open()) {
+        throw std::runtime_error("Error: Failed to open file " + path);
+    }
+
+    os << "{\n  \"context\": {\"cpu\": ";
+    bench::writeJsonString(os, bench::cpuModel());
+    os << ", \"isa\": \"" << cpu::isaName(kernels::activeISA()) << "\""
+       << ", \"max_threads\": " << parallel::availableCPUs().size()
+       << ", \"peak_rss_bytes\": " << memory::peakRSS() << "},\n  \"results\": [";
+    for (size_t i = 0; i < configs.size(); i++) {
+        auto& c = configs[i];
+        os << (i > 0 ? "," : "") << "\n    {\"model\": ";
+        bench::writeJsonString(os, c.model);
+        os << ", \"batch_size\": " << c.batch_size << ", \"threads\": " << c.threads
+           << ", \"images\": " << c.images << ", \"images_per_sec\": " << c.imagesPerSecond()
+           << ", \"p50_ms\": " << c.latency(0.5) * 1e3 << ", \"p95_ms\": " << c.latency(0.95) * 1e3
+           << ", \"p99_ms\": " << c.latency(0.99) * 1e3 << ", \"peak_bytes\": " << c.peak_bytes
+           << ", \"accuracy\": " << c.accuracy << "}";
+    }
+    os << "\n  ]\n}" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    try {
+        options = parseArgs(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << "usage: bench_MNIST [--models float,conv,static,graph,quantize,int4] [--batch-sizes 1,100,1000] "
+                     "[--threads 1,2,4] [--images N] [--warmup BATCHES] [--json PATH]" << std::endl;
+        return 1;
+    }
+    if (options.threads.empty()) {
+        options.threads.push_back(parallel::numThreads());
+    }
+
+    Tensor<uint8_t> images = readMNISTImages<uint8_t>(testImgPath);
+    Tensor<int> labels = readMNISTLabels<int>(testLabelsPath);
+    if (options.images > 0 && options.images < images.shape()[0]) {
+        images = images.slice(0, options.images, 0);
+    }
+
+    Tensor<float> fcWeight = readCSV<float>(fcWeightPath);
+    // int8 per output row, pixels to classes without floats, see QuantizedLinear.hpp.
+    nn::QuantizedLinear fc1_q(fcWeight.shape()[1], fcWeight.shape()[0], fcWeight);
+    // 4 bit in groups of 16 columns, see Int4Linear.hpp.
+    nn::Int4Linear fc1_4(fcWeight.shape()[1], fcWeight.shape()[0], fcWeight, {16, false});
+    nn::Linear<float> fc1(fcWeight.shape()[1], fcWeight.shape()[0], std::move(fcWeight));
+
+    std::vector<Model> models;
+    for (auto& name : options.models) {
+        if (name == "float") {
+            models.push_back({name, [&](const Tensor<uint8_t>& X) {
+                return fc1.forward(X, 1.0f / 255.0f).argmax(1);
+            }});
+        } else if (name == "conv") {
+            // the activations share one arena, planned once per batch size, see Sequential.hpp.
+            Tensor<float> conv1Weight = readCSV<float>(conv1WeightPath).view({1, 1, 3, 3});
+            auto model = std::make_shared<nn::Sequential<float>>();
+            model->add(nn::Conv2d<float>(1, 1, 3, 1, 1, std::move(conv1Weight))).add(nn::Flatten<float>()).add(fc1);
+            models.push_back({name, [model](const Tensor<uint8_t>& X) {
+                int B = X.shape()[0];
+                return model->forward(X.view({B, 1, 28, 28}), 1.0f / 255.0f).argmax(1);
+            }});
+        } else if (name == "static") {
+            // the conv model with the layer sizes in the types, see StaticTensor.hpp.
+            Tensor<float> conv1Weight = readCSV<float>(conv1WeightPath).view({1, 1, 3, 3});
+            auto model = std::make_shared<nn::Sequential<float>>();
+            model->add(nn::StaticConv2d<float, 1, 1, 3, 1, 1, 28, 28>(conv1Weight))
+                  .add(nn::Flatten<float>())
+                  .add(nn::StaticLinear<float, 28 * 28, 10>(readCSV<float>(fcWeightPath)));
+            models.push_back({name, [model](const Tensor<uint8_t>& X) {
+                int B = X.shape()[0];
+                return model->forward(X.view({B, 1, 28, 28}), 1.0f / 255.0f).argmax(1);
+            }});
+        } else if (name == "graph") {
+            // the conv model through the graph optimizer, see Graph.hpp.
+            auto graph = std::make_shared<nn::Graph>();
+            auto x = graph->input();
+            auto h = graph->conv2d(x, readCSV<float>(conv1WeightPath).view({1, 1, 3, 3}), 1, 1);
+            graph->output(graph->linear(graph->flatten(h), readCSV<float>(fcWeightPath)));
+            graph->optimize();
+            models.push_back({name, [graph](const Tensor<uint8_t>& X) {
+                int B = X.shape()[0];
+                return graph->forward(X.view({B, 1, 28, 28}), 1.0f / 255.0f).argmax(1);
+            }});
+        } else if (name == "quantize") {
+            models.push_back({name, [&](const Tensor<uint8_t>& X) {
+                return fc1_q.predict(X, 1.0f / 255.0f);
+            }});
+        } else if (name == "int4") {
+            models.push_back({name, [&](const Tensor<uint8_t>& X) {
+                return fc1_4.forward(X, 1.0f / 255.0f).argmax(1);
+            }});
+        } else {
+            std::cerr << "Unknown model " << name << ", expected float, conv, static, graph, quantize or int4" << std::endl;
+            return 1;
+        }
+    }
+
+    printHeader();
+    std::vector<Config> configs;
+    for (auto& model : models) {
+        for (int threads : options.threads) {
+            for (int batch_size : options.batch_sizes) {
+                configs.push_back(runConfig(model, images, labels, batch_size, threads, options.warmup));
+                printConfig(configs.back());
+            }
+        }
+    }
+
+    std::cout << "peak RSS: " << memory::peakRSS() / (1024.0 * 1024.0) << " MB" << std::endl;
+
+    if (!options.json_path.empty()) {
+        writeJson(options.json_path, configs);
+    }
+    return 0;
+}
@@ -2,6 +2,9 @@
 #include "readCSV.hpp"
 #include "nn/modules.hpp"
 #include "readMNIST.hpp"
+#include "Profiler.hpp"
+#include "Memory.hpp"
+#include "DataLoader.hpp"
 #include <cstddef>
 #include "iostream"
 
@@ -19,19 +22,36 @@ int main() {
     Tensor<float> csvData = readCSV<float>(csvFilePath);
     nn::Linear<float> fc1(csvData.shape()[1], csvData.shape()[0], std::move(csvData));
 
-    Tensor<float> X_te = readMNISTImages<float>(testImgPath);
+    // stream the test set in batches, the next batches are decoded while fc1 runs.
+    // keep the pixels as uint8, the 1/255 normalization is fused into fc1.
+    int batch_size = 1000;
+    DataLoader<uint8_t> loader(testImgPath, testLabelsPath, batch_size, false, 2);
 
-    Tensor<float> result = fc1.forward(X_te);
+    int correct = 0;
+    while (auto batch = loader.next()) {
+        int N = batch->size();
+        Tensor<uint8_t> X = batch->images.view({N, 28 * 28});
 
-    Tensor<int> label = readMNISTLabels<int>(testLabelsPath);
+        Tensor<float> result = fc1.forward(X, 1.0f / 255.0f);
 
-    Tensor<int> pred = result.argmax(1);
+        Tensor<int> pred = result.argmax(1);
 
-    // std::cout << pred << std::endl;
+        // std::cout << pred << std::endl;
 
-    Tensor<int> correct = (pred == label);
+        Tensor<int> match = (pred == batch->labels);
+        for (int i = 0; i < N; i++) {
+            correct += match.data_[i];
+        }
+    }
 
-    auto meanValue = correct.mean();
+    std::cout << static_cast<float>(correct) / loader.size() << std::endl;
 
-    std::cout << meanValue << std::endl;
+    // run with TENSORLIB_PROFILE=1 to get the per-op timings.
+    if (profiler::enabled()) {
+        profiler::printSummary(std::cout);
+    }
+    // run with TENSORLIB_MEMORY=1 to get the Tensor memory charged to each op.
+    if (memory::enabled()) {
+        memory::printSummary(std::cout);
+    }
 }
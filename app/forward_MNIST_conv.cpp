@@ -1,7 +1,10 @@
 #include "Tensor.hpp"
 #include "readCSV.hpp"
 #include "nn/modules.hpp"
+#include "nn/Sequential.hpp"
 #include "readMNIST.hpp"
+#include "Profiler.hpp"
+#include "Memory.hpp"
 #include <cstddef>
 #include "iostream"
 #include <chrono>
@@ -19,27 +22,25 @@ int main() {
 
     Tensor<float> conv1Weight = readCSV<float>(conv1WeightPath);
     conv1Weight = conv1Weight.view({1,1,3,3,});
-    nn::Conv2d<float> conv1(1,1,3,1,1,std::move(conv1Weight));
-
-    // nn::ReLU<float> relu;
 
     Tensor<float> fcWeight = readCSV<float>(fcWeightPath);
-    nn::Linear<float> fc1(fcWeight.shape()[1], fcWeight.shape()[0], std::move(fcWeight));
 
-    Tensor<float> X_te = readMNISTImages<float>(testImgPath);
+    // the activations of the layers share one arena planned for the input shape.
+    nn::Sequential<float> model;
+    model.add(nn::Conv2d<float>(1, 1, 3, 1, 1, std::move(conv1Weight)))
+         // .add(nn::ReLU<float>())
+         .add(nn::Flatten<float>())
+         .add(nn::Linear<float>(fcWeight.shape()[1], fcWeight.shape()[0], std::move(fcWeight)));
+
+    Tensor<uint8_t> X_te = readMNISTImages<uint8_t>(testImgPath);
     X_te = X_te.view({10000, 1,28, 28});
 
     // int slice_N = 100;
     int slice_N = 1000;
     X_te = X_te.slice(0, slice_N, 0);
 
-    Tensor<float> result1 = conv1.forward(X_te);
-    // result1 = result1.view({10000, 28 * 28});
-    // auto result2 = relu.forward(result1);
-
-    auto result2 = result1.view({slice_N, 28 * 28});
-
-    Tensor<float> result3 = fc1.forward(result2);
+    // the 1/255 normalization is fused into conv1.
+    const Tensor<float>& result3 = model.forward(X_te, 1.0f / 255.0f);
 
 
     Tensor<int> label = readMNISTLabels<int>(testLabelsPath);
@@ -56,5 +57,14 @@ int main() {
 
     std::cout << meanValue << std::endl;
 
+    // run with TENSORLIB_PROFILE=1 to get the per-op timings.
+    if (profiler::enabled()) {
+        profiler::printSummary(std::cout);
+    }
+    // run with TENSORLIB_MEMORY=1 to get the Tensor memory charged to each op.
+    if (memory::enabled()) {
+        memory::printSummary(std::cout);
+    }
+
     return 0;
 }
@@ -1,7 +1,10 @@
 #include "Tensor.hpp"
 #include "readCSV.hpp"
 #include "nn/modules.hpp"
+#include "nn/QuantizedLinear.hpp"
 #include "readMNIST.hpp"
+#include "Profiler.hpp"
+#include "Memory.hpp"
 #include <cstddef>
 #include "iostream"
 
@@ -17,21 +20,21 @@ const std::string csvFilePath = "../weights/fc_weight.csv";
 
 int main() {
     Tensor<float> csvData = readCSV<float>(csvFilePath);
-    Tensor<int> csvData_q = csvData.quantize();
 
-    nn::Linear<int> fc1(csvData_q.shape()[1], csvData_q.shape()[0], std::move(csvData_q));
+    // int8 weights with a scale per output row, see QuantizedLinear.hpp.
+    nn::QuantizedLinear fc1(csvData.shape()[1], csvData.shape()[0], csvData);
     // nn::Linear<float> fc1(csvData.shape()[1], csvData.shape()[0], std::move(csvData));
 
-    Tensor<float> X_te = readMNISTImages<float>(testImgPath);
-    Tensor<int> X_te_q = X_te.quantize();
-
-
-    Tensor<int> result = fc1.forward(X_te_q);
-    // Tensor<float> result = fc1.forward(X_te);
+    // uint8 pixels are already integers, feed them directly instead of
+    // normalizing to float and quantizing again, 1/255 is their scale.
+    Tensor<uint8_t> X_te = readMNISTImages<uint8_t>(testImgPath);
 
     Tensor<int> label = readMNISTLabels<int>(testLabelsPath);
 
-    Tensor<int> pred = result.argmax(1);
+    // pixels to classes in integers: the argmax runs on the weighed int32 accumulators,
+    // no float logits in between.
+    Tensor<int> pred = fc1.predict(X_te, 1.0f / 255.0f);
+    // Tensor<int> pred = fc1.forward(X_te, 1.0f / 255.0f).argmax(1);
 
     // std::cout << pred << std::endl;
 
@@ -40,4 +43,13 @@ int main() {
     auto meanValue = correct.mean();
 
     std::cout << meanValue << std::endl;
+
+    // run with TENSORLIB_PROFILE=1 to get the per-op timings.
+    if (profiler::enabled()) {
+        profiler::printSummary(std::cout);
+    }
+    // run with TENSORLIB_MEMORY=1 to get the Tensor memory charged to each op.
+    if (memory::enabled()) {
+        memory::printSummary(std::cout);
+    }
 }
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "ThreadPool.hpp"
+#include "Kernels.hpp"
+
+/**
+ * A small self-contained benchmark harness: each case is run warmup times, then timed
+ * for repetitions runs (at least min_time seconds in total), for every thread count of
+ * the sweep. Reports median/p99 latency and GFLOP/s, GB/s from the median, as a table
+ * and as JSON for tracking regressions across releases.
+ *
+ * command line:
+ *     --warmup N  --reps N  --min-time SECONDS  --threads 1,2,4  --filter SUBSTRING  --json PATH
+ */
+namespace bench {
+
+struct Options {
+    int warmup = 2;
+    int repetitions = 10;
+    double min_time = 0;
+    // default pool sizes to sweep, the current parallel::numThreads() when empty.
+    std::vector<int> threads;
+    // only run the cases whose name contains filter.
+    std::string filter;
+    std::string json_path;
+};
+
+struct Result {
+    std::string name;
+    std::string params;
+    int threads;
+    std::vector<double> seconds; // one per repetition
+    double flops;
+    double bytes;
+
+    // q-quantile of the repetition times, nearest rank.
+    double quantile(double q) const {
+        std::vector<double> sorted = seconds;
+        std::sort(sorted.begin(), sorted.end());
+        size_t idx = std::min(sorted.size() - 1, (size_t)(q * sorted.size()));
+        return sorted[idx];
+    }
+
+    double median() const { return quantile(0.5); }
+    double p99() const { return quantile(0.99); }
+    double min() const { return *std::min_element(seconds.begin(), seconds.end()); }
+    double mean() const {
+        double sum = 0;
+        for (auto s : seconds) sum += s;
+        return sum / seconds.size();
+    }
+    double gflops() const { return flops / median() * 1e-9; }
+    double gbytes() const { return bytes / median() * 1e-9; }
+};
+
+inline std::vector<int> parseList(const std::string& s) {
+    std::vector<int> values;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        values.push_back(std::stoi(item));
+    }
+    return values;
+}
+
+inline Options parseArgs(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--warmup") {
+            options.warmup = std::stoi(value());
+        } else if (arg == "--reps") {
+            options.repetitions = std::max(1, std::stoi(value()));
+        } else if (arg == "--min-time") {
+            options.min_time = std::stod(value());
+        } else if (arg == "--threads") {
+            options.threads = parseList(value());
+        } else if (arg == "--filter") {
+            options.filter = value();
+        } else if (arg == "--json") {
+            options.json_path = value();
+        } else {
+            throw std::invalid_argument("Unknown argument " + arg);
+        }
+    }
+    return options;
+}
+
+inline std::string cpuModel() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.rfind("model name", 0) == 0) {
+            return line.substr(line.find(':') + 2);
+        }
+    }
+    return "unknown";
+}
+
+inline void writeJsonString(std::ostream& os, const std::string& s) {
+    os << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') os << '\\';
+        os << c;
+    }
+    os << '"';
+}
+
+class Runner {
+public:
+    explicit Runner(const Options& options) : options_(options) {}
+
+    /**
+     * time fn, flops and bytes are the work of one call. setup runs before every call
+     * and is not timed, e.g. to rebuild an input consumed by fn.
+     */
+    void run(const std::string& name, const std::string& params, double flops, double bytes,
+             const std::function<void()>& fn, const std::function<void()>& setup = nullptr) {
+        if (!options_.filter.empty() && name.find(options_.filter) == std::string::npos) {
+            return;
+        }
+
+        std::vector<int> sweep = options_.threads;
+        if (sweep.empty()) {
+            sweep.push_back(parallel::numThreads());
+        }
+
+        for (int threads : sweep) {
+            parallel::setNumThreads(threads);
+
+            for (int i = 0; i < options_.warmup; i++) {
+                if (setup) setup();
+                fn();
+            }
+
+            Result result{name, params, threads, {}, flops, bytes};
+            double total = 0;
+            while ((int)result.seconds.size() < options_.repetitions || total < options_.min_time) {
+                if (setup) setup();
+                auto start = std::chrono::steady_clock::now();
+                fn();
+                auto end = std::chrono::steady_clock::now();
+                double seconds = std::chrono::duration<double>(end - start).count();
+                result.seconds.push_back(seconds);
+                total += seconds;
+            }
+
+            print(result);
+            results_.push_back(result);
+        }
+    }
+
+    const std::vector<Result>& results() const { return results_; }
+
+    void printHeader(std::ostream& os = std::cout) const {
+        os << std::left << std::setw(24) << "benchmark" << std::setw(28) << "params"
+           << std::right << std::setw(8) << "threads"
+           << std::setw(12) << "median(ms)" << std::setw(12) << "p99(ms)"
+           << std::setw(10) << "GFLOP/s" << std::setw(10) << "GB/s" << std::endl;
+    }
+
+    void print(const Result& r, std::ostream& os = std::cout) const {
+        auto flags = os.flags();
+        os << std::left << std::setw(24) << r.name << std::setw(28) << r.params
+           << std::right << std::setw(8) << r.threads << std::fixed << std::setprecision(3)
+           << std::setw(12) << r.median() * 1e3 << std::setw(12) << r.p99() * 1e3
+           << std::setw(10) << r.gflops() << std::setw(10) << r.gbytes() << std::endl;
+        os.flags(flags);
+    }
+
+    void writeJson(std::ostream& os) const {
+        char host[256] = "unknown";
+        gethostname(host, sizeof(host));
+        std::time_t now = std::time(nullptr);
+        char date[64];
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+        os << "{\n  \"context\": {\"date\": \"" << date << "\", \"host\": ";
+        writeJsonString(os, host);
+        os << ", \"cpu\": ";
+        writeJsonString(os, cpuModel());
+        os << ", \"isa\": \"" << cpu::isaName(kernels::activeISA()) << "\""
+           << ", \"max_threads\": " << parallel::availableCPUs().size()
+           << ", \"warmup\": " << options_.warmup << "},\n  \"benchmarks\": [";
+
+        for (size_t i = 0; i < results_.size(); i++) {
+            auto& r = results_[i];
+            os << (i > 0 ? "," : "") << "\n    {\"name\": ";
+            writeJsonString(os, r.name);
+            os << ", \"params\": ";
+            writeJsonString(os, r.params);
+            os << ", \"threads\": " << r.threads << ", \"repetitions\": " << r.seconds.size()
+               << ", \"median_ms\": " << r.median() * 1e3 << ", \"p99_ms\": " << r.p99() * 1e3
+               << ", \"mean_ms\": " << r.mean() * 1e3 << ", \"min_ms\": " << r.min() * 1e3
+               << ", \"flops\": " << r.flops << ", \"bytes\": " << r.bytes
+               << ", \"gflops\": " << r.gflops() << ", \"gbps\": " << r.gbytes() << "}";
+        }
+        os << "\n  ]\n}" << std::endl;
+    }
+
+    // write the JSON report to options.json_path when one was given.
+    void finish() const {
+        if (options_.json_path.empty()) {
+            return;
+        }
+        std::ofstream file(options_.json_path);
+        if (!file.is_open()) {
+            throw std::runtime_error("Error: Failed to open file " + options_.json_path);
+        }
+        writeJson(file);
+    }
+
+private:
+    Options options_;
+    std::vector<Result> results_;
+};
+
+} // namespace bench
@@ -0,0 +1,275 @@
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <zlib.h>
+#include "Benchmark.hpp"
+#include "Tensor.hpp"
+#include "Memory.hpp"
+#include "readCSV.hpp"
+#include "readIDX.hpp"
+#include "readMNIST.hpp"
+#include "MappedFile.hpp"
+#include "DataLoader.hpp"
+#include "nn/modules.hpp"
+
+/**
+ * Microbenchmarks of the Tensor kernels, nn modules and readers.
+ *
+ * usage:
+ *     tensor_bench --threads 1,2,4 --json bench.json
+ *     tensor_bench --filter matmul --reps 20
+ */
+
+static std::mt19937 rng(0);
+
+template <typename dtype>
+Tensor<dtype> randomTensor(const std::vector<int>& shape, double low = -1.0, double high = 1.0) {
+    size_t n = 1;
+    for (auto dim : shape) n *= dim;
+    auto data = memory::allocate<dtype>(n);
+    std::uniform_real_distribution<double> dist(low, high);
+    for (size_t i = 0; i < n; ++i) {
+        data[i] = static_cast<dtype>(dist(rng));
+    }
+    return Tensor<dtype>(shape, data);
+}
+
+static std::string shapeString(const std::vector<int>& shape) {
+    std::string s;
+    for (size_t i = 0; i < shape.size(); ++i) {
+        s += (i > 0 ? "x" : "") + std::to_string(shape[i]);
+    }
+    return s;
+}
+
+static std::string tmpPath(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// uint8 images in IDX format, gzip compressed when the path ends with .gz
+static void writeImages(const std::string& path, int n, int rows, int cols) {
+    gzFile file = gzopen(path.c_str(), path.size() > 3 && path.substr(path.size() - 3) == ".gz" ? "wb" : "wbT");
+    if (file == nullptr) {
+        throw std::runtime_error("Error: Failed to open file " + path);
+    }
+    uint8_t magic[4] = {0, 0, static_cast<uint8_t>(IDXType::UInt8), 3};
+    gzwrite(file, magic, 4);
+    for (uint32_t dim : {(uint32_t)n, (uint32_t)rows, (uint32_t)cols}) {
+        uint32_t be = __builtin_bswap32(dim);
+        gzwrite(file, &be, 4);
+    }
+    std::vector<uint8_t> pixels((size_t)n * rows * cols);
+    for (auto& p : pixels) p = static_cast<uint8_t>(rng() % 256);
+    gzwrite(file, pixels.data(), pixels.size());
+    gzclose(file);
+}
+
+static void writeLabels(const std::string& path, int n) {
+    gzFile file = gzopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("Error: Failed to open file " + path);
+    }
+    uint8_t magic[4] = {0, 0, static_cast<uint8_t>(IDXType::UInt8), 1};
+    uint32_t be = __builtin_bswap32((uint32_t)n);
+    gzwrite(file, magic, 4);
+    gzwrite(file, &be, 4);
+    std::vector<uint8_t> labels(n);
+    for (auto& l : labels) l = static_cast<uint8_t>(rng() % 10);
+    gzwrite(file, labels.data(), labels.size());
+    gzclose(file);
+}
+
+template <typename dtype>
+void benchMatmul(bench::Runner& runner, const char* name) {
+    std::vector<std::vector<int>> shapes = {
+        {32, 32, 32}, {64, 64, 64}, {128, 128, 128}, {256, 256, 256},
+        {1, 784, 10}, {100, 784, 10}, {1000, 784, 10},
+    };
+    for (auto& s : shapes) {
+        int M = s[0], K = s[1], N = s[2];
+        auto a = randomTensor<dtype>({M, K});
+        auto b = randomTensor<dtype>({K, N});
+        runner.run(name, "M=" + std::to_string(M) + " K=" + std::to_string(K) + " N=" + std::to_string(N),
+                   2.0 * M * K * N, (double)sizeof(dtype) * ((double)M * K + (double)K * N + (double)M * N),
+                   [&]() { a.matmul(b); });
+    }
+}
+
+void benchLinear(bench::Runner& runner) {
+    for (int batch : {1, 100, 1000}) {
+        nn::Linear<float> fc(784, 10, randomTensor<float>({10, 784}));
+        auto x = randomTensor<float>({batch, 784});
+        auto x8 = randomTensor<uint8_t>({batch, 784}, 0, 255);
+        std::string params = "N=" + std::to_string(batch) + " 784->10";
+        double flops = 2.0 * batch * 784 * 10;
+
+        runner.run("Linear", params, flops, 4.0 * (batch * 784 + 784 * 10 + batch * 10),
+                   [&]() { fc.forward(x); });
+        runner.run("Linear(uint8)", params, flops, batch * 784 + 4.0 * (784 * 10 + batch * 10),
+                   [&]() { fc.forward(x8, 1.0f / 255.0f); });
+
+        // the same layer with the sizes in the type.
+        nn::StaticLinear<float, 784, 10> fixed(randomTensor<float>({10, 784}));
+        runner.run("StaticLinear", params, flops, 4.0 * (batch * 784 + 784 * 10 + batch * 10),
+                   [&]() { fixed.forward(x); });
+        runner.run("StaticLinear(uint8)", params, flops, batch * 784 + 4.0 * (784 * 10 + batch * 10),
+                   [&]() { fixed.forward(x8, 1.0f / 255.0f); });
+    }
+}
+
+void benchConv2d(bench::Runner& runner) {
+    struct Config { int n, c_in, hw, c_out, kernel, stride, padding; };
+    // the float path is slow, keep its batches small.
+    std::vector<Config> configs = {
+        {8, 1, 28, 1, 3, 1, 1},
+        {8, 1, 28, 4, 5, 1, 2},
+        {4, 3, 32, 8, 3, 1, 1},
+        {4, 3, 32, 8, 3, 2, 0},
+    };
+    for (auto& c : configs) {
+        nn::Conv2d<float> conv(c.c_in, c.c_out, c.kernel, c.stride, c.padding,
+                               randomTensor<float>({c.c_out, c.c_in, c.kernel, c.kernel}));
+        auto x = randomTensor<float>({c.n, c.c_in, c.hw, c.hw});
+        auto x8 = randomTensor<uint8_t>({c.n, c.c_in, c.hw, c.hw}, 0, 255);
+        int out = (c.hw + 2 * c.padding - c.kernel) / c.stride + 1;
+        double flops = 2.0 * c.n * c.c_out * out * out * c.c_in * c.kernel * c.kernel;
+        double in_elems = (double)c.n * c.c_in * c.hw * c.hw;
+        double out_elems = (double)c.n * c.c_out * out * out;
+        double weight_elems = (double)c.c_out * c.c_in * c.kernel * c.kernel;
+        std::string params = shapeString({c.n, c.c_in, c.hw, c.hw}) + " k" + std::to_string(c.kernel) +
+                             " s" + std::to_string(c.stride) + " p" + std::to_string(c.padding) +
+                             " ->" + std::to_string(c.c_out);
+
+        runner.run("Conv2d", params, flops, 4.0 * (in_elems + weight_elems + out_elems),
+                   [&]() { conv.forward(x); });
+        runner.run("Conv2d(uint8)", params, flops, in_elems + 4.0 * (weight_elems + out_elems),
+                   [&]() { conv.forward(x8, 1.0f / 255.0f); });
+    }
+
+    // the MNIST conv layer with the sizes in the type, against the dynamic Conv2d.
+    for (int batch : {1, 100, 1000}) {
+        auto weight = randomTensor<float>({1, 1, 3, 3});
+        nn::StaticConv2d<float, 1, 1, 3, 1, 1, 28, 28> fixed(weight);
+        nn::Conv2d<float> conv(1, 1, 3, 1, 1, std::move(weight));
+        auto x = randomTensor<float>({batch, 1, 28, 28});
+        auto x8 = randomTensor<uint8_t>({batch, 1, 28, 28}, 0, 255);
+        double flops = 2.0 * batch * 28 * 28 * 9;
+        std::string params = shapeString({batch, 1, 28, 28}) + " k3 s1 p1 ->1";
+
+        runner.run("Conv2d", params, flops, 8.0 * batch * 28 * 28, [&]() { conv.forward(x); });
+        runner.run("StaticConv2d", params, flops, 8.0 * batch * 28 * 28, [&]() { fixed.forward(x); });
+        runner.run("Conv2d(uint8)", params, flops, 5.0 * batch * 28 * 28, [&]() { conv.forward(x8, 1.0f / 255.0f); });
+        runner.run("StaticConv2d(uint8)", params, flops, 5.0 * batch * 28 * 28,
+                   [&]() { fixed.forward(x8, 1.0f / 255.0f); });
+    }
+}
+
+void benchReductions(bench::Runner& runner) {
+    for (int rows : {1000, 10000, 100000}) {
+        auto logits = randomTensor<float>({rows, 10});
+        runner.run("argmax", shapeString({rows, 10}) + " dim=1", (double)rows * 10, 4.0 * rows * 10 + 4.0 * rows,
+                   [&]() { logits.argmax(1); });
+    }
+
+    for (auto& shape : std::vector<std::vector<int>>{{64, 1, 28, 28}, {16, 8, 32, 32}, {32, 32, 32}}) {
+        auto t = randomTensor<float>(shape);
+        double n = t.num_elements;
+        runner.run("sum", shapeString(shape), n, 4.0 * n, [&]() { t.sum(); });
+    }
+
+    for (int n : {10000, 1000000}) {
+        auto t = randomTensor<int>({n}, 0, 2);
+        runner.run("mean", shapeString({n}), n, 4.0 * n, [&]() { t.mean(); });
+    }
+}
+
+void benchContiguous(bench::Runner& runner) {
+    for (auto& shape : std::vector<std::vector<int>>{{784, 10}, {1000, 784}, {1024, 1024}}) {
+        auto t = randomTensor<float>(shape).transpose(0, 1);
+        double n = t.num_elements;
+        runner.run("contiguous", shapeString(shape) + " transposed", 0, 2 * 4.0 * n,
+                   [&]() { t.contiguous(); });
+    }
+}
+
+void benchReaders(bench::Runner& runner) {
+    // the CSV layout of the Linear weights, rows x cols floats.
+    for (auto& shape : std::vector<std::vector<int>>{{10, 784}, {128, 784}}) {
+        std::string path = tmpPath("tensor_bench_" + shapeString(shape) + ".csv");
+        {
+            std::ofstream file(path);
+            auto t = randomTensor<float>(shape);
+            for (int i = 0; i < shape[0]; ++i) {
+                for (int j = 0; j < shape[1]; ++j) {
+                    file << (j > 0 ? "," : "") << t.getData({i, j});
+                }
+                file << "\n";
+            }
+        }
+        double bytes = std::filesystem::file_size(path);
+        runner.run("readCSV", shapeString(shape), 0, bytes, [&]() { readCSV<float>(path); });
+        std::remove(path.c_str());
+    }
+
+    const int N = 10000, ROWS = 28, COLS = 28;
+    std::string gz_images = tmpPath("tensor_bench-images-idx3-ubyte.gz");
+    std::string raw_images = tmpPath("tensor_bench-images-idx3-ubyte");
+    std::string gz_labels = tmpPath("tensor_bench-labels-idx1-ubyte.gz");
+    writeImages(gz_images, N, ROWS, COLS);
+    writeImages(raw_images, N, ROWS, COLS);
+    writeLabels(gz_labels, N);
+
+    std::string params = shapeString({N, ROWS, COLS});
+    double bytes = (double)N * ROWS * COLS;
+    runner.run("readIDX(uint8)", params + " gz", 0, bytes, [&]() { readIDX<uint8_t>(gz_images); });
+    runner.run("readIDX(uint8)", params + " raw", 0, bytes, [&]() { readIDX<uint8_t>(raw_images); });
+    runner.run("readIDX(float)", params + " gz", 0, bytes, [&]() { readIDX<float>(gz_images); });
+    runner.run("readMNISTImages", params + " gz", 0, bytes, [&]() { readMNISTImages<float>(gz_images); });
+    // touch one byte of every image, mapping alone does not read the file.
+    runner.run("mmapIDX(uint8)", params + " raw", 0, bytes, [&]() {
+        auto images = mmapIDX<uint8_t>(raw_images);
+        volatile uint8_t sink = 0;
+        for (int i = 0; i < N; ++i) {
+            sink += images.getData({i, 0, 0});
+        }
+    });
+
+    for (int workers : {1, 2, 4}) {
+        runner.run("DataLoader(uint8)", params + " B=1000 workers=" + std::to_string(workers), 0, bytes, [&]() {
+            DataLoader<uint8_t> loader(gz_images, gz_labels, 1000, false, workers);
+            while (auto batch = loader.next()) {
+            }
+        });
+    }
+
+    std::remove(gz_images.c_str());
+    std::remove(raw_images.c_str());
+    std::remove(gz_labels.c_str());
+}
+
+int main(int argc, char** argv) {
+    bench::Options options;
+    try {
+        options = bench::parseArgs(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << "usage: tensor_bench [--warmup N] [--reps N] [--min-time SECONDS] "
+                     "[--threads 1,2,4] [--filter SUBSTRING] [--json PATH]" << std::endl;
+        return 1;
+    }
+
+    bench::Runner runner(options);
+    runner.printHeader();
+
+    benchMatmul<float>(runner, "matmul(float)");
+    benchMatmul<int>(runner, "matmul(int)");
+    benchLinear(runner);
+    benchConv2d(runner);
+    benchReductions(runner);
+    benchContiguous(runner);
+    benchReaders(runner);
+
+    runner.finish();
+    return 0;
+}
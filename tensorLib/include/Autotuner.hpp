@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include "Kernels.hpp"
+
+/**
+ * Shape-specialized autotuning of the float matmul and Conv2d kernels.
+ *
+ * With tuning enabled (tuner::enable() or TENSORLIB_AUTOTUNE=1), the first time a shape
+ * is seen its candidate configurations are timed on scratch buffers of that shape:
+ *     matmul: GEMM blocking (mc, kc, nc), then the thread count,
+ *     Conv2d: direct vs im2col + GEMM, then the thread count.
+ * The winner is kept in memory and written to an on-disk cache keyed by CPU model, ISA,
+ * available threads and shape, so later runs on the same kind of host reuse it without
+ * tuning. The cache is read even when tuning is disabled, shapes that are not in it use
+ * the default configuration.
+ *
+ * The cache is a text file, TENSORLIB_TUNING_CACHE or ~/.cache/tensorlib/tuning.txt,
+ * entries of other CPUs are kept so one file can be shared by a heterogeneous fleet.
+ *
+ * Each thread remembers the configurations it looked up, a repeated shape is answered
+ * without a lock, so concurrent models in their own pools do not wait on each other.
+ */
+namespace tuner {
+
+bool enabled();
+
+void enable(bool on = true);
+
+// configuration for C(M x N) = A(M x K) * B, B given as (N x K) when transposed_b.
+kernels::GemmConfig gemm(int M, int N, int K, bool transposed_b);
+
+kernels::ConvConfig conv2d(int N, int C_in, int H, int W, int C_out, int kernel, int stride, int padding);
+
+// the cache file, set before the first lookup to use another file.
+std::string cachePath();
+void setCachePath(const std::string& path);
+
+// forget the entries in memory, the cache file is read again at the next lookup.
+void clear();
+
+// number of entries known for this host.
+size_t size();
+
+} // namespace tuner
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+
+/**
+ * CPU feature detection for the kernel dispatch, see Kernels.hpp.
+ *
+ * The instruction sets are detected once from CPUID, AVX and AVX-512 also require the
+ * OS to save their registers (XCR0), otherwise they are reported as unsupported.
+ */
+namespace cpu {
+
+// ordered from the most portable to the fastest.
+enum class ISA {
+    Scalar,
+    SSE42,
+    AVX2,    // with FMA
+    AVX512,  // F, BW, DQ, VL
+};
+
+// "scalar", "sse4.2", "avx2", "avx512"
+const char* isaName(ISA isa);
+
+// parse an isaName, return false for an unknown name.
+bool parseISA(const std::string& name, ISA& isa);
+
+// whether this CPU (and OS) can run code compiled for isa.
+bool supported(ISA isa);
+
+// the fastest supported ISA.
+ISA best();
+
+// CPU brand string, e.g. "Intel(R) Xeon(R) Gold 6248 CPU @ 2.50GHz", "unknown" when not available.
+std::string modelName();
+
+} // namespace cpu
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Tensor.hpp"
+#include "readIDX.hpp"
+#include "Profiler.hpp"
+
+/**
+ * Streams (images, labels) mini-batches from a pair of IDX files.
+ *
+ * Only prefetch batches are resident at any time, so memory is bounded by
+ * batch_size * prefetch records whatever the dataset size. num_workers threads decode
+ * batches ahead of the consumer: the gzip stream itself can only be inflated in order,
+ * so a worker holds the reader while it pulls the raw records of its batch, then converts
+ * them to dtype and publishes the batch without blocking the other workers.
+ *
+ * With shuffle, samples are drawn from a shuffle buffer of batch_size * prefetch
+ * records (a compressed stream can't be read at random positions), the same trade-off
+ * made by streaming loaders such as tf.data.
+ *
+ * usage:
+ *     DataLoader<uint8_t> loader(imgPath, labelPath, 1000);
+ *     while (auto batch = loader.next()) {
+ *         auto result = fc1.forward(batch->images.view({batch->size(), 784}));
+ *     }
+ */
+template <typename dtype>
+class DataLoader {
+public:
+    struct Batch {
+        Batch(Tensor<dtype>&& images, Tensor<int>&& labels)
+            : images(std::move(images)), labels(std::move(labels)) {}
+
+        int size() const { return labels.shape()[0]; }
+
+        // (B, record shape...), e.g. (B, 28, 28) for MNIST
+        Tensor<dtype> images;
+        // (B)
+        Tensor<int> labels;
+    };
+
+    DataLoader(const std::string& imagePath, const std::string& labelPath, int batch_size,
+               bool shuffle = false, int num_workers = 1, int prefetch = 2, unsigned seed = 0);
+    ~DataLoader();
+
+    DataLoader(const DataLoader&) = delete;
+    DataLoader& operator=(const DataLoader&) = delete;
+
+    // return the next batch in order, or std::nullopt when the dataset is exhausted.
+    std::optional<Batch> next();
+
+    int size() const { return num_records; }
+    int num_batches() const { return (num_records + batch_size - 1) / batch_size; }
+    const std::vector<int>& record_shape() const { return images_reader.recordShape(); }
+
+private:
+    void worker();
+    // wake up every waiting worker and make them exit.
+    void shutdown();
+    // read the raw records of one batch in dataset (or shuffled) order, called with read_mutex held.
+    void read_raw(int count, std::vector<uint8_t>& raw_images, std::vector<uint8_t>& raw_labels);
+
+    int batch_size;
+    int prefetch;
+    bool shuffle;
+    int num_records;
+
+    IDXReader images_reader;
+    IDXReader labels_reader;
+
+    // reader state, only touched with read_mutex held by the worker whose turn it is.
+    std::mutex read_mutex;
+    std::condition_variable read_cv;
+    int next_read = 0;
+    std::mt19937 rng;
+    std::vector<uint8_t> shuffle_images;
+    std::vector<uint8_t> shuffle_labels;
+    int shuffle_count = 0;
+    int records_read = 0;
+
+    // batch ring shared by workers and the consumer, batch b goes to slots[b % prefetch].
+    std::mutex mutex;
+    std::condition_variable slot_cv;  // workers wait for a free slot
+    std::condition_variable ready_cv; // consumer waits for the next batch
+    std::vector<std::optional<Batch>> slots;
+    int next_claim = 0;
+    int consumed = 0;
+    // also read by the workers waiting on read_cv, set on destruction or on the first error.
+    std::atomic<bool> stop{false};
+    std::exception_ptr error;
+
+    std::vector<std::thread> workers;
+};
+
+template <typename dtype>
+DataLoader<dtype>::DataLoader(const std::string& imagePath, const std::string& labelPath, int batch_size,
+                              bool shuffle, int num_workers, int prefetch, unsigned seed)
+    : batch_size(batch_size), prefetch(std::max(prefetch, 1)), shuffle(shuffle),
+      images_reader(imagePath), labels_reader(labelPath), rng(seed), slots(std::max(prefetch, 1)) {
+    if (batch_size <= 0) {
+        throw std::invalid_argument("batch_size should be positive.");
+    }
+    if (images_reader.numRecords() != labels_reader.numRecords() || labels_reader.recordElements() != 1) {
+        throw std::invalid_argument("The images and labels files do not match.");
+    }
+    num_records = images_reader.numRecords();
+
+    if (shuffle) {
+        // the buffer holds one window of records, refilled one record at a time as samples are drawn.
+        int window = std::min(num_records, batch_size * this->prefetch);
+        shuffle_images.resize((size_t)window * images_reader.recordBytes());
+        shuffle_labels.resize((size_t)window * labels_reader.recordBytes());
+        images_reader.read(shuffle_images.data(), window);
+        labels_reader.read(shuffle_labels.data(), window);
+        shuffle_count = window;
+        records_read = window;
+    }
+
+    for (int i = 0; i < std::max(num_workers, 1); i++) {
+        workers.emplace_back(&DataLoader<dtype>::worker, this);
+    }
+}
+
+template <typename dtype>
+DataLoader<dtype>::~DataLoader() {
+    shutdown();
+
+    for (auto& t : workers) {
+        t.join();
+    }
+}
+
+template <typename dtype>
+void DataLoader<dtype>::shutdown() {
+    // take each mutex so that no waiter misses the notification between its check and its wait.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    slot_cv.notify_all();
+    ready_cv.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(read_mutex);
+    }
+    read_cv.notify_all();
+}
+
+template <typename dtype>
+void DataLoader<dtype>::read_raw(int count, std::vector<uint8_t>& raw_images, std::vector<uint8_t>& raw_labels) {
+    size_t image_bytes = images_reader.recordBytes();
+    size_t label_bytes = labels_reader.recordBytes();
+
+    if (!shuffle) {
+        images_reader.read(raw_images.data(), count);
+        labels_reader.read(raw_labels.data(), count);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int j = std::uniform_int_distribution<int>(0, shuffle_count - 1)(rng);
+        std::memcpy(&raw_images[i * image_bytes], &shuffle_images[j * image_bytes], image_bytes);
+        std::memcpy(&raw_labels[i * label_bytes], &shuffle_labels[j * label_bytes], label_bytes);
+
+        if (records_read < num_records) {
+            // replace the drawn record by the next one in the file.
+            images_reader.read(&shuffle_images[j * image_bytes], 1);
+            labels_reader.read(&shuffle_labels[j * label_bytes], 1);
+            records_read++;
+        } else {
+            // the file is exhausted, shrink the buffer.
+            shuffle_count--;
+            std::memcpy(&shuffle_images[j * image_bytes], &shuffle_images[shuffle_count * image_bytes], image_bytes);
+            std::memcpy(&shuffle_labels[j * label_bytes], &shuffle_labels[shuffle_count * label_bytes], label_bytes);
+        }
+    }
+}
+
+template <typename dtype>
+void DataLoader<dtype>::worker() {
+    // raw buffers are reused for every batch this worker decodes.
+    std::vector<uint8_t> raw_images((size_t)batch_size * images_reader.recordBytes());
+    std::vector<uint8_t> raw_labels((size_t)batch_size * labels_reader.recordBytes());
+
+    while (true) {
+        int b;
+        {
+            // claim a batch, and wait until its slot is free so at most prefetch batches are resident.
+            std::unique_lock<std::mutex> lock(mutex);
+            if (stop || error || next_claim >= num_batches()) {
+                return;
+            }
+            b = next_claim++;
+            slot_cv.wait(lock, [&] { return stop || b < consumed + prefetch; });
+            if (stop) {
+                return;
+            }
+        }
+
+        try {
+            int count = std::min(batch_size, num_records - b * batch_size);
+            {
+                // records must be read in batch order, wait for our turn.
+                std::unique_lock<std::mutex> lock(read_mutex);
+                read_cv.wait(lock, [&] { return next_read == b || stop; });
+                if (stop) {
+                    return;
+                }
+                read_raw(count, raw_images, raw_labels);
+                next_read++;
+            }
+            read_cv.notify_all();
+
+            PROFILE_OP("DataLoader", 0, (double)count * (images_reader.recordBytes() + labels_reader.recordBytes()));
+
+            std::vector<int> shape = {count};
+            shape.insert(shape.end(), record_shape().begin(), record_shape().end());
+            Tensor<dtype> images(shape);
+            Tensor<int> labels(std::vector<int>{count});
+            decodeIDX(images_reader.type(), raw_images.data(), &images.data_[0], (size_t)count * images_reader.recordElements());
+            decodeIDX(labels_reader.type(), raw_labels.data(), &labels.data_[0], (size_t)count);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                slots[b % prefetch].emplace(std::move(images), std::move(labels));
+            }
+            ready_cv.notify_all();
+        } catch (...) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            // the batches after this one can't be read any more, stop the other workers too.
+            shutdown();
+            return;
+        }
+    }
+}
+
+template <typename dtype>
+std::optional<typename DataLoader<dtype>::Batch> DataLoader<dtype>::next() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (consumed >= num_batches()) {
+        return std::nullopt;
+    }
+
+    auto& slot = slots[consumed % prefetch];
+    ready_cv.wait(lock, [&] { return slot.has_value() || error; });
+    if (!slot.has_value()) {
+        std::rethrow_exception(error);
+    }
+
+    std::optional<Batch> batch = std::move(slot);
+    slot.reset();
+    consumed++;
+    lock.unlock();
+    slot_cv.notify_all();
+
+    return batch;
+}
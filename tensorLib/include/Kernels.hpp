@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "CpuFeatures.hpp"
+
+/**
+ * Hot kernels with runtime CPU dispatch.
+ *
+ * The kernels are written once in src/kernels/KernelsISA.cpp and compiled once per
+ * instruction set (scalar, SSE4.2, AVX2, AVX-512) with the matching -m flags, each copy
+ * in its own namespace. At startup the fastest variant the CPU supports is selected, so
+ * one binary runs at full speed on any x86-64 host. The TENSORLIB_ISA environment
+ * variable (scalar, sse4.2, avx2, avx512) overrides the choice, e.g. to compare variants
+ * or to work around a bad one. Non x86 builds only have the scalar variant.
+ *
+ * All matrices are row-major, ld* is the distance in elements between two rows.
+ *
+ * usage:
+ *     kernels::active().gemm_f32(M, N, K, a, K, b, N, c, N, kernels::GemmConfig{});
+ */
+namespace kernels {
+
+// GEMM tuning parameters, 0 keeps the default. See Autotuner.hpp.
+struct GemmConfig {
+    int mc = 0;       // rows of A per block
+    int kc = 0;       // depth per block
+    int nc = 0;       // columns of B per block
+    int threads = 0;  // at most this many threads of the pool, 0 for all parallel::numThreads()
+};
+
+enum class ConvAlgorithm {
+    Im2col,  // im2col + GEMM per image
+    Direct,  // direct convolution per image
+};
+
+struct ConvConfig {
+    ConvAlgorithm algorithm = ConvAlgorithm::Im2col;
+    int threads = 0;  // as in GemmConfig, images are split across the threads
+};
+
+// channels per block of the blocked (NCHWc) activation layout.
+const int CONV_BLOCK = 8;
+
+struct KernelTable {
+    const char* name;
+
+    // C(M x N) = A(M x K) * B(K x N)
+    void (*gemm_f32)(int M, int N, int K, const float* A, int lda, const float* B, int ldb, float* C, int ldc,
+                     const GemmConfig& config);
+
+    // C(M x N) = A(M x K) * B(N x K)^T, e.g. Linear with its (out_features, in_features) weight.
+    // only config.threads applies.
+    void (*gemm_nt_f32)(int M, int N, int K, const float* A, int lda, const float* B, int ldb, float* C, int ldc,
+                        const GemmConfig& config);
+
+    // C(M x N) = scale * A(M x K) * B(N x K)^T, uint8 activations with float weights.
+    void (*gemm_nt_u8f32)(int M, int N, int K, const uint8_t* A, int lda, const float* B, int ldb,
+                          float* C, int ldc, float scale);
+
+    // C(M x N) = A(M x K) * B(N x K)^T, uint8 activations with quantized weights, int32 accumulators.
+    void (*gemm_nt_u8i32)(int M, int N, int K, const uint8_t* A, int lda, const int32_t* B, int ldb,
+                          int32_t* C, int ldc);
+
+    // C(M x N) = A(M x K) * B(N x K)^T, uint8 activations with int8 weights, int32 accumulators.
+    // the zero points and scales are applied by the caller, see Quantize.hpp.
+    void (*gemm_nt_u8s8i32)(int M, int N, int K, const uint8_t* A, int lda, const int8_t* B, int ldb,
+                            int32_t* C, int ldc);
+
+    // C(M x N) = A(M x K) * W(N x K)^T, float activations with packed 4 bit weights (see
+    // quant::PackedWeight4): row j of W is ldb bytes from the last, its group g of group_size
+    // columns is scales[j * K / group_size + g] * (u - zero_points[...]), dequantized in
+    // registers while accumulating in float.
+    void (*gemm_nt_f32_u4)(int M, int N, int K, const float* A, int lda, const uint8_t* B, int ldb,
+                           const float* scales, const int32_t* zero_points, int group_size, float* C, int ldc);
+
+    // C(M x N) = A(M x K) * W(N x K)^T with W sparse in blocks of block_rows x block_cols,
+    // 1x1 (CSR), 1x4 or 4x4 (see sparse::Matrix): block row r holds blocks row_ptr[r] to
+    // row_ptr[r + 1], block b starts at column col_idx[b] with its values row major at
+    // values + b * block_rows * block_cols. Rows of the last block row past N are skipped.
+    void (*spmm_nt_f32)(int M, int N, const float* A, int lda, const int32_t* row_ptr, const int32_t* col_idx,
+                        const float* values, int block_rows, int block_cols, float* C, int ldc);
+
+    // one image (C, H, W) to columns (C * kernel * kernel, H_out * W_out), zero padded.
+    void (*im2col_f32)(const float* input, int C, int H, int W, int kernel, int stride, int padding, float* columns);
+
+    // one uint8 image (C, H, W) to rows (H_out * W_out, C * kernel * kernel), one output pixel per row
+    // so it is the A of gemm_nt_u8s8i32. Each value is XORed with flip (0x80 reads int8 as uint8 + 128),
+    // padding is pad, the input zero point, so it stands for 0.
+    void (*im2row_u8)(const uint8_t* input, int C, int H, int W, int kernel, int stride, int padding, uint8_t pad,
+                      uint8_t flip, uint8_t* rows);
+
+    // direct convolution of one image (C_in, H, W) with weight (C_out, C_in, kernel, kernel) into (C_out, H_out, W_out).
+    void (*conv2d_direct_f32)(const float* input, int C_in, int H, int W, const float* weight, int C_out,
+                              int kernel, int stride, int padding, float* output);
+
+    // direct convolution of one image into the blocked layout (C_out / CONV_BLOCK, H_out, W_out, CONV_BLOCK),
+    // the channels of a block computed as one vector. input is (C_in, H, W) for in_lanes = 1 or blocked
+    // the same way for in_lanes = CONV_BLOCK, weight is (C_out / CONV_BLOCK, C_in, kernel, kernel, CONV_BLOCK).
+    // C_out must be a multiple of CONV_BLOCK.
+    void (*conv2d_nchwc_f32)(const float* input, int C_in, int H, int W, int in_lanes, const float* weight,
+                             int C_out, int kernel, int stride, int padding, float* output);
+
+    // y = max(floor, max of each kernel x kernel window) over C planes of (H, W, lanes), no padding.
+    // floor = 0 fuses a ReLU, -inf pools only.
+    void (*maxpool2d_f32)(const float* x, int C, int H, int W, int lanes, int kernel, int stride, float floor,
+                          float* y);
+
+    float (*sum_f32)(const float* x, size_t n);
+
+    // index of the max of each of the rows, the first one on ties.
+    void (*argmax_rows_f32)(const float* x, int rows, int cols, int ld, int32_t* out);
+
+    // y = max(x, s), ReLU for s = 0
+    void (*maximum_f32)(const float* x, float s, float* y, size_t n);
+
+    // y = scale * x, e.g. normalizing uint8 pixels with scale = 1/255
+    void (*scale_u8_f32)(const uint8_t* x, float scale, float* y, size_t n);
+
+    // y (rows, cols) += bias, bias[r] along each row for per_row (the channels of a conv
+    // output), else bias[c] down each column (the features of a Linear output).
+    void (*bias_add_f32)(float* y, int rows, int cols, const float* bias, bool per_row);
+};
+
+// the kernels of the selected ISA.
+const KernelTable& active();
+
+cpu::ISA activeISA();
+
+// the kernels compiled for isa, nullptr when they are not built or the CPU does not support them.
+const KernelTable* table(cpu::ISA isa);
+
+// switch every following call to the kernels of isa, return false (and keep the current ones) if not available.
+bool setISA(cpu::ISA isa);
+
+/**
+ * batched float convolution with the active kernels.
+ * input (N, C_in, H, W), weight (C_out, C_in, kernel, kernel), output (N, C_out, H_out, W_out), all contiguous.
+ * workspace holds conv2d_workspace_f32() floats of scratch, nullptr to allocate it per call.
+ * bias (C_out) is added to each image right after its convolution, nullptr for none.
+ */
+void conv2d_f32(const float* input, int N, int C_in, int H, int W, const float* weight, int C_out,
+                int kernel, int stride, int padding, float* output, const ConvConfig& config,
+                float* workspace = nullptr, const float* bias = nullptr);
+
+// floats of scratch conv2d_f32 needs with config on the current pool.
+size_t conv2d_workspace_f32(int N, int C_in, int H, int W, int kernel, int stride, int padding,
+                            const ConvConfig& config);
+
+} // namespace kernels
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "Tensor.hpp"
+#include "readIDX.hpp"
+
+/**
+ * Tensors backed by a memory-mapped file instead of a heap array, so data larger than
+ * RAM can be represented: the kernel pages the data in when it is touched and can drop
+ * clean pages again under memory pressure. slice/select views share the mapping, and the
+ * file is unmapped when the last Tensor using it is destroyed.
+ */
+
+// access pattern hints passed to madvise.
+enum class MapAdvice {
+    Normal,
+    Sequential, // read ahead aggressively, drop pages behind
+    Random,     // no read ahead
+    WillNeed,   // start paging in now
+};
+
+/**
+ * map length bytes of path starting at offset (need not be page aligned).
+ * writable maps the file shared, so writes go to the file, otherwise the mapping is
+ * read only and writing to it crashes. With create, the file is created (or truncated)
+ * with offset + length bytes first.
+ * the returned pointer unmaps the file when released.
+ */
+std::shared_ptr<uint8_t> mapFile(const std::string& path, size_t length, size_t offset,
+                                 bool writable, bool create, MapAdvice advice);
+
+// madvise over [addr, addr + length), the range is widened to whole pages.
+void adviseMapping(const void* addr, size_t length, MapAdvice advice);
+
+/**
+ * a Tensor of the given shape over the bytes of path starting at offset, the elements
+ * are read in host byte order.
+ */
+template <typename dtype>
+Tensor<dtype> mmapTensor(const std::string& path, const std::vector<int>& shape, size_t offset = 0,
+                         bool writable = false, MapAdvice advice = MapAdvice::Sequential) {
+    if (offset % alignof(dtype) != 0) {
+        throw std::invalid_argument("The offset is not aligned for the element type.");
+    }
+
+    long long num = 1;
+    for (auto dim : shape) {
+        num *= dim;
+    }
+    if (num > INT_MAX) {
+        throw std::invalid_argument("Too many elements for one Tensor.");
+    }
+
+    auto bytes = mapFile(path, num * sizeof(dtype), offset, writable, false, advice);
+
+    // the deleter holds the mapping, so it lives as long as the Tensor and its views.
+    return Tensor<dtype>::from_blob(reinterpret_cast<dtype*>(bytes.get()), shape, {}, [bytes](dtype*) {});
+}
+
+/**
+ * create (or truncate) path to hold a Tensor of the given shape and map it writable,
+ * e.g. to dump activations that don't fit in memory.
+ */
+template <typename dtype>
+Tensor<dtype> createMappedTensor(const std::string& path, const std::vector<int>& shape,
+                                 MapAdvice advice = MapAdvice::Sequential) {
+    long long num = 1;
+    for (auto dim : shape) {
+        num *= dim;
+    }
+    if (num > INT_MAX) {
+        throw std::invalid_argument("Too many elements for one Tensor.");
+    }
+
+    auto bytes = mapFile(path, num * sizeof(dtype), 0, true, true, advice);
+
+    return Tensor<dtype>::from_blob(reinterpret_cast<dtype*>(bytes.get()), shape, {}, [bytes](dtype*) {});
+}
+
+/**
+ * map an uncompressed IDX file without reading it. Only single byte dtypes (uint8, int8)
+ * can be mapped as is, wider IDX types are big-endian and need readIDX to convert them.
+ */
+template <typename dtype>
+Tensor<dtype> mmapIDX(const std::string& path, MapAdvice advice = MapAdvice::Sequential) {
+    gzFile file = gzopen(path.c_str(), "rb");
+    if (file == NULL) {
+        throw std::runtime_error("Error: Failed to open IDX file " + path);
+    }
+    IDXHeader header;
+    bool compressed;
+    try {
+        header = readIDXHeader(file, path);
+        compressed = gzdirect(file) == 0;
+    } catch (...) {
+        gzclose(file);
+        throw;
+    }
+    gzclose(file);
+
+    if (compressed) {
+        throw std::runtime_error("Error: Can't map a compressed IDX file " + path);
+    }
+    bool matched = (header.type == IDXType::UInt8 && std::is_same<dtype, uint8_t>::value) ||
+                   (header.type == IDXType::Int8 && std::is_same<dtype, int8_t>::value);
+    if (!matched) {
+        throw std::runtime_error("Error: IDX data type can't be mapped as the Tensor type " + path);
+    }
+
+    return mmapTensor<dtype>(path, header.shape, header.headerBytes, false, advice);
+}
+
+/**
+ * hint the access pattern of the memory under a view, e.g. WillNeed on the next batch
+ * slice while the current one is computed.
+ */
+template <typename dtype>
+void adviseTensor(const Tensor<dtype>& tensor, MapAdvice advice) {
+    // the view spans from its first element to its last one.
+    size_t last = tensor.offset();
+    for (size_t i = 0; i < tensor.shape().size(); i++) {
+        if (tensor.shape()[i] == 0) {
+            return;
+        }
+        last += (size_t)(tensor.shape()[i] - 1) * tensor.stride()[i];
+    }
+    const dtype* begin = &tensor.data_[tensor.offset()];
+    adviseMapping(begin, (last - tensor.offset() + 1) * sizeof(dtype), advice);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "Numa.hpp"
+
+/**
+ * Memory accounting for Tensor storage.
+ *
+ * Every heap storage allocated by a Tensor goes through memory::allocate, which keeps
+ * live bytes, peak bytes and allocation counts for the process. Storage that is not
+ * owned by the library (from_blob, mmapped files) is not counted.
+ *
+ * With attribution enabled (memory::enable() or TENSORLIB_MEMORY=1), allocations are
+ * also charged to the op or module running on the allocating thread, the innermost
+ * PROFILE_OP scope, so allocation churn can be traced back to e.g. Conv2d.
+ */
+namespace memory {
+
+struct Stats {
+    int64_t live_bytes = 0;
+    int64_t peak_bytes = 0;
+    int64_t allocs = 0;
+    int64_t frees = 0;
+    int64_t total_bytes = 0; // allocated since start, freed or not
+};
+
+struct OpStats {
+    std::string name;
+    int64_t allocs = 0;
+    int64_t total_bytes = 0;
+    int64_t live_bytes = 0;
+    int64_t peak_bytes = 0;
+};
+
+extern std::atomic<bool> enabled_flag;
+
+inline bool enabled() {
+    return enabled_flag.load(std::memory_order_relaxed);
+}
+
+// per-op attribution, the global counters are always kept.
+void enable(bool on = true);
+
+Stats stats();
+
+// restart peak_bytes from the current live bytes, e.g. before measuring one batch.
+void resetPeak();
+
+// allocations charged to each op, sorted by total bytes. Storage allocated outside any op is charged to "(none)".
+std::vector<OpStats> byOp();
+
+void resetOps();
+
+// peak resident set size of the process in bytes, from getrusage.
+int64_t peakRSS();
+
+// current resident set size of the process in bytes.
+int64_t currentRSS();
+
+void printSummary(std::ostream& os);
+
+// set the op charged for allocations on this thread, return the previous one.
+const char* setCurrentOp(const char* name);
+
+const char* currentOp();
+
+// bookkeeping, return the token to pass to recordFree.
+void* recordAlloc(size_t bytes);
+void recordFree(void* token, size_t bytes);
+
+/**
+ * allocate storage for n elements, tracked until the last shared_ptr is released.
+ */
+template <typename dtype>
+std::shared_ptr<dtype[]> allocate(size_t n) {
+    size_t bytes = n * sizeof(dtype);
+    dtype* ptr = nullptr;
+    bool placed = false;
+    if (std::is_trivially_default_constructible<dtype>::value && bytes >= numa::PLACE_MIN_BYTES &&
+        numa::policy() != numa::Policy::Off) {
+        // large storage gets fresh pages, placed on the NUMA nodes before the first write.
+        ptr = static_cast<dtype*>(numa::allocatePlaced(bytes));
+        placed = ptr != nullptr;
+    }
+    if (!placed) {
+        ptr = new dtype[n];
+    }
+    void* token = recordAlloc(bytes);
+    return std::shared_ptr<dtype[]>(ptr, [token, bytes, placed](dtype* p) {
+        if (placed) {
+            numa::releasePlaced(p, bytes);
+        } else {
+            delete[] p;
+        }
+        recordFree(token, bytes);
+    });
+}
+
+} // namespace memory
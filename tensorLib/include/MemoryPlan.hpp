@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Static memory planning of activation buffers.
+ *
+ * A model run is a sequence of steps, each buffer is live from the step that writes it
+ * to the last step that reads it. planArena packs the buffers into one arena so that
+ * buffers live at the same step never overlap and the others share memory: the largest
+ * buffers are placed first, each in the smallest gap left by the buffers it overlaps in
+ * time (greedy by size). For a chain of layers the arena comes down to the largest pair
+ * of neighbouring activations instead of their sum.
+ *
+ * usage:
+ *     auto plan = memory::planArena({{bytes0, 0, 1}, {bytes1, 1, 2}, {bytes2, 2, 3}});
+ *     // buffer i at arena + plan.offsets[i], plan.arena_bytes in total
+ */
+namespace memory {
+
+struct Buffer {
+    size_t bytes;
+    int first; // step writing it
+    int last;  // last step reading it, inclusive
+};
+
+struct ArenaPlan {
+    std::vector<size_t> offsets; // in bytes, one per buffer
+    size_t arena_bytes = 0;
+    size_t naive_bytes = 0;      // sum of the buffers, one allocation each
+};
+
+// offsets are multiples of alignment, which must be a power of two.
+ArenaPlan planArena(const std::vector<Buffer>& buffers, size_t alignment = 64);
+
+} // namespace memory
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace parallel {
+class ThreadPool;
+}
+
+/**
+ * NUMA placement of Tensor storage and threads, for hosts with more than one memory node
+ * (multi-socket). On a single node host everything here is a no-op.
+ *
+ * Storage: memory::allocate takes every allocation of at least PLACE_MIN_BYTES from fresh,
+ * untouched pages (allocatePlaced) and places them before anything is written to them.
+ * The policy (TENSORLIB_NUMA or setPolicy) is
+ *     interleave  (default on NUMA hosts) the pages are spread round robin over all nodes
+ *                 (mbind), so every worker sees the same mix of local and remote memory,
+ *     firsttouch  the pages are touched chunk by chunk by the threads of the current pool,
+ *                 landing in contiguous blocks on the nodes the pool runs on. Only with
+ *                 pinned workers (TENSORLIB_PIN_THREADS, nodePool), an unpinned pool
+ *                 interleaves. parallel_for does not tie a row range to a worker, so the
+ *                 block a later reader gets is not necessarily on its own node,
+ *     off         the kernel's default, the node of the first thread writing a page.
+ *
+ * Weights: Linear keeps one copy of its weight per node (Replicas) and every worker reads
+ * the copy on its own node, TENSORLIB_NUMA_REPLICATE=0 turns it off.
+ *
+ * Threads: TENSORLIB_PIN_THREADS=scatter (or 1) pins the default pool's workers round
+ * robin over the nodes, =compact fills one node first. nodePool() builds a pool on the
+ * CPUs of one node, to give each socket its own model.
+ */
+namespace numa {
+
+enum class Policy { Off, FirstTouch, Interleave };
+
+const char* policyName(Policy policy);
+
+bool parsePolicy(const std::string& name, Policy& policy);
+
+Policy policy();
+
+void setPolicy(Policy policy);
+
+// allocations smaller than this are left to the allocator.
+const size_t PLACE_MIN_BYTES = 1 << 21;
+
+// number of memory nodes, 1 when the host is not NUMA or sysfs is not readable.
+int nodeCount();
+
+// the CPUs of node this process may run on.
+std::vector<int> nodeCPUs(int node);
+
+int nodeOfCPU(int cpu);
+
+// node of the CPU the calling thread is running on.
+int currentNode();
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}, the sysfs cpulist / nodelist format.
+std::vector<int> parseList(const std::string& list);
+
+// the CPUs of all nodes in pinning order: scatter takes one CPU of each node in turn,
+// compact all CPUs of a node before the next one.
+std::vector<int> pinOrder(const std::vector<std::vector<int>>& cpus_by_node, bool scatter);
+
+// a pool of threads (default: one per CPU) pinned to the CPUs of node.
+std::unique_ptr<parallel::ThreadPool> nodePool(int node, int threads = 0);
+
+// place fresh, untouched storage according to policy().
+void place(void* ptr, size_t bytes);
+
+// bytes of fresh pages, placed according to policy(), nullptr when they can't be mapped.
+// freed with releasePlaced.
+void* allocatePlaced(size_t bytes);
+void releasePlaced(void* ptr, size_t bytes);
+
+// move the pages of [ptr, ptr + bytes) to node / spread them over all nodes. false when
+// the kernel refuses (no NUMA support, seccomp), the memory is usable either way.
+bool bindToNode(void* ptr, size_t bytes, int node);
+bool interleave(void* ptr, size_t bytes);
+
+// whether Linear keeps per-node weight copies, by default on NUMA hosts.
+bool replicateWeights();
+
+void setReplicateWeights(bool on);
+
+// memory bound to node, not tracked by memory::allocate.
+std::shared_ptr<char[]> allocateOnNode(size_t bytes, int node);
+
+/**
+ * one copy of an array per node, each bound to its node. Read only once built.
+ */
+template <typename dtype>
+class Replicas {
+public:
+    Replicas() = default;
+
+    void build(const dtype* src, size_t n) {
+        copies_.clear();
+        int nodes = nodeCount();
+        for (int node = 0; node < nodes; node++) {
+            auto copy = allocateOnNode(n * sizeof(dtype), node);
+            std::memcpy(copy.get(), src, n * sizeof(dtype));
+            copies_.push_back(copy);
+        }
+    }
+
+    bool empty() const {
+        return copies_.empty();
+    }
+
+    // the copy on the calling thread's node.
+    const dtype* local() const {
+        int node = currentNode();
+        if (node < 0 || node >= (int)copies_.size()) {
+            node = 0;
+        }
+        return reinterpret_cast<const dtype*>(copies_[node].get());
+    }
+
+private:
+    std::vector<std::shared_ptr<char[]>> copies_;
+};
+
+} // namespace numa
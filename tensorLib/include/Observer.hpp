@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include "Quantize.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Activation range observers for post-training calibration.
+ *
+ * An Observer sees the activations of one point of a model over a few sample batches
+ * and keeps their exact min and max and a histogram of |x| (the range grows with the
+ * data, the counts are re-binned). From that it picks the range to quantize to:
+ *
+ *   MinMax      the full observed range, exact but one outlier stretches every step.
+ *   Percentile  clip |x| at the given percentile of the values.
+ *   Entropy     clip |x| at the threshold whose quantized histogram is closest to the
+ *               observed one (least KL divergence), the outliers folded into the last
+ *               bin, as TensorRT calibrates.
+ *
+ *     quant::Observer observer;
+ *     for (auto& batch : samples) observer.observe(batch);
+ *     quant::Params p = observer.params(quant::CalibrationMethod::Entropy, 0, 255, false);
+ *
+ * See nn::calibrate for running a whole model.
+ */
+namespace quant {
+
+enum class CalibrationMethod {
+    MinMax,
+    Percentile,
+    Entropy,
+};
+
+class Observer {
+public:
+    explicit Observer(int bins = 2048);
+
+    void observe(const float* x, size_t n);
+    void observe(const Tensor<float>& x);
+
+    // values seen so far.
+    int64_t count() const { return count_; }
+    float min() const { return min_; }
+    float max() const { return max_; }
+
+    // the range [lo, hi] to quantize to with levels steps, within [min, max]. percentile
+    // is in percent, for CalibrationMethod::Percentile only.
+    std::pair<float, float> range(CalibrationMethod method, int levels = 256, float percentile = 99.99f) const;
+
+    // the params for range(), over [qmin, qmax]. Before any observe the defaults.
+    Params params(CalibrationMethod method, int32_t qmin, int32_t qmax, bool symmetric,
+                  float percentile = 99.99f) const;
+
+private:
+    // |x| threshold of the method, a multiple of the bin width.
+    float threshold(CalibrationMethod method, int levels, float percentile) const;
+    float entropyThreshold(int levels) const;
+    // re-bin the counts for a new largest |x|.
+    void grow(float absmax);
+
+    std::vector<int64_t> histogram_;
+    float absmax_ = 0.0f;
+    float min_ = 0.0f;
+    float max_ = 0.0f;
+    int64_t count_ = 0;
+};
+
+} // namespace quant
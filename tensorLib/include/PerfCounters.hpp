@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Hardware performance counters read with Linux perf_event_open.
+ *
+ * The counters are opened once for the process with inherit set, so they count the
+ * calling thread and every thread it creates afterwards. Threads that already exist are
+ * not counted: the workers of the default ThreadPool start on the first parallel_for
+ * (e.g. the one of quant::quantizeWeight), so open() restarts the default pool from the
+ * calling thread to have its workers counted. Like parallel::setNumThreads, that must not
+ * happen while the pool runs kernels. Pools of your own (PoolScope) should be built after
+ * open(). Counts are process wide, so with several threads running unrelated work the
+ * per-op numbers are approximate.
+ *
+ * When perf events are not permitted (perf_event_paranoid, seccomp in containers, no
+ * PMU in a VM) the unavailable events read as -1 and everything else keeps working.
+ */
+namespace perf {
+
+enum Event {
+    Cycles,
+    Instructions,
+    BranchMisses,
+    L1DMisses,
+    LLCMisses,
+    DTLBMisses,
+    NUM_EVENTS
+};
+
+const char* eventName(int event);
+
+// open the counters, return whether at least one event is available. Safe to call repeatedly.
+bool open();
+
+bool available();
+
+bool available(Event event);
+
+// why the counters are (partly) unavailable, empty when every event opened.
+std::string status();
+
+// current counts since open(), scaled for multiplexing, -1 for unavailable events.
+void read(int64_t values[NUM_EVENTS]);
+
+} // namespace perf
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "PerfCounters.hpp"
+#include "Memory.hpp"
+
+/**
+ * A low overhead per-op profiler.
+ *
+ * Ops are instrumented with PROFILE_OP, which records the op name, input shapes, wall
+ * time, FLOPs, bytes moved and thread into a thread-local ring buffer, so the hot path
+ * takes no lock and does no I/O. The records are aggregated afterwards into a summary
+ * table (GFLOP/s, GB/s per op) or exported as Chrome trace JSON (chrome://tracing, Perfetto).
+ *
+ * Compile-time toggle: PROFILE_OP expands to nothing unless TENSORLIB_PROFILING is
+ * defined (the TENSORLIB_PROFILING CMake option, ON by default).
+ * Runtime toggle: off by default, profiler::enable() or the TENSORLIB_PROFILE=1
+ * environment variable turns it on, disabled scopes cost one atomic load.
+ * Hardware counters (cycles, instructions, cache/TLB misses, see PerfCounters.hpp) are
+ * collected per op on top of the timings after profiler::enableCounters() or with
+ * TENSORLIB_PERF_COUNTERS=1.
+ *
+ * usage:
+ *     PROFILE_OP("Linear", 2.0 * N * K * M, bytes, &input.shape(), &weight.shape());
+ */
+namespace profiler {
+
+// shapes of up to MAX_SHAPES operands with up to MAX_DIMS dimensions are kept per record.
+constexpr int MAX_SHAPES = 3;
+constexpr int MAX_DIMS = 4;
+
+struct Record {
+    const char* name;
+    int64_t start_ns;
+    int64_t end_ns;
+    double flops;
+    double bytes;
+    int thread;
+    int depth;   // nesting level, 0 for top-level ops
+    int8_t ndims[MAX_SHAPES]; // -1 for an unused shape slot
+    int shapes[MAX_SHAPES][MAX_DIMS];
+    // hardware counter deltas over the op, -1 when not collected
+    int64_t counters[perf::NUM_EVENTS];
+
+    double seconds() const { return (end_ns - start_ns) * 1e-9; }
+    // e.g. "[1000,784] [784,10]"
+    std::string shapeString() const;
+};
+
+struct OpStats {
+    std::string name;
+    int64_t calls = 0;
+    double seconds = 0;
+    double flops = 0;
+    double bytes = 0;
+    // summed hardware counters, -1 when not collected
+    int64_t counters[perf::NUM_EVENTS] = {-1, -1, -1, -1, -1, -1};
+
+    double gflops() const { return seconds > 0 ? flops / seconds * 1e-9 : 0; }
+    double gbytes() const { return seconds > 0 ? bytes / seconds * 1e-9 : 0; }
+};
+
+extern std::atomic<bool> enabled_flag;
+extern std::atomic<bool> counters_flag;
+
+inline bool enabled() {
+    return enabled_flag.load(std::memory_order_relaxed);
+}
+
+void enable(bool on = true);
+
+inline bool countersEnabled() {
+    return counters_flag.load(std::memory_order_relaxed);
+}
+
+// collect hardware counters per op, return false (and stay disabled) when perf events are not permitted.
+// the first call restarts the default thread pool, see PerfCounters.hpp.
+bool enableCounters(bool on = true);
+
+// records per thread kept in the ring buffer, the oldest ones are overwritten when full.
+void setBufferCapacity(size_t capacity);
+
+// nanoseconds since the profiler epoch.
+int64_t now();
+
+// drop every record collected so far.
+void reset();
+
+// every record of every thread, ordered by start time. Should not run concurrently with profiled ops.
+std::vector<Record> records();
+
+// number of records lost because a ring buffer was full.
+int64_t dropped();
+
+// aggregate the records by op name, sorted by total time.
+std::vector<OpStats> summary();
+
+void printSummary(std::ostream& os);
+
+void writeChromeTrace(std::ostream& os);
+void writeChromeTrace(const std::string& path);
+
+/**
+ * RAII scope timing one op, the record is written when the scope ends.
+ */
+class OpScope {
+public:
+    // the op is also charged for the Tensor storage allocated in the scope, see Memory.hpp.
+    explicit OpScope(const char* name) : prev_op_(memory::setCurrentOp(name)) {
+        if (enabled()) {
+            begin(name);
+        }
+    }
+
+    ~OpScope() {
+        if (active_) {
+            end();
+        }
+        memory::setCurrentOp(prev_op_);
+    }
+
+    OpScope(const OpScope&) = delete;
+    OpScope& operator=(const OpScope&) = delete;
+
+    bool active() const { return active_; }
+
+    void annotate(double flops, double bytes, std::initializer_list<const std::vector<int>*> shapes);
+
+private:
+    void begin(const char* name);
+    void end();
+
+    const char* prev_op_;
+    bool active_ = false;
+    bool counting_ = false;
+    Record record_;
+};
+
+} // namespace profiler
+
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+
+#ifdef TENSORLIB_PROFILING
+// the flops, bytes and shapes arguments are only evaluated when profiling is enabled.
+#define PROFILE_OP(name, flops, bytes, ...)                                                     \
+    profiler::OpScope PROFILER_CONCAT(profile_scope_, __LINE__)(name);                        \
+    if (PROFILER_CONCAT(profile_scope_, __LINE__).active())                                   \
+        PROFILER_CONCAT(profile_scope_, __LINE__).annotate((flops), (bytes), {__VA_ARGS__})
+#else
+#define PROFILE_OP(name, flops, bytes, ...) do {} while (0)
+#endif
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Affine int8 quantization of weights and uint8 quantization of activations.
+ *
+ * A real value r is stored as q = clamp(round(r / scale) + zero_point, qmin, qmax) and
+ * read back as scale * (q - zero_point). Weights (rows, cols), e.g. a Linear's
+ * (out_features, in_features), get a scale per row (output channel) or per group of
+ * group_size consecutive columns of a row, symmetric (zero point 0, [-127, 127]) or
+ * asymmetric ([-128, 127] around a zero point, for rows not centered on 0). A single
+ * scale for the whole matrix, as Tensor::quantize() does, lets the row with the largest
+ * weight set the step for every other row.
+ *
+ *     auto w = quant::quantizeWeight(fc_weight, {128, false}); // groups of 128, asymmetric
+ *     Tensor<float> back = quant::dequantize(w);               // error at most scale / 2
+ *
+ * The product of uint8 activations x (scale s_x, zero point z_x) and a weight row w of
+ * one group (s_w, z_w) over K columns is
+ *     s_x * s_w * (sum x*w - z_w * sum x - z_x * sum w + K * z_x * z_w)
+ * so kernels::gemm_nt_u8s8i32 runs on the raw values and the zero points are corrected
+ * in the epilogue with the sums kept here, see nn::QuantizedLinear.
+ */
+namespace quant {
+
+struct Config {
+    // 0 for a scale per row, else per group_size columns, which must divide cols.
+    int group_size = 0;
+    bool symmetric = true;
+    // float input of a QuantizedLinear gets a scale and zero point per row, chosen on
+    // the fly, instead of one for the whole batch.
+    bool per_row_activations = false;
+};
+
+struct Params {
+    float scale = 1.0f;
+    int32_t zero_point = 0;
+};
+
+// round to nearest (ties to even), saturated to [qmin, qmax].
+inline int32_t quantize(float r, float inv_scale, int32_t zero_point, int32_t qmin, int32_t qmax) {
+    float q = std::nearbyint(r * inv_scale) + (float)zero_point;
+    return q < (float)qmin ? qmin : (q > (float)qmax ? qmax : (int32_t)q);
+}
+
+// the scale and zero point mapping [min, max], widened to hold 0 exactly, onto
+// [qmin, qmax]. symmetric uses max(|min|, |max|) and zero point 0.
+Params chooseParams(float min, float max, int32_t qmin, int32_t qmax, bool symmetric);
+
+struct QuantizedWeight {
+    int rows = 0;
+    int cols = 0;
+    int group_size = 0; // cols for one scale per row
+    int groups = 0;     // per row, cols / group_size
+    Tensor<int8_t> values = Tensor<int8_t>(std::vector<int>{0}); // (rows, cols)
+    // per row and group, index row * groups + group.
+    std::vector<float> scales;
+    std::vector<int32_t> zero_points;
+    std::vector<int32_t> sums; // of the values of the group
+    bool symmetric = true;
+};
+
+// w (rows, cols) of float weights.
+QuantizedWeight quantizeWeight(const Tensor<float>& w, const Config& config = Config());
+
+Tensor<float> dequantize(const QuantizedWeight& w);
+
+/**
+ * Weight-only 4 bit quantization, two values per byte, 8x fewer weight bytes than float.
+ * Each group of a row holds unsigned u in [0, 15] read as scale * (u - zero_point):
+ * symmetric groups use [1, 15] around zero point 8, asymmetric ones all 16 steps. Byte t
+ * of a group packs element t in its low nibble and element t + group_size / 2 in its
+ * high one, so a kernel unpacks both halves from contiguous loads.
+ *
+ *     auto w4 = quant::quantizeWeight4(fc_weight, {64, false});  // groups of 64
+ */
+struct PackedWeight4 {
+    int rows = 0;
+    int cols = 0;
+    int group_size = 0; // even, cols for one scale per row
+    int groups = 0;     // per row, cols / group_size
+    Tensor<uint8_t> values = Tensor<uint8_t>(std::vector<int>{0}); // (rows, cols / 2)
+    // per row and group, index row * groups + group.
+    std::vector<float> scales;
+    std::vector<int32_t> zero_points;
+    bool symmetric = true;
+};
+
+// w (rows, cols) of float weights, group_size (or cols) must be even.
+PackedWeight4 quantizeWeight4(const Tensor<float>& w, const Config& config = Config());
+
+Tensor<float> dequantize(const PackedWeight4& w);
+
+// x as uint8 with params, e.g. a float input quantized per tensor.
+void quantizeU8(const float* x, size_t n, const Params& params, uint8_t* out);
+
+// params for x as uint8 over its range, asymmetric.
+Params chooseParamsU8(const float* x, size_t n);
+
+} // namespace quant
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Sparse storage of pruned float weights (rows, cols), e.g. a Linear's (out_features,
+ * in_features), in blocks of block_rows x block_cols:
+ *     CSR       1x1, every weight above the threshold on its own,
+ *     Block1x4  4 consecutive columns of a row, for weights pruned in short runs,
+ *     Block4x4  4x4 tiles, for structured pruning.
+ * A block is stored when any of its weights is above threshold in magnitude, the weights
+ * at or below it are pruned to 0 inside stored blocks too, so toDense() gives back the
+ * thresholded matrix. The last block of a block row that would cross cols starts at
+ * cols - block_cols instead, with the columns of its neighbour zeroed, so kernels never
+ * read past a row; the last block row is padded with zero rows.
+ *
+ *     auto w = sparse::fromDense(fc_weight, sparse::Format::Block1x4, 1e-3f);
+ *     Tensor<float> pruned = sparse::toDense(w);
+ *
+ * Linear stores its weight sparse on its own when at least minSparsity() of it is exact
+ * zeros (TENSORLIB_SPARSE, default 0.5, above 1 never) and the format chooseFormat()
+ * picks is expected to beat the dense GEMM, then runs kernels::spmm_nt_f32 instead.
+ * Unstructured zeros pay off from about 90%, 4x4 structured ones from about half.
+ */
+namespace sparse {
+
+enum class Format { CSR, Block1x4, Block4x4 };
+
+const char* formatName(Format format);
+
+struct Matrix {
+    int rows = 0;
+    int cols = 0;
+    Format format = Format::CSR;
+    int block_rows = 1;
+    int block_cols = 1;
+    // (rows / block_rows rounded up) + 1 offsets into col_idx, one block row each.
+    std::vector<int32_t> row_ptr;
+    // first column of each block.
+    std::vector<int32_t> col_idx;
+    // block_rows * block_cols per block, row major.
+    std::vector<float> values;
+
+    bool empty() const { return rows == 0; }
+    size_t blocks() const { return col_idx.size(); }
+    // bytes of values and indices, what a product reads of the weight.
+    size_t bytes() const;
+};
+
+// w (rows, cols), cols (and rows for Block4x4) at least the block size.
+Matrix fromDense(const Tensor<float>& w, Format format, float threshold = 0.0f);
+
+Tensor<float> toDense(const Matrix& m);
+
+// the fraction of w at or below threshold in magnitude.
+double sparsity(const Tensor<float>& w, float threshold = 0.0f);
+
+// the estimated time of a product with w stored in format, relative to dense: the stored
+// values, each costing more the smaller its block.
+double relativeCost(const Tensor<float>& w, Format format, float threshold = 0.0f);
+
+// the format of the smallest relativeCost, blocks when the zeros are structured.
+Format chooseFormat(const Tensor<float>& w, float threshold = 0.0f);
+
+double minSparsity();
+
+void setMinSparsity(double sparsity);
+
+} // namespace sparse
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * A tensor whose shape is part of its type, for the small layers whose sizes are known
+ * when the model is written (3x3 kernels, 28x28 images, 10 classes).
+ *
+ * The elements are stored inline, row-major and 64-byte aligned, and every loop bound in
+ * static_kernels below is a compile-time constant, so the compiler unrolls the short loops
+ * completely and vectorizes the rest without the shape and stride lookups of Tensor.
+ *
+ * view() wraps the storage in a Tensor<dtype> without copying, so the dynamic ops can be
+ * used on it, and fromTensor() copies a Tensor (or any view of one) of the same shape.
+ *
+ * usage:
+ *     auto w = StaticTensor<float, 10, 784>::fromTensor(readCSV<float>(fcWeightPath));
+ *     Tensor<float> t = w.view();      // shares w's storage, must not outlive w
+ */
+template <typename dtype, int... Dims>
+class StaticTensor {
+    static_assert(sizeof...(Dims) > 0, "a StaticTensor has at least one dimension");
+    static_assert(((Dims > 0) && ...), "the dimensions of a StaticTensor must be positive");
+
+public:
+    static constexpr int ndim = sizeof...(Dims);
+    static constexpr int num_elements = (Dims * ...);
+    static constexpr std::array<int, ndim> dims = {Dims...};
+
+    // row-major strides in elements.
+    static constexpr std::array<int, ndim> strides() {
+        std::array<int, ndim> s{};
+        int step = 1;
+        for (int i = ndim - 1; i >= 0; i--) {
+            s[i] = step;
+            step *= dims[i];
+        }
+        return s;
+    }
+
+    // the shape as Tensor has it, for the places that take a std::vector.
+    static const std::vector<int>& shape() {
+        static const std::vector<int> instance{Dims...};
+        return instance;
+    }
+
+    StaticTensor() = default;
+
+    explicit StaticTensor(dtype value) {
+        fill(value);
+    }
+
+    void fill(dtype value) {
+        for (int i = 0; i < num_elements; i++) {
+            data_[i] = value;
+        }
+    }
+
+    template <typename... Idx>
+    dtype& operator()(Idx... idx) {
+        static_assert(sizeof...(Idx) == ndim, "one index per dimension");
+        return data_[index(idx...)];
+    }
+
+    template <typename... Idx>
+    const dtype& operator()(Idx... idx) const {
+        static_assert(sizeof...(Idx) == ndim, "one index per dimension");
+        return data_[index(idx...)];
+    }
+
+    // flat, row-major access.
+    dtype& operator[](int i) {
+        return data_[i];
+    }
+
+    const dtype& operator[](int i) const {
+        return data_[i];
+    }
+
+    dtype* data() {
+        return data_;
+    }
+
+    const dtype* data() const {
+        return data_;
+    }
+
+    // a Tensor over this storage, no copy. writes through either are seen by both.
+    Tensor<dtype> view() {
+        return Tensor<dtype>::from_blob(data_, shape());
+    }
+
+    // copy of t, which may be a non-contiguous view, of exactly this shape.
+    static StaticTensor fromTensor(const Tensor<dtype>& t) {
+        if (t.shape() != shape()) {
+            throw std::invalid_argument("Shape mismatch: the Tensor does not have the StaticTensor's shape.");
+        }
+
+        StaticTensor result;
+        if (t.is_contiguous()) {
+            std::memcpy(result.data_, &t.data_[t.offset()], sizeof(dtype) * num_elements);
+            return result;
+        }
+
+        std::vector<int> indices(ndim, 0);
+        for (int i = 0; i < num_elements; i++) {
+            result.data_[i] = t.getData(indices);
+            for (int d = ndim - 1; d >= 0; d--) {
+                if (++indices[d] < dims[d]) {
+                    break;
+                }
+                indices[d] = 0;
+            }
+        }
+        return result;
+    }
+
+private:
+    template <typename... Idx>
+    static constexpr int index(Idx... idx) {
+        constexpr std::array<int, ndim> s = strides();
+        int i = 0;
+        int d = 0;
+        ((i += static_cast<int>(idx) * s[d++]), ...);
+        return i;
+    }
+
+    alignas(64) dtype data_[num_elements] = {};
+};
+
+/**
+ * Kernels whose sizes are template parameters. They are plain loops over constant bounds,
+ * compiled in the including translation unit, the short ones (kernel window, output
+ * features) are unrolled with the pragma and the inner ones are left to the vectorizer.
+ */
+namespace static_kernels {
+
+// c(M x N) = a(M x K) * b(K x N)
+template <typename dtype, int M, int K, int N>
+StaticTensor<dtype, M, N> matmul(const StaticTensor<dtype, M, K>& a, const StaticTensor<dtype, K, N>& b) {
+    StaticTensor<dtype, M, N> c;
+    for (int i = 0; i < M; i++) {
+        dtype* c_row = c.data() + i * N;
+        #pragma GCC unroll 16
+        for (int k = 0; k < K; k++) {
+            dtype a_ik = a[i * K + k];
+            const dtype* b_row = b.data() + k * N;
+            #pragma omp simd
+            for (int j = 0; j < N; j++) {
+                c_row[j] += a_ik * b_row[j];
+            }
+        }
+    }
+    return c;
+}
+
+/**
+ * out(rows x Out) = scale * x(rows x In) * w(Out x In)^T, x rows ld elements apart.
+ * each output feature keeps LANES partial sums, so the reduction over In vectorizes
+ * without reassociating a single sum.
+ */
+template <typename dtype, int In, int Out, typename xtype>
+void linear(const xtype* x, int rows, int ld, const StaticTensor<dtype, Out, In>& w, dtype* out, dtype scale) {
+    constexpr int LANES = 8;
+    constexpr int BODY = In / LANES * LANES;
+    const dtype* w_ptr = w.data();
+
+    for (int r = 0; r < rows; r++) {
+        const xtype* x_row = x + (size_t)r * ld;
+        dtype acc[Out][LANES] = {};
+        for (int k = 0; k < BODY; k += LANES) {
+            #pragma GCC unroll 16
+            for (int o = 0; o < Out; o++) {
+                #pragma omp simd
+                for (int l = 0; l < LANES; l++) {
+                    acc[o][l] += static_cast<dtype>(x_row[k + l]) * w_ptr[o * In + k + l];
+                }
+            }
+        }
+
+        dtype* out_row = out + (size_t)r * Out;
+        for (int o = 0; o < Out; o++) {
+            dtype sum = 0;
+            for (int l = 0; l < LANES; l++) {
+                sum += acc[o][l];
+            }
+            for (int k = BODY; k < In; k++) {
+                sum += static_cast<dtype>(x_row[k]) * w_ptr[o * In + k];
+            }
+            out_row[o] = sum * scale;
+        }
+    }
+}
+
+/**
+ * one image: out(C_out x H_out x W_out) = scale * conv(x(C_in x H x W), w(C_out x C_in x K x K)).
+ * the image is copied once into a zero-padded buffer, so the window loops have no bound
+ * checks and unroll completely.
+ */
+template <typename dtype, int C_in, int C_out, int K, int Stride, int Padding, int H, int W, typename xtype>
+void conv2d(const xtype* x, const StaticTensor<dtype, C_out, C_in, K, K>& w, dtype* out, dtype scale) {
+    constexpr int H_pad = H + 2 * Padding;
+    constexpr int W_pad = W + 2 * Padding;
+    constexpr int H_out = (H_pad - K) / Stride + 1;
+    constexpr int W_out = (W_pad - K) / Stride + 1;
+    static_assert(H_out > 0 && W_out > 0, "the kernel is larger than the padded image");
+
+    dtype padded[C_in][H_pad][W_pad] = {};
+    for (int ci = 0; ci < C_in; ci++) {
+        for (int h = 0; h < H; h++) {
+            const xtype* x_row = x + ((size_t)ci * H + h) * W;
+            #pragma omp simd
+            for (int iw = 0; iw < W; iw++) {
+                padded[ci][h + Padding][iw + Padding] = static_cast<dtype>(x_row[iw]);
+            }
+        }
+    }
+
+    for (int co = 0; co < C_out; co++) {
+        for (int oh = 0; oh < H_out; oh++) {
+            dtype acc[W_out] = {};
+            for (int ci = 0; ci < C_in; ci++) {
+                #pragma GCC unroll 16
+                for (int kh = 0; kh < K; kh++) {
+                    const dtype* row = padded[ci][oh * Stride + kh];
+                    #pragma GCC unroll 16
+                    for (int kw = 0; kw < K; kw++) {
+                        dtype w_k = w(co, ci, kh, kw);
+                        #pragma omp simd
+                        for (int ow = 0; ow < W_out; ow++) {
+                            acc[ow] += w_k * row[ow * Stride + kw];
+                        }
+                    }
+                }
+            }
+            dtype* out_row = out + ((size_t)co * H_out + oh) * W_out;
+            for (int ow = 0; ow < W_out; ow++) {
+                out_row[ow] = acc[ow] * scale;
+            }
+        }
+    }
+}
+
+} // namespace static_kernels
@@ -2,9 +2,12 @@
 
 #include <cassert>
 #include <cstddef>
+#include <functional>
 #include <memory>
+#include <type_traits>
 #include <vector>
 #include <ostream>
+#include "Kernels.hpp"
 
 // Forward declaration of Tensor class
 // template <typename dtype>
@@ -44,6 +47,17 @@ public:
     // Tensor(const std::vector<int>& shape, const std::vector<dtype>& data);
     Tensor(const std::vector<int>& shape, const std::shared_ptr<dtype[]>& data);
 
+    /**
+     * wrap memory allocated elsewhere (socket buffers, mmapped files, other libraries)
+     * without copying. strides are in elements, empty means contiguous.
+     * with a deleter the Tensor adopts ptr and calls deleter(ptr) when the last Tensor
+     * sharing it is destroyed, without one ptr is only borrowed and must outlive the
+     * Tensor and every view of it.
+     */
+    static Tensor<dtype> from_blob(dtype* ptr, const std::vector<int>& shape,
+                                   const std::vector<int>& strides = {},
+                                   const std::function<void(dtype*)>& deleter = nullptr);
+
     // Destructor
     ~Tensor();
 
@@ -62,6 +76,20 @@ public:
         return data_;
     }
 
+    const std::vector<int>& stride() const {
+        return stride_;
+    }
+
+    // offset of the first element in data_, not zero for slice and select views.
+    int offset() const {
+        return offset_;
+    }
+
+    // whether the elements are laid out densely in row-major order.
+    bool is_contiguous() const {
+        return is_contiguous(*this);
+    }
+
     const dtype& getData(const std::vector<int>& indices) const;
 
     void setData(const std::vector<int>& indices, const dtype& value);
@@ -115,6 +143,7 @@ public:
     Tensor<dtype> contiguous() const;
 
     // int8_t quantize, but use int32_t store value now in case of overflow when perform mutmul.
+    // one symmetric scale for the whole tensor, values rounded to nearest in [-127, 127].
     Tensor<int> quantize() const;
 
     Tensor<float> dequantize() const;
@@ -124,9 +153,10 @@ public:
     std::shared_ptr<dtype[]> data_;
     int num_elements;
 
-    // used for quantize
-    // int group_size;  // seem as one group now for simple
+    // used for quantize, real value = scale * (value - zero_point).
+    // per channel and per group scales are kept by quant::QuantizedWeight, see Quantize.hpp.
     float scale;
+    int zero_point = 0;
 private:
     // the offset of data_, used for slice method to share the same memory area of data_.
     int offset_;
@@ -166,6 +196,12 @@ Tensor<T> maximum(Tensor<T> a, Tensor<T> b) {
     assert(b.shape().empty());
 
     Tensor<T> result(a.shape());
+    if constexpr (std::is_same<T, float>::value) {
+        if (a.is_contiguous()) {
+            kernels::active().maximum_f32(&a.data_[a.offset()], b.data_[0], &result.data_[0], a.num_elements);
+            return result;
+        }
+    }
     for (auto i = 0; i < a.num_elements; ++i) {
         result.data_[i] = std::max(a.data_[i], b.data_[0]);
     }
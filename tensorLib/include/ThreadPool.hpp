@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * The library's own intra-op thread pool, used by every parallel kernel instead of OpenMP.
+ *
+ * parallel_for splits [begin, end) into chunks of at least grain iterations and hands each
+ * participating thread a contiguous run of them. A thread works through its own run from
+ * the front, then steals single chunks from the back of the others' runs, so uneven chunks
+ * balance out without a shared queue. The calling thread is always one of the participants.
+ *
+ * Every thread uses the default pool (TENSORLIB_NUM_THREADS threads, the CPUs the process
+ * may run on by default, workers pinned to them with TENSORLIB_PIN_THREADS=1, see Numa.hpp
+ * for the socket-aware orders) unless a PoolScope routes it to another pool. Several
+ * models in one process can so be given disjoint sets of cores:
+ *
+ *     parallel::ThreadPool pool_a(4, {0, 1, 2, 3}), pool_b(4, {4, 5, 6, 7});
+ *     std::thread a([&] { parallel::PoolScope scope(pool_a); model_a.forward(x); });
+ *     std::thread b([&] { parallel::PoolScope scope(pool_b); model_b.forward(y); });
+ *
+ * A parallel_for called from inside another one runs inline on the calling thread, so
+ * nesting never oversubscribes the cores. The function must not throw: an exception
+ * is rethrown on the calling thread, but the other chunks still run.
+ */
+namespace parallel {
+
+// fn(context, begin, end) for one chunk.
+using RangeFunction = void (*)(void* context, int64_t begin, int64_t end);
+
+class ThreadPool {
+public:
+    // num_threads counts the calling thread, so ThreadPool(4) starts 3 workers. with cpus,
+    // worker i is pinned to cpus[i % cpus.size()], the calling threads are left alone.
+    explicit ThreadPool(int num_threads, const std::vector<int>& cpus = {});
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // workers + the calling thread.
+    int size() const;
+
+    // whether the workers were given CPUs to run on.
+    bool pinned() const;
+
+    // at most max_threads threads take part, 0 means size().
+    void run(int64_t begin, int64_t end, int64_t grain, RangeFunction fn, void* context, int max_threads = 0);
+
+private:
+    struct Job;
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+// the pool of this thread: the innermost PoolScope's, or the default pool.
+ThreadPool& current();
+
+ThreadPool& defaultPool();
+
+// replace the default pool, e.g. to sweep thread counts. not while it runs kernels.
+void setNumThreads(int num_threads);
+
+// replace the default pool by one of the same size with new workers, e.g. so they inherit
+// the perf counters opened since. nothing to do before the first parallel_for.
+void restartDefaultPool();
+
+// size of the current pool.
+int numThreads();
+
+// 0 .. participants-1 inside a parallel_for, unique among the threads of that call, e.g.
+// to pick a per-thread scratch buffer. 0 outside.
+int threadIndex();
+
+// the CPUs this process may run on.
+std::vector<int> availableCPUs();
+
+// route the parallel kernels of this thread to pool until the scope ends.
+class PoolScope {
+public:
+    explicit PoolScope(ThreadPool& pool);
+    ~PoolScope();
+
+    PoolScope(const PoolScope&) = delete;
+    PoolScope& operator=(const PoolScope&) = delete;
+
+private:
+    ThreadPool* previous_;
+};
+
+// on the current pool.
+void run(int64_t begin, int64_t end, int64_t grain, RangeFunction fn, void* context, int max_threads = 0);
+
+template <typename F>
+void invokeRange(void* context, int64_t begin, int64_t end) {
+    (*static_cast<F*>(context))(begin, end);
+}
+
+// fn(chunk_begin, chunk_end) over [begin, end) on the current pool.
+template <typename F>
+void parallel_for(int64_t begin, int64_t end, int64_t grain, F&& fn, int max_threads = 0) {
+    using Fn = typename std::remove_reference<F>::type;
+    run(begin, end, grain, &invokeRange<Fn>, const_cast<void*>(static_cast<const void*>(&fn)), max_threads);
+}
+
+/**
+ * combine(...combine(identity, map(b0, e0)), map(b1, e1)...) over [begin, end) split in at
+ * most MAX_PARTS parts of at least grain iterations. The parts and the order they are
+ * combined in do not depend on the number of threads, so float reductions give the same
+ * result on any pool. T must be default constructible.
+ */
+template <typename T, typename Map, typename Combine>
+T parallel_reduce(int64_t begin, int64_t end, int64_t grain, T identity, Map&& map, Combine&& combine,
+                  int max_threads = 0) {
+    const int64_t MAX_PARTS = 64;
+    if (end <= begin) {
+        return identity;
+    }
+    if (grain < 1) {
+        grain = 1;
+    }
+    int64_t range = end - begin;
+    int64_t parts = (range + grain - 1) / grain;
+    if (parts > MAX_PARTS) {
+        parts = MAX_PARTS;
+    }
+    int64_t step = (range + parts - 1) / parts;
+    parts = (range + step - 1) / step;
+
+    T partial[MAX_PARTS];
+    parallel_for(0, parts, 1, [&](int64_t p0, int64_t p1) {
+        for (int64_t p = p0; p < p1; p++) {
+            int64_t b = begin + p * step;
+            int64_t e = end - b < step ? end : b + step;
+            partial[p] = map(b, e);
+        }
+    }, max_threads);
+
+    T result = identity;
+    for (int64_t p = 0; p < parts; p++) {
+        result = combine(result, partial[p]);
+    }
+    return result;
+}
+
+} // namespace parallel
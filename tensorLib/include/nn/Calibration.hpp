@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include "Observer.hpp"
+#include "nn/Sequential.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace nn {
+
+struct CalibrationConfig {
+    quant::CalibrationMethod method = quant::CalibrationMethod::Entropy;
+    float percentile = 99.99f; // for CalibrationMethod::Percentile
+    int bins = 2048;           // of each Observer
+};
+
+/**
+ * Post-training calibration of the static activation ranges of a model.
+ *
+ * Runs the sample batches through model layer by layer, with an Observer (see
+ * Observer.hpp) on the float input and output of every QuantizedLinear and
+ * QuantizedConv2d, then freezes what they saw into the layers: the input as uint8
+ * (setInputParams), so float input is quantized without scanning each batch for its
+ * range, and the output as int8 (setOutputParams) for forwardQuantized. A few hundred
+ * representative samples are enough, the test set is not needed.
+ *
+ *     std::vector<Tensor<float>> samples = {train.slice(0, 256, 0), train.slice(256, 512, 0)};
+ *     nn::calibrate(model, samples, {quant::CalibrationMethod::Percentile, 99.9f});
+ *
+ * The layers are changed in place, models sharing them see the new params too.
+ * Returns the number of layers calibrated.
+ */
+int calibrate(Sequential<float>& model, const std::vector<Tensor<float>>& batches,
+              const CalibrationConfig& config = CalibrationConfig());
+
+// uint8 batches (e.g. pixels) taken by the first layer with input_scale, as
+// Sequential::forward does, whose input then needs no calibration.
+int calibrate(Sequential<float>& model, const std::vector<Tensor<uint8_t>>& batches, float input_scale,
+              const CalibrationConfig& config = CalibrationConfig());
+
+} // namespace nn
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace nn {
+
+struct GraphOptions {
+    // evaluate the nodes that only depend on constants once, in optimize().
+    bool fold_constants = true;
+    // Conv2d + ReLU + MaxPool2d and MatMul + ReLU run as one kernel, transposes feeding a
+    // MatMul become a transposed operand, views never copy.
+    bool fuse = true;
+    // convolutions with a multiple of kernels::CONV_BLOCK output channels produce the
+    // blocked NCHWc layout, consecutive ones pass it along without reordering.
+    bool select_layouts = true;
+};
+
+/**
+ * A float model as a graph of ops, optimized across layers and run out of one planned
+ * arena like Sequential.
+ *
+ * Build the graph with the op methods, each returns the Value it produces, then
+ * optimize() rewrites it:
+ *     constant folding  ops on constants only (e.g. a transposed weight) are computed once,
+ *     fusion            Conv2d(+ReLU)(+MaxPool2d) and MatMul(+ReLU) become one step, the
+ *                       ReLU and pooling applied to each image while it is in cache,
+ *                       MatMul(x, transpose(w)) reads w as B^T instead of transposing it,
+ *                       views are aliases of their input,
+ *     layout selection  convolutions with a multiple of CONV_BLOCK output channels use the
+ *                       blocked direct kernel (kernels::conv2d_nchwc_f32), the others the
+ *                       tuned NCHW one, reorders are inserted where an NCHW op reads a
+ *                       blocked value.
+ * Without optimize() every op runs on its own, as written.
+ *
+ *     nn::Graph g;
+ *     auto x = g.input();
+ *     auto h = g.maxPool2d(g.relu(g.conv2d(x, conv_weight, 1, 1)), 2);
+ *     g.output(g.linear(g.flatten(h), fc_weight));
+ *     g.optimize();
+ *     const Tensor<float>& logits = g.forward(images);
+ *
+ * forward plans an arena per input shape (see Sequential.hpp) and returns a view into
+ * it, valid until the next forward. A Graph runs one forward at a time.
+ */
+class Graph {
+public:
+    using Value = int;
+
+    Graph();
+    ~Graph();
+
+    Graph(const Graph&) = delete;
+    Graph& operator=(const Graph&) = delete;
+
+    // the model input, one per graph.
+    Value input();
+
+    Value constant(const Tensor<float>& value);
+
+    // x (N, C_in, H, W), weight (C_out, C_in, K, K).
+    Value conv2d(Value x, Value weight, int stride, int padding);
+    Value conv2d(Value x, const Tensor<float>& weight, int stride, int padding);
+
+    // a (M, K) * b (K, N).
+    Value matmul(Value a, Value b);
+
+    // x (N, in_features) * weight.T, weight (out_features, in_features) like Linear.
+    Value linear(Value x, const Tensor<float>& weight);
+
+    Value relu(Value x);
+
+    // (N, C, H, W) -> (N, C, H_out, W_out), no padding, stride 0 means kernel.
+    Value maxPool2d(Value x, int kernel, int stride = 0);
+
+    // one dimension may be -1, inferred from the others.
+    Value view(Value x, const std::vector<int>& shape);
+
+    // (N, ...) -> (N, -1)
+    Value flatten(Value x);
+
+    // of a 2D value.
+    Value transpose(Value x, int dim0, int dim1);
+
+    void output(Value value);
+
+    void optimize(const GraphOptions& options = GraphOptions());
+
+    const Tensor<float>& forward(const Tensor<float>& input);
+
+    // raw uint8 input, scaled to float into the arena first.
+    const Tensor<float>& forward(const Tensor<uint8_t>& input, float input_scale = 1.0f / 255.0f);
+
+    // kernels run per forward, after the last plan.
+    size_t steps() const;
+
+    size_t arenaBytes() const;
+
+    // the steps of the last plan, one per line, e.g. "%5 = conv2d(%0, %1) s1 p1 +relu +maxpool2 [nchw8c]".
+    void print(std::ostream& os) const;
+
+private:
+    struct Node;
+    struct Plan;
+
+    Value add(Node node);
+    void plan(const std::vector<int>& input_shape, bool input_u8);
+    void run(const float* input);
+
+    std::vector<Node> nodes_;
+    Value input_ = -1;
+    Value output_ = -1;
+    std::unique_ptr<Plan> plan_;
+};
+
+} // namespace nn
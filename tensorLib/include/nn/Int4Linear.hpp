@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include "Quantize.hpp"
+#include "nn/Module.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nn {
+
+/**
+ * Linear with weight-only 4 bit quantization: the weight is packed two values per byte
+ * with a scale (and zero point) per group (see quant::PackedWeight4), the activations
+ * stay float. The kernel unpacks and dequantizes the weights in registers and
+ * accumulates in float, for layers bound by the bandwidth of their weight, e.g. a large
+ * Linear at small batch sizes, which reads 8x fewer bytes than in float.
+ *
+ * input:  (N, in_features) float, or uint8 with a scale (e.g. pixels, 1/255)
+ * weight: (out_features, in_features) float, quantized at construction
+ * output: (N, out_features) float
+ *
+ *     nn::Int4Linear fc(784, 10, weight, {16, false});  // groups of 16, asymmetric
+ *     Tensor<float> logits = fc.forward(pixels, 1.0f / 255.0f);
+ *
+ * Smaller groups follow the weights more closely for a few more bytes of scales.
+ */
+class Int4Linear : public Module<float> {
+public:
+    Int4Linear(int in_features, int out_features, const Tensor<float>& weight,
+               const quant::Config& config = quant::Config());
+    // bias (out_features), in float.
+    Int4Linear(int in_features, int out_features, const Tensor<float>& weight, const Tensor<float>& bias,
+               const quant::Config& config = quant::Config());
+    ~Int4Linear() = default;
+
+    Tensor<float> forward(const Tensor<float>& input);
+    Tensor<float> forward(const Tensor<uint8_t>& input, float input_scale = 1.0f / 255.0f);
+
+    const char* name() const override { return "Int4Linear"; }
+    std::vector<int> outputShape(const std::vector<int>& input_shape) const override;
+    // uint8 input scaled to float, float input needs none.
+    size_t uint8WorkspaceSize(const std::vector<int>& input_shape) const override;
+    void forward_into(const Tensor<float>& input, Tensor<float>& output, float* workspace) override;
+    void forward_into(const Tensor<uint8_t>& input, float input_scale, Tensor<float>& output,
+                      float* workspace) override;
+
+    const quant::PackedWeight4& weight() const { return weight_; }
+
+protected:
+    // x (N, in_features) contiguous float into y.
+    void run(const float* x, int N, float* y) const;
+
+    int in_features;
+    int out_features;
+    quant::PackedWeight4 weight_;
+    std::vector<float> bias;
+};
+
+} // namespace nn
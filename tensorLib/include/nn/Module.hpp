@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace nn {
+
+/**
+ * The interface the layers share for running into memory they do not own, used by
+ * Sequential to run a whole model out of one planned arena.
+ *
+ * forward_into writes the layer's output for input into output, a contiguous Tensor
+ * of outputShape(input.shape()), and uses workspace (workspaceSize(input.shape())
+ * elements, nullptr when that is 0) for its scratch, so a planned run allocates nothing.
+ * The layers keep their allocating forward() for standalone use.
+ */
+template <typename dtype>
+class Module {
+public:
+    virtual ~Module() = default;
+
+    virtual const char* name() const = 0;
+
+    virtual std::vector<int> outputShape(const std::vector<int>& input_shape) const = 0;
+
+    virtual void forward_into(const Tensor<dtype>& input, Tensor<dtype>& output, dtype* workspace) = 0;
+
+    // raw uint8 input (e.g. pixels) with input_scale applied in the epilogue, for the
+    // layers that take it, see Linear.
+    virtual void forward_into(const Tensor<uint8_t>& input, float input_scale, Tensor<dtype>& output,
+                              dtype* workspace) {
+        (void)input; (void)input_scale; (void)output; (void)workspace;
+        throw std::invalid_argument(std::string(name()) + " does not take uint8 input");
+    }
+
+    // elements of scratch forward_into needs for input_shape.
+    virtual size_t workspaceSize(const std::vector<int>& input_shape) const {
+        (void)input_shape;
+        return 0;
+    }
+
+    // the same for the uint8 forward_into, by default as much as for float input.
+    virtual size_t uint8WorkspaceSize(const std::vector<int>& input_shape) const {
+        return workspaceSize(input_shape);
+    }
+
+    // whether output may be the storage of input, e.g. ReLU. Sequential then runs the
+    // layer in place and saves a buffer.
+    virtual bool inPlace() const {
+        return false;
+    }
+};
+
+} // namespace nn
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include "Quantize.hpp"
+#include "nn/Module.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nn {
+
+/**
+ * Conv2d with int8 weights quantized per output channel (see Quantize.hpp). Each chunk
+ * of images is unfolded to uint8 rows, one per output pixel (kernels::im2row_u8), and
+ * multiplied with the weight by the integer GEMM; one epilogue pass then applies the
+ * zero point corrections, the per channel scales, the bias and an optional ReLU, and
+ * writes float or requantized int8 NCHW output.
+ *
+ * input:  (N, in_channels, H, W) contiguous, float (quantized to uint8 on the way in,
+ *         with the input params or per tensor), uint8 with its scale and zero point, or int8 with Tensor::scale and
+ *         zero_point (e.g. another QuantizedConv2d's output)
+ * weight: (out_channels, in_channels, kernel_size, kernel_size) float, quantized at
+ *         construction, per channel only (config.group_size 0)
+ * output: (N, out_channels, H_out, W_out) float, or int8 with the output params
+ *
+ *     nn::QuantizedConv2d conv1(1, 8, 3, 1, 1, w1, b1), conv2(8, 16, 3, 1, 1, w2, b2);
+ *     conv1.setReLU(true);
+ *     conv1.setOutputParams(quant::chooseParams(0.0f, 6.0f, -128, 127, false));
+ *     Tensor<int8_t> h = conv1.forwardQuantized(pixels, 1.0f / 255.0f);  // int8 between the layers
+ *     Tensor<float> y = conv2.forward(h);
+ *
+ * As a Module<float> it slots into a Sequential<float>, float in and float out.
+ */
+class QuantizedConv2d : public Module<float> {
+public:
+    QuantizedConv2d(int in_channels, int out_channels, int kernel_size, int stride, int padding,
+                    const Tensor<float>& weight, const quant::Config& config = quant::Config());
+    // bias (out_channels), added in float before the ReLU and any requantization.
+    QuantizedConv2d(int in_channels, int out_channels, int kernel_size, int stride, int padding,
+                    const Tensor<float>& weight, const Tensor<float>& bias,
+                    const quant::Config& config = quant::Config());
+    ~QuantizedConv2d() = default;
+
+    Tensor<float> forward(const Tensor<float>& input);
+    Tensor<float> forward(const Tensor<uint8_t>& input, float input_scale = 1.0f / 255.0f,
+                          int32_t input_zero_point = 0);
+    Tensor<float> forward(const Tensor<int8_t>& input);
+
+    // fuse a ReLU into the epilogue, before the requantization.
+    void setReLU(bool relu) { this->relu = relu; }
+
+    // static uint8 params for float input, e.g. from calibration (see nn::calibrate),
+    // instead of the range of each batch.
+    void setInputParams(const quant::Params& params);
+
+    // the scale and zero point of the int8 output of forwardQuantized. Until set,
+    // forwardQuantized throws.
+    void setOutputParams(const quant::Params& params);
+
+    Tensor<int8_t> forwardQuantized(const Tensor<uint8_t>& input, float input_scale,
+                                    int32_t input_zero_point = 0);
+    Tensor<int8_t> forwardQuantized(const Tensor<int8_t>& input);
+
+    const char* name() const override { return "QuantizedConv2d"; }
+    std::vector<int> outputShape(const std::vector<int>& input_shape) const override;
+    // the quantized float input, the rows of a chunk of images and their int32 accumulators.
+    size_t workspaceSize(const std::vector<int>& input_shape) const override;
+    void forward_into(const Tensor<float>& input, Tensor<float>& output, float* workspace) override;
+    void forward_into(const Tensor<uint8_t>& input, float input_scale, Tensor<float>& output,
+                      float* workspace) override;
+
+    const quant::QuantizedWeight& weight() const { return weight_; }
+
+protected:
+    // images per GEMM, as many as keep the rows of a chunk within a few MB.
+    int chunkImages(int N, int spatial) const;
+    // floats of workspace run needs for input_shape.
+    size_t runWorkspaceSize(const std::vector<int>& input_shape) const;
+    // x (N, in_channels, H, W), each byte XORed with flip, with input params (zero point
+    // after the flip), into y (float) or, requantized, q (int8).
+    void run(const uint8_t* x, uint8_t flip, const std::vector<int>& input_shape, const quant::Params& input,
+             float* y, int8_t* q, float* workspace) const;
+    // outputShape, and the contiguity the kernels need.
+    void checkInput(const std::vector<int>& shape, bool contiguous) const;
+
+    int in_channels;
+    int out_channels;
+    int kernel_size;
+    int stride;
+    int padding;
+    quant::QuantizedWeight weight_;
+    std::vector<float> bias;
+    bool relu = false;
+    bool has_input_params = false;
+    quant::Params input_params;
+    bool has_output_params = false;
+    quant::Params output_params;
+};
+
+} // namespace nn
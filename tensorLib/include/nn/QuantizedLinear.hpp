@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include "Quantize.hpp"
+#include "nn/Module.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nn {
+
+/**
+ * Linear with int8 weights quantized per output channel or per group (see Quantize.hpp),
+ * running an integer GEMM on uint8 activations and rescaling the int32 accumulators in
+ * the epilogue, with the zero point corrections and the bias.
+ *
+ * input:  (N, in_features) float (quantized to uint8 on the way in, with the input
+ *         params or per tensor), uint8 with its scale and zero point (e.g. pixels,
+ *         1/255 and 0), or int8 with Tensor::scale and zero_point (e.g. another
+ *         QuantizedLinear's output)
+ * weight: (out_features, in_features) float, quantized at construction
+ * output: (N, out_features) float, or int8 requantized with the output params
+ *
+ *     nn::QuantizedLinear fc(784, 10, weight, {0, true});    // a symmetric scale per row
+ *     Tensor<float> logits = fc.forward(pixels, 1.0f / 255.0f);
+ *     Tensor<int> classes = fc.predict(pixels);              // integers all the way
+ *
+ * With config.per_row_activations float input is quantized dynamically, each row with
+ * its own range, in tiles that go into the GEMM as they are quantized: one large row no
+ * longer costs the others their precision and nothing is calibrated. Static input params
+ * (setInputParams) take precedence.
+ *
+ * As a Module<float> it slots into a Sequential<float>, float in and float out.
+ */
+class QuantizedLinear : public Module<float> {
+public:
+    QuantizedLinear(int in_features, int out_features, const Tensor<float>& weight,
+                    const quant::Config& config = quant::Config());
+    // bias (out_features), added in float before any requantization.
+    QuantizedLinear(int in_features, int out_features, const Tensor<float>& weight, const Tensor<float>& bias,
+                    const quant::Config& config = quant::Config());
+    ~QuantizedLinear() = default;
+
+    Tensor<float> forward(const Tensor<float>& input);
+    Tensor<float> forward(const Tensor<uint8_t>& input, float input_scale = 1.0f / 255.0f,
+                          int32_t input_zero_point = 0);
+
+    // static uint8 params for float input, e.g. from calibration (see nn::calibrate),
+    // instead of the range of each batch.
+    void setInputParams(const quant::Params& params);
+
+    // the scale and zero point of the int8 output of forwardQuantized, e.g. from the
+    // range of the float outputs over some inputs. Until set, forwardQuantized throws.
+    void setOutputParams(const quant::Params& params);
+
+    Tensor<int8_t> forwardQuantized(const Tensor<uint8_t>& input, float input_scale,
+                                    int32_t input_zero_point = 0);
+    Tensor<int8_t> forwardQuantized(const Tensor<int8_t>& input);
+
+    // the argmax of each row's output from uint8 input, without a float past the weight
+    // scales: the accumulators of each output (and group) are weighed with a fixed point
+    // multiplier relative to the largest weight scale and compared in int64, the bias is
+    // converted once to the same units. input_scale only matters to the bias.
+    Tensor<int> predict(const Tensor<uint8_t>& input, float input_scale = 1.0f / 255.0f,
+                        int32_t input_zero_point = 0);
+
+    const char* name() const override { return "QuantizedLinear"; }
+    std::vector<int> outputShape(const std::vector<int>& input_shape) const override;
+    // the quantized float input, the int32 accumulators and the params per row.
+    size_t workspaceSize(const std::vector<int>& input_shape) const override;
+    void forward_into(const Tensor<float>& input, Tensor<float>& output, float* workspace) override;
+    void forward_into(const Tensor<uint8_t>& input, float input_scale, Tensor<float>& output,
+                      float* workspace) override;
+
+    const quant::QuantizedWeight& weight() const { return weight_; }
+
+protected:
+    // x (N, in_features) uint8 with input params, or row_params[i] for row i when not null,
+    // into y (float) or, requantized, q (int8), acc holding N * out_features int32 and
+    // y_scratch as many floats when y is null.
+    void run(const uint8_t* x, int N, const quant::Params& input, const quant::Params* row_params, float* y,
+             int8_t* q, int32_t* acc, float* y_scratch) const;
+    // run without its profiler entry, e.g. for one tile of rows.
+    void compute(const uint8_t* x, int N, const quant::Params& input, const quant::Params* row_params, float* y,
+                 int8_t* q, int32_t* acc, float* y_scratch) const;
+    // float x quantized with params per row, each tile of rows straight into compute
+    // while it is still in cache. workspace as for forward_into.
+    void runPerRow(const float* x, int N, float* y, float* workspace) const;
+
+    int in_features;
+    int out_features;
+    quant::QuantizedWeight weight_;
+    std::vector<float> bias;
+    bool per_row_activations = false;
+    bool has_input_params = false;
+    quant::Params input_params;
+    bool has_output_params = false;
+    quant::Params output_params;
+};
+
+} // namespace nn
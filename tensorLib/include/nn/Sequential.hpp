@@ -0,0 +1,238 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include "Memory.hpp"
+#include "MemoryPlan.hpp"
+#include "ThreadPool.hpp"
+#include "nn/Module.hpp"
+#include "nn/modules.hpp"
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace nn {
+
+/**
+ * A chain of layers run out of one planned activation arena.
+ *
+ * The first forward for an input shape (or plan()) asks every layer for its output
+ * shape and scratch size, notes the last layer reading each activation, and packs them
+ * with memory::planArena: two activations share memory when they are never live at the
+ * same time, and in-place layers (ReLU, Flatten) write over their input. Later batches
+ * of the same shape reuse the arena and the prepared output views, so the steady state
+ * allocates no Tensor storage. Another input shape or input type (the first layer's
+ * scratch may differ for uint8), or another pool size (the Conv2d scratch is per thread),
+ * is planned again, the arena only grows.
+ *
+ *     nn::Sequential<float> model;
+ *     model.add(nn::Conv2d<float>(1, 1, 3, 1, 1, std::move(w1)))
+ *          .add(nn::Flatten<float>())
+ *          .add(nn::Linear<float>(784, 10, std::move(w2)));
+ *     const Tensor<float>& logits = model.forward(pixels.view({B, 1, 28, 28}), 1.0f / 255.0f);
+ *
+ * forward returns a view into the arena, valid until the next forward or plan. A
+ * Sequential runs one forward at a time, models on several threads each need their own
+ * (the layers themselves can be shared, see add(std::shared_ptr)).
+ */
+template <typename dtype>
+class Sequential {
+public:
+    Sequential() = default;
+    ~Sequential() = default;
+
+    Sequential(const Sequential&) = delete;
+    Sequential& operator=(const Sequential&) = delete;
+    Sequential(Sequential&&) = default;
+    Sequential& operator=(Sequential&&) = default;
+
+    // append a copy of module (or module itself, moved), e.g. add(nn::ReLU<float>()).
+    template <typename M,
+              typename = typename std::enable_if<std::is_base_of<Module<dtype>, typename std::decay<M>::type>::value>::type>
+    Sequential& add(M&& module) {
+        return add(std::make_shared<typename std::decay<M>::type>(std::forward<M>(module)));
+    }
+
+    // append a layer shared with other models.
+    Sequential& add(std::shared_ptr<Module<dtype>> module) {
+        layers_.push_back(std::move(module));
+        planned_ = false;
+        return *this;
+    }
+
+    size_t size() const {
+        return layers_.size();
+    }
+
+    Module<dtype>& operator[](size_t i) {
+        return *layers_[i];
+    }
+
+    // replace each Conv2d or Linear followed by a BatchNorm with one copy of that layer,
+    // the BatchNorm folded into its weight and bias. layers shared with other models are
+    // not changed. returns the number of BatchNorms removed.
+    int foldBatchNorm();
+
+    const Tensor<dtype>& forward(const Tensor<dtype>& input) {
+        prepare(input.shape(), false);
+        layers_[0]->forward_into(input, outputs_[0], workspaces_[0]);
+        return runFrom(1);
+    }
+
+    // raw uint8 input, taken by the first layer with input_scale applied in its epilogue.
+    const Tensor<dtype>& forward(const Tensor<uint8_t>& input, float input_scale = 1.0f / 255.0f) {
+        prepare(input.shape(), true);
+        layers_[0]->forward_into(input, input_scale, outputs_[0], workspaces_[0]);
+        return runFrom(1);
+    }
+
+    // plan the arena for input_shape, e.g. to size it up front for the largest batch.
+    void plan(const std::vector<int>& input_shape, bool uint8_input = false);
+
+    // bytes of the arena planned for the last input shape.
+    size_t arenaBytes() const {
+        return arena_bytes_;
+    }
+
+    // bytes the same activations and scratch take with one allocation each.
+    size_t naiveBytes() const {
+        return naive_bytes_;
+    }
+
+private:
+    void prepare(const std::vector<int>& input_shape, bool uint8_input) {
+        if (!planned_ || input_shape != planned_shape_ || uint8_input != planned_uint8_ ||
+            parallel::numThreads() != planned_threads_) {
+            plan(input_shape, uint8_input);
+        }
+    }
+
+    const Tensor<dtype>& runFrom(size_t first) {
+        for (size_t i = first; i < layers_.size(); i++) {
+            layers_[i]->forward_into(outputs_[i - 1], outputs_[i], workspaces_[i]);
+        }
+        return outputs_.back();
+    }
+
+    static const size_t ALIGNMENT = 64;
+
+    std::vector<std::shared_ptr<Module<dtype>>> layers_;
+
+    bool planned_ = false;
+    std::vector<int> planned_shape_;
+    bool planned_uint8_ = false;
+    int planned_threads_ = 0;
+    std::shared_ptr<dtype[]> arena_;
+    size_t arena_capacity_ = 0; // elements
+    size_t arena_bytes_ = 0;
+    size_t naive_bytes_ = 0;
+    // per layer, views into the arena.
+    std::vector<Tensor<dtype>> outputs_;
+    std::vector<dtype*> workspaces_;
+};
+
+template <typename dtype>
+int Sequential<dtype>::foldBatchNorm() {
+    int folded = 0;
+    if constexpr (std::is_floating_point<dtype>::value) {
+        for (size_t i = 0; i + 1 < layers_.size(); i++) {
+            auto bn = std::dynamic_pointer_cast<BatchNorm<dtype>>(layers_[i + 1]);
+            if (!bn) {
+                continue;
+            }
+            if (auto conv = std::dynamic_pointer_cast<Conv2d<dtype>>(layers_[i])) {
+                auto copy = std::make_shared<Conv2d<dtype>>(*conv);
+                copy->foldBatchNorm(*bn);
+                layers_[i] = copy;
+            } else if (auto linear = std::dynamic_pointer_cast<Linear<dtype>>(layers_[i])) {
+                auto copy = std::make_shared<Linear<dtype>>(*linear);
+                copy->foldBatchNorm(*bn);
+                layers_[i] = copy;
+            } else {
+                continue;
+            }
+            layers_.erase(layers_.begin() + i + 1);
+            folded++;
+        }
+    }
+    if (folded > 0) {
+        planned_ = false;
+    }
+    return folded;
+}
+
+template <typename dtype>
+void Sequential<dtype>::plan(const std::vector<int>& input_shape, bool uint8_input) {
+    if (layers_.empty()) {
+        throw std::invalid_argument("Sequential has no layers");
+    }
+    size_t L = layers_.size();
+
+    // one buffer per activation and per scratch, live from the step writing it to the
+    // last step reading it.
+    std::vector<memory::Buffer> buffers;
+    std::vector<std::vector<int>> shapes(L);
+    std::vector<size_t> elements(L);
+    std::vector<int> output_buffer(L), workspace_buffer(L, -1);
+    std::vector<int> shape = input_shape;
+    for (size_t i = 0; i < L; i++) {
+        int step = (int)i;
+        shapes[i] = layers_[i]->outputShape(shape);
+        elements[i] = 1;
+        for (int dim : shapes[i]) {
+            elements[i] *= dim;
+        }
+
+        // only the first layer is handed the uint8 input.
+        size_t scratch = i == 0 && uint8_input ? layers_[i]->uint8WorkspaceSize(shape)
+                                               : layers_[i]->workspaceSize(shape);
+        if (scratch > 0) {
+            workspace_buffer[i] = (int)buffers.size();
+            buffers.push_back({scratch * sizeof(dtype), step, step});
+        }
+
+        // in place over the previous activation, never over the caller's input.
+        if (i > 0 && layers_[i]->inPlace() && elements[i] == elements[i - 1]) {
+            output_buffer[i] = output_buffer[i - 1];
+        } else {
+            output_buffer[i] = (int)buffers.size();
+            buffers.push_back({elements[i] * sizeof(dtype), step, step});
+        }
+        // read by the next layer, the last activation is the result and outlives the run.
+        buffers[output_buffer[i]].last = step + 1;
+        shape = shapes[i];
+    }
+
+    memory::ArenaPlan arena_plan = memory::planArena(buffers, ALIGNMENT);
+
+    // room to align the start of the arena.
+    size_t needed = (arena_plan.arena_bytes + ALIGNMENT) / sizeof(dtype) + 1;
+    if (needed > arena_capacity_) {
+        outputs_.clear();
+        arena_.reset();
+        arena_ = memory::allocate<dtype>(needed);
+        arena_capacity_ = needed;
+    }
+    uintptr_t base = ((uintptr_t)arena_.get() + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    auto at = [&](int buffer) { return reinterpret_cast<dtype*>(base + arena_plan.offsets[buffer]); };
+
+    outputs_.clear();
+    workspaces_.assign(L, nullptr);
+    for (size_t i = 0; i < L; i++) {
+        // sharing the arena's ownership, a copy of a result keeps the arena alive.
+        outputs_.push_back(Tensor<dtype>(shapes[i], std::shared_ptr<dtype[]>(arena_, at(output_buffer[i]))));
+        if (workspace_buffer[i] >= 0) {
+            workspaces_[i] = at(workspace_buffer[i]);
+        }
+    }
+
+    arena_bytes_ = arena_plan.arena_bytes;
+    naive_bytes_ = arena_plan.naive_bytes;
+    planned_shape_ = input_shape;
+    planned_uint8_ = uint8_input;
+    planned_threads_ = parallel::numThreads();
+    planned_ = true;
+}
+
+} // namespace nn
@@ -1,24 +1,82 @@
 #pragma once
 
 #include "Tensor.hpp"
+#include "Profiler.hpp"
+#include "Autotuner.hpp"
+#include "StaticTensor.hpp"
+#include "ThreadPool.hpp"
+#include "Numa.hpp"
+#include "Memory.hpp"
+#include "Sparse.hpp"
+#include "nn/Module.hpp"
+#include <algorithm>
 #include <cassert>
-#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
 #include "iostream"
 
 namespace nn {
 
 template <typename dtype>
-class Linear {
+class BatchNorm;
+
+template <typename dtype>
+class Linear : public Module<dtype> {
 public:
     Linear(int in_features, int out_features);
     Linear(int in_features, int out_features, Tensor<dtype>&& weight);
+    // bias (out_features), float and double weights only.
+    Linear(int in_features, int out_features, Tensor<dtype>&& weight, Tensor<dtype>&& bias);
     ~Linear() = default;
     Tensor<dtype> forward(const Tensor<dtype>& input);
+    // raw uint8 input (e.g. pixels), input_scale is applied in the epilogue instead of
+    // normalizing the whole input first.
+    Tensor<dtype> forward(const Tensor<uint8_t>& input, float input_scale = 1.0f / 255.0f);
+
+    const char* name() const override { return "Linear"; }
+    std::vector<int> outputShape(const std::vector<int>& input_shape) const override;
+    void forward_into(const Tensor<dtype>& input, Tensor<dtype>& output, dtype* workspace) override;
+    void forward_into(const Tensor<uint8_t>& input, float input_scale, Tensor<dtype>& output,
+                      dtype* workspace) override;
+
+    // fold a following BatchNorm1d into the weight and bias, see BatchNorm.
+    void foldBatchNorm(const BatchNorm<dtype>& bn);
+
+    // store the weight sparse in format whatever its sparsity, the weights at or below
+    // threshold in magnitude pruned to 0 (see Sparse.hpp). float weights only.
+    void sparsify(sparse::Format format, float threshold = 0.0f);
+    // empty while the dense GEMM runs.
+    const sparse::Matrix& sparseWeight() const { return sparse_weight; }
+    // uint8 input scaled to float for a sparse weight, float input needs none.
+    size_t uint8WorkspaceSize(const std::vector<int>& input_shape) const override;
 
 protected:
+    // out (N, out_features) += bias, nothing without one.
+    void addBias(dtype* out, int N) const;
+
+    // the weight sparse when sparse::minSparsity() of it is zeros and a format is expected
+    // to beat the GEMM.
+    void chooseSparse();
+    // x (N, in_features) contiguous through spmm_nt_f32, then the bias.
+    void forwardSparse(const float* x, int N, float* out) const;
+
+    // rows of the output split over the pool, each worker reading the weight copy on its
+    // own NUMA node. x is (N, in_features) contiguous.
+    template <typename xtype>
+    void forwardReplicated(const xtype* x, int N, dtype* out, float input_scale) const;
+
     int in_features;
     int out_features;
     Tensor<dtype> weight;
+    // (out_features), or no elements without a bias.
+    Tensor<dtype> bias = Tensor<dtype>(std::vector<int>{0});
+    // one copy of weight per NUMA node, empty on single node hosts, see Numa.hpp.
+    numa::Replicas<dtype> replicas;
+    // the weight in blocks, empty for the dense path.
+    sparse::Matrix sparse_weight;
 };
 
 template <typename dtype>
@@ -29,9 +87,116 @@ Linear<dtype>::Linear(int in_features, int out_features) : in_features(in_featur
 template <typename dtype>
 Linear<dtype>::Linear(int in_features, int out_features, Tensor<dtype>&& weight)
         : in_features(in_features), out_features(out_features), weight(std::move(weight)) {
-    // Optionally perform some sanity checks on the weight tensor shape
-    assert(weight.shape().size() == 2 && weight.shape()[0] == out_features && weight.shape()[1] == in_features);
-    // assert(weight.shape().size() == 2 && weight.shape()[1] == out_features && weight.shape()[0] == in_features);
+    const std::vector<int>& shape = this->weight.shape();
+    if (shape.size() != 2 || shape[0] != out_features || shape[1] != in_features) {
+        throw std::invalid_argument("Linear: weight must be (" + std::to_string(out_features) + ", " +
+                                    std::to_string(in_features) + ")");
+    }
+
+    if constexpr (std::is_same<dtype, float>::value) {
+        chooseSparse();
+    }
+    if constexpr (std::is_same<dtype, float>::value || std::is_same<dtype, int32_t>::value) {
+        if (numa::replicateWeights() && sparse_weight.empty()) {
+            auto w = this->weight.is_contiguous() ? this->weight : this->weight.contiguous();
+            replicas.build(&w.data_[w.offset()], w.num_elements);
+        }
+    }
+}
+
+template <typename dtype>
+Linear<dtype>::Linear(int in_features, int out_features, Tensor<dtype>&& weight, Tensor<dtype>&& bias)
+        : Linear(in_features, out_features, std::move(weight)) {
+    if (!std::is_floating_point<dtype>::value) {
+        throw std::invalid_argument("Linear: a bias needs float or double weights");
+    }
+    if (bias.num_elements != out_features) {
+        throw std::invalid_argument("Linear: bias must have " + std::to_string(out_features) + " elements");
+    }
+    this->bias = bias.is_contiguous() ? std::move(bias) : bias.contiguous();
+}
+
+template <typename dtype>
+void Linear<dtype>::addBias(dtype* out, int N) const {
+    if (bias.num_elements == 0) {
+        return;
+    }
+    const dtype* b = &bias.data_[bias.offset()];
+    if constexpr (std::is_same<dtype, float>::value) {
+        kernels::active().bias_add_f32(out, N, out_features, b, false);
+    } else {
+        for (int64_t i = 0; i < (int64_t)N * out_features; i++) {
+            out[i] += b[i % out_features];
+        }
+    }
+}
+
+template <typename dtype>
+void Linear<dtype>::chooseSparse() {
+    if (weight.shape().size() != 2 || sparse::sparsity(weight) < sparse::minSparsity()) {
+        return;
+    }
+    sparse::Format format = sparse::chooseFormat(weight);
+    if (sparse::relativeCost(weight, format) < 1.0) {
+        sparse_weight = sparse::fromDense(weight, format);
+    }
+}
+
+template <typename dtype>
+void Linear<dtype>::sparsify(sparse::Format format, float threshold) {
+    if constexpr (!std::is_same<dtype, float>::value) {
+        throw std::invalid_argument("Linear: sparse weights are float only");
+    } else {
+        sparse_weight = sparse::fromDense(weight, format, threshold);
+        weight = sparse::toDense(sparse_weight);
+        replicas = numa::Replicas<dtype>();
+    }
+}
+
+template <typename dtype>
+size_t Linear<dtype>::uint8WorkspaceSize(const std::vector<int>& input_shape) const {
+    return sparse_weight.empty() || input_shape.empty() ? 0 : (size_t)input_shape[0] * in_features;
+}
+
+template <typename dtype>
+void Linear<dtype>::forwardSparse(const float* x, int N, float* out) const {
+    const sparse::Matrix& w = sparse_weight;
+    std::vector<int> shape = {N, in_features};
+    PROFILE_OP("Linear(sparse)", 2.0 * N * w.values.size(),
+               4.0 * N * (in_features + out_features) + (double)w.bytes(), &shape, &weight.shape());
+    kernels::active().spmm_nt_f32(N, out_features, x, in_features, w.row_ptr.data(), w.col_idx.data(),
+                                  w.values.data(), w.block_rows, w.block_cols, out, out_features);
+    addBias(out, N);
+}
+
+template <typename dtype>
+template <typename xtype>
+void Linear<dtype>::forwardReplicated(const xtype* x, int N, dtype* out, float input_scale) const {
+    const auto& k = kernels::active();
+    int grain = std::max(1, (1 << 16) / std::max(1, in_features * out_features));
+    // each chunk runs on one worker, the default blocking on one thread. tuning here would
+    // time single threaded runs of every chunk height under the full pool's key.
+    kernels::GemmConfig config;
+    config.threads = 1;
+    parallel::parallel_for(0, N, grain, [&](int64_t begin, int64_t end) {
+        int rows = (int)(end - begin);
+        const xtype* x_rows = x + (size_t)begin * in_features;
+        dtype* out_rows = out + (size_t)begin * out_features;
+        const dtype* w = replicas.local();
+        // nested in this parallel_for, the kernel runs on this worker only.
+        if constexpr (std::is_same<xtype, float>::value) {
+            k.gemm_nt_f32(rows, out_features, in_features, x_rows, in_features, w, in_features, out_rows,
+                          out_features, config);
+            addBias(out_rows, rows);
+        } else if constexpr (std::is_same<dtype, float>::value) {
+            k.gemm_nt_u8f32(rows, out_features, in_features, x_rows, in_features, w, in_features, out_rows,
+                            out_features, input_scale);
+            addBias(out_rows, rows);
+        } else {
+            k.gemm_nt_u8i32(rows, out_features, in_features, x_rows, in_features, w, in_features, out_rows,
+                            out_features);
+        }
+    });
 }
 
 /**
@@ -42,40 +207,359 @@ Linear<dtype>::Linear(int in_features, int out_features, Tensor<dtype>&& weight)
  */
 template <typename dtype>
 Tensor<dtype> Linear<dtype>::forward(const Tensor<dtype>& input) {
-    auto start_time = std::chrono::high_resolution_clock::now();
+    // throws for input that is not (N, in_features).
+    outputShape(input.shape());
+    if constexpr (std::is_same<dtype, float>::value) {
+        if (!sparse_weight.empty()) {
+            Tensor<dtype> result(outputShape(input.shape()));
+            forward_into(input, result, nullptr);
+            return result;
+        }
+    }
+    PROFILE_OP("Linear", 2.0 * input.shape()[0] * in_features * out_features,
+               (double)sizeof(dtype) * (input.num_elements + weight.num_elements + (double)input.shape()[0] * out_features),
+               &input.shape(), &weight.shape());
+
+    if constexpr (std::is_same<dtype, float>::value) {
+        if (!replicas.empty() && input.shape().size() == 2 && input.shape()[1] == in_features) {
+            auto x = input.is_contiguous() ? input : input.contiguous();
+            Tensor<dtype> result({x.shape()[0], out_features});
+            forwardReplicated(&x.data_[x.offset()], x.shape()[0], &result.data_[0], 1.0f);
+            return result;
+        }
+    }
 
     auto result = input.matmul(weight.transpose(0, 1));
+    if (bias.num_elements > 0) {
+        addBias(&result.data_[result.offset()], result.shape()[0]);
+    }
+
+    return result;
+}
+
+template <typename dtype>
+std::vector<int> Linear<dtype>::outputShape(const std::vector<int>& input_shape) const {
+    if (input_shape.size() != 2 || input_shape[1] != in_features) {
+        throw std::invalid_argument("Linear expects (N, " + std::to_string(in_features) + ") input");
+    }
+    return {input_shape[0], out_features};
+}
+
+/**
+ * forward into output, (N, out_features) contiguous. float weights run the GEMM of matmul
+ * straight into output, the other types go through forward and a copy.
+ */
+template <typename dtype>
+void Linear<dtype>::forward_into(const Tensor<dtype>& input, Tensor<dtype>& output, dtype*) {
+    // throws for input that is not (N, in_features).
+    outputShape(input.shape());
+
+    if constexpr (std::is_same<dtype, float>::value) {
+        auto x = input.is_contiguous() ? input : input.contiguous();
+        int N = x.shape()[0];
+        const float* x_ptr = &x.data_[x.offset()];
+        float* o_ptr = &output.data_[output.offset()];
+        if (!sparse_weight.empty()) {
+            forwardSparse(x_ptr, N, o_ptr);
+            return;
+        }
 
-    auto end_time = std::chrono::high_resolution_clock::now();
-    auto duration_seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end_time - start_time).count();
-    std::cout << "Linear Execution time: " << duration_seconds << " seconds" << std::endl;
+        PROFILE_OP("Linear", 2.0 * input.shape()[0] * in_features * out_features,
+                   (double)sizeof(dtype) * (input.num_elements + weight.num_elements + (double)input.shape()[0] * out_features),
+                   &input.shape(), &weight.shape());
+        if (!replicas.empty()) {
+            forwardReplicated(x_ptr, N, o_ptr, 1.0f);
+            return;
+        }
+        auto w = weight.is_contiguous() ? weight : weight.contiguous();
+        kernels::active().gemm_nt_f32(N, out_features, in_features, x_ptr, in_features, &w.data_[w.offset()],
+                                      in_features, o_ptr, out_features, tuner::gemm(N, out_features, in_features, true));
+        addBias(o_ptr, N);
+    } else {
+        auto result = forward(input);
+        std::copy(&result.data_[0], &result.data_[0] + result.num_elements, &output.data_[output.offset()]);
+    }
+}
 
+/**
+ * input:  (N, in_features), uint8
+ * weight: (out_features, in_features)
+ * output: (N, out_features), output = input_scale * input.matmul(weight.T)
+ * for float weights input_scale is multiplied into each output element, for quantized
+ * (integer) weights the accumulators are returned as is and input_scale is folded into
+ * output.scale together with weight.scale, so output.dequantize() gives the real value.
+ */
+template <typename dtype>
+Tensor<dtype> Linear<dtype>::forward(const Tensor<uint8_t>& input, float input_scale) {
+    Tensor<dtype> result(outputShape(input.shape()));
+    forward_into(input, input_scale, result, nullptr);
     return result;
 }
 
+template <typename dtype>
+void Linear<dtype>::forward_into(const Tensor<uint8_t>& input, float input_scale, Tensor<dtype>& output,
+                                 dtype* workspace) {
+    // throws for input that is not (N, in_features).
+    outputShape(input.shape());
+
+    if constexpr (std::is_same<dtype, float>::value) {
+        if (!sparse_weight.empty()) {
+            // the sparse kernel reads float activations, the pixels are scaled once up front.
+            auto x = input.is_contiguous() ? input : input.contiguous();
+            std::shared_ptr<float[]> scratch;
+            if (workspace == nullptr) {
+                scratch = memory::allocate<float>(uint8WorkspaceSize(x.shape()));
+                workspace = scratch.get();
+            }
+            kernels::active().scale_u8_f32(&x.data_[x.offset()], input_scale, workspace, x.num_elements);
+            forwardSparse(workspace, x.shape()[0], &output.data_[output.offset()]);
+            return;
+        }
+    }
+
+    PROFILE_OP("Linear(uint8)", 2.0 * input.shape()[0] * in_features * out_features,
+               input.num_elements + (double)sizeof(dtype) * (weight.num_elements + (double)input.shape()[0] * out_features),
+               &input.shape(), &weight.shape());
+
+    auto x = input.is_contiguous() ? input : input.contiguous();
+    auto w = weight.is_contiguous() ? weight : weight.contiguous();
+
+    int N = x.shape()[0];
+
+    const uint8_t* x_ptr = &x.data_[x.offset()];
+    const dtype* w_ptr = &w.data_[w.offset()];
+    dtype* r_ptr = &output.data_[output.offset()];
+
+    if constexpr (std::is_same<dtype, float>::value || std::is_same<dtype, int32_t>::value) {
+        if (!replicas.empty()) {
+            forwardReplicated(x_ptr, N, r_ptr, input_scale);
+            if constexpr (std::is_same<dtype, int32_t>::value) {
+                output.scale = input_scale * weight.scale;
+            }
+            return;
+        }
+    }
+
+    if constexpr (std::is_same<dtype, float>::value) {
+        kernels::active().gemm_nt_u8f32(N, out_features, in_features, x_ptr, in_features, w_ptr, in_features,
+                                        r_ptr, out_features, input_scale);
+        addBias(r_ptr, N);
+        return;
+    } else if constexpr (std::is_same<dtype, int32_t>::value) {
+        kernels::active().gemm_nt_u8i32(N, out_features, in_features, x_ptr, in_features, w_ptr, in_features,
+                                        r_ptr, out_features);
+        output.scale = input_scale * weight.scale;
+        return;
+    }
+
+    // both input rows and weight rows are contiguous, each output is a dot product.
+    int row_work = std::max(1, in_features * out_features);
+    parallel::parallel_for(0, N, std::max(1, (1 << 16) / row_work), [&](int64_t begin, int64_t end) {
+        for (int i = (int)begin; i < (int)end; ++i) {
+            for (int j = 0; j < out_features; ++j) {
+                const uint8_t* x_row = x_ptr + (size_t)i * in_features;
+                const dtype* w_row = w_ptr + (size_t)j * in_features;
+                dtype sum = 0;
+                for (int k = 0; k < in_features; ++k) {
+                    sum += static_cast<dtype>(x_row[k]) * w_row[k];
+                }
+                if constexpr (std::is_floating_point<dtype>::value) {
+                    r_ptr[(size_t)i * out_features + j] = sum * input_scale + (bias.num_elements > 0 ? bias.data_[bias.offset() + j] : 0);
+                } else {
+                    r_ptr[(size_t)i * out_features + j] = sum;
+                }
+            }
+        }
+    });
+
+    if constexpr (!std::is_floating_point<dtype>::value) {
+        output.scale = input_scale * weight.scale;
+    }
+}
+
 
 template <typename dtype>
-class ReLU {
+class ReLU : public Module<dtype> {
 public:
     ReLU() = default;
     ~ReLU() = default;
     Tensor<dtype> forward(const Tensor<dtype>& input); // maximum method
+
+    const char* name() const override { return "ReLU"; }
+    std::vector<int> outputShape(const std::vector<int>& input_shape) const override { return input_shape; }
+    void forward_into(const Tensor<dtype>& input, Tensor<dtype>& output, dtype* workspace) override;
+    bool inPlace() const override { return true; }
 };
 
 template <typename dtype>
 Tensor<dtype> ReLU<dtype>::forward(const Tensor<dtype>& input) {
-    Tensor<dtype> temp({});
-    temp.setData({}, 0);
-    return maximum(input, temp);
+    if constexpr (!std::is_same<dtype, float>::value) {
+        // quantized, real 0 is the zero point, see forward_into.
+        Tensor<dtype> output(input.shape());
+        forward_into(input, output, nullptr);
+        return output;
+    } else {
+        Tensor<dtype> temp({});
+        temp.setData({}, 0);
+        return maximum(input, temp);
+    }
 }
 
+// element by element, so output may be input itself. Quantized values keep their scale
+// and zero point and are clamped at the zero point, the quantized real 0.
 template <typename dtype>
-class Conv2d {
+void ReLU<dtype>::forward_into(const Tensor<dtype>& input, Tensor<dtype>& output, dtype*) {
+    auto x = input.is_contiguous() ? input : input.contiguous();
+    const dtype* x_ptr = &x.data_[x.offset()];
+    dtype* y_ptr = &output.data_[output.offset()];
+    output.scale = input.scale;
+    output.zero_point = input.zero_point;
+    if constexpr (std::is_same<dtype, float>::value) {
+        kernels::active().maximum_f32(x_ptr, 0.0f, y_ptr, x.num_elements);
+    } else {
+        dtype zero = (dtype)input.zero_point;
+        for (int i = 0; i < x.num_elements; i++) {
+            y_ptr[i] = x_ptr[i] > zero ? x_ptr[i] : zero;
+        }
+    }
+}
+
+/**
+ * (N, d1, d2, ...) -> (N, d1 * d2 * ...), e.g. between Conv2d and Linear.
+ * forward returns a view of the input, no copy is made.
+ */
+template <typename dtype>
+class Flatten : public Module<dtype> {
+public:
+    Flatten() = default;
+    ~Flatten() = default;
+
+    Tensor<dtype> forward(const Tensor<dtype>& input) const {
+        return input.view(outputShape(input.shape()));
+    }
+
+    const char* name() const override { return "Flatten"; }
+
+    std::vector<int> outputShape(const std::vector<int>& input_shape) const override {
+        if (input_shape.empty()) {
+            throw std::invalid_argument("Flatten expects a batch dimension");
+        }
+        int features = 1;
+        for (size_t i = 1; i < input_shape.size(); i++) {
+            features *= input_shape[i];
+        }
+        return {input_shape[0], features};
+    }
+
+    // a copy only when output is not the input's storage already, in a Sequential it is.
+    void forward_into(const Tensor<dtype>& input, Tensor<dtype>& output, dtype*) override {
+        auto x = input.is_contiguous() ? input : input.contiguous();
+        const dtype* src = &x.data_[x.offset()];
+        dtype* dst = &output.data_[output.offset()];
+        output.scale = input.scale;
+        output.zero_point = input.zero_point;
+        if (src != dst) {
+            std::copy(src, src + x.num_elements, dst);
+        }
+    }
+
+    bool inPlace() const override { return true; }
+};
+
+/**
+ * (N, C, H, W) -> (N, C, (H - kernel) / stride + 1, (W - kernel) / stride + 1), the
+ * maximum of each kernel x kernel window, no padding.
+ */
+template <typename dtype>
+class MaxPool2d : public Module<dtype> {
+public:
+    // stride 0 means kernel_size, windows side by side.
+    explicit MaxPool2d(int kernel_size, int stride = 0)
+        : kernel_size(kernel_size), stride(stride > 0 ? stride : kernel_size) {}
+    ~MaxPool2d() = default;
+
+    Tensor<dtype> forward(const Tensor<dtype>& input) {
+        Tensor<dtype> output(outputShape(input.shape()));
+        forward_into(input, output, nullptr);
+        return output;
+    }
+
+    const char* name() const override { return "MaxPool2d"; }
+
+    std::vector<int> outputShape(const std::vector<int>& input_shape) const override {
+        if (input_shape.size() != 4 || input_shape[2] < kernel_size || input_shape[3] < kernel_size) {
+            throw std::invalid_argument("MaxPool2d expects (N, C, H, W) input of at least the kernel size");
+        }
+        return {input_shape[0], input_shape[1], (input_shape[2] - kernel_size) / stride + 1,
+                (input_shape[3] - kernel_size) / stride + 1};
+    }
+
+    void forward_into(const Tensor<dtype>& input, Tensor<dtype>& output, dtype*) override {
+        auto x = input.is_contiguous() ? input : input.contiguous();
+        const std::vector<int>& s = x.shape();
+        int planes = s[0] * s[1], H = s[2], W = s[3];
+        const dtype* x_ptr = &x.data_[x.offset()];
+        dtype* y_ptr = &output.data_[output.offset()];
+        // the maximum commutes with the quantization, scale and zero point carry over.
+        output.scale = input.scale;
+        output.zero_point = input.zero_point;
+
+        PROFILE_OP("MaxPool2d", (double)output.num_elements * kernel_size * kernel_size,
+                   (double)sizeof(dtype) * (x.num_elements + output.num_elements), &input.shape());
+        if constexpr (std::is_same<dtype, float>::value) {
+            kernels::active().maxpool2d_f32(x_ptr, planes, H, W, 1, kernel_size, stride,
+                                            -std::numeric_limits<float>::infinity(), y_ptr);
+        } else {
+            int H_out = (H - kernel_size) / stride + 1, W_out = (W - kernel_size) / stride + 1;
+            parallel::parallel_for(0, planes, 1, [&](int64_t begin, int64_t end) {
+                for (int64_t c = begin; c < end; c++) {
+                    const dtype* plane = x_ptr + c * H * W;
+                    dtype* out = y_ptr + c * H_out * W_out;
+                    for (int i = 0; i < H_out; i++) {
+                        for (int j = 0; j < W_out; j++) {
+                            dtype m = plane[i * stride * W + j * stride];
+                            for (int ki = 0; ki < kernel_size; ki++) {
+                                for (int kj = 0; kj < kernel_size; kj++) {
+                                    m = std::max(m, plane[(i * stride + ki) * W + j * stride + kj]);
+                                }
+                            }
+                            out[i * W_out + j] = m;
+                        }
+                    }
+                }
+            });
+        }
+    }
+
+// private:
+protected:
+    int kernel_size;
+    int stride;
+};
+
+template <typename dtype>
+class Conv2d : public Module<dtype> {
 public:
     Conv2d(int in_channels, int out_channels, int kernel_size, int stride, int padding, Tensor<dtype>&& weight);
+    // bias (out_channels), float and double weights only.
+    Conv2d(int in_channels, int out_channels, int kernel_size, int stride, int padding, Tensor<dtype>&& weight,
+           Tensor<dtype>&& bias);
     ~Conv2d() = default;
 
     Tensor<dtype> forward(const Tensor<dtype>& input);
+    // raw uint8 input, input_scale is applied in the epilogue like Linear.
+    Tensor<dtype> forward(const Tensor<uint8_t>& input, float input_scale = 1.0f / 255.0f);
+
+    const char* name() const override { return "Conv2d"; }
+    std::vector<int> outputShape(const std::vector<int>& input_shape) const override;
+    // the im2col columns of the float kernel, see kernels::conv2d_f32.
+    size_t workspaceSize(const std::vector<int>& input_shape) const override;
+    void forward_into(const Tensor<dtype>& input, Tensor<dtype>& output, dtype* workspace) override;
+    void forward_into(const Tensor<uint8_t>& input, float input_scale, Tensor<dtype>& output,
+                      dtype* workspace) override;
+
+    // fold a following BatchNorm2d into the weight and bias, see BatchNorm.
+    void foldBatchNorm(const BatchNorm<dtype>& bn);
 
 // private:
 protected:
@@ -86,6 +570,8 @@ protected:
     int padding;
     // c_cout * c_in * kernel_size * kernel_size
     Tensor<dtype> weight;
+    // c_out, or no elements without a bias.
+    Tensor<dtype> bias = Tensor<dtype>(std::vector<int>{0});
 };
 
 template <typename dtype>
@@ -98,6 +584,19 @@ Conv2d<dtype>::Conv2d(int in_channels, int out_channels, int kernel_size, int st
     // weight({in_channels, kernel_size, kernel_size, out_channels});
 }
 
+template <typename dtype>
+Conv2d<dtype>::Conv2d(int in_channels, int out_channels, int kernel_size, int stride, int padding,
+                      Tensor<dtype>&& weight, Tensor<dtype>&& bias)
+        : Conv2d(in_channels, out_channels, kernel_size, stride, padding, std::move(weight)) {
+    if (!std::is_floating_point<dtype>::value) {
+        throw std::invalid_argument("Conv2d: a bias needs float or double weights");
+    }
+    if (bias.num_elements != out_channels) {
+        throw std::invalid_argument("Conv2d: bias must have " + std::to_string(out_channels) + " elements");
+    }
+    this->bias = bias.is_contiguous() ? std::move(bias) : bias.contiguous();
+}
+
 /**
  * input shape:  N x c_in x H x W 
  * weight shape: c_cout * c_in * kernel_size * kernel_size
@@ -105,14 +604,24 @@ Conv2d<dtype>::Conv2d(int in_channels, int out_channels, int kernel_size, int st
  */
 template <typename dtype>
 Tensor<dtype> Conv2d<dtype>::forward(const Tensor<dtype>& input) {
-    auto start_time = std::chrono::high_resolution_clock::now();
-
     assert(input.shape().size() == 4 && input.shape()[1] == in_channels);
 
+    if constexpr (std::is_same<dtype, float>::value) {
+        if (input.is_contiguous() && weight.is_contiguous()) {
+            auto output = Tensor<dtype>(outputShape(input.shape()));
+            forward_into(input, output, nullptr);
+            return output;
+        }
+    }
+
     auto output_height = (input.shape()[2] + 2 * padding - kernel_size) / stride + 1;
     auto output_width = (input.shape()[3] + 2 * padding - kernel_size) / stride + 1;
     auto output_shape = std::vector<int>{input.shape()[0], out_channels, output_height, output_width};
 
+    PROFILE_OP("Conv2d", 2.0 * input.shape()[0] * out_channels * output_height * output_width * in_channels * kernel_size * kernel_size,
+               (double)sizeof(dtype) * (input.num_elements + weight.num_elements + (double)input.shape()[0] * out_channels * output_height * output_width),
+               &input.shape(), &weight.shape());
+
     // padding
     auto input_padded = zeros<dtype>({input.shape()[0], input.shape()[1], input.shape()[2] + 2 * padding, input.shape()[3] + 2 * padding});
     for (int i = 0; i < input.shape()[0]; i++) {
@@ -127,7 +636,6 @@ Tensor<dtype> Conv2d<dtype>::forward(const Tensor<dtype>& input) {
 
     auto output = Tensor<dtype>(output_shape);
 
-    // auto start_time = std::chrono::high_resolution_clock::now();
     // conv
     for (int idxn = 0; idxn < output_shape[0]; idxn++) {
         // printf("idxn: %d\n", idxn);
@@ -136,17 +644,467 @@ Tensor<dtype> Conv2d<dtype>::forward(const Tensor<dtype>& input) {
                 for (int idxw = 0; idxw < output_shape[3]; idxw++) {
                     // weight select channel idxc, input_padded select data idxn.
                     auto convTensor = weight.select(0, idxc) * input_padded.select(0, idxn).slice(idxh*stride, idxh*stride+kernel_size, 1).slice(idxw*stride, idxw*stride+kernel_size, 2);
-                    output.setData({idxn, idxc, idxh, idxw}, convTensor.sum());
+                    dtype b = bias.num_elements > 0 ? bias.data_[bias.offset() + idxc] : 0;
+                    output.setData({idxn, idxc, idxh, idxw}, convTensor.sum() + b);
                 }
             }
         }
     }
 
-    auto end_time = std::chrono::high_resolution_clock::now();
-    auto duration_seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end_time - start_time).count();
-    std::cout << "Conv Execution time: " << duration_seconds << " seconds" << std::endl;
-    
     return output;
 }
 
+template <typename dtype>
+std::vector<int> Conv2d<dtype>::outputShape(const std::vector<int>& input_shape) const {
+    if (input_shape.size() != 4 || input_shape[1] != in_channels) {
+        throw std::invalid_argument("Conv2d expects (N, " + std::to_string(in_channels) + ", H, W) input");
+    }
+    int output_height = (input_shape[2] + 2 * padding - kernel_size) / stride + 1;
+    int output_width = (input_shape[3] + 2 * padding - kernel_size) / stride + 1;
+    return {input_shape[0], out_channels, output_height, output_width};
+}
+
+template <typename dtype>
+size_t Conv2d<dtype>::workspaceSize(const std::vector<int>& input_shape) const {
+    if constexpr (std::is_same<dtype, float>::value) {
+        int N = input_shape[0], H = input_shape[2], W = input_shape[3];
+        auto config = tuner::conv2d(N, in_channels, H, W, out_channels, kernel_size, stride, padding);
+        return kernels::conv2d_workspace_f32(N, in_channels, H, W, kernel_size, stride, padding, config);
+    }
+    return 0;
+}
+
+/**
+ * forward into output, N x c_cout x H_out x W_out contiguous. float runs im2col + GEMM or
+ * direct, whichever is tuned for this shape (see Autotuner.hpp), with the columns in
+ * workspace, the other types go through forward and a copy.
+ */
+template <typename dtype>
+void Conv2d<dtype>::forward_into(const Tensor<dtype>& input, Tensor<dtype>& output, dtype* workspace) {
+    assert(input.shape().size() == 4 && input.shape()[1] == in_channels);
+
+    if constexpr (std::is_same<dtype, float>::value) {
+        if (input.is_contiguous() && weight.is_contiguous()) {
+            int N = input.shape()[0], H = input.shape()[2], W = input.shape()[3];
+            PROFILE_OP("Conv2d", 2.0 * output.num_elements * in_channels * kernel_size * kernel_size,
+                       (double)sizeof(dtype) * (input.num_elements + weight.num_elements + (double)output.num_elements),
+                       &input.shape(), &weight.shape());
+
+            auto config = tuner::conv2d(N, in_channels, H, W, out_channels, kernel_size, stride, padding);
+            kernels::conv2d_f32(&input.data_[input.offset()], N, in_channels, H, W, &weight.data_[weight.offset()],
+                                out_channels, kernel_size, stride, padding, &output.data_[output.offset()], config,
+                                workspace, bias.num_elements > 0 ? &bias.data_[bias.offset()] : nullptr);
+            return;
+        }
+    }
+
+    auto result = forward(input);
+    std::copy(&result.data_[0], &result.data_[0] + result.num_elements, &output.data_[output.offset()]);
+}
+
+/**
+ * input shape:  N x c_in x H x W, uint8
+ * the padding is handled by skipping the out of bound pixels, so no padded copy of the
+ * input is made, and input_scale is applied once per output element.
+ */
+template <typename dtype>
+Tensor<dtype> Conv2d<dtype>::forward(const Tensor<uint8_t>& input, float input_scale) {
+    auto output = Tensor<dtype>(outputShape(input.shape()));
+    forward_into(input, input_scale, output, nullptr);
+    return output;
+}
+
+template <typename dtype>
+void Conv2d<dtype>::forward_into(const Tensor<uint8_t>& input, float input_scale, Tensor<dtype>& output, dtype*) {
+    assert(input.shape().size() == 4 && input.shape()[1] == in_channels);
+
+    auto x = input.is_contiguous() ? input : input.contiguous();
+    auto w = weight.is_contiguous() ? weight : weight.contiguous();
+
+    int N = x.shape()[0];
+    int H = x.shape()[2];
+    int W = x.shape()[3];
+    int output_height = (H + 2 * padding - kernel_size) / stride + 1;
+    int output_width = (W + 2 * padding - kernel_size) / stride + 1;
+
+    PROFILE_OP("Conv2d(uint8)", 2.0 * output.num_elements * in_channels * kernel_size * kernel_size,
+               input.num_elements + (double)sizeof(dtype) * (weight.num_elements + output.num_elements),
+               &input.shape(), &weight.shape());
+
+    const uint8_t* x_ptr = &x.data_[x.offset()];
+    const dtype* w_ptr = &w.data_[w.offset()];
+    const dtype* b_ptr = bias.num_elements > 0 ? &bias.data_[bias.offset()] : nullptr;
+    dtype* o_ptr = &output.data_[output.offset()];
+
+    int plane_work = std::max(1, output_height * output_width * in_channels * kernel_size * kernel_size);
+    parallel::parallel_for(0, (int64_t)N * out_channels, std::max(1, (1 << 16) / plane_work),
+                           [&](int64_t begin, int64_t end) {
+        for (int64_t plane = begin; plane < end; plane++) {
+            int n = (int)(plane / out_channels);
+            int co = (int)(plane % out_channels);
+            for (int oh = 0; oh < output_height; oh++) {
+                for (int ow = 0; ow < output_width; ow++) {
+                    dtype sum = 0;
+                    for (int ci = 0; ci < in_channels; ci++) {
+                        const uint8_t* x_plane = x_ptr + ((size_t)n * in_channels + ci) * H * W;
+                        const dtype* w_plane = w_ptr + ((size_t)co * in_channels + ci) * kernel_size * kernel_size;
+                        for (int kh = 0; kh < kernel_size; kh++) {
+                            int ih = oh * stride + kh - padding;
+                            if (ih < 0 || ih >= H) continue;
+                            for (int kw = 0; kw < kernel_size; kw++) {
+                                int iw = ow * stride + kw - padding;
+                                if (iw < 0 || iw >= W) continue;
+                                sum += static_cast<dtype>(x_plane[ih * W + iw]) * w_plane[kh * kernel_size + kw];
+                            }
+                        }
+                    }
+                    size_t idx = (((size_t)n * out_channels + co) * output_height + oh) * output_width + ow;
+                    if constexpr (std::is_floating_point<dtype>::value) {
+                        o_ptr[idx] = sum * input_scale + (b_ptr != nullptr ? b_ptr[co] : 0);
+                    } else {
+                        o_ptr[idx] = sum;
+                    }
+                }
+            }
+        }
+    });
+
+    if constexpr (!std::is_floating_point<dtype>::value) {
+        output.scale = input_scale * weight.scale;
+    }
+}
+
+/**
+ * Batch normalization with the running statistics from training, for each channel c
+ * (dimension 1 of the input):
+ *     y = (x - running_mean[c]) / sqrt(running_var[c] + eps) * weight[c] + bias[c]
+ * precomputed at construction as y = x * scale[c] + shift[c].
+ *
+ * On its own it is one more read and write of every activation. Right after a Conv2d or
+ * Linear it is better folded into that layer's weight and bias when loading the model,
+ * see foldBatchNorm there and Sequential::foldBatchNorm, so the normalized model costs
+ * the same as the unnormalized one.
+ */
+template <typename dtype>
+class BatchNorm : public Module<dtype> {
+    static_assert(std::is_floating_point<dtype>::value, "BatchNorm is for float and double activations");
+
+public:
+    // the per channel tensors in any shape with num_features elements, e.g. read from CSV.
+    BatchNorm(int num_features, const Tensor<dtype>& weight, const Tensor<dtype>& bias,
+              const Tensor<dtype>& running_mean, const Tensor<dtype>& running_var, double eps = 1e-5);
+    ~BatchNorm() = default;
+
+    Tensor<dtype> forward(const Tensor<dtype>& input) {
+        Tensor<dtype> output(outputShape(input.shape()));
+        forward_into(input, output, nullptr);
+        return output;
+    }
+
+    std::vector<int> outputShape(const std::vector<int>& input_shape) const override;
+    // element by element, so output may be input itself.
+    void forward_into(const Tensor<dtype>& input, Tensor<dtype>& output, dtype* workspace) override;
+    bool inPlace() const override { return true; }
+
+    int numFeatures() const { return num_features; }
+    const Tensor<dtype>& scale() const { return scale_; }
+    const Tensor<dtype>& shift() const { return shift_; }
+
+protected:
+    // the input ranks accepted, (N, C, ...) with min_rank to max_rank dimensions.
+    int min_rank = 2;
+    int max_rank = 4;
+    int num_features;
+    Tensor<dtype> scale_;
+    Tensor<dtype> shift_;
+};
+
+template <typename dtype>
+BatchNorm<dtype>::BatchNorm(int num_features, const Tensor<dtype>& weight, const Tensor<dtype>& bias,
+                            const Tensor<dtype>& running_mean, const Tensor<dtype>& running_var, double eps)
+        : num_features(num_features), scale_(std::vector<int>{num_features}), shift_(std::vector<int>{num_features}) {
+    for (const Tensor<dtype>* t : {&weight, &bias, &running_mean, &running_var}) {
+        if (t->num_elements != num_features) {
+            throw std::invalid_argument("BatchNorm: parameters must have " + std::to_string(num_features) + " elements");
+        }
+    }
+    auto g = weight.is_contiguous() ? weight : weight.contiguous();
+    auto b = bias.is_contiguous() ? bias : bias.contiguous();
+    auto m = running_mean.is_contiguous() ? running_mean : running_mean.contiguous();
+    auto v = running_var.is_contiguous() ? running_var : running_var.contiguous();
+    for (int c = 0; c < num_features; c++) {
+        double s = g.data_[g.offset() + c] / std::sqrt((double)v.data_[v.offset() + c] + eps);
+        scale_.data_[c] = (dtype)s;
+        shift_.data_[c] = (dtype)(b.data_[b.offset() + c] - m.data_[m.offset() + c] * s);
+    }
+}
+
+template <typename dtype>
+std::vector<int> BatchNorm<dtype>::outputShape(const std::vector<int>& input_shape) const {
+    if ((int)input_shape.size() < min_rank || (int)input_shape.size() > max_rank || input_shape[1] != num_features) {
+        std::string ranks = std::to_string(min_rank) + (max_rank > min_rank ? " to " + std::to_string(max_rank) : "");
+        throw std::invalid_argument(std::string(this->name()) + " expects (N, " + std::to_string(num_features) +
+                                    ", ...) input of " + ranks + " dimensions");
+    }
+    return input_shape;
+}
+
+template <typename dtype>
+void BatchNorm<dtype>::forward_into(const Tensor<dtype>& input, Tensor<dtype>& output, dtype*) {
+    auto x = input.is_contiguous() ? input : input.contiguous();
+    int planes = x.shape()[0] * num_features;
+    int inner = x.num_elements / std::max(1, planes);
+    const dtype* x_ptr = &x.data_[x.offset()];
+    dtype* y_ptr = &output.data_[output.offset()];
+
+    PROFILE_OP("BatchNorm", 2.0 * x.num_elements, 2.0 * sizeof(dtype) * x.num_elements, &input.shape());
+    parallel::parallel_for(0, planes, std::max(1, (1 << 14) / std::max(1, inner)), [&](int64_t begin, int64_t end) {
+        for (int64_t p = begin; p < end; p++) {
+            dtype s = scale_.data_[p % num_features], t = shift_.data_[p % num_features];
+            const dtype* in = x_ptr + p * inner;
+            dtype* out = y_ptr + p * inner;
+            #pragma omp simd
+            for (int i = 0; i < inner; i++) {
+                out[i] = in[i] * s + t;
+            }
+        }
+    });
+}
+
+// (N, C) or (N, C, L), e.g. after a Linear.
+template <typename dtype>
+class BatchNorm1d : public BatchNorm<dtype> {
+public:
+    BatchNorm1d(int num_features, const Tensor<dtype>& weight, const Tensor<dtype>& bias,
+                const Tensor<dtype>& running_mean, const Tensor<dtype>& running_var, double eps = 1e-5)
+            : BatchNorm<dtype>(num_features, weight, bias, running_mean, running_var, eps) {
+        this->min_rank = 2;
+        this->max_rank = 3;
+    }
+
+    const char* name() const override { return "BatchNorm1d"; }
+};
+
+// (N, C, H, W), e.g. after a Conv2d.
+template <typename dtype>
+class BatchNorm2d : public BatchNorm<dtype> {
+public:
+    BatchNorm2d(int num_features, const Tensor<dtype>& weight, const Tensor<dtype>& bias,
+                const Tensor<dtype>& running_mean, const Tensor<dtype>& running_var, double eps = 1e-5)
+            : BatchNorm<dtype>(num_features, weight, bias, running_mean, running_var, eps) {
+        this->min_rank = 4;
+        this->max_rank = 4;
+    }
+
+    const char* name() const override { return "BatchNorm2d"; }
+};
+
+// rows of weight (out, ...) scaled by bn.scale, bias * scale + shift. new storage, so
+// copies of the layer sharing the old weight keep it.
+template <typename dtype>
+void foldBatchNormRows(const BatchNorm<dtype>& bn, int out, Tensor<dtype>& weight, Tensor<dtype>& bias) {
+    if (bn.numFeatures() != out) {
+        throw std::invalid_argument("foldBatchNorm: " + std::to_string(bn.numFeatures()) + " features after a layer of " +
+                                    std::to_string(out) + " outputs");
+    }
+    auto w = weight.is_contiguous() ? weight : weight.contiguous();
+    int row = w.num_elements / out;
+    Tensor<dtype> folded_weight(w.shape());
+    Tensor<dtype> folded_bias(std::vector<int>{out});
+    for (int o = 0; o < out; o++) {
+        dtype s = bn.scale().data_[o];
+        for (int i = 0; i < row; i++) {
+            folded_weight.data_[(size_t)o * row + i] = w.data_[w.offset() + (size_t)o * row + i] * s;
+        }
+        dtype b = bias.num_elements > 0 ? bias.data_[bias.offset() + o] : 0;
+        folded_bias.data_[o] = b * s + bn.shift().data_[o];
+    }
+    weight = folded_weight;
+    bias = folded_bias;
+}
+
+template <typename dtype>
+void Linear<dtype>::foldBatchNorm(const BatchNorm<dtype>& bn) {
+    foldBatchNormRows(bn, out_features, weight, bias);
+    if (!replicas.empty()) {
+        replicas.build(&weight.data_[0], weight.num_elements);
+    }
+    if constexpr (std::is_same<dtype, float>::value) {
+        // the rows are only scaled, the pruned weights stay 0.
+        if (!sparse_weight.empty()) {
+            sparse_weight = sparse::fromDense(weight, sparse_weight.format);
+        }
+    }
+}
+
+template <typename dtype>
+void Conv2d<dtype>::foldBatchNorm(const BatchNorm<dtype>& bn) {
+    foldBatchNormRows(bn, out_channels, weight, bias);
+}
+
+/**
+ * Linear with the feature sizes fixed at compile time, e.g. StaticLinear<float, 784, 10>.
+ * the batch stays dynamic, small batches go row by row through static_kernels::linear.
+ * input:  (N, In), any view whose rows are contiguous
+ * weight: (Out, In)
+ * output: (N, Out)
+ */
+template <typename dtype, int In, int Out>
+class StaticLinear : public Module<dtype> {
+    static_assert(std::is_floating_point<dtype>::value, "StaticLinear is for float and double weights");
+
+public:
+    StaticLinear() = default;
+    explicit StaticLinear(const Tensor<dtype>& weight) : weight(StaticTensor<dtype, Out, In>::fromTensor(weight)) {}
+    ~StaticLinear() = default;
+
+    Tensor<dtype> forward(const Tensor<dtype>& input) {
+        Tensor<dtype> result(outputShape(input.shape()));
+        forward_into(input, result, nullptr);
+        return result;
+    }
+
+    // raw uint8 input, input_scale is applied in the epilogue like Linear.
+    Tensor<dtype> forward(const Tensor<uint8_t>& input, float input_scale = 1.0f / 255.0f) {
+        Tensor<dtype> result(outputShape(input.shape()));
+        forward_into(input, input_scale, result, nullptr);
+        return result;
+    }
+
+    const char* name() const override { return "StaticLinear"; }
+
+    std::vector<int> outputShape(const std::vector<int>& input_shape) const override {
+        if (input_shape.size() != 2 || input_shape[1] != In) {
+            throw std::invalid_argument("StaticLinear expects (N, " + std::to_string(In) + ") input");
+        }
+        return {input_shape[0], Out};
+    }
+
+    void forward_into(const Tensor<dtype>& input, Tensor<dtype>& output, dtype*) override {
+        PROFILE_OP("StaticLinear", 2.0 * input.shape()[0] * In * Out,
+                   (double)sizeof(dtype) * ((double)input.shape()[0] * (In + Out) + In * Out),
+                   &input.shape(), &weight.shape());
+        run(input, 1, &output.data_[output.offset()]);
+    }
+
+    void forward_into(const Tensor<uint8_t>& input, float input_scale, Tensor<dtype>& output, dtype*) override {
+        PROFILE_OP("StaticLinear(uint8)", 2.0 * input.shape()[0] * In * Out,
+                   input.num_elements + (double)sizeof(dtype) * ((double)input.shape()[0] * Out + In * Out),
+                   &input.shape(), &weight.shape());
+        run(input, input_scale, &output.data_[output.offset()]);
+    }
+
+protected:
+    // into o_ptr, (N, Out) contiguous.
+    template <typename xtype>
+    void run(const Tensor<xtype>& input, dtype scale, dtype* o_ptr) {
+        assert(input.shape().size() == 2 && input.shape()[1] == In);
+        auto x = input.stride()[1] == 1 ? input : input.contiguous();
+
+        int N = x.shape()[0];
+        const xtype* x_ptr = &x.data_[x.offset()];
+        int ld = x.stride()[0];
+
+        // past a few rows the weights are reused enough for the GEMM of the CPU's widest
+        // ISA to win over the fixed-size loops, which only get the baseline instructions.
+        if constexpr (std::is_same<dtype, float>::value) {
+            if (N >= STATIC_ROWS) {
+                const auto& k = kernels::active();
+                if constexpr (std::is_same<xtype, uint8_t>::value) {
+                    k.gemm_nt_u8f32(N, Out, In, x_ptr, ld, weight.data(), In, o_ptr, Out, scale);
+                } else {
+                    k.gemm_nt_f32(N, Out, In, x_ptr, ld, weight.data(), In, o_ptr, Out, tuner::gemm(N, Out, In, true));
+                }
+                return;
+            }
+        }
+
+        parallel::parallel_for(0, N, std::max(1, (1 << 16) / (In * Out)), [&](int64_t begin, int64_t end) {
+            static_kernels::linear(x_ptr + (size_t)begin * ld, (int)(end - begin), ld, weight,
+                                   o_ptr + (size_t)begin * Out, scale);
+        });
+    }
+
+    static constexpr int STATIC_ROWS = 16;
+    StaticTensor<dtype, Out, In> weight;
+};
+
+/**
+ * Conv2d with the channels, kernel, stride, padding and image size fixed at compile time,
+ * e.g. StaticConv2d<float, 1, 1, 3, 1, 1, 28, 28> for the MNIST conv layer.
+ * input shape:  N x C_in x H x W, contiguous images
+ * weight shape: C_out x C_in x K x K
+ * output shape: N x C_out x H_out x W_out
+ */
+template <typename dtype, int C_in, int C_out, int K, int Stride, int Padding, int H, int W>
+class StaticConv2d : public Module<dtype> {
+    static_assert(std::is_floating_point<dtype>::value, "StaticConv2d is for float and double weights");
+
+public:
+    static constexpr int H_out = (H + 2 * Padding - K) / Stride + 1;
+    static constexpr int W_out = (W + 2 * Padding - K) / Stride + 1;
+
+    StaticConv2d() = default;
+    explicit StaticConv2d(const Tensor<dtype>& weight) : weight(StaticTensor<dtype, C_out, C_in, K, K>::fromTensor(weight)) {}
+    ~StaticConv2d() = default;
+
+    Tensor<dtype> forward(const Tensor<dtype>& input) {
+        auto output = Tensor<dtype>(outputShape(input.shape()));
+        forward_into(input, output, nullptr);
+        return output;
+    }
+
+    // raw uint8 input, input_scale is applied once per output element.
+    Tensor<dtype> forward(const Tensor<uint8_t>& input, float input_scale = 1.0f / 255.0f) {
+        auto output = Tensor<dtype>(outputShape(input.shape()));
+        forward_into(input, input_scale, output, nullptr);
+        return output;
+    }
+
+    const char* name() const override { return "StaticConv2d"; }
+
+    std::vector<int> outputShape(const std::vector<int>& input_shape) const override {
+        if (input_shape.size() != 4 || input_shape[1] != C_in || input_shape[2] != H || input_shape[3] != W) {
+            throw std::invalid_argument("StaticConv2d expects (N, " + std::to_string(C_in) + ", " +
+                                        std::to_string(H) + ", " + std::to_string(W) + ") input");
+        }
+        return {input_shape[0], C_out, H_out, W_out};
+    }
+
+    void forward_into(const Tensor<dtype>& input, Tensor<dtype>& output, dtype*) override {
+        PROFILE_OP("StaticConv2d", 2.0 * input.shape()[0] * C_out * H_out * W_out * C_in * K * K,
+                   (double)sizeof(dtype) * ((double)input.shape()[0] * (C_in * H * W + C_out * H_out * W_out)),
+                   &input.shape(), &weight.shape());
+        run(input, 1, &output.data_[output.offset()]);
+    }
+
+    void forward_into(const Tensor<uint8_t>& input, float input_scale, Tensor<dtype>& output, dtype*) override {
+        PROFILE_OP("StaticConv2d(uint8)", 2.0 * input.shape()[0] * C_out * H_out * W_out * C_in * K * K,
+                   input.num_elements + (double)sizeof(dtype) * input.shape()[0] * C_out * H_out * W_out,
+                   &input.shape(), &weight.shape());
+        run(input, input_scale, &output.data_[output.offset()]);
+    }
+
+protected:
+    // into o_ptr, N x C_out x H_out x W_out contiguous.
+    template <typename xtype>
+    void run(const Tensor<xtype>& input, dtype scale, dtype* o_ptr) {
+        assert(input.shape().size() == 4 && input.shape()[1] == C_in && input.shape()[2] == H && input.shape()[3] == W);
+        auto x = input.is_contiguous() ? input : input.contiguous();
+
+        int N = x.shape()[0];
+        const xtype* x_ptr = &x.data_[x.offset()];
+
+        parallel::parallel_for(0, N, std::max(1, (1 << 16) / (C_out * H_out * W_out * C_in * K * K)),
+                               [&](int64_t begin, int64_t end) {
+            for (int64_t n = begin; n < end; n++) {
+                static_kernels::conv2d<dtype, C_in, C_out, K, Stride, Padding, H, W>(
+                    x_ptr + (size_t)n * C_in * H * W, weight, o_ptr + (size_t)n * C_out * H_out * W_out, scale);
+            }
+        });
+    }
+
+    StaticTensor<dtype, C_out, C_in, K, K> weight;
+};
+
 }
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "zlib.h" // For decompression of gzip files
+#include "Tensor.hpp"
+#include "Profiler.hpp"
+
+/**
+ * IDX file format (used by MNIST, Fashion-MNIST, EMNIST ...):
+ *   magic number: 0x00 0x00 <dtype> <ndim>
+ *   ndim big-endian uint32 sizes, one for each dimension
+ *   data, big-endian, in row-major order
+ * gzopen also reads uncompressed files transparently, so both .gz and raw files work.
+ */
+enum class IDXType : uint8_t {
+    UInt8   = 0x08,
+    Int8    = 0x09,
+    Int16   = 0x0B,
+    Int32   = 0x0C,
+    Float32 = 0x0D,
+    Float64 = 0x0E,
+};
+
+inline size_t idxTypeSize(IDXType type) {
+    switch (type) {
+        case IDXType::UInt8:   return 1;
+        case IDXType::Int8:    return 1;
+        case IDXType::Int16:   return 2;
+        case IDXType::Int32:   return 4;
+        case IDXType::Float32: return 4;
+        case IDXType::Float64: return 8;
+    }
+    throw std::runtime_error("Error: Unknown IDX data type");
+}
+
+struct IDXHeader {
+    IDXType type;
+    std::vector<int> shape;
+    // bytes occupied by the magic number and the dimension sizes
+    size_t headerBytes;
+
+    size_t numElements() const {
+        size_t num = 1;
+        for (auto dim : shape) {
+            num *= dim;
+        }
+        return num;
+    }
+};
+
+// read exactly size bytes, a short read means a truncated or corrupted file.
+inline void gzreadExact(gzFile file, void* buf, size_t size, const std::string& path) {
+    auto dst = static_cast<char*>(buf);
+    while (size > 0) {
+        // gzread takes an unsigned int length, read big buffers piece by piece.
+        unsigned chunk = size > (1u << 30) ? (1u << 30) : static_cast<unsigned>(size);
+        int n = gzread(file, dst, chunk);
+        if (n <= 0) {
+            throw std::runtime_error("Error: Unexpected end of IDX file " + path);
+        }
+        dst += n;
+        size -= n;
+    }
+}
+
+inline IDXHeader readIDXHeader(gzFile file, const std::string& path) {
+    uint8_t magic[4];
+    gzreadExact(file, magic, sizeof(magic), path);
+
+    if (magic[0] != 0 || magic[1] != 0) {
+        throw std::runtime_error("Error: Invalid IDX magic number in " + path);
+    }
+
+    IDXHeader header;
+    header.type = static_cast<IDXType>(magic[2]);
+    idxTypeSize(header.type); // validate the dtype byte
+
+    int ndim = magic[3];
+    header.shape.resize(ndim);
+    for (int i = 0; i < ndim; ++i) {
+        uint32_t dim;
+        gzreadExact(file, &dim, sizeof(dim), path);
+        dim = __builtin_bswap32(dim); // Convert to host byte order
+        if (dim > INT32_MAX) {
+            throw std::runtime_error("Error: IDX dimension too large in " + path);
+        }
+        header.shape[i] = static_cast<int>(dim);
+    }
+    header.headerBytes = 4 + 4 * ndim;
+
+    return header;
+}
+
+/**
+ * decode n big-endian elements of type Src from raw and convert them to T.
+ */
+template <typename Src, typename T>
+void decodeIDX(const uint8_t* raw, T* dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        Src value;
+        if constexpr (sizeof(Src) == 1) {
+            std::memcpy(&value, raw + i, 1);
+        } else if constexpr (sizeof(Src) == 2) {
+            uint16_t bits;
+            std::memcpy(&bits, raw + 2 * i, 2);
+            bits = __builtin_bswap16(bits);
+            std::memcpy(&value, &bits, 2);
+        } else if constexpr (sizeof(Src) == 4) {
+            uint32_t bits;
+            std::memcpy(&bits, raw + 4 * i, 4);
+            bits = __builtin_bswap32(bits);
+            std::memcpy(&value, &bits, 4);
+        } else {
+            uint64_t bits;
+            std::memcpy(&bits, raw + 8 * i, 8);
+            bits = __builtin_bswap64(bits);
+            std::memcpy(&value, &bits, 8);
+        }
+        dst[i] = static_cast<T>(value);
+    }
+}
+
+template <typename T>
+void decodeIDX(IDXType type, const uint8_t* raw, T* dst, size_t n) {
+    switch (type) {
+        case IDXType::UInt8:   decodeIDX<uint8_t>(raw, dst, n); break;
+        case IDXType::Int8:    decodeIDX<int8_t>(raw, dst, n);  break;
+        case IDXType::Int16:   decodeIDX<int16_t>(raw, dst, n); break;
+        case IDXType::Int32:   decodeIDX<int32_t>(raw, dst, n); break;
+        case IDXType::Float32: decodeIDX<float>(raw, dst, n);   break;
+        case IDXType::Float64: decodeIDX<double>(raw, dst, n);  break;
+    }
+}
+
+/**
+ * read an IDX file of any rank and dtype, the result has the shape stored in the file,
+ * and the elements are converted from the file dtype to T.
+ */
+template <typename T>
+Tensor<T> readIDX(const std::string& path) {
+    PROFILE_OP("readIDX", 0, 0);
+
+    gzFile file = gzopen(path.c_str(), "rb");
+    if (file == NULL) {
+        throw std::runtime_error("Error: Failed to open IDX file " + path);
+    }
+    // a bigger internal buffer makes gzread faster on large files.
+    gzbuffer(file, 1 << 20);
+
+    try {
+        IDXHeader header = readIDXHeader(file, path);
+        Tensor<T> tensor(header.shape);
+        size_t n = header.numElements();
+
+        if (header.type == IDXType::UInt8 && std::is_same<T, uint8_t>::value) {
+            // no conversion, read directly into the tensor.
+            gzreadExact(file, &tensor.data_[0], n, path);
+        } else {
+            // decode chunk by chunk so the raw bytes never need a full copy of the file.
+            size_t elemSize = idxTypeSize(header.type);
+            size_t chunk = (1 << 20) / elemSize;
+            std::vector<uint8_t> raw(chunk * elemSize);
+            for (size_t i = 0; i < n; i += chunk) {
+                size_t count = std::min(chunk, n - i);
+                gzreadExact(file, raw.data(), count * elemSize, path);
+                decodeIDX(header.type, raw.data(), &tensor.data_[i], count);
+            }
+        }
+
+        gzclose(file);
+        return tensor;
+    } catch (...) {
+        gzclose(file);
+        throw;
+    }
+}
+
+/**
+ * sequential reader over the records of an IDX file, a record is one entry along the
+ * first dimension (e.g. one image). Used to stream datasets that should not be
+ * loaded into memory at once.
+ */
+class IDXReader {
+public:
+    explicit IDXReader(const std::string& path) : path_(path) {
+        file_ = gzopen(path.c_str(), "rb");
+        if (file_ == NULL) {
+            throw std::runtime_error("Error: Failed to open IDX file " + path);
+        }
+        gzbuffer(file_, 1 << 20);
+
+        try {
+            header_ = readIDXHeader(file_, path);
+        } catch (...) {
+            gzclose(file_);
+            throw;
+        }
+        if (header_.shape.empty()) {
+            gzclose(file_);
+            throw std::runtime_error("Error: IDX file has no records " + path);
+        }
+
+        recordShape_.assign(header_.shape.begin() + 1, header_.shape.end());
+        recordElements_ = 1;
+        for (auto dim : recordShape_) {
+            recordElements_ *= dim;
+        }
+    }
+
+    ~IDXReader() {
+        gzclose(file_);
+    }
+
+    IDXReader(const IDXReader&) = delete;
+    IDXReader& operator=(const IDXReader&) = delete;
+
+    const IDXHeader& header() const { return header_; }
+    IDXType type() const { return header_.type; }
+    int numRecords() const { return header_.shape[0]; }
+    // shape of one record, the file shape without the first dimension.
+    const std::vector<int>& recordShape() const { return recordShape_; }
+    size_t recordElements() const { return recordElements_; }
+    size_t recordBytes() const { return recordElements_ * idxTypeSize(header_.type); }
+
+    // read the next count records as raw big-endian bytes, use decodeIDX to convert them.
+    void read(uint8_t* dst, size_t count) {
+        gzreadExact(file_, dst, count * recordBytes(), path_);
+    }
+
+private:
+    std::string path_;
+    gzFile file_;
+    IDXHeader header_;
+    std::vector<int> recordShape_;
+    size_t recordElements_;
+};
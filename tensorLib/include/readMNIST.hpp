@@ -1,3 +1,5 @@
+#pragma once
+
 #include <iostream>
 #include <vector>
 #include <cstdint>
@@ -5,130 +7,62 @@
 #include <stdexcept>
 #include "zlib.h" // For decompression of gzip files
 #include "Tensor.hpp"
+#include "readIDX.hpp"
 
 
 // Tensor<uint8_t> readMNISTLabels(const std::string& labelPath);
 
 // Function to read MNIST images file and return vector of image data
+// images of any size are accepted (MNIST, Fashion-MNIST, EMNIST ...), the result shape is
+// (num_images, rows * cols) and pixels are normalized to [0, 1].
 template <typename T>
 Tensor<T> readMNISTImages(const std::string& imagePath) {
-    std::vector<std::vector<T>> images;
-
-    // Open the gzip-compressed images file
-    gzFile file = gzopen(imagePath.c_str(), "rb");
-    if (file == NULL) {
-        throw std::runtime_error("Error: Failed to open images file");
-    }
-
-    // Read MNIST file header (magic number and metadata)
-    uint32_t magicNumber;
-    uint32_t numImages;
-    uint32_t numRows;
-    uint32_t numCols;
-    // Read magic number and metadata with big-endian byte order
-    gzread(file, &magicNumber, sizeof(magicNumber));
-    gzread(file, &numImages, sizeof(numImages));
-    gzread(file, &numRows, sizeof(numRows));
-    gzread(file, &numCols, sizeof(numCols));
-
-    magicNumber = __builtin_bswap32(magicNumber); // Convert to host byte order
-    numImages = __builtin_bswap32(numImages); // Convert to host byte order
-    numRows = __builtin_bswap32(numRows); // Convert to host byte order
-    numCols = __builtin_bswap32(numCols); // Convert to host byte order
-
-    // Validate magic number and image dimensions
-    if (magicNumber != 0x00000803 || numRows != 28 || numCols != 28) {
-        gzclose(file);
-        
-        // Print information when validation fails
-        std::cout << "Invalid images file format:" << std::endl;
-        std::cout << "Magic Number: 0x" << std::hex << magicNumber << std::dec << std::endl;
-        std::cout << "Num Images: " << numImages << std::endl;
-        std::cout << "Num Rows: " << numRows << std::endl;
-        std::cout << "Num Cols: " << numCols << std::endl;
-
-        throw std::runtime_error("Invalid images file format");
+    // Validate the images file, should be a 3d uint8 IDX file (magic number 0x803).
+    // readIDX converts any dtype, so check the header before reading.
+    {
+        IDXReader reader(imagePath);
+        const IDXHeader& header = reader.header();
+        if (header.type != IDXType::UInt8 || header.shape.size() != 3) {
+            // Print information when validation fails
+            std::cout << "Invalid images file format:" << std::endl;
+            std::cout << "Data Type: 0x" << std::hex << static_cast<int>(header.type) << std::dec << std::endl;
+            std::cout << "Num Dims: " << header.shape.size() << std::endl;
+
+            throw std::runtime_error("Invalid images file format");
+        }
     }
+    Tensor<uint8_t> raw = readIDX<uint8_t>(imagePath);
 
-    // Read image data
-    for (size_t i = 0; i < numImages; ++i) {
-        std::vector<uint8_t> rawImage(numRows * numCols);
+    int numImages = raw.shape()[0];
+    int numPixels = raw.shape()[1] * raw.shape()[2];
 
-        // Read raw image data (single channel, grayscale)
-        gzread(file, rawImage.data(), sizeof(uint8_t) * numRows * numCols);
+    if constexpr (std::is_same<T, uint8_t>::value) {
+        return raw.view({numImages, numPixels});
+    } else {
+        Tensor<T> tensor({numImages, numPixels});
 
         // Normalize pixel values to range [0, 1] (assuming 8-bit grayscale)
-        std::vector<T> normalizedImage(rawImage.size());
-        for (size_t j = 0; j < rawImage.size(); ++j) {
-            normalizedImage[j] = static_cast<T>(rawImage[j]) / 255.0;
+        if constexpr (std::is_same<T, float>::value) {
+            kernels::active().scale_u8_f32(&raw.data_[0], 1.0f / 255.0f, &tensor.data_[0], raw.num_elements);
+        } else {
+            for (int i = 0; i < raw.num_elements; ++i) {
+                tensor.data_[i] = static_cast<T>(raw.data_[i]) / 255.0;
+            }
         }
 
-        // Add normalized image data to images vector
-        images.push_back(normalizedImage);
-    }
-
-    // Close the file
-    gzclose(file);
-
-    // Determine the shape of the tensor
-    std::vector<int> shape = {static_cast<int>(images.size())};
-    if (!images.empty()) {
-        shape.push_back(static_cast<int>(images[0].size()));
+        return tensor;
     }
-
-    // Create a Tensor object with the inferred shape
-    Tensor<T> tensor(shape);
-
-    // Copy the data from the vector of vectors to the Tensor
-    for (size_t i = 0; i < images.size(); ++i) {
-        for (size_t j = 0; j < images[i].size(); ++j) {
-            std::vector<int> indices = {static_cast<int>(i), static_cast<int>(j)};
-            tensor(indices) = images[i][j];
-        }
-    }
-    return tensor;
 }
 
 // Function to read MNIST labels file and return vector of label data
 template <typename T>
 Tensor<T> readMNISTLabels(const std::string& labelPath) {
-    std::vector<uint8_t> labels;
-
-    // Open the gzip-compressed labels file
-    gzFile file = gzopen(labelPath.c_str(), "rb");
-    if (file == NULL) {
-        throw std::runtime_error("Error: Failed to open labels file");
-    }
-
-    // Read MNIST file header (magic number and metadata)
-    uint32_t magicNumber;
-    uint32_t numLabels;
-    gzread(file, &magicNumber, sizeof(magicNumber));
-    gzread(file, &numLabels, sizeof(numLabels));
-    magicNumber = __builtin_bswap32(magicNumber);
-    numLabels = __builtin_bswap32(numLabels);
+    Tensor<T> tensor = readIDX<T>(labelPath);
 
-    // Validate magic number
-    if (magicNumber != 0x00000801) {
-        gzclose(file);
+    // Validate the labels file, should be a 1d IDX file (magic number 0x801)
+    if (tensor.shape().size() != 1) {
         throw std::runtime_error("Error: Invalid labels file format");
     }
 
-    // Read label data
-    labels.resize(numLabels);
-    gzread(file, labels.data(), sizeof(uint8_t) * numLabels);
-
-    // Close the file
-    gzclose(file);
-
-    std::vector<int> shape = {static_cast<int>(labels.size())};
-    Tensor<T> tensor(shape);
-
-    // Copy the data from the vector of vectors to the Tensor
-    for (size_t i = 0; i < labels.size(); ++i) {
-        std::vector<int> indices = {static_cast<int>(i)};
-        tensor(indices) = static_cast<T>(labels[i]);
-    }
-
     return tensor;
-}
\ No newline at end of file
+}
@@ -0,0 +1,421 @@
+#include "../include/Autotuner.hpp"
+#include "../include/ThreadPool.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+
+namespace tuner {
+
+namespace {
+
+bool envEnabled() {
+    const char* env = std::getenv("TENSORLIB_AUTOTUNE");
+    return env != nullptr && std::string(env) != "0";
+}
+
+std::atomic<bool> enabled_flag{envEnabled()};
+
+// moves on whenever a lookup could give another answer: tuning turned on or off, another
+// cache file, clear().
+std::atomic<uint64_t> generation{1};
+
+// the configurations this thread has looked up, by shape, thread count and ISA, so every
+// lookup after the first takes no lock and builds no string. Emptied when generation moves.
+template <typename Config, size_t Fields>
+struct LocalCache {
+    uint64_t seen = 0;
+    std::map<std::array<int, Fields>, Config> configs;
+
+    const Config* find(const std::array<int, Fields>& key) {
+        uint64_t current = generation.load(std::memory_order_acquire);
+        if (current != seen) {
+            configs.clear();
+            seen = current;
+        }
+        auto it = configs.find(key);
+        return it == configs.end() ? nullptr : &it->second;
+    }
+};
+
+struct State {
+    std::mutex mutex;
+    bool loaded = false;
+    std::string path;
+    // "cpu \t isa \t threads \t shape" -> configuration, the entries of every host in the file.
+    std::map<std::string, std::string> entries;
+};
+
+State& state() {
+    static State instance;
+    return instance;
+}
+
+std::string defaultPath() {
+    const char* env = std::getenv("TENSORLIB_TUNING_CACHE");
+    if (env != nullptr && *env != '\0') {
+        return env;
+    }
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    if (xdg != nullptr && *xdg != '\0') {
+        return std::string(xdg) + "/tensorlib/tuning.txt";
+    }
+    const char* home = std::getenv("HOME");
+    if (home != nullptr && *home != '\0') {
+        return std::string(home) + "/.cache/tensorlib/tuning.txt";
+    }
+    return "tensorlib_tuning.txt";
+}
+
+// the configurations tuned on one host are only reused on the same CPU, ISA and thread count.
+std::string hostKey() {
+    static const std::string model = cpu::modelName();
+    return model + "\t" + cpu::isaName(kernels::activeISA()) + "\t" + std::to_string(parallel::numThreads());
+}
+
+// with the state locked.
+void load(State& s) {
+    if (s.loaded) {
+        return;
+    }
+    s.loaded = true;
+    if (s.path.empty()) {
+        s.path = defaultPath();
+    }
+
+    std::ifstream file(s.path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        size_t sep = line.rfind('\t');
+        if (sep == std::string::npos) {
+            continue;
+        }
+        s.entries[line.substr(0, sep)] = line.substr(sep + 1);
+    }
+}
+
+// with the state locked, a failure to write only costs tuning again next run.
+void save(State& s) {
+    std::error_code ec;
+    std::filesystem::path path(s.path);
+    if (path.has_parent_path()) {
+        std::filesystem::create_directories(path.parent_path(), ec);
+    }
+
+    // write a temporary file and rename it, so a concurrent reader never sees half a file.
+    std::string tmp = s.path + ".tmp" + std::to_string(::getpid());
+    {
+        std::ofstream file(tmp);
+        if (!file.is_open()) {
+            return;
+        }
+        file << "# tensorLib tuning cache: cpu, isa, threads, shape, configuration" << std::endl;
+        for (auto& kv : s.entries) {
+            file << kv.first << "\t" << kv.second << std::endl;
+        }
+    }
+    std::filesystem::rename(tmp, s.path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+    }
+}
+
+// median time in seconds of a few runs after one warm-up run.
+template <typename F>
+double timeRuns(F&& fn) {
+    fn();
+    std::vector<double> times;
+    for (int r = 0; r < 3; r++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double>(end - start).count());
+        // slow candidates are timed once.
+        if (times.back() > 0.05) {
+            break;
+        }
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+std::vector<int> threadCandidates() {
+    std::vector<int> candidates;
+    int max_threads = parallel::numThreads();
+    for (int t = 1; t < max_threads; t *= 2) {
+        candidates.push_back(t);
+    }
+    candidates.push_back(max_threads);
+    return candidates;
+}
+
+std::vector<float> scratch(size_t n) {
+    std::vector<float> values(n);
+    for (size_t i = 0; i < n; i++) {
+        values[i] = static_cast<float>(i % 7) - 3.0f;
+    }
+    return values;
+}
+
+std::string formatGemm(const kernels::GemmConfig& c) {
+    return "mc=" + std::to_string(c.mc) + " kc=" + std::to_string(c.kc) + " nc=" + std::to_string(c.nc) +
+           " threads=" + std::to_string(c.threads);
+}
+
+std::string formatConv(const kernels::ConvConfig& c) {
+    return std::string("algorithm=") + (c.algorithm == kernels::ConvAlgorithm::Direct ? "direct" : "im2col") +
+           " threads=" + std::to_string(c.threads);
+}
+
+// "name=value" fields, unknown names are ignored.
+std::map<std::string, std::string> parseFields(const std::string& value) {
+    std::map<std::string, std::string> fields;
+    std::istringstream iss(value);
+    std::string field;
+    while (iss >> field) {
+        size_t eq = field.find('=');
+        if (eq != std::string::npos) {
+            fields[field.substr(0, eq)] = field.substr(eq + 1);
+        }
+    }
+    return fields;
+}
+
+int intField(const std::map<std::string, std::string>& fields, const std::string& name) {
+    auto it = fields.find(name);
+    return it == fields.end() ? 0 : std::atoi(it->second.c_str());
+}
+
+kernels::GemmConfig tuneGemm(int M, int N, int K, bool transposed_b) {
+    auto A = scratch((size_t)M * K);
+    auto B = scratch((size_t)K * N);
+    std::vector<float> C((size_t)M * N);
+    const auto& k = kernels::active();
+
+    auto run = [&](const kernels::GemmConfig& config) {
+        if (transposed_b) {
+            k.gemm_nt_f32(M, N, K, A.data(), K, B.data(), K, C.data(), N, config);
+        } else {
+            k.gemm_f32(M, N, K, A.data(), K, B.data(), N, C.data(), N, config);
+        }
+    };
+
+    kernels::GemmConfig best;
+    double best_time = timeRuns([&]() { run(best); });
+
+    auto tryConfig = [&](const kernels::GemmConfig& config) {
+        double t = timeRuns([&]() { run(config); });
+        if (t < best_time) {
+            best_time = t;
+            best = config;
+        }
+    };
+
+    // one blocking parameter at a time, sizes past the matrix dimension behave the same.
+    if (!transposed_b) {
+        for (int kc : {64, 128, 256, 512, 1024}) {
+            if (kc / 2 >= K) break;
+            kernels::GemmConfig c = best;
+            c.kc = kc;
+            tryConfig(c);
+        }
+        for (int nc : {64, 128, 256, 512, 1024, 2048}) {
+            if (nc / 2 >= N) break;
+            kernels::GemmConfig c = best;
+            c.nc = nc;
+            tryConfig(c);
+        }
+        for (int mc : {8, 16, 32, 64, 128, 256}) {
+            if (mc / 2 >= M) break;
+            kernels::GemmConfig c = best;
+            c.mc = mc;
+            tryConfig(c);
+        }
+    }
+
+    for (int threads : threadCandidates()) {
+        kernels::GemmConfig c = best;
+        c.threads = threads;
+        tryConfig(c);
+    }
+    return best;
+}
+
+kernels::ConvConfig tuneConv(int N, int C_in, int H, int W, int C_out, int kernel, int stride, int padding) {
+    int H_out = (H + 2 * padding - kernel) / stride + 1;
+    int W_out = (W + 2 * padding - kernel) / stride + 1;
+    auto input = scratch((size_t)N * C_in * H * W);
+    auto weight = scratch((size_t)C_out * C_in * kernel * kernel);
+    std::vector<float> output((size_t)N * C_out * H_out * W_out);
+
+    auto run = [&](const kernels::ConvConfig& config) {
+        kernels::conv2d_f32(input.data(), N, C_in, H, W, weight.data(), C_out, kernel, stride, padding,
+                            output.data(), config);
+    };
+
+    kernels::ConvConfig best;
+    double best_time = timeRuns([&]() { run(best); });
+
+    auto tryConfig = [&](const kernels::ConvConfig& config) {
+        double t = timeRuns([&]() { run(config); });
+        if (t < best_time) {
+            best_time = t;
+            best = config;
+        }
+    };
+
+    kernels::ConvConfig direct = best;
+    direct.algorithm = kernels::ConvAlgorithm::Direct;
+    tryConfig(direct);
+
+    for (int threads : threadCandidates()) {
+        kernels::ConvConfig c = best;
+        c.threads = threads;
+        tryConfig(c);
+    }
+    return best;
+}
+
+} // namespace
+
+bool enabled() {
+    return enabled_flag.load(std::memory_order_relaxed);
+}
+
+void enable(bool on) {
+    enabled_flag.store(on, std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+namespace {
+
+kernels::GemmConfig lookupGemm(int M, int N, int K, bool transposed_b) {
+    std::string key = hostKey() + "\t" + (transposed_b ? "gemm_nt " : "gemm ") +
+                      std::to_string(M) + "x" + std::to_string(K) + "x" + std::to_string(N);
+
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    load(s);
+
+    auto it = s.entries.find(key);
+    if (it != s.entries.end()) {
+        auto fields = parseFields(it->second);
+        kernels::GemmConfig config;
+        config.mc = intField(fields, "mc");
+        config.kc = intField(fields, "kc");
+        config.nc = intField(fields, "nc");
+        config.threads = intField(fields, "threads");
+        return config;
+    }
+    if (!enabled()) {
+        return kernels::GemmConfig{};
+    }
+
+    kernels::GemmConfig config = tuneGemm(M, N, K, transposed_b);
+    s.entries[key] = formatGemm(config);
+    save(s);
+    std::cerr << "autotuned matmul " << M << "x" << K << "x" << N << (transposed_b ? " (B^T)" : "")
+              << ": " << formatGemm(config) << std::endl;
+    return config;
+}
+
+kernels::ConvConfig lookupConv(int N, int C_in, int H, int W, int C_out, int kernel, int stride, int padding) {
+    std::string key = hostKey() + "\tconv2d " + std::to_string(N) + "x" + std::to_string(C_in) + "x" +
+                      std::to_string(H) + "x" + std::to_string(W) + " ->" + std::to_string(C_out) +
+                      " k" + std::to_string(kernel) + " s" + std::to_string(stride) + " p" + std::to_string(padding);
+
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    load(s);
+
+    auto it = s.entries.find(key);
+    if (it != s.entries.end()) {
+        auto fields = parseFields(it->second);
+        kernels::ConvConfig config;
+        config.algorithm = fields["algorithm"] == "direct" ? kernels::ConvAlgorithm::Direct : kernels::ConvAlgorithm::Im2col;
+        config.threads = intField(fields, "threads");
+        return config;
+    }
+    if (!enabled()) {
+        return kernels::ConvConfig{};
+    }
+
+    kernels::ConvConfig config = tuneConv(N, C_in, H, W, C_out, kernel, stride, padding);
+    s.entries[key] = formatConv(config);
+    save(s);
+    std::cerr << "autotuned conv2d " << N << "x" << C_in << "x" << H << "x" << W << " ->" << C_out
+              << " k" << kernel << " s" << stride << " p" << padding << ": " << formatConv(config) << std::endl;
+    return config;
+}
+
+} // namespace
+
+kernels::GemmConfig gemm(int M, int N, int K, bool transposed_b) {
+    thread_local LocalCache<kernels::GemmConfig, 6> local;
+    std::array<int, 6> key = {M, N, K, transposed_b, parallel::numThreads(), (int)kernels::activeISA()};
+    if (const auto* config = local.find(key)) {
+        return *config;
+    }
+    return local.configs[key] = lookupGemm(M, N, K, transposed_b);
+}
+
+kernels::ConvConfig conv2d(int N, int C_in, int H, int W, int C_out, int kernel, int stride, int padding) {
+    thread_local LocalCache<kernels::ConvConfig, 10> local;
+    std::array<int, 10> key = {N, C_in, H, W, C_out, kernel, stride, padding, parallel::numThreads(),
+                               (int)kernels::activeISA()};
+    if (const auto* config = local.find(key)) {
+        return *config;
+    }
+    return local.configs[key] = lookupConv(N, C_in, H, W, C_out, kernel, stride, padding);
+}
+
+std::string cachePath() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.path.empty() ? defaultPath() : s.path;
+}
+
+void setCachePath(const std::string& path) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.path = path;
+    s.entries.clear();
+    s.loaded = false;
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+void clear() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.entries.clear();
+    s.loaded = false;
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+size_t size() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    load(s);
+    std::string prefix = hostKey() + "\t";
+    size_t count = 0;
+    for (auto& kv : s.entries) {
+        if (kv.first.compare(0, prefix.size(), prefix) == 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+} // namespace tuner
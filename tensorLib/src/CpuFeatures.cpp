@@ -0,0 +1,122 @@
+#include "../include/CpuFeatures.hpp"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define TENSORLIB_X86 1
+#endif
+
+namespace cpu {
+
+namespace {
+
+struct Features {
+    bool sse42 = false;
+    bool avx2 = false;
+    bool avx512 = false;
+};
+
+#ifdef TENSORLIB_X86
+uint64_t xgetbv() {
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+#endif
+
+Features detect() {
+    Features f;
+#ifdef TENSORLIB_X86
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return f;
+    }
+    f.sse42 = (ecx & bit_SSE4_2) != 0;
+    bool fma = (ecx & bit_FMA) != 0;
+    bool avx = (ecx & bit_AVX) != 0;
+    bool osxsave = (ecx & bit_OSXSAVE) != 0;
+
+    // the OS must save the YMM (and ZMM, opmask) registers on context switches.
+    uint64_t xcr0 = osxsave ? xgetbv() : 0;
+    bool ymm = (xcr0 & 0x6) == 0x6;
+    bool zmm = (xcr0 & 0xe6) == 0xe6;
+
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        f.avx2 = avx && ymm && fma && (ebx & bit_AVX2) != 0;
+        f.avx512 = f.avx2 && zmm && (ebx & bit_AVX512F) && (ebx & bit_AVX512BW) &&
+                   (ebx & bit_AVX512DQ) && (ebx & bit_AVX512VL);
+    }
+#endif
+    return f;
+}
+
+const Features& features() {
+    static Features f = detect();
+    return f;
+}
+
+} // namespace
+
+const char* isaName(ISA isa) {
+    switch (isa) {
+        case ISA::Scalar: return "scalar";
+        case ISA::SSE42:  return "sse4.2";
+        case ISA::AVX2:   return "avx2";
+        case ISA::AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+bool parseISA(const std::string& name, ISA& isa) {
+    for (ISA candidate : {ISA::Scalar, ISA::SSE42, ISA::AVX2, ISA::AVX512}) {
+        if (name == isaName(candidate)) {
+            isa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool supported(ISA isa) {
+    switch (isa) {
+        case ISA::Scalar: return true;
+        case ISA::SSE42:  return features().sse42;
+        case ISA::AVX2:   return features().avx2;
+        case ISA::AVX512: return features().avx512;
+    }
+    return false;
+}
+
+ISA best() {
+    for (ISA isa : {ISA::AVX512, ISA::AVX2, ISA::SSE42}) {
+        if (supported(isa)) {
+            return isa;
+        }
+    }
+    return ISA::Scalar;
+}
+
+std::string modelName() {
+#ifdef TENSORLIB_X86
+    unsigned int regs[12];
+    if (__get_cpuid_max(0x80000000, nullptr) >= 0x80000004) {
+        for (unsigned int i = 0; i < 3; i++) {
+            __get_cpuid(0x80000002 + i, &regs[i * 4], &regs[i * 4 + 1], &regs[i * 4 + 2], &regs[i * 4 + 3]);
+        }
+        char brand[49];
+        std::memcpy(brand, regs, 48);
+        brand[48] = '\0';
+
+        std::string name(brand);
+        size_t begin = name.find_first_not_of(' ');
+        size_t end = name.find_last_not_of(' ');
+        if (begin != std::string::npos) {
+            return name.substr(begin, end - begin + 1);
+        }
+    }
+#endif
+    return "unknown";
+}
+
+} // namespace cpu
@@ -0,0 +1,160 @@
+#include "../include/Kernels.hpp"
+#include "../include/Memory.hpp"
+#include "../include/ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+
+namespace kernels {
+
+// one copy per ISA, from src/kernels/KernelsISA.cpp
+namespace scalar { extern const KernelTable table; }
+#ifdef TENSORLIB_X86_KERNELS
+namespace sse42 { extern const KernelTable table; }
+namespace avx2 { extern const KernelTable table; }
+namespace avx512 { extern const KernelTable table; }
+#endif
+
+namespace {
+
+const KernelTable* compiled(cpu::ISA isa) {
+    switch (isa) {
+        case cpu::ISA::Scalar: return &scalar::table;
+#ifdef TENSORLIB_X86_KERNELS
+        case cpu::ISA::SSE42:  return &sse42::table;
+        case cpu::ISA::AVX2:   return &avx2::table;
+        case cpu::ISA::AVX512: return &avx512::table;
+#endif
+        default: return nullptr;
+    }
+}
+
+// the fastest available ISA, or the one asked for with TENSORLIB_ISA.
+cpu::ISA select() {
+    cpu::ISA isa = cpu::ISA::Scalar;
+    for (cpu::ISA candidate : {cpu::ISA::AVX512, cpu::ISA::AVX2, cpu::ISA::SSE42}) {
+        if (table(candidate) != nullptr) {
+            isa = candidate;
+            break;
+        }
+    }
+
+    const char* env = std::getenv("TENSORLIB_ISA");
+    if (env != nullptr && *env != '\0') {
+        cpu::ISA requested;
+        if (!cpu::parseISA(env, requested)) {
+            std::cerr << "TENSORLIB_ISA=" << env << " is not one of scalar, sse4.2, avx2, avx512, using "
+                      << cpu::isaName(isa) << std::endl;
+        } else if (table(requested) == nullptr) {
+            std::cerr << "TENSORLIB_ISA=" << env << " is not supported on this CPU or build, using "
+                      << cpu::isaName(isa) << std::endl;
+        } else {
+            isa = requested;
+        }
+    }
+    return isa;
+}
+
+struct Active {
+    std::atomic<cpu::ISA> isa;
+    std::atomic<const KernelTable*> table;
+
+    Active() {
+        cpu::ISA selected = select();
+        isa.store(selected);
+        table.store(compiled(selected));
+    }
+};
+
+Active& state() {
+    static Active instance;
+    return instance;
+}
+
+} // namespace
+
+const KernelTable& active() {
+    return *state().table.load(std::memory_order_relaxed);
+}
+
+cpu::ISA activeISA() {
+    return state().isa.load(std::memory_order_relaxed);
+}
+
+const KernelTable* table(cpu::ISA isa) {
+    if (!cpu::supported(isa)) {
+        return nullptr;
+    }
+    return compiled(isa);
+}
+
+bool setISA(cpu::ISA isa) {
+    const KernelTable* t = table(isa);
+    if (t == nullptr) {
+        return false;
+    }
+    state().isa.store(isa);
+    state().table.store(t);
+    return true;
+}
+
+namespace {
+
+int convThreads(int N, const ConvConfig& config) {
+    int threads = config.threads > 0 ? std::min(config.threads, parallel::numThreads()) : parallel::numThreads();
+    return std::min(threads, N);
+}
+
+} // namespace
+
+size_t conv2d_workspace_f32(int N, int C_in, int H, int W, int kernel, int stride, int padding,
+                            const ConvConfig& config) {
+    if (config.algorithm != ConvAlgorithm::Im2col) {
+        return 0;
+    }
+    int H_out = (H + 2 * padding - kernel) / stride + 1;
+    int W_out = (W + 2 * padding - kernel) / stride + 1;
+    // (C_in * kernel * kernel) x (H_out * W_out) columns per thread.
+    return (size_t)convThreads(N, config) * C_in * kernel * kernel * H_out * W_out;
+}
+
+void conv2d_f32(const float* input, int N, int C_in, int H, int W, const float* weight, int C_out,
+                int kernel, int stride, int padding, float* output, const ConvConfig& config,
+                float* workspace, const float* bias) {
+    int H_out = (H + 2 * padding - kernel) / stride + 1;
+    int W_out = (W + 2 * padding - kernel) / stride + 1;
+    int patch = C_in * kernel * kernel;
+    int spatial = H_out * W_out;
+    int threads = convThreads(N, config);
+    const KernelTable& k = active();
+    // the GEMM of one image runs on the thread that owns the image.
+    GemmConfig single;
+    single.threads = 1;
+
+    // without a workspace the columns are charged to the calling op.
+    std::shared_ptr<float[]> columns;
+    if (config.algorithm == ConvAlgorithm::Im2col && workspace == nullptr) {
+        columns = memory::allocate<float>(conv2d_workspace_f32(N, C_in, H, W, kernel, stride, padding, config));
+        workspace = columns.get();
+    }
+
+    parallel::parallel_for(0, N, 1, [&](int64_t begin, int64_t end) {
+        float* cols = workspace + (size_t)parallel::threadIndex() * patch * spatial;
+        for (int64_t n = begin; n < end; n++) {
+            const float* x = input + (size_t)n * C_in * H * W;
+            float* out = output + (size_t)n * C_out * spatial;
+            if (config.algorithm == ConvAlgorithm::Im2col) {
+                k.im2col_f32(x, C_in, H, W, kernel, stride, padding, cols);
+                k.gemm_f32(C_out, spatial, patch, weight, patch, cols, spatial, out, spatial, single);
+            } else {
+                k.conv2d_direct_f32(x, C_in, H, W, weight, C_out, kernel, stride, padding, out);
+            }
+            if (bias != nullptr) {
+                k.bias_add_f32(out, C_out, spatial, bias, true);
+            }
+        }
+    }, threads);
+}
+
+} // namespace kernels
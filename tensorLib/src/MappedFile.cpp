@@ -0,0 +1,80 @@
+#include "../include/MappedFile.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int toMadvise(MapAdvice advice) {
+    switch (advice) {
+        case MapAdvice::Normal:     return MADV_NORMAL;
+        case MapAdvice::Sequential: return MADV_SEQUENTIAL;
+        case MapAdvice::Random:     return MADV_RANDOM;
+        case MapAdvice::WillNeed:   return MADV_WILLNEED;
+    }
+    return MADV_NORMAL;
+}
+
+void adviseMapping(const void* addr, size_t length, MapAdvice advice) {
+    if (length == 0) {
+        return;
+    }
+    // madvise needs a page aligned start address.
+    static const size_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = reinterpret_cast<uintptr_t>(addr) / page * page;
+    uintptr_t end = reinterpret_cast<uintptr_t>(addr) + length;
+
+    // only a hint, ignore failures (e.g. on heap memory).
+    madvise(reinterpret_cast<void*>(begin), end - begin, toMadvise(advice));
+}
+
+std::shared_ptr<uint8_t> mapFile(const std::string& path, size_t length, size_t offset,
+                                 bool writable, bool create, MapAdvice advice) {
+    int flags = writable ? O_RDWR : O_RDONLY;
+    if (create) {
+        flags = O_RDWR | O_CREAT | O_TRUNC;
+    }
+
+    int fd = open(path.c_str(), flags, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Error: Failed to open file " + path + ": " + std::strerror(errno));
+    }
+
+    if (create) {
+        if (ftruncate(fd, offset + length) != 0) {
+            close(fd);
+            throw std::runtime_error("Error: Failed to resize file " + path + ": " + std::strerror(errno));
+        }
+    } else {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < offset + length) {
+            close(fd);
+            throw std::runtime_error("Error: File " + path + " is smaller than the mapped range");
+        }
+    }
+
+    // mmap offsets must be page aligned, map from the page holding offset.
+    static const size_t page = sysconf(_SC_PAGESIZE);
+    size_t mapOffset = offset / page * page;
+    size_t mapLength = length + (offset - mapOffset);
+    if (mapLength == 0) {
+        mapLength = 1;
+    }
+
+    int prot = (writable || create) ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* base = mmap(nullptr, mapLength, prot, MAP_SHARED, fd, mapOffset);
+    // the mapping stays valid after the descriptor is closed.
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("Error: Failed to map file " + path + ": " + std::strerror(errno));
+    }
+
+    madvise(base, mapLength, toMadvise(advice));
+
+    std::shared_ptr<uint8_t> mapping(static_cast<uint8_t*>(base), [mapLength](uint8_t* p) {
+        munmap(p, mapLength);
+    });
+    // point to offset, but keep ownership of the whole mapping.
+    return std::shared_ptr<uint8_t>(mapping, mapping.get() + (offset - mapOffset));
+}
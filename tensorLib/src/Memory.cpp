@@ -0,0 +1,195 @@
+#include "../include/Memory.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace memory {
+
+static bool envEnabled() {
+    const char* env = std::getenv("TENSORLIB_MEMORY");
+    return env != nullptr && std::string(env) != "0";
+}
+
+std::atomic<bool> enabled_flag{envEnabled()};
+
+namespace {
+
+std::atomic<int64_t> live_bytes{0};
+std::atomic<int64_t> peak_bytes{0};
+std::atomic<int64_t> allocs{0};
+std::atomic<int64_t> frees{0};
+std::atomic<int64_t> total_bytes{0};
+
+thread_local const char* current_op = nullptr;
+
+struct OpTable {
+    std::mutex mutex;
+    // op names are string literals, keyed by pointer. The entries are never erased,
+    // their addresses are the tokens carried by the allocations.
+    std::map<const char*, OpStats> ops;
+};
+
+OpTable& opTable() {
+    // leaked on purpose, storage may be freed after static destruction.
+    static OpTable* table = new OpTable();
+    return *table;
+}
+
+void updatePeak(std::atomic<int64_t>& peak, int64_t value) {
+    int64_t old = peak.load(std::memory_order_relaxed);
+    while (value > old && !peak.compare_exchange_weak(old, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+void enable(bool on) {
+    enabled_flag.store(on, std::memory_order_relaxed);
+}
+
+const char* setCurrentOp(const char* name) {
+    const char* prev = current_op;
+    current_op = name;
+    return prev;
+}
+
+const char* currentOp() {
+    return current_op;
+}
+
+void* recordAlloc(size_t bytes) {
+    int64_t live = live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    updatePeak(peak_bytes, live);
+    allocs.fetch_add(1, std::memory_order_relaxed);
+    total_bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+    if (!enabled()) {
+        return nullptr;
+    }
+
+    auto& table = opTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    const char* name = current_op ? current_op : "(none)";
+    auto& op = table.ops[name];
+    op.allocs++;
+    op.total_bytes += bytes;
+    op.live_bytes += bytes;
+    op.peak_bytes = std::max(op.peak_bytes, op.live_bytes);
+    return &op;
+}
+
+void recordFree(void* token, size_t bytes) {
+    live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    frees.fetch_add(1, std::memory_order_relaxed);
+
+    if (token != nullptr) {
+        auto& table = opTable();
+        std::lock_guard<std::mutex> lock(table.mutex);
+        static_cast<OpStats*>(token)->live_bytes -= bytes;
+    }
+}
+
+Stats stats() {
+    Stats s;
+    s.live_bytes = live_bytes.load();
+    s.peak_bytes = peak_bytes.load();
+    s.allocs = allocs.load();
+    s.frees = frees.load();
+    s.total_bytes = total_bytes.load();
+    return s;
+}
+
+void resetPeak() {
+    peak_bytes.store(live_bytes.load());
+}
+
+std::vector<OpStats> byOp() {
+    std::vector<OpStats> result;
+    auto& table = opTable();
+    {
+        std::lock_guard<std::mutex> lock(table.mutex);
+        // the same name may come from string literals at different addresses, merge them.
+        std::map<std::string, OpStats> merged;
+        for (auto& kv : table.ops) {
+            auto& op = merged[kv.first];
+            op.name = kv.first;
+            op.allocs += kv.second.allocs;
+            op.total_bytes += kv.second.total_bytes;
+            op.live_bytes += kv.second.live_bytes;
+            op.peak_bytes += kv.second.peak_bytes;
+        }
+        for (auto& kv : merged) {
+            result.push_back(kv.second);
+        }
+    }
+
+    std::sort(result.begin(), result.end(), [](const OpStats& a, const OpStats& b) {
+        return a.total_bytes > b.total_bytes;
+    });
+    return result;
+}
+
+void resetOps() {
+    auto& table = opTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    // keep live_bytes, the storage still alive will be freed against these entries.
+    for (auto& kv : table.ops) {
+        kv.second.allocs = 0;
+        kv.second.total_bytes = 0;
+        kv.second.peak_bytes = kv.second.live_bytes;
+    }
+}
+
+int64_t peakRSS() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<int64_t>(usage.ru_maxrss) * 1024; // ru_maxrss is in KB on Linux
+}
+
+int64_t currentRSS() {
+    long pages = 0, resident = 0;
+    FILE* file = std::fopen("/proc/self/statm", "r");
+    if (file == nullptr) {
+        return -1;
+    }
+    if (std::fscanf(file, "%ld %ld", &pages, &resident) != 2) {
+        resident = -1;
+    }
+    std::fclose(file);
+    return resident < 0 ? -1 : static_cast<int64_t>(resident) * sysconf(_SC_PAGESIZE);
+}
+
+void printSummary(std::ostream& os) {
+    auto s = stats();
+    auto flags = os.flags();
+    os << std::fixed << std::setprecision(3);
+
+    const double MB = 1024.0 * 1024.0;
+    os << "Tensor memory: live " << s.live_bytes / MB << " MB, peak " << s.peak_bytes / MB
+       << " MB, " << s.allocs << " allocs, " << s.frees << " frees, " << s.total_bytes / MB << " MB allocated" << std::endl;
+    os << "Process RSS: current " << currentRSS() / MB << " MB, peak " << peakRSS() / MB << " MB" << std::endl;
+
+    auto ops = byOp();
+    if (!ops.empty()) {
+        os << std::left << std::setw(20) << "op"
+           << std::right << std::setw(10) << "allocs"
+           << std::setw(14) << "total(MB)"
+           << std::setw(14) << "live(MB)"
+           << std::setw(14) << "peak(MB)" << std::endl;
+        for (auto& op : ops) {
+            os << std::left << std::setw(20) << op.name
+               << std::right << std::setw(10) << op.allocs
+               << std::setw(14) << op.total_bytes / MB
+               << std::setw(14) << op.live_bytes / MB
+               << std::setw(14) << op.peak_bytes / MB << std::endl;
+        }
+    }
+    os.flags(flags);
+}
+
+} // namespace memory
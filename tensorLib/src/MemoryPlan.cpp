@@ -0,0 +1,58 @@
+#include "../include/MemoryPlan.hpp"
+#include <algorithm>
+#include <numeric>
+
+namespace memory {
+
+ArenaPlan planArena(const std::vector<Buffer>& buffers, size_t alignment) {
+    ArenaPlan plan;
+    plan.offsets.assign(buffers.size(), 0);
+
+    auto align = [alignment](size_t bytes) { return (bytes + alignment - 1) & ~(alignment - 1); };
+
+    // largest first, the small ones fill the gaps they leave.
+    std::vector<size_t> order(buffers.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (buffers[a].bytes != buffers[b].bytes) {
+            return buffers[a].bytes > buffers[b].bytes;
+        }
+        return buffers[a].first < buffers[b].first;
+    });
+
+    std::vector<size_t> placed;
+    for (size_t i : order) {
+        const Buffer& buffer = buffers[i];
+        size_t bytes = align(buffer.bytes);
+        plan.naive_bytes += bytes;
+
+        // the placed buffers live at the same time as this one, by offset.
+        std::vector<size_t> overlapping;
+        for (size_t j : placed) {
+            if (buffers[j].first <= buffer.last && buffer.first <= buffers[j].last) {
+                overlapping.push_back(j);
+            }
+        }
+        std::sort(overlapping.begin(), overlapping.end(),
+                  [&](size_t a, size_t b) { return plan.offsets[a] < plan.offsets[b]; });
+
+        // the smallest gap between them that fits, else after the last one.
+        size_t best = 0, best_gap = 0, cursor = 0;
+        bool found = false;
+        for (size_t j : overlapping) {
+            size_t begin = plan.offsets[j];
+            if (begin >= cursor + bytes && (!found || begin - cursor < best_gap)) {
+                best = cursor;
+                best_gap = begin - cursor;
+                found = true;
+            }
+            cursor = std::max(cursor, begin + align(buffers[j].bytes));
+        }
+        plan.offsets[i] = found ? best : cursor;
+        plan.arena_bytes = std::max(plan.arena_bytes, plan.offsets[i] + bytes);
+        placed.push_back(i);
+    }
+    return plan;
+}
+
+} // namespace memory
@@ -0,0 +1,312 @@
+#include "../include/Numa.hpp"
+#include "../include/ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace numa {
+
+namespace {
+
+const size_t PAGE = 4096;
+
+std::string readLine(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+struct Topology {
+    // the nodes with CPUs or memory, usually 0 .. n-1.
+    std::vector<int> nodes;
+    // cpu -> node, -1 for CPUs sysfs does not list.
+    std::vector<int> node_of_cpu;
+
+    Topology() {
+        nodes = parseList(readLine("/sys/devices/system/node/online"));
+        if (nodes.empty()) {
+            nodes.push_back(0);
+        }
+        for (int node : nodes) {
+            for (int cpu : parseList(readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"))) {
+                if (cpu >= (int)node_of_cpu.size()) {
+                    node_of_cpu.resize(cpu + 1, -1);
+                }
+                node_of_cpu[cpu] = node;
+            }
+        }
+    }
+};
+
+const Topology& topology() {
+    static Topology instance;
+    return instance;
+}
+
+Policy defaultPolicy() {
+    const char* env = std::getenv("TENSORLIB_NUMA");
+    Policy fallback = nodeCount() > 1 ? Policy::Interleave : Policy::Off;
+    if (env == nullptr || *env == '\0') {
+        return fallback;
+    }
+    Policy p;
+    if (!parsePolicy(env, p)) {
+        std::cerr << "TENSORLIB_NUMA=" << env << " is not one of off, firsttouch, interleave, using "
+                  << policyName(fallback) << std::endl;
+        return fallback;
+    }
+    return p;
+}
+
+bool defaultReplicate() {
+    const char* env = std::getenv("TENSORLIB_NUMA_REPLICATE");
+    if (env != nullptr && *env != '\0') {
+        return std::string(env) != "0";
+    }
+    return nodeCount() > 1;
+}
+
+std::atomic<Policy>& policyState() {
+    static std::atomic<Policy> instance{defaultPolicy()};
+    return instance;
+}
+
+std::atomic<bool>& replicateState() {
+    static std::atomic<bool> instance{defaultReplicate()};
+    return instance;
+}
+
+#ifdef __linux__
+bool mbindRange(void* ptr, size_t bytes, int mode, const std::vector<int>& nodes, unsigned flags) {
+    // mbind works on whole pages, partial pages at the ends are left alone.
+    uintptr_t begin = ((uintptr_t)ptr + PAGE - 1) / PAGE * PAGE;
+    uintptr_t end = ((uintptr_t)ptr + bytes) / PAGE * PAGE;
+    if (end <= begin) {
+        return true;
+    }
+    const int BITS = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(1024 / BITS, 0);
+    for (int node : nodes) {
+        if (node >= 0 && node < 1024) {
+            mask[node / BITS] |= 1UL << (node % BITS);
+        }
+    }
+    long ret = syscall(SYS_mbind, begin, end - begin, mode, mask.data(), (unsigned long)(mask.size() * BITS), flags);
+    return ret == 0;
+}
+#endif
+
+} // namespace
+
+const char* policyName(Policy policy) {
+    switch (policy) {
+        case Policy::FirstTouch: return "firsttouch";
+        case Policy::Interleave: return "interleave";
+        default: return "off";
+    }
+}
+
+bool parsePolicy(const std::string& name, Policy& policy) {
+    if (name == "off" || name == "0") {
+        policy = Policy::Off;
+    } else if (name == "firsttouch" || name == "first-touch") {
+        policy = Policy::FirstTouch;
+    } else if (name == "interleave") {
+        policy = Policy::Interleave;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+Policy policy() {
+    return policyState().load(std::memory_order_relaxed);
+}
+
+void setPolicy(Policy p) {
+    policyState().store(p, std::memory_order_relaxed);
+}
+
+int nodeCount() {
+    return (int)topology().nodes.size();
+}
+
+std::vector<int> nodeCPUs(int node) {
+    std::vector<int> cpus;
+    for (int cpu : parallel::availableCPUs()) {
+        if (nodeOfCPU(cpu) == node) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+int nodeOfCPU(int cpu) {
+    const auto& t = topology();
+    if (cpu < 0 || cpu >= (int)t.node_of_cpu.size() || t.node_of_cpu[cpu] < 0) {
+        return t.nodes.front();
+    }
+    return t.node_of_cpu[cpu];
+}
+
+int currentNode() {
+#ifdef __linux__
+    if (nodeCount() > 1) {
+        return nodeOfCPU(sched_getcpu());
+    }
+#endif
+    return topology().nodes.front();
+}
+
+std::vector<int> parseList(const std::string& list) {
+    std::vector<int> values;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        size_t dash = item.find('-');
+        int first = std::atoi(item.substr(0, dash).c_str());
+        int last = dash == std::string::npos ? first : std::atoi(item.substr(dash + 1).c_str());
+        for (int v = first; v <= last; v++) {
+            values.push_back(v);
+        }
+    }
+    return values;
+}
+
+std::vector<int> pinOrder(const std::vector<std::vector<int>>& cpus_by_node, bool scatter) {
+    std::vector<int> order;
+    if (!scatter) {
+        for (auto& cpus : cpus_by_node) {
+            order.insert(order.end(), cpus.begin(), cpus.end());
+        }
+        return order;
+    }
+    for (size_t i = 0;; i++) {
+        bool any = false;
+        for (auto& cpus : cpus_by_node) {
+            if (i < cpus.size()) {
+                order.push_back(cpus[i]);
+                any = true;
+            }
+        }
+        if (!any) {
+            return order;
+        }
+    }
+}
+
+std::unique_ptr<parallel::ThreadPool> nodePool(int node, int threads) {
+    std::vector<int> cpus = nodeCPUs(node);
+    if (cpus.empty()) {
+        cpus = parallel::availableCPUs();
+    }
+    if (threads <= 0) {
+        threads = (int)cpus.size();
+    }
+    // the calling thread is not pinned, the workers take the node's CPUs after the first.
+    std::rotate(cpus.begin(), cpus.begin() + 1, cpus.end());
+    return std::make_unique<parallel::ThreadPool>(threads, cpus);
+}
+
+void place(void* ptr, size_t bytes) {
+    Policy p = policy();
+    if (p == Policy::Off || bytes < PLACE_MIN_BYTES) {
+        return;
+    }
+    // an unpinned worker touches a page from wherever the scheduler runs it.
+    if (p == Policy::Interleave || !parallel::current().pinned()) {
+        interleave(ptr, bytes);
+        return;
+    }
+
+    char* base = static_cast<char*>(ptr);
+    size_t pages = (bytes + PAGE - 1) / PAGE;
+    parallel::parallel_for(0, (int64_t)pages, 64, [&](int64_t begin, int64_t end) {
+        for (int64_t page = begin; page < end; page++) {
+            base[page * PAGE] = 0;
+        }
+    });
+}
+
+void* allocatePlaced(size_t bytes) {
+#ifdef __linux__
+    size_t length = std::max(PAGE, (bytes + PAGE - 1) / PAGE * PAGE);
+    void* ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr != MAP_FAILED) {
+        // the allocator may hand out pages some thread already touched, these are new.
+        place(ptr, length);
+        return ptr;
+    }
+#else
+    (void)bytes;
+#endif
+    return nullptr;
+}
+
+void releasePlaced(void* ptr, size_t bytes) {
+#ifdef __linux__
+    munmap(ptr, std::max(PAGE, (bytes + PAGE - 1) / PAGE * PAGE));
+#else
+    (void)ptr; (void)bytes;
+#endif
+}
+
+bool bindToNode(void* ptr, size_t bytes, int node) {
+#ifdef __linux__
+    return mbindRange(ptr, bytes, MPOL_BIND, {node}, MPOL_MF_MOVE);
+#else
+    (void)ptr; (void)bytes; (void)node;
+    return false;
+#endif
+}
+
+bool interleave(void* ptr, size_t bytes) {
+#ifdef __linux__
+    return mbindRange(ptr, bytes, MPOL_INTERLEAVE, topology().nodes, MPOL_MF_MOVE);
+#else
+    (void)ptr; (void)bytes;
+    return false;
+#endif
+}
+
+bool replicateWeights() {
+    return replicateState().load(std::memory_order_relaxed);
+}
+
+void setReplicateWeights(bool on) {
+    replicateState().store(on, std::memory_order_relaxed);
+}
+
+std::shared_ptr<char[]> allocateOnNode(size_t bytes, int node) {
+#ifdef __linux__
+    size_t length = std::max(PAGE, (bytes + PAGE - 1) / PAGE * PAGE);
+    void* ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr != MAP_FAILED) {
+        // nothing is touched yet, the pages are allocated on node by the first write.
+        if (nodeCount() > 1) {
+            bindToNode(ptr, length, node);
+        }
+        return std::shared_ptr<char[]>(static_cast<char*>(ptr), [length](char* p) { munmap(p, length); });
+    }
+#else
+    (void)node;
+#endif
+    return std::shared_ptr<char[]>(new char[bytes]);
+}
+
+} // namespace numa
@@ -0,0 +1,166 @@
+#include "../include/Observer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace quant {
+
+Observer::Observer(int bins) : histogram_(bins, 0) {
+    if (bins < 1) {
+        throw std::invalid_argument("Observer needs at least 1 bin, got " + std::to_string(bins));
+    }
+}
+
+void Observer::grow(float absmax) {
+    int B = (int)histogram_.size();
+    std::vector<int64_t> rebinned(B, 0);
+    float width = absmax_ / B, new_width = absmax / B;
+    for (int b = 0; b < B; b++) {
+        if (histogram_[b] == 0) {
+            continue;
+        }
+        // the counts of a bin move with its center.
+        int to = std::min(B - 1, (int)((b + 0.5f) * width / new_width));
+        rebinned[to] += histogram_[b];
+    }
+    histogram_.swap(rebinned);
+    absmax_ = absmax;
+}
+
+void Observer::observe(const float* x, size_t n) {
+    if (n == 0) {
+        return;
+    }
+    auto range = std::minmax_element(x, x + n);
+    min_ = count_ == 0 ? *range.first : std::min(min_, *range.first);
+    max_ = count_ == 0 ? *range.second : std::max(max_, *range.second);
+    float absmax = std::max(-min_, max_);
+    if (absmax > absmax_) {
+        grow(absmax);
+    }
+    count_ += n;
+
+    int B = (int)histogram_.size();
+    if (absmax_ == 0.0f) {
+        histogram_[0] += n;
+        return;
+    }
+    float inv_width = B / absmax_;
+    for (size_t i = 0; i < n; i++) {
+        histogram_[std::min(B - 1, (int)(std::fabs(x[i]) * inv_width))]++;
+    }
+}
+
+void Observer::observe(const Tensor<float>& x) {
+    if (x.is_contiguous()) {
+        observe(&x.data_[x.offset()], x.num_elements);
+        return;
+    }
+    auto contiguous = x.contiguous();
+    observe(&contiguous.data_[0], contiguous.num_elements);
+}
+
+float Observer::threshold(CalibrationMethod method, int levels, float percentile) const {
+    int B = (int)histogram_.size();
+    float width = absmax_ / B;
+    switch (method) {
+    case CalibrationMethod::MinMax:
+        return absmax_;
+    case CalibrationMethod::Percentile: {
+        int64_t target = (int64_t)std::ceil(count_ * (double)percentile / 100.0);
+        int64_t seen = 0;
+        for (int b = 0; b < B; b++) {
+            seen += histogram_[b];
+            if (seen >= target) {
+                return (b + 1) * width;
+            }
+        }
+        return absmax_;
+    }
+    case CalibrationMethod::Entropy:
+        return entropyThreshold(levels);
+    }
+    return absmax_;
+}
+
+float Observer::entropyThreshold(int levels) const {
+    int B = (int)histogram_.size();
+    if (levels >= B) {
+        return absmax_;
+    }
+    // the spike of exact zeros (e.g. after a ReLU) would outweigh the rest of the
+    // distribution, it counts as much as its neighbour.
+    std::vector<int64_t> histogram = histogram_;
+    if (B > 1) {
+        histogram[0] = histogram[1];
+    }
+    std::vector<int64_t> outliers(B + 1, 0);
+    for (int b = B - 1; b >= 0; b--) {
+        outliers[b] = outliers[b + 1] + histogram[b];
+    }
+
+    // clipping at bin i: the reference keeps the first i bins with everything above in
+    // the last one, the candidate spreads each of the levels chunks evenly over its
+    // non-empty bins. the smallest divergence wins, ties to the wider range.
+    std::vector<double> q;
+    double best = std::numeric_limits<double>::infinity();
+    int best_i = B;
+    for (int i = levels; i <= B; i++) {
+        q.assign(i, 0.0);
+        for (int j = 0; j < levels; j++) {
+            int begin = (int)((int64_t)j * i / levels), end = (int)((int64_t)(j + 1) * i / levels);
+            int64_t total = 0;
+            int nonzero = 0;
+            for (int b = begin; b < end; b++) {
+                total += histogram[b];
+                nonzero += histogram[b] > 0;
+            }
+            for (int b = begin; b < end && nonzero > 0; b++) {
+                q[b] = histogram[b] > 0 ? (double)total / nonzero : 0.0;
+            }
+        }
+        // p holds every count, q all but the outliers.
+        double p_sum = (double)outliers[0], q_sum = (double)(outliers[0] - outliers[i]);
+        if (q_sum <= 0) {
+            continue;
+        }
+        double divergence = 0;
+        for (int b = 0; b < i; b++) {
+            double p = (double)histogram[b] + (b == i - 1 ? (double)outliers[i] : 0.0);
+            if (p == 0) {
+                continue;
+            }
+            // an outlier bin the candidate left empty, smoothed instead of infinite.
+            double qb = std::max(q[b], 1e-3);
+            divergence += p / p_sum * std::log((p / p_sum) / (qb / q_sum));
+        }
+        if (divergence <= best) {
+            best = divergence;
+            best_i = i;
+        }
+    }
+    return best_i * (absmax_ / B);
+}
+
+std::pair<float, float> Observer::range(CalibrationMethod method, int levels, float percentile) const {
+    if (count_ == 0) {
+        return {0.0f, 0.0f};
+    }
+    float t = std::min(threshold(method, levels, percentile), absmax_);
+    return {std::max(min_, -t), std::min(max_, t)};
+}
+
+Params Observer::params(CalibrationMethod method, int32_t qmin, int32_t qmax, bool symmetric, float percentile) const {
+    if (count_ == 0) {
+        return Params();
+    }
+    // the steps spent on |x|, all of them when the values are one sided.
+    int steps = qmax - qmin + 1;
+    int levels = (!symmetric && min_ >= 0.0f) ? steps : steps / 2;
+    auto r = range(method, levels, percentile);
+    return chooseParams(r.first, r.second, qmin, qmax, symmetric);
+}
+
+} // namespace quant
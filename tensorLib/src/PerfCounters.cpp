@@ -0,0 +1,149 @@
+#include "../include/PerfCounters.hpp"
+#include "../include/ThreadPool.hpp"
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace perf {
+
+namespace {
+
+struct State {
+    std::once_flag opened;
+    int fds[NUM_EVENTS];
+    std::string status;
+};
+
+State& state() {
+    static State instance;
+    return instance;
+}
+
+#ifdef __linux__
+uint64_t cacheConfig(uint64_t cache, uint64_t op, uint64_t result) {
+    return cache | (op << 8) | (result << 16);
+}
+
+int openEvent(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    // user space only, this works with the default perf_event_paranoid level.
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    // needed to scale the counts when the PMU multiplexes events.
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+void openAll() {
+    auto& s = state();
+    for (int i = 0; i < NUM_EVENTS; i++) {
+        s.fds[i] = -1;
+    }
+
+#ifdef __linux__
+    struct { uint32_t type; uint64_t config; } events[NUM_EVENTS] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE, cacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        {PERF_TYPE_HW_CACHE, cacheConfig(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        {PERF_TYPE_HW_CACHE, cacheConfig(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    };
+
+    for (int i = 0; i < NUM_EVENTS; i++) {
+        s.fds[i] = openEvent(events[i].type, events[i].config);
+        if (s.fds[i] < 0) {
+            if (!s.status.empty()) s.status += ", ";
+            s.status += std::string(eventName(i)) + ": " + std::strerror(errno);
+        }
+    }
+    // workers started before now are not counted, start them again from this thread.
+    for (int i = 0; i < NUM_EVENTS; i++) {
+        if (s.fds[i] >= 0) {
+            parallel::restartDefaultPool();
+            break;
+        }
+    }
+#else
+    s.status = "perf_event_open is only available on Linux";
+#endif
+}
+
+} // namespace
+
+const char* eventName(int event) {
+    switch (event) {
+        case Cycles:       return "cycles";
+        case Instructions: return "instructions";
+        case BranchMisses: return "branch-misses";
+        case L1DMisses:    return "L1D-misses";
+        case LLCMisses:    return "LLC-misses";
+        case DTLBMisses:   return "dTLB-misses";
+    }
+    return "unknown";
+}
+
+bool open() {
+    std::call_once(state().opened, openAll);
+    for (int i = 0; i < NUM_EVENTS; i++) {
+        if (state().fds[i] >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool available() {
+    return open();
+}
+
+bool available(Event event) {
+    open();
+    return state().fds[event] >= 0;
+}
+
+std::string status() {
+    open();
+    return state().status;
+}
+
+void read(int64_t values[NUM_EVENTS]) {
+    open();
+    auto& s = state();
+    for (int i = 0; i < NUM_EVENTS; i++) {
+        values[i] = -1;
+#ifdef __linux__
+        if (s.fds[i] < 0) {
+            continue;
+        }
+        uint64_t data[3]; // value, time enabled, time running
+        if (::read(s.fds[i], data, sizeof(data)) != sizeof(data)) {
+            continue;
+        }
+        if (data[2] == 0) {
+            values[i] = 0;
+        } else if (data[2] < data[1]) {
+            // the event was multiplexed, extrapolate to the whole enabled time.
+            values[i] = static_cast<int64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+        } else {
+            values[i] = static_cast<int64_t>(data[0]);
+        }
+#endif
+    }
+}
+
+} // namespace perf
@@ -0,0 +1,335 @@
+#include "../include/Profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+namespace profiler {
+
+static bool envEnabled() {
+    const char* env = std::getenv("TENSORLIB_PROFILE");
+    return env != nullptr && std::string(env) != "0";
+}
+
+std::atomic<bool> enabled_flag{envEnabled()};
+
+static bool envCounters() {
+    const char* env = std::getenv("TENSORLIB_PERF_COUNTERS");
+    return env != nullptr && std::string(env) != "0" && perf::open();
+}
+
+std::atomic<bool> counters_flag{envCounters()};
+
+namespace {
+
+const auto epoch = std::chrono::steady_clock::now();
+
+// one ring buffer per thread, only its own thread writes to it.
+struct ThreadBuffer {
+    int thread;
+    std::vector<Record> ring;
+    size_t next = 0;    // total records written, ring position is next % capacity
+    int depth = 0;      // current nesting of OpScopes
+};
+
+struct Registry {
+    std::mutex mutex;
+    // shared with the thread_local handles so records outlive their threads.
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    size_t capacity = 1 << 14;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+ThreadBuffer& threadBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        auto buf = std::make_shared<ThreadBuffer>();
+        buf->thread = reg.buffers.size();
+        buf->ring.resize(reg.capacity);
+        reg.buffers.push_back(buf);
+        return buf;
+    }();
+    return *buffer;
+}
+
+} // namespace
+
+void enable(bool on) {
+    enabled_flag.store(on, std::memory_order_relaxed);
+}
+
+bool enableCounters(bool on) {
+    bool ok = !on || perf::open();
+    counters_flag.store(on && ok, std::memory_order_relaxed);
+    return ok;
+}
+
+void setBufferCapacity(size_t capacity) {
+    if (capacity == 0) {
+        throw std::invalid_argument("The profiler buffer capacity should be positive.");
+    }
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.capacity = capacity;
+    for (auto& buf : reg.buffers) {
+        buf->ring.assign(capacity, Record());
+        buf->next = 0;
+    }
+}
+
+int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void reset() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (auto& buf : reg.buffers) {
+        buf->next = 0;
+    }
+}
+
+std::vector<Record> records() {
+    std::vector<Record> result;
+    auto& reg = registry();
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (auto& buf : reg.buffers) {
+            size_t capacity = buf->ring.size();
+            size_t count = std::min(buf->next, capacity);
+            for (size_t i = buf->next - count; i < buf->next; i++) {
+                result.push_back(buf->ring[i % capacity]);
+            }
+        }
+    }
+
+    std::sort(result.begin(), result.end(), [](const Record& a, const Record& b) {
+        return a.start_ns < b.start_ns;
+    });
+    return result;
+}
+
+int64_t dropped() {
+    int64_t total = 0;
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (auto& buf : reg.buffers) {
+        if (buf->next > buf->ring.size()) {
+            total += buf->next - buf->ring.size();
+        }
+    }
+    return total;
+}
+
+std::string Record::shapeString() const {
+    std::ostringstream os;
+    for (int s = 0; s < MAX_SHAPES && ndims[s] >= 0; s++) {
+        if (s > 0) os << " ";
+        os << "[";
+        for (int d = 0; d < ndims[s] && d < MAX_DIMS; d++) {
+            if (d > 0) os << ",";
+            os << shapes[s][d];
+        }
+        if (ndims[s] > MAX_DIMS) os << ",...";
+        os << "]";
+    }
+    return os.str();
+}
+
+std::vector<OpStats> summary() {
+    std::map<std::string, OpStats> stats;
+    for (auto& r : records()) {
+        auto& s = stats[r.name];
+        s.name = r.name;
+        s.calls++;
+        s.seconds += r.seconds();
+        s.flops += r.flops;
+        s.bytes += r.bytes;
+        for (int e = 0; e < perf::NUM_EVENTS; e++) {
+            if (r.counters[e] >= 0) {
+                s.counters[e] = std::max<int64_t>(s.counters[e], 0) + r.counters[e];
+            }
+        }
+    }
+
+    std::vector<OpStats> result;
+    for (auto& kv : stats) {
+        result.push_back(kv.second);
+    }
+    std::sort(result.begin(), result.end(), [](const OpStats& a, const OpStats& b) {
+        return a.seconds > b.seconds;
+    });
+    return result;
+}
+
+void printSummary(std::ostream& os) {
+    auto stats = summary();
+
+    auto flags = os.flags();
+    os << std::left << std::setw(20) << "op"
+       << std::right << std::setw(8) << "calls"
+       << std::setw(14) << "total(ms)"
+       << std::setw(14) << "mean(ms)"
+       << std::setw(12) << "GFLOP/s"
+       << std::setw(12) << "GB/s" << std::endl;
+
+    os << std::fixed << std::setprecision(3);
+    for (auto& s : stats) {
+        os << std::left << std::setw(20) << s.name
+           << std::right << std::setw(8) << s.calls
+           << std::setw(14) << s.seconds * 1e3
+           << std::setw(14) << s.seconds * 1e3 / s.calls
+           << std::setw(12) << s.gflops()
+           << std::setw(12) << s.gbytes() << std::endl;
+    }
+
+    bool has_counters = false;
+    for (auto& s : stats) {
+        for (int e = 0; e < perf::NUM_EVENTS; e++) {
+            has_counters |= s.counters[e] >= 0;
+        }
+    }
+
+    if (has_counters) {
+        os << std::endl << std::left << std::setw(20) << "op" << std::right;
+        for (int e = 0; e < perf::NUM_EVENTS; e++) {
+            os << std::setw(15) << perf::eventName(e);
+        }
+        os << std::setw(8) << "IPC" << std::endl;
+
+        for (auto& s : stats) {
+            os << std::left << std::setw(20) << s.name << std::right;
+            for (int e = 0; e < perf::NUM_EVENTS; e++) {
+                if (s.counters[e] >= 0) {
+                    os << std::setw(15) << s.counters[e];
+                } else {
+                    os << std::setw(15) << "-";
+                }
+            }
+            if (s.counters[perf::Cycles] > 0 && s.counters[perf::Instructions] >= 0) {
+                os << std::setw(8) << std::setprecision(2)
+                   << (double)s.counters[perf::Instructions] / s.counters[perf::Cycles] << std::setprecision(3);
+            } else {
+                os << std::setw(8) << "-";
+            }
+            os << std::endl;
+        }
+    }
+
+    int64_t lost = dropped();
+    if (lost > 0) {
+        os << lost << " records dropped, increase the buffer capacity." << std::endl;
+    }
+    os.flags(flags);
+}
+
+static void writeJsonString(std::ostream& os, const std::string& s) {
+    os << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') os << '\\';
+        os << c;
+    }
+    os << '"';
+}
+
+void writeChromeTrace(std::ostream& os) {
+    auto all = records();
+
+    os << "{\"traceEvents\":[";
+    for (size_t i = 0; i < all.size(); i++) {
+        auto& r = all[i];
+        if (i > 0) os << ",";
+        os << "\n{\"name\":";
+        writeJsonString(os, r.name);
+        // complete events, timestamps in microseconds.
+        os << ",\"cat\":\"op\",\"ph\":\"X\",\"pid\":0,\"tid\":" << r.thread
+           << std::fixed << std::setprecision(3)
+           << ",\"ts\":" << r.start_ns * 1e-3
+           << ",\"dur\":" << (r.end_ns - r.start_ns) * 1e-3
+           << std::defaultfloat << std::setprecision(6)
+           << ",\"args\":{\"shapes\":";
+        writeJsonString(os, r.shapeString());
+        os << ",\"flops\":" << r.flops << ",\"bytes\":" << r.bytes;
+        for (int e = 0; e < perf::NUM_EVENTS; e++) {
+            if (r.counters[e] >= 0) {
+                os << ",\"" << perf::eventName(e) << "\":" << r.counters[e];
+            }
+        }
+        os << "}}";
+    }
+    os << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+}
+
+void writeChromeTrace(const std::string& path) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error: Failed to open file " + path);
+    }
+    writeChromeTrace(file);
+}
+
+void OpScope::begin(const char* name) {
+    active_ = true;
+    auto& buf = threadBuffer();
+    record_.name = name;
+    record_.flops = 0;
+    record_.bytes = 0;
+    record_.thread = buf.thread;
+    record_.depth = buf.depth++;
+    for (int s = 0; s < MAX_SHAPES; s++) {
+        record_.ndims[s] = -1;
+    }
+    // start values for now, turned into deltas when the scope ends.
+    counting_ = countersEnabled();
+    if (counting_) {
+        perf::read(record_.counters);
+    } else {
+        for (int e = 0; e < perf::NUM_EVENTS; e++) {
+            record_.counters[e] = -1;
+        }
+    }
+    record_.start_ns = now();
+}
+
+void OpScope::annotate(double flops, double bytes, std::initializer_list<const std::vector<int>*> shapes) {
+    record_.flops = flops;
+    record_.bytes = bytes;
+    int s = 0;
+    for (auto shape : shapes) {
+        if (s >= MAX_SHAPES) break;
+        record_.ndims[s] = static_cast<int8_t>(shape->size());
+        for (size_t d = 0; d < shape->size() && d < (size_t)MAX_DIMS; d++) {
+            record_.shapes[s][d] = (*shape)[d];
+        }
+        s++;
+    }
+}
+
+void OpScope::end() {
+    record_.end_ns = now();
+    if (counting_) {
+        int64_t values[perf::NUM_EVENTS];
+        perf::read(values);
+        for (int e = 0; e < perf::NUM_EVENTS; e++) {
+            bool valid = record_.counters[e] >= 0 && values[e] >= 0;
+            record_.counters[e] = valid ? values[e] - record_.counters[e] : -1;
+        }
+    }
+    auto& buf = threadBuffer();
+    buf.depth--;
+    buf.ring[buf.next % buf.ring.size()] = record_;
+    buf.next++;
+}
+
+} // namespace profiler
@@ -0,0 +1,160 @@
+#include "../include/Quantize.hpp"
+#include "../include/ThreadPool.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace quant {
+
+Params chooseParams(float min, float max, int32_t qmin, int32_t qmax, bool symmetric) {
+    Params params;
+    min = std::min(min, 0.0f);
+    max = std::max(max, 0.0f);
+    if (symmetric) {
+        float bound = std::max(-min, max);
+        // symmetric around 0 over [-qmax, qmax], qmin = -qmax - 1 stays unused.
+        params.scale = bound > 0 ? bound / (float)qmax : 1.0f;
+        params.zero_point = 0;
+        return params;
+    }
+    if (max <= min) {
+        return params;
+    }
+    params.scale = (max - min) / (float)(qmax - qmin);
+    // min maps to qmin, the zero point is where 0 lands, rounded so 0 is exact.
+    float zero = (float)qmin - min / params.scale;
+    params.zero_point = (int32_t)std::max((float)qmin, std::min((float)qmax, std::nearbyint(zero)));
+    return params;
+}
+
+QuantizedWeight quantizeWeight(const Tensor<float>& w, const Config& config) {
+    if (w.shape().size() != 2) {
+        throw std::invalid_argument("quantizeWeight expects a (rows, cols) weight");
+    }
+    auto contiguous = w.is_contiguous() ? w : w.contiguous();
+    const float* src = &contiguous.data_[contiguous.offset()];
+
+    QuantizedWeight q;
+    q.rows = w.shape()[0];
+    q.cols = w.shape()[1];
+    q.group_size = config.group_size > 0 ? config.group_size : q.cols;
+    if (q.cols % q.group_size != 0) {
+        throw std::invalid_argument("quantizeWeight: group size " + std::to_string(q.group_size) +
+                                    " does not divide " + std::to_string(q.cols) + " columns");
+    }
+    q.groups = q.cols / q.group_size;
+    q.symmetric = config.symmetric;
+    q.values = Tensor<int8_t>({q.rows, q.cols});
+    q.scales.resize((size_t)q.rows * q.groups);
+    q.zero_points.resize(q.scales.size());
+    q.sums.resize(q.scales.size());
+
+    int8_t* dst = &q.values.data_[0];
+    parallel::parallel_for(0, (int64_t)q.rows * q.groups, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t g = begin; g < end; g++) {
+            const float* in = src + g * q.group_size;
+            int8_t* out = dst + g * q.group_size;
+            auto range = std::minmax_element(in, in + q.group_size);
+            Params params = chooseParams(*range.first, *range.second, -128, 127, q.symmetric);
+            float inv_scale = 1.0f / params.scale;
+            int32_t sum = 0;
+            for (int k = 0; k < q.group_size; k++) {
+                out[k] = (int8_t)quantize(in[k], inv_scale, params.zero_point, -128, 127);
+                sum += out[k];
+            }
+            q.scales[g] = params.scale;
+            q.zero_points[g] = params.zero_point;
+            q.sums[g] = sum;
+        }
+    });
+    return q;
+}
+
+Tensor<float> dequantize(const QuantizedWeight& w) {
+    Tensor<float> result({w.rows, w.cols});
+    for (int64_t g = 0; g < (int64_t)w.rows * w.groups; g++) {
+        for (int k = 0; k < w.group_size; k++) {
+            size_t i = g * w.group_size + k;
+            result.data_[i] = w.scales[g] * (w.values.data_[i] - w.zero_points[g]);
+        }
+    }
+    return result;
+}
+
+PackedWeight4 quantizeWeight4(const Tensor<float>& w, const Config& config) {
+    if (w.shape().size() != 2) {
+        throw std::invalid_argument("quantizeWeight4 expects a (rows, cols) weight");
+    }
+    auto contiguous = w.is_contiguous() ? w : w.contiguous();
+    const float* src = &contiguous.data_[contiguous.offset()];
+
+    PackedWeight4 q;
+    q.rows = w.shape()[0];
+    q.cols = w.shape()[1];
+    q.group_size = config.group_size > 0 ? config.group_size : q.cols;
+    if (q.cols % q.group_size != 0 || q.group_size % 2 != 0) {
+        throw std::invalid_argument("quantizeWeight4: group size " + std::to_string(q.group_size) +
+                                    " must be even and divide " + std::to_string(q.cols) + " columns");
+    }
+    q.groups = q.cols / q.group_size;
+    q.symmetric = config.symmetric;
+    q.values = Tensor<uint8_t>({q.rows, q.cols / 2});
+    q.scales.resize((size_t)q.rows * q.groups);
+    q.zero_points.resize(q.scales.size());
+
+    uint8_t* dst = &q.values.data_[0];
+    const int half = q.group_size / 2;
+    parallel::parallel_for(0, (int64_t)q.rows * q.groups, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t g = begin; g < end; g++) {
+            const float* in = src + g * q.group_size;
+            uint8_t* out = dst + g * half;
+            auto range = std::minmax_element(in, in + q.group_size);
+            // symmetric: [-7, 7] shifted by 8, asymmetric: [0, 15] around its zero point.
+            Params params = q.symmetric ? chooseParams(*range.first, *range.second, -8, 7, true)
+                                        : chooseParams(*range.first, *range.second, 0, 15, false);
+            int32_t zero_point = q.symmetric ? 8 : params.zero_point;
+            float inv_scale = 1.0f / params.scale;
+            for (int t = 0; t < half; t++) {
+                int32_t lo = quantize(in[t], inv_scale, zero_point, 0, 15);
+                int32_t hi = quantize(in[t + half], inv_scale, zero_point, 0, 15);
+                out[t] = (uint8_t)(lo | (hi << 4));
+            }
+            q.scales[g] = params.scale;
+            q.zero_points[g] = zero_point;
+        }
+    });
+    return q;
+}
+
+Tensor<float> dequantize(const PackedWeight4& w) {
+    Tensor<float> result({w.rows, w.cols});
+    const int half = w.group_size / 2;
+    for (int64_t g = 0; g < (int64_t)w.rows * w.groups; g++) {
+        const uint8_t* in = &w.values.data_[g * half];
+        float* out = &result.data_[g * w.group_size];
+        for (int t = 0; t < half; t++) {
+            out[t] = w.scales[g] * ((in[t] & 0x0F) - w.zero_points[g]);
+            out[t + half] = w.scales[g] * ((in[t] >> 4) - w.zero_points[g]);
+        }
+    }
+    return result;
+}
+
+void quantizeU8(const float* x, size_t n, const Params& params, uint8_t* out) {
+    float inv_scale = 1.0f / params.scale;
+    parallel::parallel_for(0, (int64_t)n, 1 << 14, [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; i++) {
+            out[i] = (uint8_t)quantize(x[i], inv_scale, params.zero_point, 0, 255);
+        }
+    });
+}
+
+Params chooseParamsU8(const float* x, size_t n) {
+    if (n == 0) {
+        return Params();
+    }
+    auto range = std::minmax_element(x, x + n);
+    return chooseParams(*range.first, *range.second, 0, 255, false);
+}
+
+} // namespace quant
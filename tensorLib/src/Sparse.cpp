@@ -0,0 +1,205 @@
+#include "../include/Sparse.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace sparse {
+
+namespace {
+
+const double DEFAULT_MIN_SPARSITY = 0.5;
+
+// time per stored value relative to a weight of the dense GEMM, measured with spmm_nt_f32
+// from batch 1 to 64: CSR pays an index and a scattered load per value.
+double valueCost(Format format) {
+    switch (format) {
+    case Format::CSR:
+        return 7.0;
+    case Format::Block1x4:
+        return 3.0;
+    case Format::Block4x4:
+        return 1.2;
+    }
+    return 7.0;
+}
+
+void blockShape(Format format, int& block_rows, int& block_cols) {
+    block_rows = format == Format::Block4x4 ? 4 : 1;
+    block_cols = format == Format::CSR ? 1 : 4;
+}
+
+bool fits(Format format, int rows, int cols) {
+    int block_rows, block_cols;
+    blockShape(format, block_rows, block_cols);
+    return rows >= block_rows && cols >= block_cols;
+}
+
+// visit(row, first, c0, keep) for every block: its first row, the first column it owns,
+// the column it starts at (first, or earlier for the last block of a block row) and
+// whether it holds a weight above threshold.
+template <typename Visit>
+void forEachBlock(const float* w, int rows, int cols, int block_rows, int block_cols, float threshold,
+                  Visit visit) {
+    for (int row = 0; row < rows; row += block_rows) {
+        for (int first = 0; first < cols; first += block_cols) {
+            int c0 = std::min(first, cols - block_cols);
+            bool keep = false;
+            for (int p = 0; p < block_rows && row + p < rows && !keep; p++) {
+                for (int col = first; col < c0 + block_cols; col++) {
+                    keep = keep || std::fabs(w[(size_t)(row + p) * cols + col]) > threshold;
+                }
+            }
+            visit(row, first, c0, keep);
+        }
+    }
+}
+
+double defaultMinSparsity() {
+    const char* env = std::getenv("TENSORLIB_SPARSE");
+    if (env == nullptr || *env == '\0') {
+        return DEFAULT_MIN_SPARSITY;
+    }
+    char* end = nullptr;
+    double value = std::strtod(env, &end);
+    if (end == env || *end != '\0') {
+        std::cerr << "TENSORLIB_SPARSE=" << env << " is not a fraction of zeros, using " << DEFAULT_MIN_SPARSITY
+                  << std::endl;
+        return DEFAULT_MIN_SPARSITY;
+    }
+    return value;
+}
+
+std::atomic<double>& minSparsityState() {
+    static std::atomic<double> instance{defaultMinSparsity()};
+    return instance;
+}
+
+} // namespace
+
+const char* formatName(Format format) {
+    switch (format) {
+    case Format::CSR:
+        return "csr";
+    case Format::Block1x4:
+        return "block1x4";
+    case Format::Block4x4:
+        return "block4x4";
+    }
+    return "unknown";
+}
+
+size_t Matrix::bytes() const {
+    return values.size() * sizeof(float) + (row_ptr.size() + col_idx.size()) * sizeof(int32_t);
+}
+
+Matrix fromDense(const Tensor<float>& w, Format format, float threshold) {
+    if (w.shape().size() != 2) {
+        throw std::invalid_argument("sparse::fromDense expects a (rows, cols) weight");
+    }
+    Matrix m;
+    m.rows = w.shape()[0];
+    m.cols = w.shape()[1];
+    m.format = format;
+    blockShape(format, m.block_rows, m.block_cols);
+    if (!fits(format, m.rows, m.cols)) {
+        throw std::invalid_argument(std::string("sparse::fromDense: ") + formatName(format) + " needs at least " +
+                                    std::to_string(m.block_rows) + " rows and " + std::to_string(m.block_cols) +
+                                    " columns, got (" + std::to_string(m.rows) + ", " + std::to_string(m.cols) + ")");
+    }
+    auto contiguous = w.is_contiguous() ? w : w.contiguous();
+    const float* src = &contiguous.data_[contiguous.offset()];
+
+    const int R = m.rows, C = m.cols, BR = m.block_rows, BC = m.block_cols;
+    m.row_ptr.push_back(0);
+    forEachBlock(src, R, C, BR, BC, threshold, [&](int row, int first, int c0, bool keep) {
+        if (keep) {
+            m.col_idx.push_back(c0);
+            for (int p = 0; p < BR; p++) {
+                for (int col = c0; col < c0 + BC; col++) {
+                    float v = row + p < R && col >= first ? src[(size_t)(row + p) * C + col] : 0.0f;
+                    m.values.push_back(std::fabs(v) > threshold ? v : 0.0f);
+                }
+            }
+        }
+        if (first + BC >= C) {
+            m.row_ptr.push_back((int32_t)m.col_idx.size());
+        }
+    });
+    return m;
+}
+
+Tensor<float> toDense(const Matrix& m) {
+    Tensor<float> dense(std::vector<int>{m.rows, m.cols});
+    std::fill(&dense.data_[0], &dense.data_[0] + dense.num_elements, 0.0f);
+    const int BR = m.block_rows, BC = m.block_cols;
+    for (size_t r = 0; r + 1 < m.row_ptr.size(); r++) {
+        for (int32_t b = m.row_ptr[r]; b < m.row_ptr[r + 1]; b++) {
+            const float* v = &m.values[(size_t)b * BR * BC];
+            for (int p = 0; p < BR && (int)r * BR + p < m.rows; p++) {
+                for (int q = 0; q < BC; q++) {
+                    // the columns a shifted block shares with its neighbour hold 0.
+                    dense.data_[((size_t)r * BR + p) * m.cols + m.col_idx[b] + q] += v[p * BC + q];
+                }
+            }
+        }
+    }
+    return dense;
+}
+
+double sparsity(const Tensor<float>& w, float threshold) {
+    if (w.num_elements == 0) {
+        return 0.0;
+    }
+    auto contiguous = w.is_contiguous() ? w : w.contiguous();
+    const float* src = &contiguous.data_[contiguous.offset()];
+    int64_t zeros = 0;
+    for (int i = 0; i < w.num_elements; i++) {
+        zeros += std::fabs(src[i]) <= threshold;
+    }
+    return (double)zeros / w.num_elements;
+}
+
+double relativeCost(const Tensor<float>& w, Format format, float threshold) {
+    if (w.shape().size() != 2) {
+        throw std::invalid_argument("sparse::relativeCost expects a (rows, cols) weight");
+    }
+    const int R = w.shape()[0], C = w.shape()[1];
+    if (!fits(format, R, C) || w.num_elements == 0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    auto contiguous = w.is_contiguous() ? w : w.contiguous();
+    int BR, BC;
+    blockShape(format, BR, BC);
+    int64_t blocks = 0;
+    forEachBlock(&contiguous.data_[contiguous.offset()], R, C, BR, BC, threshold,
+                 [&](int, int, int, bool keep) { blocks += keep; });
+    return (double)blocks * BR * BC * valueCost(format) / w.num_elements;
+}
+
+Format chooseFormat(const Tensor<float>& w, float threshold) {
+    Format best = Format::CSR;
+    double best_cost = std::numeric_limits<double>::infinity();
+    for (Format format : {Format::CSR, Format::Block1x4, Format::Block4x4}) {
+        double cost = relativeCost(w, format, threshold);
+        if (cost < best_cost) {
+            best = format;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+double minSparsity() {
+    return minSparsityState().load(std::memory_order_relaxed);
+}
+
+void setMinSparsity(double sparsity) {
+    minSparsityState().store(sparsity, std::memory_order_relaxed);
+}
+
+} // namespace sparse
@@ -1,12 +1,20 @@
 #include "../include/Tensor.hpp"
+#include "../include/Profiler.hpp"
+#include "../include/Memory.hpp"
+#include "../include/Kernels.hpp"
+#include "../include/Autotuner.hpp"
+#include "../include/ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <type_traits>
 #include <utility>
 #include <vector>
 #include <iomanip>
 #include "iostream"
 #include "math.h"
-#include "omp.h"
 
 // Explicit instantiation for int
 template class Tensor<int>;
@@ -19,6 +27,10 @@ template class Tensor<float>;
 
 template class Tensor<uint8_t>;
 
+template class Tensor<int8_t>;
+
+template class Tensor<int16_t>;
+
 template <typename dtype>
 Tensor<dtype>::Tensor(const std::vector<int>& shape) : ndim(shape.size()), shape_(shape), offset_(0) {
         num_elements = 1; // even shape is empty, it should have 1 elem, means a scala.
@@ -30,8 +42,8 @@ Tensor<dtype>::Tensor(const std::vector<int>& shape) : ndim(shape.size()), shape
         // data_ = std::vector<dtype>(num_elements);
 
         // data_ = std::make_shared<dtype[]>(num_elements); // cpp 20 or later
-        std::shared_ptr<dtype[]> temp(new dtype[num_elements]);
-        data_ = temp;
+        // allocated through memory::allocate so live/peak bytes are accounted.
+        data_ = memory::allocate<dtype>(num_elements);
 
         stride_ = std::vector<int>(ndim);
 
@@ -66,6 +78,30 @@ Tensor<dtype>::Tensor(const std::vector<int>& shape, const std::shared_ptr<dtype
         }
 }
 
+template <typename dtype>
+Tensor<dtype> Tensor<dtype>::from_blob(dtype* ptr, const std::vector<int>& shape,
+                                       const std::vector<int>& strides,
+                                       const std::function<void(dtype*)>& deleter) {
+    if (!strides.empty() && strides.size() != shape.size()) {
+        throw std::invalid_argument("The strides size does not match the shape size.");
+    }
+
+    std::shared_ptr<dtype[]> data;
+    if (deleter) {
+        data = std::shared_ptr<dtype[]>(ptr, deleter);
+    } else {
+        // borrowed, nothing to free.
+        data = std::shared_ptr<dtype[]>(ptr, [](dtype*) {});
+    }
+
+    Tensor<dtype> result(shape, data);
+    if (!strides.empty()) {
+        result.stride_ = strides;
+    }
+
+    return result;
+}
+
 template <typename dtype>
 Tensor<dtype>::~Tensor() {
 
@@ -172,8 +208,31 @@ Tensor<dtype> Tensor<dtype>::matmul(const Tensor<dtype>& other) const {
         throw std::invalid_argument("Matrix dimensions are not compatible for multiplication");
     }
 
+    PROFILE_OP("matmul", 2.0 * shape_[0] * shape_[1] * other.shape()[1],
+               (double)sizeof(dtype) * (num_elements + other.num_elements + (double)shape_[0] * other.shape()[1]),
+               &shape_, &other.shape());
+
     // make this and other matrix contiguous, which is more efficient when accessing memory for elements.
     auto left = is_contiguous(*this) ? *this : this->contiguous();
+
+    if constexpr (std::is_same<dtype, float>::value) {
+        int M = shape_[0], K = shape_[1], N = other.shape_[1];
+        Tensor<dtype> result({M, N});
+        const float* a = &left.data_[left.offset_];
+
+        // a transposed contiguous matrix, e.g. weight.transpose(0, 1) in Linear, is read in place as B^T.
+        // the blocking and thread count tuned for this shape, see Autotuner.hpp.
+        if (other.stride_[0] == 1 && other.stride_[1] == K) {
+            kernels::active().gemm_nt_f32(M, N, K, a, K, &other.data_[other.offset_], K, &result.data_[0], N,
+                                          tuner::gemm(M, N, K, true));
+        } else {
+            auto right = is_contiguous(other) ? other : other.contiguous();
+            kernels::active().gemm_f32(M, N, K, a, K, &right.data_[right.offset_], N, &result.data_[0], N,
+                                       tuner::gemm(M, N, K, false));
+        }
+        return result;
+    }
+
     auto right = is_contiguous(other) ? other : other.contiguous();
 
 
@@ -181,19 +240,22 @@ Tensor<dtype> Tensor<dtype>::matmul(const Tensor<dtype>& other) const {
     std::vector<int> result_shape = {left.shape_[0], right.shape_[1]};
     Tensor<dtype> result(result_shape);
 
-    // Parallelized matrix multiplication
-    #pragma omp parallel for collapse(2)
-    for (int i = 0; i < left.shape_[0]; ++i) {
-        for (int j = 0; j < right.shape_[1]; ++j) {
-            dtype sum = 0;
-            for (int k = 0; k < left.shape_[1]; ++k) {
-                // sum += left.getData({i, k}) * right.getData({k, j});
-                sum += left.data_[i * left.stride_[0] + k * left.stride_[1]] * right.data_[k * right.stride_[0] + j * right.stride_[1]];
+    // Parallelized matrix multiplication, rows of the result split over the thread pool.
+    int K = left.shape_[1];
+    parallel::parallel_for(0, left.shape_[0], std::max(1, (1 << 16) / std::max(1, K * right.shape_[1])),
+                           [&](int64_t begin, int64_t end) {
+        for (int i = (int)begin; i < (int)end; ++i) {
+            for (int j = 0; j < right.shape_[1]; ++j) {
+                dtype sum = 0;
+                for (int k = 0; k < K; ++k) {
+                    // sum += left.getData({i, k}) * right.getData({k, j});
+                    sum += left.data_[left.offset_ + i * left.stride_[0] + k * left.stride_[1]] * right.data_[right.offset_ + k * right.stride_[0] + j * right.stride_[1]];
+                }
+                // result.setData({i, j}, sum);
+                result.data_[i * result.stride_[0] + j * result.stride_[1]] = sum;
             }
-            // result.setData({i, j}, sum);
-            result.data_[i * result.stride_[0] + j * result.stride_[1]] = sum;
         }
-    }
+    });
 
     return result;
 }
@@ -208,18 +270,27 @@ Tensor<int> Tensor<dtype>::argmax(int dim, bool keepdim) const{
         throw std::invalid_argument("Only support 2d.");
     }
 
+    PROFILE_OP("argmax", (double)num_elements, (double)sizeof(dtype) * num_elements, &shape_);
+
     int reduce_shape = shape_[1 - dim];
     Tensor<int> result(std::vector<int>{reduce_shape});
 
     int off = stride_[1-dim];
     int stride = stride_[dim];
 
+    if constexpr (std::is_same<dtype, float>::value) {
+        if (stride == 1) {
+            kernels::active().argmax_rows_f32(&data_[offset_], reduce_shape, shape_[dim], off, &result.data_[0]);
+            return result;
+        }
+    }
+
     for (int i = 0; i < reduce_shape; ++i) {
         int max_index = 0;
-        dtype max_value = data_[i*off];
+        dtype max_value = data_[offset_ + i*off];
         for (int j = 0; j < shape_[dim]; ++j) {
-            if (data_[i*off + j*stride] > max_value) {
-                max_value = data_[i*off + j*stride];
+            if (data_[offset_ + i*off + j*stride] > max_value) {
+                max_value = data_[offset_ + i*off + j*stride];
                 max_index = j;
             }
         }
@@ -310,6 +381,11 @@ Tensor<dtype> Tensor<dtype>::view(const std::vector<int>& shape) const {
      * it maybe optimized it later.
      */
     Tensor<dtype> result(shape, this->data());
+    // a view of a slice starts where the slice does.
+    result.offset_ = this->offset_;
+    // and reads the same quantized values.
+    result.scale = this->scale;
+    result.zero_point = this->zero_point;
 
     return result;
 }
@@ -325,6 +401,12 @@ dtype Tensor<dtype>::sum(bool keepdim) const {
         throw std::invalid_argument("Only support 4d.");
     }
 
+    if constexpr (std::is_same<dtype, float>::value) {
+        if (is_contiguous(*this)) {
+            return kernels::active().sum_f32(&data_[offset_], num_elements);
+        }
+    }
+
     dtype sum = 0;
 
     if (shape_.size() == 4) {
@@ -444,8 +526,8 @@ Tensor<dtype> Tensor<dtype>::select(int dim, int index) const {
         }
     }
 
-    Tensor<dtype> result(new_shape);
-    result.data_ = this->data_;
+    // share data_ directly, the Tensor(shape) constructor would allocate a buffer just to drop it.
+    Tensor<dtype> result(new_shape, this->data_);
     result.offset_ = this->offset_ + this->stride_[dim] * index;
     result.stride_ = new_stride;
 
@@ -469,6 +551,8 @@ Tensor<dtype> Tensor<dtype>::contiguous() const {
         throw std::invalid_argument("only support 2d tensor now");
     }
 
+    PROFILE_OP("contiguous", 0, 2.0 * sizeof(dtype) * num_elements, &shape_);
+
     Tensor<dtype> result(this->shape());
 
     for (int i=0; i < this->shape()[0]; i++) {
@@ -502,10 +586,13 @@ Tensor<int> Tensor<dtype>::quantize() const {
         }
     }
 
-    result.scale = wmax / Q_MAX;
+    // an all zero tensor still gets a usable scale.
+    result.scale = wmax > 0 ? wmax / Q_MAX : 1.0f;
 
+    // round to nearest, truncating toward zero lost up to a whole step.
     for (int i=0; i < this->num_elements; i++) {
-        result.data_[i] = (int)(this->data_[i] / result.scale);
+        double q = std::nearbyint(this->data_[i] / result.scale);
+        result.data_[i] = (int)std::max(-127.0, std::min(127.0, q));
     }
 
     return result;
@@ -0,0 +1,415 @@
+#include "../include/ThreadPool.hpp"
+#include "../include/Numa.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace parallel {
+
+namespace {
+
+// chunks per participating thread, more leave room for stealing, fewer cost less to hand out.
+const int64_t CHUNKS_PER_THREAD = 4;
+
+thread_local ThreadPool* scoped_pool = nullptr;
+thread_local int thread_index = 0;
+// inside a chunk, a nested parallel_for runs inline.
+thread_local bool in_parallel = false;
+
+// a thread's run of chunks, [lo, hi) packed in one word so the owner (front) and the
+// thieves (back) can take chunks with a single compare-exchange.
+uint64_t pack(uint32_t lo, uint32_t hi) {
+    return (uint64_t)hi << 32 | lo;
+}
+
+bool popFront(std::atomic<uint64_t>& run, uint32_t& chunk) {
+    uint64_t value = run.load(std::memory_order_acquire);
+    while (true) {
+        uint32_t lo = (uint32_t)value, hi = (uint32_t)(value >> 32);
+        if (lo >= hi) {
+            return false;
+        }
+        if (run.compare_exchange_weak(value, pack(lo + 1, hi), std::memory_order_acq_rel)) {
+            chunk = lo;
+            return true;
+        }
+    }
+}
+
+bool popBack(std::atomic<uint64_t>& run, uint32_t& chunk) {
+    uint64_t value = run.load(std::memory_order_acquire);
+    while (true) {
+        uint32_t lo = (uint32_t)value, hi = (uint32_t)(value >> 32);
+        if (lo >= hi) {
+            return false;
+        }
+        if (run.compare_exchange_weak(value, pack(lo, hi - 1), std::memory_order_acq_rel)) {
+            chunk = hi - 1;
+            return true;
+        }
+    }
+}
+
+void pin(std::thread& thread, int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+    if (err != 0) {
+        std::cerr << "Warning: can't pin a worker thread to CPU " << cpu << std::endl;
+    }
+#else
+    (void)thread;
+    (void)cpu;
+#endif
+}
+
+int envInt(const char* name, int fallback) {
+    const char* env = std::getenv(name);
+    if (env == nullptr || *env == '\0') {
+        return fallback;
+    }
+    int value = std::atoi(env);
+    return value > 0 ? value : fallback;
+}
+
+std::unique_ptr<ThreadPool> makeDefaultPool(int num_threads) {
+    std::vector<int> cpus = availableCPUs();
+    if (num_threads <= 0) {
+        num_threads = envInt("TENSORLIB_NUM_THREADS", (int)cpus.size());
+    }
+    const char* env = std::getenv("TENSORLIB_PIN_THREADS");
+    if (env == nullptr || std::string(env) == "0") {
+        return std::make_unique<ThreadPool>(num_threads);
+    }
+
+    // scatter (the default) spreads the workers over the sockets, so a pool smaller than
+    // the machine still uses every memory controller, compact keeps them on as few as possible.
+    std::vector<std::vector<int>> cpus_by_node;
+    for (int node = 0; node < numa::nodeCount(); node++) {
+        cpus_by_node.push_back(numa::nodeCPUs(node));
+    }
+    cpus = numa::pinOrder(cpus_by_node, std::string(env) != "compact");
+    if (cpus.empty()) {
+        cpus = availableCPUs();
+    }
+    // worker i on the i-th CPU in that order, the first one is left to the main thread.
+    std::rotate(cpus.begin(), cpus.begin() + 1, cpus.end());
+    return std::make_unique<ThreadPool>(num_threads, cpus);
+}
+
+struct Default {
+    std::mutex mutex;
+    std::unique_ptr<ThreadPool> pool;
+    // pool once built, read without the mutex by every parallel_for and numThreads().
+    std::atomic<ThreadPool*> published{nullptr};
+};
+
+Default& defaults() {
+    static Default instance;
+    return instance;
+}
+
+} // namespace
+
+struct ThreadPool::Job {
+    RangeFunction fn;
+    void* context;
+    int64_t begin;
+    int64_t end;
+    int64_t chunk_size;
+    int participants;
+    // one run of chunks per participant, participant 0 is the calling thread.
+    std::unique_ptr<std::atomic<uint64_t>[]> runs;
+    // the next participant slot a worker can claim, under the pool mutex.
+    int next_slot = 1;
+    std::atomic<int64_t> remaining;
+    // workers that claimed a slot and did not finish yet, under mutex.
+    int inside = 0;
+    std::mutex mutex;
+    std::condition_variable done;
+    std::exception_ptr error;
+
+    void execute(uint32_t chunk) {
+        int64_t b = begin + (int64_t)chunk * chunk_size;
+        int64_t e = std::min(end, b + chunk_size);
+        try {
+            fn(context, b, e);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.notify_all();
+        }
+    }
+
+    // as participant slot: the own run first, then the others' from the back.
+    void work(int slot) {
+        bool was_in_parallel = in_parallel;
+        int prev_index = thread_index;
+        in_parallel = true;
+        thread_index = slot;
+
+        uint32_t chunk;
+        while (popFront(runs[slot], chunk)) {
+            execute(chunk);
+        }
+        bool stolen = true;
+        while (stolen) {
+            stolen = false;
+            for (int i = 1; i < participants; i++) {
+                int victim = (slot + i) % participants;
+                if (popBack(runs[victim], chunk)) {
+                    execute(chunk);
+                    stolen = true;
+                    break;
+                }
+            }
+        }
+
+        thread_index = prev_index;
+        in_parallel = was_in_parallel;
+    }
+};
+
+struct ThreadPool::State {
+    int size = 1;
+    bool pinned = false;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    // jobs with slots left to claim.
+    std::vector<Job*> jobs;
+    bool stop = false;
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&]() { return stop || !jobs.empty(); });
+            if (stop) {
+                return;
+            }
+
+            Job* job = jobs.front();
+            int slot = job->next_slot++;
+            if (job->next_slot >= job->participants) {
+                jobs.erase(jobs.begin());
+            }
+            {
+                std::lock_guard<std::mutex> job_lock(job->mutex);
+                job->inside++;
+            }
+            lock.unlock();
+
+            job->work(slot);
+
+            {
+                // the caller may free the job as soon as inside drops to 0 and the lock is released.
+                std::lock_guard<std::mutex> job_lock(job->mutex);
+                if (--job->inside == 0) {
+                    job->done.notify_all();
+                }
+            }
+            lock.lock();
+        }
+    }
+};
+
+ThreadPool::ThreadPool(int num_threads, const std::vector<int>& cpus) : state_(std::make_unique<State>()) {
+    state_->size = std::max(1, num_threads);
+    state_->pinned = !cpus.empty() && state_->size > 1;
+    for (int i = 1; i < state_->size; i++) {
+        state_->workers.emplace_back([this]() { state_->workerLoop(); });
+        if (!cpus.empty()) {
+            pin(state_->workers.back(), cpus[(i - 1) % cpus.size()]);
+        }
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->stop = true;
+    }
+    state_->wake.notify_all();
+    for (auto& worker : state_->workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::size() const {
+    return state_->size;
+}
+
+bool ThreadPool::pinned() const {
+    return state_->pinned;
+}
+
+void ThreadPool::run(int64_t begin, int64_t end, int64_t grain, RangeFunction fn, void* context, int max_threads) {
+    if (end <= begin) {
+        return;
+    }
+    grain = std::max<int64_t>(1, grain);
+    int64_t range = end - begin;
+    int64_t max_chunks = (range + grain - 1) / grain;
+    int64_t participants = std::min<int64_t>(max_chunks, max_threads > 0 ? std::min(max_threads, size()) : size());
+
+    if (participants <= 1 || in_parallel) {
+        int prev_index = thread_index;
+        bool was_in_parallel = in_parallel;
+        thread_index = 0;
+        in_parallel = true;
+        try {
+            fn(context, begin, end);
+        } catch (...) {
+            thread_index = prev_index;
+            in_parallel = was_in_parallel;
+            throw;
+        }
+        thread_index = prev_index;
+        in_parallel = was_in_parallel;
+        return;
+    }
+
+    int64_t chunks = std::min(max_chunks, participants * CHUNKS_PER_THREAD);
+    int64_t chunk_size = (range + chunks - 1) / chunks;
+    chunks = (range + chunk_size - 1) / chunk_size;
+
+    Job job;
+    job.fn = fn;
+    job.context = context;
+    job.begin = begin;
+    job.end = end;
+    job.chunk_size = chunk_size;
+    job.participants = (int)participants;
+    job.runs = std::make_unique<std::atomic<uint64_t>[]>(participants);
+    for (int64_t p = 0; p < participants; p++) {
+        job.runs[p].store(pack((uint32_t)(p * chunks / participants), (uint32_t)((p + 1) * chunks / participants)));
+    }
+    job.remaining.store(chunks);
+
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->jobs.push_back(&job);
+    }
+    state_->wake.notify_all();
+
+    job.work(0);
+
+    {
+        // slots nobody claimed yet have been emptied by work(0).
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        auto it = std::find(state_->jobs.begin(), state_->jobs.end(), &job);
+        if (it != state_->jobs.end()) {
+            state_->jobs.erase(it);
+        }
+    }
+    {
+        std::unique_lock<std::mutex> lock(job.mutex);
+        job.done.wait(lock, [&]() { return job.remaining.load() == 0 && job.inside == 0; });
+    }
+    if (job.error) {
+        std::rethrow_exception(job.error);
+    }
+}
+
+ThreadPool& defaultPool() {
+    Default& d = defaults();
+    if (ThreadPool* pool = d.published.load(std::memory_order_acquire)) {
+        return *pool;
+    }
+    std::lock_guard<std::mutex> lock(d.mutex);
+    if (!d.pool) {
+        d.pool = makeDefaultPool(0);
+        d.published.store(d.pool.get(), std::memory_order_release);
+    }
+    return *d.pool;
+}
+
+ThreadPool& current() {
+    return scoped_pool != nullptr ? *scoped_pool : defaultPool();
+}
+
+void setNumThreads(int num_threads) {
+    Default& d = defaults();
+    std::lock_guard<std::mutex> lock(d.mutex);
+    if (d.pool && d.pool->size() == num_threads) {
+        return;
+    }
+    d.published.store(nullptr, std::memory_order_release);
+    d.pool.reset();
+    d.pool = makeDefaultPool(std::max(1, num_threads));
+    d.published.store(d.pool.get(), std::memory_order_release);
+}
+
+void restartDefaultPool() {
+    Default& d = defaults();
+    std::lock_guard<std::mutex> lock(d.mutex);
+    if (!d.pool) {
+        return;
+    }
+    int num_threads = d.pool->size();
+    d.published.store(nullptr, std::memory_order_release);
+    d.pool.reset();
+    d.pool = makeDefaultPool(num_threads);
+    d.published.store(d.pool.get(), std::memory_order_release);
+}
+
+int numThreads() {
+    return current().size();
+}
+
+int threadIndex() {
+    return thread_index;
+}
+
+std::vector<int> availableCPUs() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        int count = std::max(1u, std::thread::hardware_concurrency());
+        for (int cpu = 0; cpu < count; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+PoolScope::PoolScope(ThreadPool& pool) : previous_(scoped_pool) {
+    scoped_pool = &pool;
+}
+
+PoolScope::~PoolScope() {
+    scoped_pool = previous_;
+}
+
+void run(int64_t begin, int64_t end, int64_t grain, RangeFunction fn, void* context, int max_threads) {
+    current().run(begin, end, grain, fn, context, max_threads);
+}
+
+} // namespace parallel
@@ -0,0 +1,607 @@
+/**
+ * Kernel implementations, compiled once per ISA (see CMakeLists.txt) with
+ * TENSORLIB_KERNEL_ISA set to the namespace of the copy: scalar, sse42, avx2, avx512.
+ *
+ * The loops are plain C++ shaped for the auto-vectorizer (unit stride inner loops,
+ * omp simd reductions), the -m flags of each copy decide the vector width.
+ *
+ * Keep every helper static and do not call inline library functions (std::max,
+ * std::vector ...) here: an inline function emitted by the AVX-512 copy could be picked
+ * by the linker for the whole program and fault on CPUs without AVX-512. The
+ * parallel_for / parallel_reduce templates are fine, they are instantiated on this
+ * file's own lambdas only.
+ */
+#include "../../include/Kernels.hpp"
+#include "../../include/ThreadPool.hpp"
+
+#ifndef TENSORLIB_KERNEL_ISA
+#error "TENSORLIB_KERNEL_ISA must name the ISA this copy is compiled for"
+#endif
+
+#define KERNELS_STRINGIFY_INNER(x) #x
+#define KERNELS_STRINGIFY(x) KERNELS_STRINGIFY_INNER(x)
+
+namespace kernels {
+namespace TENSORLIB_KERNEL_ISA {
+
+// below this many multiply-adds a kernel stays on the calling thread.
+static const long PARALLEL_WORK = 1L << 16;
+
+// iterations per chunk for iterations of item_work multiply-adds each.
+static inline int64_t grainFor(long item_work) {
+    return item_work >= PARALLEL_WORK ? 1 : (PARALLEL_WORK + item_work - 1) / item_work;
+}
+
+// default GEMM blocking: KC rows of B (x NC columns) are reused from cache across MC rows of A.
+static const int MC = 64;
+static const int KC = 256;
+static const int NC = 512;
+
+static inline int minInt(int a, int b) {
+    return a < b ? a : b;
+}
+
+static void gemm_f32(int M, int N, int K, const float* A, int lda, const float* B, int ldb, float* C, int ldc,
+                     const GemmConfig& config) {
+    long work = (long)M * N * K;
+    int mc = config.mc > 0 ? config.mc : MC;
+    int kc = config.kc > 0 ? config.kc : KC;
+    int nc = config.nc > 0 ? config.nc : NC;
+
+    int m_blocks = (M + mc - 1) / mc;
+    int n_blocks = (N + nc - 1) / nc;
+    int blocks = m_blocks * n_blocks;
+
+    // each (row block, column block) of C is owned by one thread.
+    parallel::parallel_for(0, blocks, grainFor(work / blocks), [&](int64_t block_begin, int64_t block_end) {
+        for (int64_t block = block_begin; block < block_end; ++block) {
+            int ib = (int)(block / n_blocks);
+            int jb = (int)(block % n_blocks);
+            int i_end = minInt(M, (ib + 1) * mc);
+            int j0 = jb * nc;
+            int j_len = minInt(N, j0 + nc) - j0;
+
+            for (int i = ib * mc; i < i_end; ++i) {
+                float* c = C + (size_t)i * ldc + j0;
+                for (int j = 0; j < j_len; ++j) {
+                    c[j] = 0;
+                }
+            }
+
+            for (int k0 = 0; k0 < K; k0 += kc) {
+                int k_end = minInt(K, k0 + kc);
+                for (int i = ib * mc; i < i_end; ++i) {
+                    float* c = C + (size_t)i * ldc + j0;
+                    const float* a = A + (size_t)i * lda;
+                    for (int k = k0; k < k_end; ++k) {
+                        float a_ik = a[k];
+                        const float* b = B + (size_t)k * ldb + j0;
+                        #pragma omp simd
+                        for (int j = 0; j < j_len; ++j) {
+                            c[j] += a_ik * b[j];
+                        }
+                    }
+                }
+            }
+        }
+    }, config.threads);
+}
+
+// the B^T kernels go over the flattened (i, j) elements of C, one dot product each.
+static void gemm_nt_f32(int M, int N, int K, const float* A, int lda, const float* B, int ldb, float* C, int ldc,
+                        const GemmConfig& config) {
+    parallel::parallel_for(0, (int64_t)M * N, grainFor(K), [&](int64_t begin, int64_t end) {
+        for (int64_t t = begin; t < end; ++t) {
+            int i = (int)(t / N), j = (int)(t % N);
+            const float* a = A + (size_t)i * lda;
+            const float* b = B + (size_t)j * ldb;
+            float sum = 0;
+            #pragma omp simd reduction(+:sum)
+            for (int k = 0; k < K; ++k) {
+                sum += a[k] * b[k];
+            }
+            C[(size_t)i * ldc + j] = sum;
+        }
+    }, config.threads);
+}
+
+static void gemm_nt_u8f32(int M, int N, int K, const uint8_t* A, int lda, const float* B, int ldb,
+                          float* C, int ldc, float scale) {
+    parallel::parallel_for(0, (int64_t)M * N, grainFor(K), [&](int64_t begin, int64_t end) {
+        for (int64_t t = begin; t < end; ++t) {
+            int i = (int)(t / N), j = (int)(t % N);
+            const uint8_t* a = A + (size_t)i * lda;
+            const float* b = B + (size_t)j * ldb;
+            float sum = 0;
+            #pragma omp simd reduction(+:sum)
+            for (int k = 0; k < K; ++k) {
+                sum += static_cast<float>(a[k]) * b[k];
+            }
+            C[(size_t)i * ldc + j] = sum * scale;
+        }
+    });
+}
+
+static void gemm_nt_u8i32(int M, int N, int K, const uint8_t* A, int lda, const int32_t* B, int ldb,
+                          int32_t* C, int ldc) {
+    parallel::parallel_for(0, (int64_t)M * N, grainFor(K), [&](int64_t begin, int64_t end) {
+        for (int64_t t = begin; t < end; ++t) {
+            int i = (int)(t / N), j = (int)(t % N);
+            const uint8_t* a = A + (size_t)i * lda;
+            const int32_t* b = B + (size_t)j * ldb;
+            int32_t sum = 0;
+            #pragma omp simd reduction(+:sum)
+            for (int k = 0; k < K; ++k) {
+                sum += static_cast<int32_t>(a[k]) * b[k];
+            }
+            C[(size_t)i * ldc + j] = sum;
+        }
+    });
+}
+
+// four weight rows per pass over a row of A, the products widened to int32 (at most
+// 255 * 128 each, so K up to 65k can't overflow).
+static void gemm_nt_u8s8i32(int M, int N, int K, const uint8_t* A, int lda, const int8_t* B, int ldb,
+                            int32_t* C, int ldc) {
+    const int NB = 4;
+    int col_blocks = (N + NB - 1) / NB;
+    parallel::parallel_for(0, (int64_t)M * col_blocks, grainFor((long)K * NB), [&](int64_t begin, int64_t end) {
+        for (int64_t t = begin; t < end; ++t) {
+            int i = (int)(t / col_blocks), j0 = (int)(t % col_blocks) * NB;
+            const uint8_t* a = A + (size_t)i * lda;
+            if (j0 + NB <= N) {
+                const int8_t* b0 = B + (size_t)j0 * ldb;
+                const int8_t* b1 = b0 + ldb;
+                const int8_t* b2 = b1 + ldb;
+                const int8_t* b3 = b2 + ldb;
+                int32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+                #pragma omp simd reduction(+:s0, s1, s2, s3)
+                for (int k = 0; k < K; ++k) {
+                    int32_t x = a[k];
+                    s0 += x * b0[k];
+                    s1 += x * b1[k];
+                    s2 += x * b2[k];
+                    s3 += x * b3[k];
+                }
+                int32_t* c = C + (size_t)i * ldc + j0;
+                c[0] = s0;
+                c[1] = s1;
+                c[2] = s2;
+                c[3] = s3;
+                continue;
+            }
+            for (int j = j0; j < N; ++j) {
+                const int8_t* b = B + (size_t)j * ldb;
+                int32_t sum = 0;
+                #pragma omp simd reduction(+:sum)
+                for (int k = 0; k < K; ++k) {
+                    sum += static_cast<int32_t>(a[k]) * b[k];
+                }
+                C[(size_t)i * ldc + j] = sum;
+            }
+        }
+    });
+}
+
+// four weight rows of a row of A in lanes of L floats: every lane keeps a partial sum
+// over the whole row with the group's scale applied, so a group costs no horizontal sum
+// and the four rows share the loads of A. the zero points come off once per group,
+// times the sum of A over the group. rows past N repeat the last one and are dropped.
+template <int L>
+static void gemm_nt_f32_u4_block(const float* a_row, const uint8_t* B, int ldb, const float* scales,
+                                 const int32_t* zero_points, int G, int half, int j0, int rows, float* c) {
+    const int NB = 4;
+    float part[NB][L] = {};
+    float zero_terms[NB] = {};
+    const uint8_t* b[NB];
+    size_t wg[NB];
+    for (int r = 0; r < NB; ++r) {
+        int j = j0 + minInt(r, rows - 1);
+        b[r] = B + (size_t)j * ldb;
+        wg[r] = (size_t)j * G;
+    }
+    for (int g = 0; g < G; ++g) {
+        const float* a_lo = a_row + (size_t)g * 2 * half;
+        const float* a_hi = a_lo + half;
+        float s0 = scales[wg[0] + g], s1 = scales[wg[1] + g], s2 = scales[wg[2] + g], s3 = scales[wg[3] + g];
+        const size_t off = (size_t)g * half;
+        float a_sum = 0.0f;
+        for (int k0 = 0; k0 < half; k0 += L) {
+            #pragma omp simd reduction(+:a_sum)
+            for (int l = 0; l < L; ++l) {
+                int k = k0 + l;
+                float lo = a_lo[k], hi = a_hi[k];
+                uint8_t v0 = b[0][off + k], v1 = b[1][off + k], v2 = b[2][off + k], v3 = b[3][off + k];
+                part[0][l] += s0 * (lo * (float)(v0 & 0x0F) + hi * (float)(v0 >> 4));
+                part[1][l] += s1 * (lo * (float)(v1 & 0x0F) + hi * (float)(v1 >> 4));
+                part[2][l] += s2 * (lo * (float)(v2 & 0x0F) + hi * (float)(v2 >> 4));
+                part[3][l] += s3 * (lo * (float)(v3 & 0x0F) + hi * (float)(v3 >> 4));
+                a_sum += lo + hi;
+            }
+        }
+        for (int r = 0; r < NB; ++r) {
+            zero_terms[r] += scales[wg[r] + g] * (float)zero_points[wg[r] + g] * a_sum;
+        }
+    }
+    for (int r = 0; r < rows; ++r) {
+        float sum = 0.0f;
+        for (int l = 0; l < L; ++l) {
+            sum += part[r][l];
+        }
+        c[r] = sum - zero_terms[r];
+    }
+}
+
+// within a group byte t holds columns t and t + group_size / 2, both halves of A are read
+// contiguously. lanes of 16 or 8 when half a group is a multiple of them, else one.
+static void gemm_nt_f32_u4(int M, int N, int K, const float* A, int lda, const uint8_t* B, int ldb,
+                           const float* scales, const int32_t* zero_points, int group_size, float* C, int ldc) {
+    const int NB = 4;
+    const int G = K / group_size, half = group_size / 2;
+    int col_blocks = (N + NB - 1) / NB;
+    parallel::parallel_for(0, (int64_t)M * col_blocks, grainFor((long)K * NB), [&](int64_t begin, int64_t end) {
+        for (int64_t t = begin; t < end; ++t) {
+            int i = (int)(t / col_blocks), j0 = (int)(t % col_blocks) * NB;
+            int rows = minInt(NB, N - j0);
+            const float* a_row = A + (size_t)i * lda;
+            float* c = C + (size_t)i * ldc + j0;
+            if (half % 16 == 0) {
+                gemm_nt_f32_u4_block<16>(a_row, B, ldb, scales, zero_points, G, half, j0, rows, c);
+            } else if (half % 8 == 0) {
+                gemm_nt_f32_u4_block<8>(a_row, B, ldb, scales, zero_points, G, half, j0, rows, c);
+            } else {
+                gemm_nt_f32_u4_block<1>(a_row, B, ldb, scales, zero_points, G, half, j0, rows, c);
+            }
+        }
+    });
+}
+
+// one block row of W against up to MR rows of A, which share every block of weights
+// read. each product of a block gets its own accumulator lane, summed once at the end, and
+// 1x1 blocks go U at a time, so no block waits on the add of the one before.
+template <int BR, int BC>
+static void spmm_nt_f32_block(const float* a, int lda, int m, const int32_t* col_idx, const float* values,
+                              int begin, int end, float* c, int ldc, int rows) {
+    const int MR = 4, U = BC == 1 ? 4 : 1, L = U * BC;
+    float acc[MR][BR][L] = {};
+    int b = begin;
+    for (; b + U <= end; b += U) {
+        const float* v = values + (size_t)b * BR * BC;
+        for (int i = 0; i < m; ++i) {
+            const float* a_i = a + (size_t)i * lda;
+            float x[L];
+            for (int u = 0; u < U; ++u) {
+                for (int q = 0; q < BC; ++q) {
+                    x[u * BC + q] = a_i[col_idx[b + u] + q];
+                }
+            }
+            for (int p = 0; p < BR; ++p) {
+                for (int l = 0; l < L; ++l) {
+                    // lane l is product q = l % BC of block u = l / BC.
+                    acc[i][p][l] += v[(l / BC) * BR * BC + p * BC + l % BC] * x[l];
+                }
+            }
+        }
+    }
+    for (; b < end; ++b) {
+        const float* v = values + (size_t)b * BR * BC;
+        for (int i = 0; i < m; ++i) {
+            const float* a_i = a + (size_t)i * lda + col_idx[b];
+            for (int p = 0; p < BR; ++p) {
+                for (int q = 0; q < BC; ++q) {
+                    acc[i][p][q] += v[p * BC + q] * a_i[q];
+                }
+            }
+        }
+    }
+    for (int i = 0; i < m; ++i) {
+        for (int p = 0; p < rows; ++p) {
+            float sum = 0.0f;
+            for (int l = 0; l < L; ++l) {
+                sum += acc[i][p][l];
+            }
+            c[(size_t)i * ldc + p] = sum;
+        }
+    }
+}
+
+// work items of MR rows of A times one block row of W, the block rows of one tile of A
+// next to each other. a single row of A (batch 1) is split over the block rows.
+static void spmm_nt_f32(int M, int N, const float* A, int lda, const int32_t* row_ptr, const int32_t* col_idx,
+                        const float* values, int block_rows, int block_cols, float* C, int ldc) {
+    const int MR = 4;
+    if (M <= 0 || N <= 0) {
+        return;
+    }
+    int tiles = (M + MR - 1) / MR, R = (N + block_rows - 1) / block_rows;
+    long item_work = (long)row_ptr[R] * block_rows * block_cols / R * MR;
+    parallel::parallel_for(0, (int64_t)tiles * R, grainFor(item_work > 0 ? item_work : 1),
+                           [&](int64_t begin, int64_t end) {
+        for (int64_t t = begin; t < end; ++t) {
+            int i0 = (int)(t / R) * MR, r = (int)(t % R);
+            int m = minInt(MR, M - i0), rows = minInt(block_rows, N - r * block_rows);
+            const float* a = A + (size_t)i0 * lda;
+            float* c = C + (size_t)i0 * ldc + (size_t)r * block_rows;
+            if (block_rows == 1 && block_cols == 1) {
+                spmm_nt_f32_block<1, 1>(a, lda, m, col_idx, values, row_ptr[r], row_ptr[r + 1], c, ldc, rows);
+            } else if (block_rows == 1) {
+                spmm_nt_f32_block<1, 4>(a, lda, m, col_idx, values, row_ptr[r], row_ptr[r + 1], c, ldc, rows);
+            } else {
+                spmm_nt_f32_block<4, 4>(a, lda, m, col_idx, values, row_ptr[r], row_ptr[r + 1], c, ldc, rows);
+            }
+        }
+    });
+}
+
+static void im2col_f32(const float* input, int C, int H, int W, int kernel, int stride, int padding, float* columns) {
+    int H_out = (H + 2 * padding - kernel) / stride + 1;
+    int W_out = (W + 2 * padding - kernel) / stride + 1;
+
+    for (int c = 0; c < C; ++c) {
+        for (int kh = 0; kh < kernel; ++kh) {
+            for (int kw = 0; kw < kernel; ++kw) {
+                float* col = columns + ((size_t)(c * kernel + kh) * kernel + kw) * H_out * W_out;
+                for (int oh = 0; oh < H_out; ++oh) {
+                    int h = oh * stride - padding + kh;
+                    float* col_row = col + (size_t)oh * W_out;
+                    if (h < 0 || h >= H) {
+                        for (int ow = 0; ow < W_out; ++ow) {
+                            col_row[ow] = 0;
+                        }
+                        continue;
+                    }
+                    const float* in_row = input + ((size_t)c * H + h) * W;
+                    for (int ow = 0; ow < W_out; ++ow) {
+                        int w = ow * stride - padding + kw;
+                        col_row[ow] = (w >= 0 && w < W) ? in_row[w] : 0.0f;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void im2row_u8(const uint8_t* input, int C, int H, int W, int kernel, int stride, int padding, uint8_t pad,
+                      uint8_t flip, uint8_t* rows) {
+    int H_out = (H + 2 * padding - kernel) / stride + 1;
+    int W_out = (W + 2 * padding - kernel) / stride + 1;
+    size_t patch = (size_t)C * kernel * kernel;
+
+    for (int oh = 0; oh < H_out; ++oh) {
+        for (int ow = 0; ow < W_out; ++ow) {
+            uint8_t* row = rows + ((size_t)oh * W_out + ow) * patch;
+            for (int c = 0; c < C; ++c) {
+                for (int kh = 0; kh < kernel; ++kh) {
+                    int h = oh * stride - padding + kh;
+                    uint8_t* out = row + ((size_t)c * kernel + kh) * kernel;
+                    if (h < 0 || h >= H) {
+                        for (int kw = 0; kw < kernel; ++kw) {
+                            out[kw] = pad;
+                        }
+                        continue;
+                    }
+                    const uint8_t* in_row = input + ((size_t)c * H + h) * W;
+                    for (int kw = 0; kw < kernel; ++kw) {
+                        int w = ow * stride - padding + kw;
+                        out[kw] = (w >= 0 && w < W) ? (uint8_t)(in_row[w] ^ flip) : pad;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void conv2d_direct_f32(const float* input, int C_in, int H, int W, const float* weight, int C_out,
+                              int kernel, int stride, int padding, float* output) {
+    int H_out = (H + 2 * padding - kernel) / stride + 1;
+    int W_out = (W + 2 * padding - kernel) / stride + 1;
+
+    for (int co = 0; co < C_out; ++co) {
+        float* out = output + (size_t)co * H_out * W_out;
+        for (int i = 0; i < H_out * W_out; ++i) {
+            out[i] = 0;
+        }
+        // accumulate one weight at a time over a whole output row, the inner loop is unit stride for stride 1.
+        for (int ci = 0; ci < C_in; ++ci) {
+            const float* in = input + (size_t)ci * H * W;
+            for (int kh = 0; kh < kernel; ++kh) {
+                for (int kw = 0; kw < kernel; ++kw) {
+                    float w_val = weight[((size_t)(co * C_in + ci) * kernel + kh) * kernel + kw];
+                    for (int oh = 0; oh < H_out; ++oh) {
+                        int h = oh * stride - padding + kh;
+                        if (h < 0 || h >= H) {
+                            continue;
+                        }
+                        // output columns whose input column lies inside the image.
+                        int ow_begin = 0;
+                        while (ow_begin < W_out && ow_begin * stride - padding + kw < 0) ow_begin++;
+                        int ow_end = W_out;
+                        while (ow_end > ow_begin && (ow_end - 1) * stride - padding + kw >= W) ow_end--;
+
+                        const float* in_row = in + (size_t)h * W;
+                        float* out_row = out + (size_t)oh * W_out;
+                        #pragma omp simd
+                        for (int ow = ow_begin; ow < ow_end; ++ow) {
+                            out_row[ow] += w_val * in_row[ow * stride - padding + kw];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void conv2d_nchwc_f32(const float* input, int C_in, int H, int W, int in_lanes, const float* weight,
+                             int C_out, int kernel, int stride, int padding, float* output) {
+    const int B = CONV_BLOCK;
+    int H_out = (H + 2 * padding - kernel) / stride + 1;
+    int W_out = (W + 2 * padding - kernel) / stride + 1;
+
+    for (int cb = 0; cb < C_out / B; ++cb) {
+        float* out = output + (size_t)cb * H_out * W_out * B;
+        const float* w_block = weight + (size_t)cb * C_in * kernel * kernel * B;
+        for (int oh = 0; oh < H_out; ++oh) {
+            for (int ow = 0; ow < W_out; ++ow) {
+                // the B output channels of the block are one vector, each input pixel is
+                // broadcast against B weights.
+                float acc[CONV_BLOCK];
+                #pragma omp simd
+                for (int j = 0; j < B; ++j) {
+                    acc[j] = 0;
+                }
+                for (int ci = 0; ci < C_in; ++ci) {
+                    const float* in = input + (size_t)(ci / in_lanes) * H * W * in_lanes + ci % in_lanes;
+                    const float* w_ci = w_block + (size_t)ci * kernel * kernel * B;
+                    for (int kh = 0; kh < kernel; ++kh) {
+                        int h = oh * stride - padding + kh;
+                        if (h < 0 || h >= H) {
+                            continue;
+                        }
+                        for (int kw = 0; kw < kernel; ++kw) {
+                            int w = ow * stride - padding + kw;
+                            if (w < 0 || w >= W) {
+                                continue;
+                            }
+                            float x = in[((size_t)h * W + w) * in_lanes];
+                            const float* w_tap = w_ci + (kh * kernel + kw) * B;
+                            #pragma omp simd
+                            for (int j = 0; j < B; ++j) {
+                                acc[j] += x * w_tap[j];
+                            }
+                        }
+                    }
+                }
+                float* o = out + ((size_t)oh * W_out + ow) * B;
+                #pragma omp simd
+                for (int j = 0; j < B; ++j) {
+                    o[j] = acc[j];
+                }
+            }
+        }
+    }
+}
+
+static void maxpool2d_f32(const float* x, int C, int H, int W, int lanes, int kernel, int stride, float floor,
+                          float* y) {
+    int H_out = (H - kernel) / stride + 1;
+    int W_out = (W - kernel) / stride + 1;
+    parallel::parallel_for(0, C, grainFor((long)H_out * W_out * kernel * kernel * lanes),
+                           [&](int64_t begin, int64_t end) {
+        for (int64_t c = begin; c < end; ++c) {
+            const float* in = x + (size_t)c * H * W * lanes;
+            float* out = y + (size_t)c * H_out * W_out * lanes;
+            for (int oh = 0; oh < H_out; ++oh) {
+                for (int ow = 0; ow < W_out; ++ow) {
+                    float* o = out + ((size_t)oh * W_out + ow) * lanes;
+                    for (int l = 0; l < lanes; ++l) {
+                        o[l] = floor;
+                    }
+                    for (int kh = 0; kh < kernel; ++kh) {
+                        for (int kw = 0; kw < kernel; ++kw) {
+                            const float* p = in + ((size_t)(oh * stride + kh) * W + ow * stride + kw) * lanes;
+                            #pragma omp simd
+                            for (int l = 0; l < lanes; ++l) {
+                                o[l] = p[l] > o[l] ? p[l] : o[l];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+static float sum_f32(const float* x, size_t n) {
+    return parallel::parallel_reduce((int64_t)0, (int64_t)n, PARALLEL_WORK, 0.0f,
+        [&](int64_t begin, int64_t end) {
+            float sum = 0;
+            #pragma omp simd reduction(+:sum)
+            for (int64_t i = begin; i < end; ++i) {
+                sum += x[i];
+            }
+            return sum;
+        },
+        [](float a, float b) { return a + b; });
+}
+
+static void argmax_rows_f32(const float* x, int rows, int cols, int ld, int32_t* out) {
+    parallel::parallel_for(0, rows, grainFor(cols), [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+            const float* row = x + (size_t)i * ld;
+            int max_index = 0;
+            float max_value = row[0];
+            for (int j = 1; j < cols; ++j) {
+                if (row[j] > max_value) {
+                    max_value = row[j];
+                    max_index = j;
+                }
+            }
+            out[i] = max_index;
+        }
+    });
+}
+
+// the element-wise kernels are split like the GEMMs' rows, so with first-touch placement
+// (Numa.hpp) each worker writes the pages on its own node.
+static void maximum_f32(const float* x, float s, float* y, size_t n) {
+    parallel::parallel_for(0, (int64_t)n, PARALLEL_WORK, [&](int64_t begin, int64_t end) {
+        #pragma omp simd
+        for (int64_t i = begin; i < end; ++i) {
+            y[i] = x[i] > s ? x[i] : s;
+        }
+    });
+}
+
+static void scale_u8_f32(const uint8_t* x, float scale, float* y, size_t n) {
+    parallel::parallel_for(0, (int64_t)n, PARALLEL_WORK, [&](int64_t begin, int64_t end) {
+        #pragma omp simd
+        for (int64_t i = begin; i < end; ++i) {
+            y[i] = static_cast<float>(x[i]) * scale;
+        }
+    });
+}
+
+static void bias_add_f32(float* y, int rows, int cols, const float* bias, bool per_row) {
+    parallel::parallel_for(0, rows, grainFor(cols), [&](int64_t begin, int64_t end) {
+        for (int64_t r = begin; r < end; ++r) {
+            float* row = y + (size_t)r * cols;
+            if (per_row) {
+                float b = bias[r];
+                #pragma omp simd
+                for (int c = 0; c < cols; ++c) {
+                    row[c] += b;
+                }
+            } else {
+                #pragma omp simd
+                for (int c = 0; c < cols; ++c) {
+                    row[c] += bias[c];
+                }
+            }
+        }
+    });
+}
+
+extern const KernelTable table;
+const KernelTable table = {
+    KERNELS_STRINGIFY(TENSORLIB_KERNEL_ISA),
+    gemm_f32,
+    gemm_nt_f32,
+    gemm_nt_u8f32,
+    gemm_nt_u8i32,
+    gemm_nt_u8s8i32,
+    gemm_nt_f32_u4,
+    spmm_nt_f32,
+    im2col_f32,
+    im2row_u8,
+    conv2d_direct_f32,
+    conv2d_nchwc_f32,
+    maxpool2d_f32,
+    sum_f32,
+    argmax_rows_f32,
+    maximum_f32,
+    scale_u8_f32,
+    bias_add_f32,
+};
+
+} // namespace TENSORLIB_KERNEL_ISA
+} // namespace kernels
@@ -0,0 +1,112 @@
+#include "../../include/nn/Calibration.hpp"
+#include "../../include/nn/QuantizedConv2d.hpp"
+#include "../../include/nn/QuantizedLinear.hpp"
+#include "../../include/Memory.hpp"
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+namespace nn {
+
+namespace {
+
+// the observers of one layer, only used for the quantized ones.
+struct Observed {
+    QuantizedLinear* linear = nullptr;
+    QuantizedConv2d* conv = nullptr;
+    quant::Observer input;
+    quant::Observer output;
+
+    explicit Observed(int bins) : input(bins), output(bins) {}
+
+    bool quantized() const {
+        return linear != nullptr || conv != nullptr;
+    }
+};
+
+// the output of layer for input, with scratch of its own.
+template <typename Input, typename... Scale>
+Tensor<float> runLayer(Module<float>& layer, const Input& input, Scale... input_scale) {
+    Tensor<float> output(layer.outputShape(input.shape()));
+    std::shared_ptr<float[]> workspace;
+    size_t scratch = std::is_same<Input, Tensor<uint8_t>>::value ? layer.uint8WorkspaceSize(input.shape())
+                                                                 : layer.workspaceSize(input.shape());
+    if (scratch > 0) {
+        workspace = memory::allocate<float>(scratch);
+    }
+    layer.forward_into(input, input_scale..., output, workspace.get());
+    return output;
+}
+
+template <typename Input, typename... Scale>
+int calibrateBatches(Sequential<float>& model, const std::vector<Input>& batches, const CalibrationConfig& config,
+                     Scale... input_scale) {
+    if (model.size() == 0) {
+        throw std::invalid_argument("calibrate: the model has no layers");
+    }
+    std::vector<Observed> layers;
+    for (size_t i = 0; i < model.size(); i++) {
+        layers.emplace_back(config.bins);
+        layers[i].linear = dynamic_cast<QuantizedLinear*>(&model[i]);
+        layers[i].conv = dynamic_cast<QuantizedConv2d*>(&model[i]);
+    }
+
+    // one layer at a time, each activation a Tensor of its own so the observers see
+    // every one of them (the arena of Sequential::forward reuses their memory).
+    for (const Input& batch : batches) {
+        if constexpr (std::is_same<Input, Tensor<float>>::value) {
+            if (layers[0].quantized()) {
+                layers[0].input.observe(batch);
+            }
+        }
+        Tensor<float> x = runLayer(model[0], batch, input_scale...);
+        for (size_t i = 0; i < model.size(); i++) {
+            if (i > 0) {
+                if (layers[i].quantized()) {
+                    layers[i].input.observe(x);
+                }
+                x = runLayer(model[i], x);
+            }
+            if (layers[i].quantized()) {
+                layers[i].output.observe(x);
+            }
+        }
+    }
+
+    // uint8 in, as the integer GEMM takes it, and int8 out.
+    int calibrated = 0;
+    for (Observed& l : layers) {
+        if (!l.quantized() || l.output.count() == 0) {
+            continue;
+        }
+        quant::Params out = l.output.params(config.method, -128, 127, false, config.percentile);
+        if (l.linear != nullptr) {
+            l.linear->setOutputParams(out);
+        } else {
+            l.conv->setOutputParams(out);
+        }
+        if (l.input.count() > 0) {
+            quant::Params in = l.input.params(config.method, 0, 255, false, config.percentile);
+            if (l.linear != nullptr) {
+                l.linear->setInputParams(in);
+            } else {
+                l.conv->setInputParams(in);
+            }
+        }
+        calibrated++;
+    }
+    return calibrated;
+}
+
+} // namespace
+
+int calibrate(Sequential<float>& model, const std::vector<Tensor<float>>& batches, const CalibrationConfig& config) {
+    return calibrateBatches(model, batches, config);
+}
+
+int calibrate(Sequential<float>& model, const std::vector<Tensor<uint8_t>>& batches, float input_scale,
+              const CalibrationConfig& config) {
+    return calibrateBatches(model, batches, config, input_scale);
+}
+
+} // namespace nn
@@ -0,0 +1,897 @@
+#include "../../include/nn/Graph.hpp"
+#include "../../include/Autotuner.hpp"
+#include "../../include/Kernels.hpp"
+#include "../../include/Memory.hpp"
+#include "../../include/MemoryPlan.hpp"
+#include "../../include/Profiler.hpp"
+#include "../../include/ThreadPool.hpp"
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace nn {
+
+namespace {
+
+enum class Op { Input, Constant, Conv2d, MatMul, ReLU, MaxPool2d, View, Transpose, Reorder };
+
+enum class Layout { NCHW, NCHWc };
+
+const char* opName(Op op) {
+    switch (op) {
+        case Op::Input: return "input";
+        case Op::Constant: return "constant";
+        case Op::Conv2d: return "conv2d";
+        case Op::MatMul: return "matmul";
+        case Op::ReLU: return "relu";
+        case Op::MaxPool2d: return "maxpool2d";
+        case Op::View: return "view";
+        case Op::Transpose: return "transpose";
+        default: return "reorder";
+    }
+}
+
+size_t product(const std::vector<int>& shape) {
+    size_t n = 1;
+    for (int dim : shape) {
+        n *= dim;
+    }
+    return n;
+}
+
+std::string shapeString(const std::vector<int>& shape) {
+    std::string s = "(";
+    for (size_t i = 0; i < shape.size(); i++) {
+        s += (i > 0 ? ", " : "") + std::to_string(shape[i]);
+    }
+    return s + ")";
+}
+
+int outSize(int size, int kernel, int stride, int padding) {
+    return (size + 2 * padding - kernel) / stride + 1;
+}
+
+struct NodeData {
+    Op op;
+    std::vector<int> inputs;
+    // Conv2d, MaxPool2d
+    int kernel = 0;
+    int stride = 1;
+    int padding = 0;
+    // View
+    std::vector<int> view_shape;
+    // MatMul: b given as (N, K)
+    bool transposed_b = false;
+    // fused epilogues of Conv2d and MatMul
+    bool relu = false;
+    int pool = 0;
+    int pool_stride = 0;
+    // of the output
+    Layout layout = Layout::NCHW;
+    // Constant
+    std::shared_ptr<Tensor<float>> value;
+    // Conv2d in NCHWc: the weight as (C_out / CONV_BLOCK, C_in, K, K, CONV_BLOCK)
+    std::shared_ptr<Tensor<float>> packed;
+};
+
+// a value during a run: where it is and how it is laid out.
+struct Slot {
+    float* data = nullptr;
+    std::vector<int> shape;
+    Layout layout = Layout::NCHW;
+};
+
+} // namespace
+
+struct Graph::Node : NodeData {};
+
+struct Graph::Plan {
+    std::vector<int> input_shape;
+    bool input_u8 = false;
+    int threads = 0;
+    // the executed nodes, in order.
+    std::vector<Value> steps;
+    std::vector<Slot> slots;
+    std::vector<float*> workspaces;
+    std::vector<kernels::ConvConfig> configs;
+    // the tuned blocking of each matmul, looked up once per plan.
+    std::vector<kernels::GemmConfig> gemm_configs;
+    // arena buffer of each node, -1 for constants, views and the float input.
+    std::vector<int> buffers;
+    std::shared_ptr<float[]> arena;
+    size_t arena_capacity = 0;
+    size_t arena_bytes = 0;
+    // a view of the output's buffer, or its own storage when the output is not in the
+    // arena (a constant or the input).
+    std::unique_ptr<Tensor<float>> result;
+    bool copy_result = false;
+    // the float input and the views of it, read where the caller keeps them.
+    std::vector<Value> input_aliases;
+    float input_scale = 1.0f;
+};
+
+namespace {
+
+// shape of the output of an op from the shapes of its inputs.
+std::vector<int> inferShape(Op op, const std::vector<std::vector<int>>& in, int kernel, int stride, int padding,
+                            const std::vector<int>& view_shape, bool transposed_b, int pool, int pool_stride) {
+    switch (op) {
+        case Op::Conv2d: {
+            const auto& x = in[0];
+            const auto& w = in[1];
+            if (x.size() != 4 || w.size() != 4 || x[1] != w[1] || w[2] != w[3]) {
+                throw std::invalid_argument("conv2d: input " + shapeString(x) + " does not match weight " +
+                                            shapeString(w));
+            }
+            int k = w[2];
+            std::vector<int> out = {x[0], w[0], outSize(x[2], k, stride, padding), outSize(x[3], k, stride, padding)};
+            if (pool > 0) {
+                out[2] = outSize(out[2], pool, pool_stride, 0);
+                out[3] = outSize(out[3], pool, pool_stride, 0);
+            }
+            return out;
+        }
+        case Op::MatMul: {
+            const auto& a = in[0];
+            const auto& b = in[1];
+            int b_rows = transposed_b ? b[1] : b[0];
+            int b_cols = transposed_b ? b[0] : b[1];
+            if (a.size() != 2 || b.size() != 2 || a[1] != b_rows) {
+                throw std::invalid_argument("matmul: " + shapeString(a) + " and " + shapeString(b) +
+                                            (transposed_b ? "^T" : "") + " do not match");
+            }
+            return {a[0], b_cols};
+        }
+        case Op::MaxPool2d: {
+            const auto& x = in[0];
+            if (x.size() != 4) {
+                throw std::invalid_argument("maxpool2d expects (N, C, H, W) input, got " + shapeString(x));
+            }
+            return {x[0], x[1], outSize(x[2], kernel, stride, 0), outSize(x[3], kernel, stride, 0)};
+        }
+        case Op::View: {
+            std::vector<int> out = view_shape;
+            size_t known = 1;
+            int infer = -1;
+            for (size_t i = 0; i < out.size(); i++) {
+                if (out[i] == -1) {
+                    infer = (int)i;
+                } else {
+                    known *= out[i];
+                }
+            }
+            size_t total = product(in[0]);
+            if (infer >= 0 && known > 0) {
+                out[infer] = (int)(total / known);
+            }
+            if (product(out) != total) {
+                throw std::invalid_argument("view: can't view " + shapeString(in[0]) + " as " + shapeString(view_shape));
+            }
+            return out;
+        }
+        case Op::Transpose: {
+            if (in[0].size() != 2) {
+                throw std::invalid_argument("transpose: only 2D values, got " + shapeString(in[0]));
+            }
+            return {in[0][1], in[0][0]};
+        }
+        default:
+            return in[0];
+    }
+}
+
+// (C_out, C_in, K, K) -> (C_out / B, C_in, K, K, B)
+std::shared_ptr<Tensor<float>> packBlocked(const Tensor<float>& weight) {
+    const int B = kernels::CONV_BLOCK;
+    auto w = weight.is_contiguous() ? weight : weight.contiguous();
+    int C_out = w.shape()[0], rest = w.num_elements / C_out;
+    auto packed = std::make_shared<Tensor<float>>(std::vector<int>{C_out / B, rest, B});
+    const float* src = &w.data_[w.offset()];
+    for (int co = 0; co < C_out; co++) {
+        for (int r = 0; r < rest; r++) {
+            packed->data_[((size_t)(co / B) * rest + r) * B + co % B] = src[(size_t)co * rest + r];
+        }
+    }
+    return packed;
+}
+
+} // namespace
+
+Graph::Graph() = default;
+
+Graph::~Graph() = default;
+
+Graph::Value Graph::add(Node node) {
+    for (Value v : node.inputs) {
+        if (v < 0 || v >= (Value)nodes_.size()) {
+            throw std::invalid_argument(std::string(opName(node.op)) + ": unknown input value");
+        }
+    }
+    nodes_.push_back(std::move(node));
+    plan_.reset();
+    return (Value)nodes_.size() - 1;
+}
+
+Graph::Value Graph::input() {
+    if (input_ >= 0) {
+        throw std::invalid_argument("the graph has an input already");
+    }
+    Node node;
+    node.op = Op::Input;
+    input_ = add(std::move(node));
+    return input_;
+}
+
+Graph::Value Graph::constant(const Tensor<float>& value) {
+    Node node;
+    node.op = Op::Constant;
+    node.value = std::make_shared<Tensor<float>>(value.is_contiguous() ? value : value.contiguous());
+    return add(std::move(node));
+}
+
+Graph::Value Graph::conv2d(Value x, Value weight, int stride, int padding) {
+    Node node;
+    node.op = Op::Conv2d;
+    node.inputs = {x, weight};
+    node.stride = stride;
+    node.padding = padding;
+    return add(std::move(node));
+}
+
+Graph::Value Graph::conv2d(Value x, const Tensor<float>& weight, int stride, int padding) {
+    return conv2d(x, constant(weight), stride, padding);
+}
+
+Graph::Value Graph::matmul(Value a, Value b) {
+    Node node;
+    node.op = Op::MatMul;
+    node.inputs = {a, b};
+    return add(std::move(node));
+}
+
+Graph::Value Graph::linear(Value x, const Tensor<float>& weight) {
+    return matmul(x, transpose(constant(weight), 0, 1));
+}
+
+Graph::Value Graph::relu(Value x) {
+    Node node;
+    node.op = Op::ReLU;
+    node.inputs = {x};
+    return add(std::move(node));
+}
+
+Graph::Value Graph::maxPool2d(Value x, int kernel, int stride) {
+    Node node;
+    node.op = Op::MaxPool2d;
+    node.inputs = {x};
+    node.kernel = kernel;
+    node.stride = stride > 0 ? stride : kernel;
+    return add(std::move(node));
+}
+
+Graph::Value Graph::view(Value x, const std::vector<int>& shape) {
+    Node node;
+    node.op = Op::View;
+    node.inputs = {x};
+    node.view_shape = shape;
+    return add(std::move(node));
+}
+
+Graph::Value Graph::flatten(Value x) {
+    Node node;
+    node.op = Op::View;
+    node.inputs = {x};
+    // the batch size of x, resolved when planning.
+    node.view_shape = {0, -1};
+    return add(std::move(node));
+}
+
+Graph::Value Graph::transpose(Value x, int dim0, int dim1) {
+    if (!((dim0 == 0 && dim1 == 1) || (dim0 == 1 && dim1 == 0))) {
+        throw std::invalid_argument("transpose: only the two dimensions of a 2D value");
+    }
+    Node node;
+    node.op = Op::Transpose;
+    node.inputs = {x};
+    return add(std::move(node));
+}
+
+void Graph::output(Value value) {
+    if (value < 0 || value >= (Value)nodes_.size()) {
+        throw std::invalid_argument("output: unknown value");
+    }
+    output_ = value;
+    plan_.reset();
+}
+
+namespace {
+
+// the nodes output depends on, inputs before their consumers.
+std::vector<Graph::Value> topoOrder(const std::vector<std::vector<Graph::Value>>& inputs, Graph::Value output) {
+    std::vector<Graph::Value> order;
+    std::vector<int> state(inputs.size(), 0);
+    std::function<void(Graph::Value)> visit = [&](Graph::Value v) {
+        if (state[v] == 2) {
+            return;
+        }
+        state[v] = 1;
+        for (Graph::Value in : inputs[v]) {
+            visit(in);
+        }
+        state[v] = 2;
+        order.push_back(v);
+    };
+    visit(output);
+    return order;
+}
+
+} // namespace
+
+/**
+ * the passes rewrite nodes in place: a fused node takes over the consumers of the nodes
+ * it absorbed, which are left unreachable from the output and so never planned.
+ */
+void Graph::optimize(const GraphOptions& options) {
+    if (output_ < 0) {
+        throw std::invalid_argument("optimize: the graph has no output");
+    }
+    plan_.reset();
+
+    auto order = [&]() {
+        std::vector<std::vector<Value>> inputs;
+        for (auto& node : nodes_) {
+            inputs.push_back(node.inputs);
+        }
+        return topoOrder(inputs, output_);
+    };
+    // consumers of each value, the output counting as one.
+    auto consumers = [&](const std::vector<Value>& live) {
+        std::vector<std::vector<Value>> users(nodes_.size());
+        for (Value v : live) {
+            for (Value in : nodes_[v].inputs) {
+                users[in].push_back(v);
+            }
+        }
+        users[output_].push_back(-1);
+        return users;
+    };
+    auto replaceUses = [&](Value from, Value to) {
+        for (auto& node : nodes_) {
+            for (Value& in : node.inputs) {
+                if (in == from) {
+                    in = to;
+                }
+            }
+        }
+        if (output_ == from) {
+            output_ = to;
+        }
+    };
+
+    // a transpose feeding a matmul is read as B^T, a transpose of a transpose is its input.
+    if (options.fuse) {
+        for (Value v : order()) {
+            Node& node = nodes_[v];
+            if (node.op == Op::MatMul) {
+                while (nodes_[node.inputs[1]].op == Op::Transpose) {
+                    node.inputs[1] = nodes_[node.inputs[1]].inputs[0];
+                    node.transposed_b = !node.transposed_b;
+                }
+            }
+            for (Value& in : node.inputs) {
+                while (nodes_[in].op == Op::Transpose && nodes_[nodes_[in].inputs[0]].op == Op::Transpose) {
+                    in = nodes_[nodes_[in].inputs[0]].inputs[0];
+                }
+            }
+        }
+    }
+
+    if (options.fold_constants) {
+        for (Value v : order()) {
+            Node& node = nodes_[v];
+            if (node.op == Op::Input || node.op == Op::Constant) {
+                continue;
+            }
+            bool constant = std::all_of(node.inputs.begin(), node.inputs.end(),
+                                        [&](Value in) { return nodes_[in].op == Op::Constant; });
+            if (!constant) {
+                continue;
+            }
+
+            // a graph of this node and its constant inputs, run once.
+            Graph sub;
+            sub.input();
+            std::vector<Value> inputs;
+            for (Value in : node.inputs) {
+                inputs.push_back(sub.constant(*nodes_[in].value));
+            }
+            Node copy = node;
+            copy.inputs = inputs;
+            sub.output(sub.add(std::move(copy)));
+            const Tensor<float>& result = sub.forward(Tensor<float>({1}));
+
+            Node folded;
+            folded.op = Op::Constant;
+            folded.value = std::make_shared<Tensor<float>>(result.shape());
+            const float* src = &result.data_[result.offset()];
+            std::copy(src, src + result.num_elements, &folded.value->data_[0]);
+            node = std::move(folded);
+        }
+    }
+
+    if (options.fuse) {
+        for (Value v : order()) {
+            Node& node = nodes_[v];
+            if (node.op != Op::Conv2d && node.op != Op::MatMul) {
+                continue;
+            }
+            // absorb the chain of ReLU / MaxPool2d consumers. relu(maxpool(x)) ==
+            // maxpool(relu(x)), so the pooling always runs first, with the ReLU as its floor.
+            while (true) {
+                auto users = consumers(order());
+                if (users[v].size() != 1 || users[v][0] < 0) {
+                    break;
+                }
+                Value next = users[v][0];
+                const Node& user = nodes_[next];
+                if (user.op == Op::ReLU && !node.relu) {
+                    node.relu = true;
+                } else if (user.op == Op::MaxPool2d && node.op == Op::Conv2d && node.pool == 0) {
+                    node.pool = user.kernel;
+                    node.pool_stride = user.stride;
+                } else {
+                    break;
+                }
+                replaceUses(next, v);
+            }
+        }
+    }
+
+    if (options.select_layouts) {
+        auto live = order();
+        for (Value v : live) {
+            Node& node = nodes_[v];
+            if (node.op == Op::Conv2d && nodes_[node.inputs[1]].op == Op::Constant) {
+                const auto& w = *nodes_[node.inputs[1]].value;
+                if (w.shape()[0] % kernels::CONV_BLOCK == 0) {
+                    node.layout = Layout::NCHWc;
+                    node.packed = packBlocked(w);
+                }
+            } else if (node.op == Op::ReLU || node.op == Op::MaxPool2d) {
+                // element-wise / per channel, in whatever layout their input has.
+                node.layout = nodes_[node.inputs[0]].layout;
+            }
+        }
+
+        // a reorder in front of every op that only reads NCHW, one per blocked value.
+        std::vector<Value> reorder_of(nodes_.size(), -1);
+        auto reordered = [&](Value v) {
+            if (reorder_of[v] < 0) {
+                Node node;
+                node.op = Op::Reorder;
+                node.inputs = {v};
+                nodes_.push_back(std::move(node));
+                reorder_of[v] = (Value)nodes_.size() - 1;
+            }
+            return reorder_of[v];
+        };
+        for (Value v : live) {
+            Op op = nodes_[v].op;
+            bool reads_blocked = (op == Op::Conv2d && nodes_[v].layout == Layout::NCHWc) || op == Op::ReLU ||
+                                 op == Op::MaxPool2d;
+            for (size_t i = 0; i < nodes_[v].inputs.size(); i++) {
+                Value in = nodes_[v].inputs[i];
+                if (nodes_[in].layout == Layout::NCHWc && !reads_blocked) {
+                    Value r = reordered(in);
+                    nodes_[v].inputs[i] = r;
+                }
+            }
+        }
+        if (nodes_[output_].layout == Layout::NCHWc) {
+            output_ = reordered(output_);
+        }
+    }
+}
+
+void Graph::plan(const std::vector<int>& input_shape, bool input_u8) {
+    if (input_ < 0 || output_ < 0) {
+        throw std::invalid_argument("the graph needs an input and an output");
+    }
+    std::unique_ptr<Plan> previous = std::move(plan_);
+    auto p = std::make_unique<Plan>();
+    p->input_shape = input_shape;
+    p->input_u8 = input_u8;
+    p->threads = parallel::numThreads();
+
+    std::vector<std::vector<Value>> inputs;
+    for (auto& node : nodes_) {
+        inputs.push_back(node.inputs);
+    }
+    std::vector<Value> order = topoOrder(inputs, output_);
+
+    p->slots.assign(nodes_.size(), Slot());
+    p->buffers.assign(nodes_.size(), -1);
+    p->workspaces.assign(nodes_.size(), nullptr);
+    p->configs.assign(nodes_.size(), kernels::ConvConfig());
+    p->gemm_configs.assign(nodes_.size(), kernels::GemmConfig());
+
+    // the step of each executed node, and the last step reading each value.
+    std::vector<int> step_of(nodes_.size(), -1);
+    std::vector<int> last_use(nodes_.size(), -1);
+    int steps = 0;
+    for (Value v : order) {
+        Op op = nodes_[v].op;
+        bool runs = op != Op::Constant && op != Op::View && !(op == Op::Input && !input_u8);
+        step_of[v] = runs ? steps++ : (steps > 0 ? steps - 1 : 0);
+        for (Value in : nodes_[v].inputs) {
+            last_use[in] = std::max(last_use[in], step_of[v]);
+        }
+    }
+    last_use[output_] = steps;
+
+    std::vector<memory::Buffer> buffers;
+    std::vector<int> workspace_buffer(nodes_.size(), -1);
+    for (Value v : order) {
+        const Node& node = nodes_[v];
+        Slot& slot = p->slots[v];
+        std::vector<std::vector<int>> in_shapes;
+        for (Value in : node.inputs) {
+            in_shapes.push_back(p->slots[in].shape);
+        }
+
+        switch (node.op) {
+            case Op::Input:
+                slot.shape = input_shape;
+                break;
+            case Op::Constant:
+                slot.shape = node.value->shape();
+                slot.data = &node.value->data_[node.value->offset()];
+                break;
+            case Op::View: {
+                std::vector<int> view_shape = node.view_shape;
+                if (!view_shape.empty() && view_shape[0] == 0) {
+                    view_shape[0] = in_shapes[0].empty() ? 1 : in_shapes[0][0];
+                }
+                slot.shape = inferShape(Op::View, in_shapes, 0, 0, 0, view_shape, false, 0, 0);
+                break;
+            }
+            default:
+                slot.shape = inferShape(node.op, in_shapes, node.kernel, node.stride, node.padding,
+                                        node.view_shape, node.transposed_b, node.pool, node.pool_stride);
+        }
+        slot.layout = node.layout;
+
+        if (node.op == Op::View) {
+            // an alias, keeps the input's buffer alive as long as the view is read.
+            Value in = node.inputs[0];
+            p->buffers[v] = p->buffers[in];
+            if (p->buffers[v] >= 0) {
+                auto& b = buffers[p->buffers[v]];
+                b.last = std::max(b.last, last_use[v]);
+            } else if (std::find(p->input_aliases.begin(), p->input_aliases.end(), in) != p->input_aliases.end()) {
+                p->input_aliases.push_back(v);
+            } else {
+                slot.data = p->slots[in].data;
+            }
+            continue;
+        }
+        if (node.op == Op::Input && !input_u8) {
+            p->input_aliases.push_back(v);
+            continue;
+        }
+        if (node.op == Op::Constant) {
+            continue;
+        }
+
+        int step = step_of[v];
+        size_t bytes = product(slot.shape) * sizeof(float);
+
+        if (node.op == Op::MatMul) {
+            p->gemm_configs[v] = tuner::gemm(in_shapes[0][0], slot.shape[1], in_shapes[0][1], node.transposed_b);
+        }
+        if (node.op == Op::Conv2d) {
+            const auto& x = in_shapes[0];
+            const auto& w = in_shapes[1];
+            int N = x[0], C_in = x[1], H = x[2], W = x[3], C_out = w[0], K = w[2];
+            int H_conv = outSize(H, K, node.stride, node.padding), W_conv = outSize(W, K, node.stride, node.padding);
+            size_t per_thread = 0;
+            if (node.layout == Layout::NCHW) {
+                p->configs[v] = tuner::conv2d(N, C_in, H, W, C_out, K, node.stride, node.padding);
+                if (p->configs[v].algorithm == kernels::ConvAlgorithm::Im2col) {
+                    per_thread += (size_t)C_in * K * K * H_conv * W_conv;
+                }
+            }
+            if (node.pool > 0) {
+                // the unpooled output of one image.
+                per_thread += (size_t)C_out * H_conv * W_conv;
+            }
+            if (per_thread > 0) {
+                workspace_buffer[v] = (int)buffers.size();
+                buffers.push_back({per_thread * p->threads * sizeof(float), step, step});
+            }
+        }
+
+        // in place over an input nobody reads later, e.g. a ReLU after an op it was not fused into.
+        if (node.op == Op::ReLU && p->buffers[node.inputs[0]] >= 0 &&
+            buffers[p->buffers[node.inputs[0]]].last == step) {
+            p->buffers[v] = p->buffers[node.inputs[0]];
+            buffers[p->buffers[v]].last = last_use[v];
+        } else {
+            p->buffers[v] = (int)buffers.size();
+            buffers.push_back({bytes, step, std::max(step, last_use[v])});
+        }
+        p->steps.push_back(v);
+    }
+
+    memory::ArenaPlan arena_plan = memory::planArena(buffers);
+    const size_t ALIGNMENT = 64;
+    size_t needed = (arena_plan.arena_bytes + ALIGNMENT) / sizeof(float) + 1;
+    if (previous && previous->arena_capacity >= needed) {
+        p->arena = previous->arena;
+        p->arena_capacity = previous->arena_capacity;
+    } else {
+        previous.reset();
+        p->arena = memory::allocate<float>(needed);
+        p->arena_capacity = needed;
+    }
+    p->arena_bytes = arena_plan.arena_bytes;
+    uintptr_t base = ((uintptr_t)p->arena.get() + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    auto at = [&](int buffer) { return reinterpret_cast<float*>(base + arena_plan.offsets[buffer]); };
+
+    for (Value v : order) {
+        if (p->buffers[v] >= 0) {
+            p->slots[v].data = at(p->buffers[v]);
+        }
+        if (workspace_buffer[v] >= 0) {
+            p->workspaces[v] = at(workspace_buffer[v]);
+        }
+    }
+
+    const Slot& out = p->slots[output_];
+    if (p->buffers[output_] >= 0) {
+        // sharing the arena's ownership, a copy of the result keeps the arena alive.
+        p->result = std::make_unique<Tensor<float>>(out.shape, std::shared_ptr<float[]>(p->arena, out.data));
+    } else {
+        p->result = std::make_unique<Tensor<float>>(out.shape);
+        p->copy_result = true;
+    }
+    plan_ = std::move(p);
+}
+
+
+namespace {
+
+void runConv(const NodeData& node, const Slot& x, const Slot& w, Slot& out, float* workspace,
+             const kernels::ConvConfig& config, int threads) {
+    const auto& k = kernels::active();
+    int N = x.shape[0], C_in = x.shape[1], H = x.shape[2], W = x.shape[3];
+    int C_out = w.shape[0], K = w.shape[2];
+    int H_conv = outSize(H, K, node.stride, node.padding), W_conv = outSize(W, K, node.stride, node.padding);
+    int patch = C_in * K * K, spatial = H_conv * W_conv;
+    bool blocked = node.layout == Layout::NCHWc;
+    int in_lanes = x.layout == Layout::NCHWc ? kernels::CONV_BLOCK : 1;
+    int lanes = blocked ? kernels::CONV_BLOCK : 1;
+    bool im2col = !blocked && config.algorithm == kernels::ConvAlgorithm::Im2col;
+    size_t cols_size = im2col ? (size_t)patch * spatial : 0;
+    size_t per_thread = cols_size + (node.pool > 0 ? (size_t)C_out * spatial : 0);
+    size_t in_image = (size_t)C_in * H * W;
+    size_t out_image = product(out.shape) / N;
+    const float* weight = blocked ? &node.packed->data_[0] : w.data;
+    float floor = node.relu ? 0.0f : -std::numeric_limits<float>::infinity();
+
+    kernels::GemmConfig single;
+    single.threads = 1;
+
+    PROFILE_OP("Graph::conv2d", 2.0 * N * C_out * spatial * patch,
+               (double)sizeof(float) * (product(x.shape) + product(w.shape) + product(out.shape)), &x.shape,
+               &w.shape);
+
+    // one image at a time through the convolution, pooling and ReLU, its unpooled output
+    // stays in cache.
+    int max_threads = config.threads > 0 ? std::min(config.threads, threads) : threads;
+    parallel::parallel_for(0, N, 1, [&](int64_t begin, int64_t end) {
+        float* scratch = workspace + (size_t)parallel::threadIndex() * per_thread;
+        for (int64_t n = begin; n < end; n++) {
+            const float* x_n = x.data + n * in_image;
+            float* out_n = out.data + n * out_image;
+            float* conv_out = node.pool > 0 ? scratch + cols_size : out_n;
+            if (blocked) {
+                k.conv2d_nchwc_f32(x_n, C_in, H, W, in_lanes, weight, C_out, K, node.stride, node.padding, conv_out);
+            } else if (im2col) {
+                k.im2col_f32(x_n, C_in, H, W, K, node.stride, node.padding, scratch);
+                k.gemm_f32(C_out, spatial, patch, weight, patch, scratch, spatial, conv_out, spatial, single);
+            } else {
+                k.conv2d_direct_f32(x_n, C_in, H, W, weight, C_out, K, node.stride, node.padding, conv_out);
+            }
+            if (node.pool > 0) {
+                k.maxpool2d_f32(conv_out, C_out / lanes, H_conv, W_conv, lanes, node.pool, node.pool_stride, floor,
+                                out_n);
+            } else if (node.relu) {
+                k.maximum_f32(conv_out, 0.0f, conv_out, out_image);
+            }
+        }
+    }, max_threads);
+}
+
+void runMatMul(const NodeData& node, const Slot& a, const Slot& b, Slot& out, const kernels::GemmConfig& config) {
+    const auto& k = kernels::active();
+    int M = a.shape[0], K = a.shape[1], N = out.shape[1];
+    int ldb = node.transposed_b ? K : N;
+
+    PROFILE_OP("Graph::matmul", 2.0 * M * N * K,
+               (double)sizeof(float) * (product(a.shape) + product(b.shape) + product(out.shape)), &a.shape,
+               &b.shape);
+
+    auto gemm = node.transposed_b ? k.gemm_nt_f32 : k.gemm_f32;
+    if (!node.relu) {
+        gemm(M, N, K, a.data, K, b.data, ldb, out.data, N, config);
+        return;
+    }
+    // the ReLU on each block of rows right after it is computed.
+    kernels::GemmConfig single;
+    single.threads = 1;
+    int64_t grain = std::max<int64_t>(1, (1 << 16) / std::max<int64_t>(1, (int64_t)N * K));
+    parallel::parallel_for(0, M, grain, [&](int64_t begin, int64_t end) {
+        int rows = (int)(end - begin);
+        float* c = out.data + begin * N;
+        gemm(rows, N, K, a.data + begin * K, K, b.data, ldb, c, N, single);
+        k.maximum_f32(c, 0.0f, c, (size_t)rows * N);
+    });
+}
+
+void runMaxPool(const NodeData& node, const Slot& x, Slot& out) {
+    int lanes = x.layout == Layout::NCHWc ? kernels::CONV_BLOCK : 1;
+    int planes = x.shape[0] * x.shape[1] / lanes;
+    PROFILE_OP("Graph::maxpool2d", (double)product(out.shape) * node.kernel * node.kernel,
+               (double)sizeof(float) * (product(x.shape) + product(out.shape)), &x.shape);
+    kernels::active().maxpool2d_f32(x.data, planes, x.shape[2], x.shape[3], lanes, node.kernel, node.stride,
+                                    -std::numeric_limits<float>::infinity(), out.data);
+}
+
+void runTranspose(const Slot& x, Slot& out) {
+    int rows = x.shape[0], cols = x.shape[1];
+    PROFILE_OP("Graph::transpose", 0.0, 2.0 * sizeof(float) * rows * cols, &x.shape);
+    parallel::parallel_for(0, cols, std::max(1, (1 << 14) / std::max(1, rows)), [&](int64_t begin, int64_t end) {
+        for (int64_t j = begin; j < end; j++) {
+            for (int i = 0; i < rows; i++) {
+                out.data[j * rows + i] = x.data[(size_t)i * cols + j];
+            }
+        }
+    });
+}
+
+// (N, C / B, H, W, B) -> (N, C, H, W)
+void runReorder(const Slot& x, Slot& out) {
+    const int B = kernels::CONV_BLOCK;
+    int N = x.shape[0], C = x.shape[1];
+    size_t plane = product(x.shape) / ((size_t)N * C);
+    PROFILE_OP("Graph::reorder", 0.0, 2.0 * sizeof(float) * product(x.shape), &x.shape);
+    int64_t grain = std::max<int64_t>(1, (1 << 16) / (int64_t)(plane * B));
+    parallel::parallel_for(0, (int64_t)N * (C / B), grain, [&](int64_t begin, int64_t end) {
+        for (int64_t nb = begin; nb < end; nb++) {
+            const float* src = x.data + nb * plane * B;
+            float* dst = out.data + nb * plane * B;
+            for (size_t i = 0; i < plane; i++) {
+                for (int j = 0; j < B; j++) {
+                    dst[j * plane + i] = src[i * B + j];
+                }
+            }
+        }
+    });
+}
+
+} // namespace
+
+void Graph::run(const float* input) {
+    Plan& p = *plan_;
+    const auto& k = kernels::active();
+    for (Value v : p.steps) {
+        const Node& node = nodes_[v];
+        Slot& out = p.slots[v];
+        switch (node.op) {
+            case Op::Input:
+                k.scale_u8_f32(reinterpret_cast<const uint8_t*>(input), p.input_scale, out.data, product(out.shape));
+                break;
+            case Op::Conv2d:
+                runConv(node, p.slots[node.inputs[0]], p.slots[node.inputs[1]], out, p.workspaces[v], p.configs[v],
+                        p.threads);
+                break;
+            case Op::MatMul:
+                runMatMul(node, p.slots[node.inputs[0]], p.slots[node.inputs[1]], out, p.gemm_configs[v]);
+                break;
+            case Op::ReLU: {
+                const Slot& x = p.slots[node.inputs[0]];
+                PROFILE_OP("Graph::relu", (double)product(x.shape), 2.0 * sizeof(float) * product(x.shape), &x.shape);
+                k.maximum_f32(x.data, 0.0f, out.data, product(x.shape));
+                break;
+            }
+            case Op::MaxPool2d:
+                runMaxPool(node, p.slots[node.inputs[0]], out);
+                break;
+            case Op::Transpose:
+                runTranspose(p.slots[node.inputs[0]], out);
+                break;
+            case Op::Reorder:
+                runReorder(p.slots[node.inputs[0]], out);
+                break;
+            default:
+                break;
+        }
+    }
+    if (p.copy_result) {
+        const Slot& out = p.slots[output_];
+        std::copy(out.data, out.data + product(out.shape), &p.result->data_[0]);
+    }
+}
+
+const Tensor<float>& Graph::forward(const Tensor<float>& input) {
+    if (!input.is_contiguous()) {
+        return forward(input.contiguous());
+    }
+    if (!plan_ || plan_->input_u8 || plan_->input_shape != input.shape() ||
+        plan_->threads != parallel::numThreads()) {
+        plan(input.shape(), false);
+    }
+    const float* data = &input.data_[input.offset()];
+    for (Value v : plan_->input_aliases) {
+        plan_->slots[v].data = const_cast<float*>(data);
+    }
+    run(data);
+    return *plan_->result;
+}
+
+const Tensor<float>& Graph::forward(const Tensor<uint8_t>& input, float input_scale) {
+    if (!input.is_contiguous()) {
+        throw std::invalid_argument("Graph::forward expects a contiguous uint8 input");
+    }
+    if (!plan_ || !plan_->input_u8 || plan_->input_shape != input.shape() ||
+        plan_->threads != parallel::numThreads()) {
+        plan(input.shape(), true);
+    }
+    plan_->input_scale = input_scale;
+    run(reinterpret_cast<const float*>(&input.data_[input.offset()]));
+    return *plan_->result;
+}
+
+size_t Graph::steps() const {
+    return plan_ ? plan_->steps.size() : 0;
+}
+
+size_t Graph::arenaBytes() const {
+    return plan_ ? plan_->arena_bytes : 0;
+}
+
+void Graph::print(std::ostream& os) const {
+    if (!plan_) {
+        return;
+    }
+    for (Value v : plan_->steps) {
+        const Node& node = nodes_[v];
+        os << "%" << v << " = " << opName(node.op) << "(";
+        for (size_t i = 0; i < node.inputs.size(); i++) {
+            os << (i > 0 ? ", %" : "%") << node.inputs[i];
+        }
+        os << ")";
+        if (node.op == Op::Conv2d) {
+            os << " s" << node.stride << " p" << node.padding;
+        } else if (node.op == Op::MaxPool2d) {
+            os << " k" << node.kernel << " s" << node.stride;
+        } else if (node.op == Op::MatMul && node.transposed_b) {
+            os << " b^T";
+        }
+        if (node.relu) {
+            os << " +relu";
+        }
+        if (node.pool > 0) {
+            os << " +maxpool" << node.pool;
+        }
+        if (node.layout == Layout::NCHWc) {
+            os << " [nchw" << kernels::CONV_BLOCK << "c]";
+        }
+        os << " " << shapeString(plan_->slots[v].shape) << "\n";
+    }
+}
+
+} // namespace nn
@@ -0,0 +1,88 @@
+#include "../../include/nn/Int4Linear.hpp"
+#include "../../include/Kernels.hpp"
+#include "../../include/Memory.hpp"
+#include "../../include/Profiler.hpp"
+#include <stdexcept>
+#include <string>
+
+namespace nn {
+
+Int4Linear::Int4Linear(int in_features, int out_features, const Tensor<float>& weight, const quant::Config& config)
+        : in_features(in_features), out_features(out_features) {
+    if (weight.shape() != std::vector<int>{out_features, in_features}) {
+        throw std::invalid_argument("Int4Linear: weight must be (" + std::to_string(out_features) + ", " +
+                                    std::to_string(in_features) + ")");
+    }
+    weight_ = quant::quantizeWeight4(weight, config);
+}
+
+Int4Linear::Int4Linear(int in_features, int out_features, const Tensor<float>& weight, const Tensor<float>& bias,
+                       const quant::Config& config)
+        : Int4Linear(in_features, out_features, weight, config) {
+    if (bias.num_elements != out_features) {
+        throw std::invalid_argument("Int4Linear: bias must have " + std::to_string(out_features) + " elements");
+    }
+    auto b = bias.is_contiguous() ? bias : bias.contiguous();
+    this->bias.assign(&b.data_[b.offset()], &b.data_[b.offset()] + out_features);
+}
+
+std::vector<int> Int4Linear::outputShape(const std::vector<int>& input_shape) const {
+    if (input_shape.size() != 2 || input_shape[1] != in_features) {
+        throw std::invalid_argument("Int4Linear expects (N, " + std::to_string(in_features) + ") input");
+    }
+    return {input_shape[0], out_features};
+}
+
+size_t Int4Linear::uint8WorkspaceSize(const std::vector<int>& input_shape) const {
+    return input_shape.empty() ? 0 : (size_t)input_shape[0] * in_features;
+}
+
+void Int4Linear::run(const float* x, int N, float* y) const {
+    const auto& k = kernels::active();
+    std::vector<int> shape = {N, in_features};
+    PROFILE_OP("Int4Linear", 2.0 * N * in_features * out_features,
+               4.0 * N * in_features + (double)weight_.values.num_elements + 8.0 * weight_.scales.size() +
+                       4.0 * N * out_features,
+               &shape, &weight_.values.shape());
+
+    k.gemm_nt_f32_u4(N, out_features, in_features, x, in_features, &weight_.values.data_[0], in_features / 2,
+                     weight_.scales.data(), weight_.zero_points.data(), weight_.group_size, y, out_features);
+    if (!bias.empty()) {
+        k.bias_add_f32(y, N, out_features, bias.data(), false);
+    }
+}
+
+void Int4Linear::forward_into(const Tensor<float>& input, Tensor<float>& output, float* workspace) {
+    (void)workspace;
+    outputShape(input.shape());
+    auto x = input.is_contiguous() ? input : input.contiguous();
+    run(&x.data_[x.offset()], x.shape()[0], &output.data_[output.offset()]);
+}
+
+void Int4Linear::forward_into(const Tensor<uint8_t>& input, float input_scale, Tensor<float>& output,
+                              float* workspace) {
+    outputShape(input.shape());
+    auto x = input.is_contiguous() ? input : input.contiguous();
+    std::shared_ptr<float[]> scratch;
+    if (workspace == nullptr) {
+        scratch = memory::allocate<float>(uint8WorkspaceSize(x.shape()));
+        workspace = scratch.get();
+    }
+    // the kernel reads float activations, the pixels are scaled once up front.
+    kernels::active().scale_u8_f32(&x.data_[x.offset()], input_scale, workspace, x.num_elements);
+    run(workspace, x.shape()[0], &output.data_[output.offset()]);
+}
+
+Tensor<float> Int4Linear::forward(const Tensor<float>& input) {
+    Tensor<float> output(outputShape(input.shape()));
+    forward_into(input, output, nullptr);
+    return output;
+}
+
+Tensor<float> Int4Linear::forward(const Tensor<uint8_t>& input, float input_scale) {
+    Tensor<float> output(outputShape(input.shape()));
+    forward_into(input, input_scale, output, nullptr);
+    return output;
+}
+
+} // namespace nn
@@ -0,0 +1,248 @@
+#include "../../include/nn/QuantizedConv2d.hpp"
+#include "../../include/Kernels.hpp"
+#include "../../include/Memory.hpp"
+#include "../../include/Profiler.hpp"
+#include "../../include/ThreadPool.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace nn {
+
+namespace {
+
+// floats holding n bytes.
+size_t floatsFor(size_t bytes) {
+    return (bytes + sizeof(float) - 1) / sizeof(float);
+}
+
+} // namespace
+
+QuantizedConv2d::QuantizedConv2d(int in_channels, int out_channels, int kernel_size, int stride, int padding,
+                                 const Tensor<float>& weight, const quant::Config& config)
+        : in_channels(in_channels), out_channels(out_channels), kernel_size(kernel_size), stride(stride),
+          padding(padding) {
+    if (weight.shape() != std::vector<int>{out_channels, in_channels, kernel_size, kernel_size}) {
+        throw std::invalid_argument("QuantizedConv2d: weight must be (" + std::to_string(out_channels) + ", " +
+                                    std::to_string(in_channels) + ", " + std::to_string(kernel_size) + ", " +
+                                    std::to_string(kernel_size) + ")");
+    }
+    int patch = in_channels * kernel_size * kernel_size;
+    if (config.group_size != 0 && config.group_size != patch) {
+        throw std::invalid_argument("QuantizedConv2d: only per channel weight scales, group size must be 0");
+    }
+    if (config.per_row_activations) {
+        throw std::invalid_argument("QuantizedConv2d: per row activations are for QuantizedLinear");
+    }
+    weight_ = quant::quantizeWeight(weight.view({out_channels, patch}), config);
+}
+
+QuantizedConv2d::QuantizedConv2d(int in_channels, int out_channels, int kernel_size, int stride, int padding,
+                                 const Tensor<float>& weight, const Tensor<float>& bias,
+                                 const quant::Config& config)
+        : QuantizedConv2d(in_channels, out_channels, kernel_size, stride, padding, weight, config) {
+    if (bias.num_elements != out_channels) {
+        throw std::invalid_argument("QuantizedConv2d: bias must have " + std::to_string(out_channels) +
+                                    " elements");
+    }
+    auto b = bias.is_contiguous() ? bias : bias.contiguous();
+    this->bias.assign(&b.data_[b.offset()], &b.data_[b.offset()] + out_channels);
+}
+
+void QuantizedConv2d::setInputParams(const quant::Params& params) {
+    input_params = params;
+    has_input_params = true;
+}
+
+void QuantizedConv2d::setOutputParams(const quant::Params& params) {
+    output_params = params;
+    has_output_params = true;
+}
+
+std::vector<int> QuantizedConv2d::outputShape(const std::vector<int>& input_shape) const {
+    if (input_shape.size() != 4 || input_shape[1] != in_channels) {
+        throw std::invalid_argument("QuantizedConv2d expects (N, " + std::to_string(in_channels) + ", H, W) input");
+    }
+    int output_height = (input_shape[2] + 2 * padding - kernel_size) / stride + 1;
+    int output_width = (input_shape[3] + 2 * padding - kernel_size) / stride + 1;
+    return {input_shape[0], out_channels, output_height, output_width};
+}
+
+void QuantizedConv2d::checkInput(const std::vector<int>& shape, bool contiguous) const {
+    outputShape(shape);
+    if (!contiguous) {
+        throw std::invalid_argument("QuantizedConv2d expects contiguous input");
+    }
+}
+
+int QuantizedConv2d::chunkImages(int N, int spatial) const {
+    size_t row_bytes = (size_t)in_channels * kernel_size * kernel_size + sizeof(int32_t) * out_channels;
+    size_t images = ((size_t)1 << 22) / std::max<size_t>(1, row_bytes * spatial);
+    return (int)std::max<size_t>(1, std::min<size_t>(images, std::max(N, 1)));
+}
+
+size_t QuantizedConv2d::runWorkspaceSize(const std::vector<int>& input_shape) const {
+    auto out = outputShape(input_shape);
+    size_t pixels = (size_t)chunkImages(input_shape[0], out[2] * out[3]) * out[2] * out[3];
+    return floatsFor(pixels * in_channels * kernel_size * kernel_size) + pixels * out_channels;
+}
+
+size_t QuantizedConv2d::workspaceSize(const std::vector<int>& input_shape) const {
+    size_t input = (size_t)input_shape[0] * in_channels * input_shape[2] * input_shape[3];
+    return runWorkspaceSize(input_shape) + floatsFor(input);
+}
+
+void QuantizedConv2d::run(const uint8_t* x, uint8_t flip, const std::vector<int>& input_shape,
+                          const quant::Params& input, float* y, int8_t* q, float* workspace) const {
+    const auto& k = kernels::active();
+    auto out_shape = outputShape(input_shape);
+    const int N = input_shape[0], H = input_shape[2], W = input_shape[3];
+    const int spatial = out_shape[2] * out_shape[3];
+    const int patch = in_channels * kernel_size * kernel_size;
+    const int chunk = chunkImages(N, spatial);
+    const size_t image = (size_t)in_channels * H * W;
+
+    uint8_t* rows = reinterpret_cast<uint8_t*>(workspace);
+    int32_t* acc = reinterpret_cast<int32_t*>(workspace + floatsFor((size_t)chunk * spatial * patch));
+    const int8_t* w = &weight_.values.data_[0];
+    const uint8_t pad = (uint8_t)input.zero_point;
+    const int32_t z_x = input.zero_point;
+    const float inv_scale = 1.0f / output_params.scale;
+
+    PROFILE_OP("QuantizedConv2d", 2.0 * N * spatial * patch * out_channels,
+               (double)N * image + (double)weight_.values.num_elements +
+                       (q != nullptr ? 1.0 : 4.0) * N * out_channels * spatial,
+               &input_shape, &weight_.values.shape());
+
+    for (int n0 = 0; n0 < N; n0 += chunk) {
+        const int images = std::min(chunk, N - n0);
+        parallel::parallel_for(0, images, 1, [&](int64_t begin, int64_t end) {
+            for (int64_t n = begin; n < end; n++) {
+                k.im2row_u8(x + (n0 + n) * image, in_channels, H, W, kernel_size, stride, padding, pad, flip,
+                            rows + (size_t)n * spatial * patch);
+            }
+        });
+
+        // every output pixel of the chunk against every channel in one GEMM.
+        const int M = images * spatial;
+        k.gemm_nt_u8s8i32(M, out_channels, patch, rows, patch, w, patch, acc, out_channels);
+
+        // the epilogue reads a pixel's channels and scatters them to the NCHW planes.
+        int row_work = std::max(1, out_channels + (weight_.symmetric ? 0 : patch));
+        parallel::parallel_for(0, M, std::max(1, (1 << 14) / row_work), [&](int64_t begin, int64_t end) {
+            for (int64_t r = begin; r < end; r++) {
+                int32_t x_sum = 0;
+                if (!weight_.symmetric) {
+                    const uint8_t* row = rows + (size_t)r * patch;
+                    for (int t = 0; t < patch; t++) {
+                        x_sum += row[t];
+                    }
+                }
+                const int32_t* a = acc + (size_t)r * out_channels;
+                size_t base = (size_t)(n0 + r / spatial) * out_channels * spatial + r % spatial;
+                for (int c = 0; c < out_channels; c++) {
+                    int32_t z_w = weight_.zero_points[c];
+                    int32_t v = a[c] - z_w * x_sum - z_x * weight_.sums[c] + patch * z_x * z_w;
+                    float f = input.scale * weight_.scales[c] * (float)v;
+                    if (!bias.empty()) {
+                        f += bias[c];
+                    }
+                    if (relu) {
+                        f = std::max(f, 0.0f);
+                    }
+                    if (q != nullptr) {
+                        q[base + (size_t)c * spatial] =
+                                (int8_t)quant::quantize(f, inv_scale, output_params.zero_point, -128, 127);
+                    } else {
+                        y[base + (size_t)c * spatial] = f;
+                    }
+                }
+            }
+        });
+    }
+}
+
+void QuantizedConv2d::forward_into(const Tensor<uint8_t>& input, float input_scale, Tensor<float>& output,
+                                   float* workspace) {
+    checkInput(input.shape(), input.is_contiguous());
+    std::shared_ptr<float[]> scratch;
+    if (workspace == nullptr) {
+        scratch = memory::allocate<float>(runWorkspaceSize(input.shape()));
+        workspace = scratch.get();
+    }
+    quant::Params params;
+    params.scale = input_scale;
+    run(&input.data_[input.offset()], 0, input.shape(), params, &output.data_[output.offset()], nullptr, workspace);
+}
+
+void QuantizedConv2d::forward_into(const Tensor<float>& input, Tensor<float>& output, float* workspace) {
+    checkInput(input.shape(), input.is_contiguous());
+    std::shared_ptr<float[]> scratch;
+    if (workspace == nullptr) {
+        scratch = memory::allocate<float>(workspaceSize(input.shape()));
+        workspace = scratch.get();
+    }
+    // the static params, else the whole batch with one scale. the quantized input goes after run's scratch.
+    const float* x = &input.data_[input.offset()];
+    size_t n = input.num_elements;
+    quant::Params params = has_input_params ? input_params : quant::chooseParamsU8(x, n);
+    uint8_t* x_q = reinterpret_cast<uint8_t*>(workspace + runWorkspaceSize(input.shape()));
+    quant::quantizeU8(x, n, params, x_q);
+    run(x_q, 0, input.shape(), params, &output.data_[output.offset()], nullptr, workspace);
+}
+
+Tensor<float> QuantizedConv2d::forward(const Tensor<float>& input) {
+    Tensor<float> output(outputShape(input.shape()));
+    forward_into(input, output, nullptr);
+    return output;
+}
+
+Tensor<float> QuantizedConv2d::forward(const Tensor<uint8_t>& input, float input_scale, int32_t input_zero_point) {
+    checkInput(input.shape(), input.is_contiguous());
+    Tensor<float> output(outputShape(input.shape()));
+    auto scratch = memory::allocate<float>(runWorkspaceSize(input.shape()));
+    run(&input.data_[input.offset()], 0, input.shape(), {input_scale, input_zero_point}, &output.data_[0], nullptr,
+        scratch.get());
+    return output;
+}
+
+Tensor<float> QuantizedConv2d::forward(const Tensor<int8_t>& input) {
+    // int8 q with zero point z is uint8 q + 128 (q ^ 0x80) with zero point z + 128.
+    checkInput(input.shape(), input.is_contiguous());
+    Tensor<float> output(outputShape(input.shape()));
+    auto scratch = memory::allocate<float>(runWorkspaceSize(input.shape()));
+    run(reinterpret_cast<const uint8_t*>(&input.data_[input.offset()]), 0x80, input.shape(),
+        {input.scale, input.zero_point + 128}, &output.data_[0], nullptr, scratch.get());
+    return output;
+}
+
+Tensor<int8_t> QuantizedConv2d::forwardQuantized(const Tensor<uint8_t>& input, float input_scale,
+                                                 int32_t input_zero_point) {
+    if (!has_output_params) {
+        throw std::invalid_argument("QuantizedConv2d: forwardQuantized needs setOutputParams first");
+    }
+    checkInput(input.shape(), input.is_contiguous());
+    Tensor<int8_t> output(outputShape(input.shape()));
+    auto scratch = memory::allocate<float>(runWorkspaceSize(input.shape()));
+    run(&input.data_[input.offset()], 0, input.shape(), {input_scale, input_zero_point}, nullptr, &output.data_[0],
+        scratch.get());
+    output.scale = output_params.scale;
+    output.zero_point = output_params.zero_point;
+    return output;
+}
+
+Tensor<int8_t> QuantizedConv2d::forwardQuantized(const Tensor<int8_t>& input) {
+    if (!has_output_params) {
+        throw std::invalid_argument("QuantizedConv2d: forwardQuantized needs setOutputParams first");
+    }
+    checkInput(input.shape(), input.is_contiguous());
+    Tensor<int8_t> output(outputShape(input.shape()));
+    auto scratch = memory::allocate<float>(runWorkspaceSize(input.shape()));
+    run(reinterpret_cast<const uint8_t*>(&input.data_[input.offset()]), 0x80, input.shape(),
+        {input.scale, input.zero_point + 128}, nullptr, &output.data_[0], scratch.get());
+    output.scale = output_params.scale;
+    output.zero_point = output_params.zero_point;
+    return output;
+}
+
+} // namespace nn
@@ -0,0 +1,335 @@
+#include "../../include/nn/QuantizedLinear.hpp"
+#include "../../include/Kernels.hpp"
+#include "../../include/Memory.hpp"
+#include "../../include/Profiler.hpp"
+#include "../../include/ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace nn {
+
+QuantizedLinear::QuantizedLinear(int in_features, int out_features, const Tensor<float>& weight,
+                                 const quant::Config& config)
+        : in_features(in_features), out_features(out_features) {
+    if (weight.shape() != std::vector<int>{out_features, in_features}) {
+        throw std::invalid_argument("QuantizedLinear: weight must be (" + std::to_string(out_features) + ", " +
+                                    std::to_string(in_features) + ")");
+    }
+    weight_ = quant::quantizeWeight(weight, config);
+    per_row_activations = config.per_row_activations;
+}
+
+QuantizedLinear::QuantizedLinear(int in_features, int out_features, const Tensor<float>& weight,
+                                 const Tensor<float>& bias, const quant::Config& config)
+        : QuantizedLinear(in_features, out_features, weight, config) {
+    if (bias.num_elements != out_features) {
+        throw std::invalid_argument("QuantizedLinear: bias must have " + std::to_string(out_features) + " elements");
+    }
+    auto b = bias.is_contiguous() ? bias : bias.contiguous();
+    this->bias.assign(&b.data_[b.offset()], &b.data_[b.offset()] + out_features);
+}
+
+void QuantizedLinear::setInputParams(const quant::Params& params) {
+    input_params = params;
+    has_input_params = true;
+}
+
+void QuantizedLinear::setOutputParams(const quant::Params& params) {
+    output_params = params;
+    has_output_params = true;
+}
+
+std::vector<int> QuantizedLinear::outputShape(const std::vector<int>& input_shape) const {
+    if (input_shape.size() != 2 || input_shape[1] != in_features) {
+        throw std::invalid_argument("QuantizedLinear expects (N, " + std::to_string(in_features) + ") input");
+    }
+    return {input_shape[0], out_features};
+}
+
+size_t QuantizedLinear::workspaceSize(const std::vector<int>& input_shape) const {
+    size_t N = input_shape.empty() ? 0 : input_shape[0];
+    // uint8 input rounded up to whole floats, the accumulators, then the params per row.
+    size_t params = per_row_activations ? N * sizeof(quant::Params) / sizeof(float) : 0;
+    return (N * in_features + sizeof(float) - 1) / sizeof(float) + N * out_features + params;
+}
+
+void QuantizedLinear::run(const uint8_t* x, int N, const quant::Params& input, const quant::Params* row_params,
+                          float* y, int8_t* q, int32_t* acc, float* y_scratch) const {
+    std::vector<int> shape = {N, in_features};
+    PROFILE_OP("QuantizedLinear", 2.0 * N * in_features * out_features,
+               (double)N * in_features + (double)weight_.values.num_elements + 4.0 * N * out_features, &shape,
+               &weight_.values.shape());
+    compute(x, N, input, row_params, y, q, acc, y_scratch);
+}
+
+void QuantizedLinear::compute(const uint8_t* x, int N, const quant::Params& input, const quant::Params* row_params,
+                              float* y, int8_t* q, int32_t* acc, float* y_scratch) const {
+    const auto& k = kernels::active();
+    const int G = weight_.groups, S = weight_.group_size;
+    const int8_t* w = &weight_.values.data_[0];
+    float* out = y != nullptr ? y : y_scratch;
+
+    for (int g = 0; g < G; g++) {
+        // one group of columns at a time, the whole batch in one GEMM.
+        k.gemm_nt_u8s8i32(N, out_features, S, x + (size_t)g * S, in_features, w + (size_t)g * S, in_features, acc,
+                          out_features);
+
+        int row_work = std::max(1, out_features * (weight_.symmetric ? 1 : S));
+        parallel::parallel_for(0, N, std::max(1, (1 << 14) / row_work), [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; i++) {
+                // the input sum only matters against a weight zero point.
+                int32_t x_sum = 0;
+                if (!weight_.symmetric) {
+                    const uint8_t* x_group = x + (size_t)i * in_features + (size_t)g * S;
+                    for (int t = 0; t < S; t++) {
+                        x_sum += x_group[t];
+                    }
+                }
+                const quant::Params& p = row_params != nullptr ? row_params[i] : input;
+                const int32_t* a = acc + (size_t)i * out_features;
+                float* o = out + (size_t)i * out_features;
+                for (int j = 0; j < out_features; j++) {
+                    size_t wg = (size_t)j * G + g;
+                    int32_t z_w = weight_.zero_points[wg];
+                    int32_t v = a[j] - z_w * x_sum - p.zero_point * weight_.sums[wg] + S * p.zero_point * z_w;
+                    float r = p.scale * weight_.scales[wg] * (float)v;
+                    o[j] = g == 0 ? r : o[j] + r;
+                }
+            }
+        });
+    }
+
+    if (!bias.empty() || q != nullptr) {
+        float inv_scale = 1.0f / output_params.scale;
+        parallel::parallel_for(0, N, std::max(1, (1 << 14) / std::max(1, out_features)),
+                               [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; i++) {
+                float* o = out + (size_t)i * out_features;
+                if (!bias.empty()) {
+                    for (int j = 0; j < out_features; j++) {
+                        o[j] += bias[j];
+                    }
+                }
+                if (q != nullptr) {
+                    int8_t* r = q + (size_t)i * out_features;
+                    for (int j = 0; j < out_features; j++) {
+                        r[j] = (int8_t)quant::quantize(o[j], inv_scale, output_params.zero_point, -128, 127);
+                    }
+                }
+            }
+        });
+    }
+}
+
+void QuantizedLinear::runPerRow(const float* x, int N, float* y, float* workspace) const {
+    const int K = in_features, M = out_features;
+    uint8_t* x_q = reinterpret_cast<uint8_t*>(workspace);
+    size_t x_floats = ((size_t)N * K + sizeof(float) - 1) / sizeof(float);
+    int32_t* acc = reinterpret_cast<int32_t*>(workspace + x_floats);
+    quant::Params* params = reinterpret_cast<quant::Params*>(workspace + x_floats + (size_t)N * M);
+
+    auto quantizeRows = [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; i++) {
+            const float* row = x + (size_t)i * K;
+            params[i] = quant::chooseParamsU8(row, K);
+            quant::quantizeU8(row, K, params[i], x_q + (size_t)i * K);
+        }
+    };
+
+    std::vector<int> shape = {N, K};
+    PROFILE_OP("QuantizedLinear", 2.0 * N * K * M,
+               4.0 * N * K + (double)weight_.values.num_elements + 4.0 * N * M, &shape, &weight_.values.shape());
+
+    // tiles of rows whose uint8 copy and accumulators stay around 64 KB. with fewer tiles
+    // than threads the rows are quantized first and the GEMM gets the pool instead.
+    int tile = std::max(1, std::min(256, (1 << 16) / std::max(1, K + 4 * M)));
+    int64_t tiles = (N + tile - 1) / tile;
+    if (tiles < parallel::numThreads()) {
+        parallel::parallel_for(0, N, std::max(1, (1 << 14) / std::max(1, K)), quantizeRows);
+        compute(x_q, N, quant::Params(), params, y, nullptr, acc, nullptr);
+        return;
+    }
+    parallel::parallel_for(0, tiles, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t t = begin; t < end; t++) {
+            int64_t first = t * tile, last = std::min<int64_t>(N, first + tile);
+            quantizeRows(first, last);
+            // nested in the pool, the GEMM and epilogue of the tile run on this thread.
+            compute(x_q + first * K, (int)(last - first), quant::Params(), params + first, y + first * M, nullptr,
+                    acc + first * M, nullptr);
+        }
+    });
+}
+
+void QuantizedLinear::forward_into(const Tensor<uint8_t>& input, float input_scale, Tensor<float>& output,
+                                   float* workspace) {
+    outputShape(input.shape());
+    auto x = input.is_contiguous() ? input : input.contiguous();
+    int N = x.shape()[0];
+    size_t x_floats = ((size_t)N * in_features + sizeof(float) - 1) / sizeof(float);
+
+    std::shared_ptr<float[]> scratch;
+    if (workspace == nullptr) {
+        scratch = memory::allocate<float>(workspaceSize(x.shape()));
+        workspace = scratch.get();
+    }
+    quant::Params params;
+    params.scale = input_scale;
+    run(&x.data_[x.offset()], N, params, nullptr, &output.data_[output.offset()], nullptr,
+        reinterpret_cast<int32_t*>(workspace + x_floats), nullptr);
+}
+
+void QuantizedLinear::forward_into(const Tensor<float>& input, Tensor<float>& output, float* workspace) {
+    outputShape(input.shape());
+    auto x = input.is_contiguous() ? input : input.contiguous();
+    int N = x.shape()[0];
+    size_t n = (size_t)N * in_features;
+    size_t x_floats = (n + sizeof(float) - 1) / sizeof(float);
+
+    std::shared_ptr<float[]> scratch;
+    if (workspace == nullptr) {
+        scratch = memory::allocate<float>(workspaceSize(x.shape()));
+        workspace = scratch.get();
+    }
+    // the static params, else per row or the whole batch with one scale.
+    const float* x_ptr = &x.data_[x.offset()];
+    if (per_row_activations && !has_input_params) {
+        runPerRow(x_ptr, N, &output.data_[output.offset()], workspace);
+        return;
+    }
+    quant::Params params = has_input_params ? input_params : quant::chooseParamsU8(x_ptr, n);
+    uint8_t* x_q = reinterpret_cast<uint8_t*>(workspace);
+    quant::quantizeU8(x_ptr, n, params, x_q);
+    run(x_q, N, params, nullptr, &output.data_[output.offset()], nullptr,
+        reinterpret_cast<int32_t*>(workspace + x_floats), nullptr);
+}
+
+Tensor<float> QuantizedLinear::forward(const Tensor<float>& input) {
+    Tensor<float> output(outputShape(input.shape()));
+    forward_into(input, output, nullptr);
+    return output;
+}
+
+Tensor<float> QuantizedLinear::forward(const Tensor<uint8_t>& input, float input_scale, int32_t input_zero_point) {
+    Tensor<float> output(outputShape(input.shape()));
+    if (input_zero_point == 0) {
+        forward_into(input, input_scale, output, nullptr);
+        return output;
+    }
+    auto x = input.is_contiguous() ? input : input.contiguous();
+    int N = x.shape()[0];
+    auto acc = memory::allocate<int32_t>((size_t)N * out_features);
+    run(&x.data_[x.offset()], N, {input_scale, input_zero_point}, nullptr, &output.data_[0], nullptr, acc.get(),
+        nullptr);
+    return output;
+}
+
+Tensor<int8_t> QuantizedLinear::forwardQuantized(const Tensor<uint8_t>& input, float input_scale,
+                                                 int32_t input_zero_point) {
+    if (!has_output_params) {
+        throw std::invalid_argument("QuantizedLinear: forwardQuantized needs setOutputParams first");
+    }
+    Tensor<int8_t> output(outputShape(input.shape()));
+    auto x = input.is_contiguous() ? input : input.contiguous();
+    int N = x.shape()[0];
+    auto acc = memory::allocate<int32_t>((size_t)N * out_features);
+    auto y = memory::allocate<float>((size_t)N * out_features);
+    run(&x.data_[x.offset()], N, {input_scale, input_zero_point}, nullptr, nullptr, &output.data_[0], acc.get(),
+        y.get());
+    output.scale = output_params.scale;
+    output.zero_point = output_params.zero_point;
+    return output;
+}
+
+Tensor<int8_t> QuantizedLinear::forwardQuantized(const Tensor<int8_t>& input) {
+    // int8 q with zero point z is uint8 q + 128 with zero point z + 128.
+    outputShape(input.shape());
+    auto x = input.is_contiguous() ? input : input.contiguous();
+    Tensor<uint8_t> shifted(x.shape());
+    const int8_t* src = &x.data_[x.offset()];
+    for (int i = 0; i < x.num_elements; i++) {
+        shifted.data_[i] = (uint8_t)(src[i] + 128);
+    }
+    return forwardQuantized(shifted, input.scale, input.zero_point + 128);
+}
+
+Tensor<int> QuantizedLinear::predict(const Tensor<uint8_t>& input, float input_scale, int32_t input_zero_point) {
+    outputShape(input.shape());
+    auto x = input.is_contiguous() ? input : input.contiguous();
+    const int N = x.shape()[0], M = out_features, G = weight_.groups, S = weight_.group_size;
+    const uint8_t* x_ptr = &x.data_[x.offset()];
+    const int8_t* w = &weight_.values.data_[0];
+
+    std::vector<int> shape = {N, in_features};
+    PROFILE_OP("QuantizedLinear", 2.0 * N * in_features * M,
+               (double)N * in_features + (double)weight_.values.num_elements + 4.0 * N, &shape,
+               &weight_.values.shape());
+
+    // an output's accumulators stay below in_features * 2^16, the multipliers get the
+    // bits the int64 sums have left, at most 30.
+    int bits = 0;
+    while (((int64_t)1 << bits) < in_features) {
+        bits++;
+    }
+    int shift = std::max(0, std::min(30, 45 - bits));
+    float max_scale = *std::max_element(weight_.scales.begin(), weight_.scales.end());
+    if (!(max_scale > 0.0f)) {
+        max_scale = 1.0f;
+    }
+    std::vector<int64_t> multipliers(weight_.scales.size());
+    for (size_t i = 0; i < multipliers.size(); i++) {
+        multipliers[i] = std::llround(std::ldexp(weight_.scales[i] / max_scale, shift));
+    }
+    // in units of input_scale * max_scale / 2^shift, like the weighed accumulators.
+    std::vector<int64_t> bias_q(M, 0);
+    for (size_t j = 0; j < bias.size(); j++) {
+        bias_q[j] = std::llround(std::ldexp(bias[j] / (input_scale * max_scale), shift));
+    }
+
+    Tensor<int> result(std::vector<int>{N});
+    auto acc = memory::allocate<int32_t>((size_t)N * M);
+    std::shared_ptr<int64_t[]> total;
+    if (G > 1) {
+        total = memory::allocate<int64_t>((size_t)N * M);
+    }
+    const auto& k = kernels::active();
+    for (int g = 0; g < G; g++) {
+        k.gemm_nt_u8s8i32(N, M, S, x_ptr + (size_t)g * S, in_features, w + (size_t)g * S, in_features, acc.get(), M);
+
+        int row_work = std::max(1, M * (weight_.symmetric ? 1 : S));
+        parallel::parallel_for(0, N, std::max(1, (1 << 14) / row_work), [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; i++) {
+                int32_t x_sum = 0;
+                if (!weight_.symmetric) {
+                    const uint8_t* x_group = x_ptr + (size_t)i * in_features + (size_t)g * S;
+                    for (int t = 0; t < S; t++) {
+                        x_sum += x_group[t];
+                    }
+                }
+                const int32_t* a = acc.get() + (size_t)i * M;
+                int64_t* sums = G > 1 ? total.get() + (size_t)i * M : nullptr;
+                int max_index = 0;
+                int64_t max_value = 0;
+                for (int j = 0; j < M; j++) {
+                    size_t wg = (size_t)j * G + g;
+                    int32_t z_w = weight_.zero_points[wg];
+                    int32_t v = a[j] - z_w * x_sum - input_zero_point * weight_.sums[wg] + S * input_zero_point * z_w;
+                    int64_t t = (int64_t)v * multipliers[wg] + (g == 0 ? bias_q[j] : sums[j]);
+                    if (g < G - 1) {
+                        sums[j] = t;
+                    } else if (j == 0 || t > max_value) {
+                        max_value = t;
+                        max_index = j;
+                    }
+                }
+                if (g == G - 1) {
+                    result.data_[i] = max_index;
+                }
+            }
+        });
+    }
+    return result;
+}
+
+} // namespace nn
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Deterministic test data and comparisons shared by the tests.
+ *
+ * pattern() is the plain case, values on a grid in [-1, 1] around 0.
+ * shifted() maps it onto a range away from 0, for zero points.
+ * outliers() adds a few far values, for the observers and calibration.
+ * pruned() zeros it in blocks, for the sparse formats.
+ */
+
+// k / 11 for k in [-11, 11], repeating every 23 elements.
+inline Tensor<float> pattern(const std::vector<int>& shape, int seed) {
+    Tensor<float> tensor(shape);
+    for (int i = 0; i < tensor.num_elements; i++) {
+        tensor.data_[i] = ((i * 7 + seed * 13) % 23 - 11) / 11.0f;
+    }
+    return tensor;
+}
+
+// pattern mapped onto [lo, hi].
+inline Tensor<float> shifted(const std::vector<int>& shape, int seed, float lo, float hi) {
+    Tensor<float> tensor = pattern(shape, seed);
+    for (int i = 0; i < tensor.num_elements; i++) {
+        tensor.data_[i] = lo + (tensor.data_[i] + 1.0f) / 2.0f * (hi - lo);
+    }
+    return tensor;
+}
+
+// pattern with one value in every `every` replaced by +magnitude or -magnitude in turn.
+inline Tensor<float> outliers(const std::vector<int>& shape, int seed, int every, float magnitude) {
+    Tensor<float> tensor = pattern(shape, seed);
+    for (int i = seed % every; i < tensor.num_elements; i += every) {
+        tensor.data_[i] = i / every % 2 == 0 ? magnitude : -magnitude;
+    }
+    return tensor;
+}
+
+// pattern (rows, cols) with one block of block_rows x block_cols in keep left, the
+// others zeroed.
+inline Tensor<float> pruned(const std::vector<int>& shape, int seed, int keep, int block_rows, int block_cols) {
+    Tensor<float> w = pattern(shape, seed);
+    int cols = shape[1];
+    for (int i = 0; i < w.num_elements; i++) {
+        int r = i / cols / block_rows, c = i % cols / block_cols;
+        if ((r * 31 + c * 17 + seed) % keep != 0) w.data_[i] = 0.0f;
+    }
+    return w;
+}
+
+inline Tensor<uint8_t> pixels(const std::vector<int>& shape, int seed = 0) {
+    Tensor<uint8_t> tensor(shape);
+    for (int i = 0; i < tensor.num_elements; i++) {
+        tensor.data_[i] = (i * 37 + seed * 11) % 256;
+    }
+    return tensor;
+}
+
+// largest absolute difference, a and b of the same shape and contiguous from their offset.
+inline float maxError(const Tensor<float>& a, const Tensor<float>& b) {
+    assert(a.shape() == b.shape());
+    float error = 0;
+    for (int i = 0; i < a.num_elements; i++) {
+        error = std::max(error, std::fabs(a.data_[a.offset() + i] - b.data_[b.offset() + i]));
+    }
+    return error;
+}
+
+inline void assertClose(const Tensor<float>& a, const Tensor<float>& b, float tolerance = 1e-4f) {
+    assert(maxError(a, b) < tolerance);
+}
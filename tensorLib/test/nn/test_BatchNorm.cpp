@@ -0,0 +1,141 @@
+#include "Tensor.hpp"
+#include "nn/modules.hpp"
+#include "nn/Sequential.hpp"
+#include "../TestUtils.hpp"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+// positive, for the running variance.
+Tensor<float> positive(int n, int seed) {
+    Tensor<float> tensor({n});
+    for (int i = 0; i < n; i++) {
+        tensor.data_[i] = 0.25f + ((i * 5 + seed) % 7) / 4.0f;
+    }
+    return tensor;
+}
+
+nn::BatchNorm2d<float> batchNorm2d(int C) {
+    return nn::BatchNorm2d<float>(C, pattern({C}, 1), pattern({C}, 2), pattern({C}, 3), positive(C, 4));
+}
+
+void test_forward() {
+    int C = 3;
+    auto bn = batchNorm2d(C);
+    Tensor<float> x = pattern({2, C, 4, 5}, 5);
+    Tensor<float> y = bn.forward(x);
+
+    Tensor<float> gamma = pattern({C}, 1), beta = pattern({C}, 2), mean = pattern({C}, 3), var = positive(C, 4);
+    for (int i = 0; i < x.num_elements; i++) {
+        int c = (i / 20) % C;
+        float expected = (x.data_[i] - mean.data_[c]) / std::sqrt(var.data_[c] + 1e-5f) * gamma.data_[c] + beta.data_[c];
+        assert(std::fabs(y.data_[i] - expected) < 1e-4f);
+    }
+
+    // ranks are checked, 1d takes (N, C) and (N, C, L).
+    nn::BatchNorm1d<float> bn1(C, pattern({C}, 1), pattern({C}, 2), pattern({C}, 3), positive(C, 4));
+    assert(bn1.forward(pattern({4, C}, 6)).shape() == std::vector<int>({4, C}));
+    assert(bn1.forward(pattern({4, C, 7}, 6)).shape() == std::vector<int>({4, C, 7}));
+    try {
+        bn.forward(pattern({4, C}, 6));
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+    try {
+        nn::BatchNorm2d<float>(C, pattern({C + 1}, 1), pattern({C}, 2), pattern({C}, 3), positive(C, 4));
+        assert(false);
+    } catch (const std::invalid_argument&) {
+    }
+
+    std::cout << "forward test passed!" << std::endl;
+}
+
+void test_bias() {
+    // the bias reaches every path: float, uint8 input and the strided fallback.
+    Tensor<float> w = pattern({4, 2, 3, 3}, 7), b = pattern({4}, 8);
+    nn::Conv2d<float> plain(2, 4, 3, 1, 1, Tensor<float>(w));
+    nn::Conv2d<float> biased(2, 4, 3, 1, 1, Tensor<float>(w), Tensor<float>(b));
+    Tensor<float> x = pattern({3, 2, 6, 6}, 9);
+    Tensor<float> y = biased.forward(x), y0 = plain.forward(x);
+    for (int i = 0; i < y.num_elements; i++) {
+        assert(std::fabs(y.data_[i] - y0.data_[i] - b.data_[(i / 36) % 4]) < 1e-4f);
+    }
+    Tensor<uint8_t> pixels({3, 2, 6, 6});
+    Tensor<float> pixels_float({3, 2, 6, 6});
+    for (int i = 0; i < pixels.num_elements; i++) {
+        pixels.data_[i] = (i * 37) % 256;
+        pixels_float.data_[i] = pixels.data_[i] / 255.0f;
+    }
+    assertClose(biased.forward(pixels, 1.0f / 255.0f), biased.forward(pixels_float));
+
+    Tensor<float> fw = pattern({5, 8}, 10), fb = pattern({5}, 11);
+    nn::Linear<float> fc(8, 5, Tensor<float>(fw), Tensor<float>(fb));
+    nn::Linear<float> fc0(8, 5, Tensor<float>(fw));
+    Tensor<float> in = pattern({6, 8}, 12);
+    Tensor<float> out = fc.forward(in), out0 = fc0.forward(in);
+    for (int i = 0; i < out.num_elements; i++) {
+        assert(std::fabs(out.data_[i] - out0.data_[i] - fb.data_[i % 5]) < 1e-4f);
+    }
+
+    try {
+        nn::Linear<float>(8, 5, pattern({5, 8}, 1), pattern({4}, 1));
+        assert(false);
+    } catch (const std::invalid_argument&) {
+    }
+    try {
+        nn::Linear<int>(8, 5, Tensor<int>({5, 8}), Tensor<int>({5}));
+        assert(false);
+    } catch (const std::invalid_argument&) {
+    }
+
+    std::cout << "bias test passed!" << std::endl;
+}
+
+void test_fold() {
+    // conv -> bn -> relu -> flatten -> linear -> bn1d
+    auto conv = std::make_shared<nn::Conv2d<float>>(2, 4, 3, 1, 1, pattern({4, 2, 3, 3}, 13));
+    nn::Sequential<float> model;
+    model.add(conv)
+         .add(batchNorm2d(4))
+         .add(nn::ReLU<float>())
+         .add(nn::Flatten<float>())
+         .add(nn::Linear<float>(4 * 6 * 6, 5, pattern({5, 4 * 6 * 6}, 14), pattern({5}, 15)))
+         .add(nn::BatchNorm1d<float>(5, pattern({5}, 16), pattern({5}, 17), pattern({5}, 18), positive(5, 19)));
+
+    Tensor<float> x = pattern({7, 2, 6, 6}, 20);
+    Tensor<float> expected = model.forward(x);
+    Tensor<float> conv_before = conv->forward(x);
+
+    assert(model.foldBatchNorm() == 2);
+    assert(model.size() == 4);
+    assert(model[0].name() == std::string("Conv2d") && model[3].name() == std::string("Linear"));
+    assertClose(model.forward(x), expected);
+    assert(model.foldBatchNorm() == 0);
+
+    // the shared conv layer is left as it was.
+    assertClose(conv->forward(x), conv_before);
+
+    // by hand, on a layer.
+    nn::Conv2d<float> c(2, 4, 3, 1, 1, pattern({4, 2, 3, 3}, 13));
+    auto bn = batchNorm2d(4);
+    Tensor<float> reference = bn.forward(c.forward(x));
+    c.foldBatchNorm(bn);
+    assertClose(c.forward(x), reference);
+    try {
+        c.foldBatchNorm(batchNorm2d(3));
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+
+    std::cout << "fold test passed!" << std::endl;
+}
+
+int main() {
+    test_forward();
+    test_bias();
+    test_fold();
+    return 0;
+}
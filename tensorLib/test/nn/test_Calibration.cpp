@@ -0,0 +1,122 @@
+#include "Tensor.hpp"
+#include "Memory.hpp"
+#include "nn/modules.hpp"
+#include "nn/QuantizedConv2d.hpp"
+#include "nn/QuantizedLinear.hpp"
+#include "nn/Sequential.hpp"
+#include "nn/Calibration.hpp"
+#include "../TestUtils.hpp"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <memory>
+
+void test_static() {
+    // with static input params a row's result no longer depends on the rest of the batch.
+    const int K = 16, H = 32, M = 4;
+    Tensor<float> w1 = pattern({H, K}, 1), w2 = pattern({M, H}, 2);
+    auto fc1 = std::make_shared<nn::QuantizedLinear>(K, H, w1);
+    auto fc2 = std::make_shared<nn::QuantizedLinear>(H, M, w2);
+    nn::Sequential<float> model;
+    model.add(fc1).add(nn::ReLU<float>()).add(fc2);
+    nn::Linear<float> fc1_f(K, H, Tensor<float>(w1)), fc2_f(H, M, Tensor<float>(w2));
+
+    Tensor<float> batch = pattern({8, K}, 3), outlier = pattern({9, K}, 3);
+    for (int k = 0; k < K; k++) outlier.data_[8 * K + k] = 50.0f;
+    auto first_row = [&](const Tensor<float>& x) {
+        Tensor<float> y = model.forward(x).slice(0, 1, 0);
+        return y.contiguous();
+    };
+    assert(maxError(first_row(batch), first_row(outlier)) > 1e-3f);
+
+    std::vector<Tensor<float>> samples = {pattern({32, K}, 4), pattern({32, K}, 5)};
+    int calibrated = nn::calibrate(model, samples, {quant::CalibrationMethod::MinMax});
+    assert(calibrated == 2);
+    assert(maxError(first_row(batch), first_row(outlier)) == 0.0f);
+
+    // close to the float model over the calibrated range.
+    Tensor<float> h_f = fc1_f.forward(batch);
+    for (int i = 0; i < h_f.num_elements; i++) h_f.data_[i] = std::max(0.0f, h_f.data_[i]);
+    Tensor<float> y_f = fc2_f.forward(h_f);
+    float largest = 0;
+    for (int i = 0; i < y_f.num_elements; i++) largest = std::max(largest, std::fabs(y_f.data_[i]));
+    float error = maxError(model.forward(batch), y_f);
+    std::cout << "calibrated error: " << error << " of " << largest << std::endl;
+    assert(error < 0.02f * largest);
+
+    // the output params are frozen too, for the int8 path.
+    Tensor<int8_t> h = fc1->forwardQuantized(pixels({2, K}, 1), 1.0f / 255.0f);
+    assert(h.scale > 0.0f);
+
+    std::cout << "static test passed!" << std::endl;
+}
+
+void test_methods() {
+    // pixels into a conv with a fused ReLU, the Linear input calibrated by each method.
+    Tensor<float> w1 = pattern({4, 1, 3, 3}, 6), w2 = pattern({10, 4 * 8 * 8}, 7);
+    std::vector<Tensor<uint8_t>> samples = {pixels({16, 1, 8, 8}, 1), pixels({16, 1, 8, 8}, 2)};
+    Tensor<uint8_t> x = pixels({8, 1, 8, 8}, 3);
+
+    nn::Sequential<float> reference;
+    reference.add(nn::Conv2d<float>(1, 4, 3, 1, 1, Tensor<float>(w1)))
+             .add(nn::ReLU<float>())
+             .add(nn::Flatten<float>())
+             .add(nn::Linear<float>(256, 10, Tensor<float>(w2)));
+    Tensor<float> expected = reference.forward(x, 1.0f / 255.0f);
+    float largest = 0;
+    for (int i = 0; i < expected.num_elements; i++) largest = std::max(largest, std::fabs(expected.data_[i]));
+
+    for (auto method : {quant::CalibrationMethod::MinMax, quant::CalibrationMethod::Percentile,
+                        quant::CalibrationMethod::Entropy}) {
+        auto conv = std::make_shared<nn::QuantizedConv2d>(1, 4, 3, 1, 1, w1);
+        conv->setReLU(true);
+        nn::Sequential<float> model;
+        model.add(conv).add(nn::Flatten<float>()).add(nn::QuantizedLinear(256, 10, w2));
+        assert(nn::calibrate(model, samples, 1.0f / 255.0f, {method, 99.9f}) == 2);
+        float error = maxError(model.forward(x, 1.0f / 255.0f), expected);
+        std::cout << "method " << (int)method << " error: " << error << " of " << largest << std::endl;
+        // without outliers to clip, entropy trades some of the real tail for finer steps.
+        assert(error < (method == quant::CalibrationMethod::Entropy ? 0.06f : 0.03f) * largest);
+        conv->forwardQuantized(x, 1.0f / 255.0f);
+    }
+
+    // a calibrated model still plans and runs without allocating.
+    nn::Sequential<float> model;
+    model.add(nn::QuantizedConv2d(1, 4, 3, 1, 1, w1)).add(nn::Flatten<float>()).add(nn::QuantizedLinear(256, 10, w2));
+    nn::calibrate(model, samples, 1.0f / 255.0f);
+    model.forward(x, 1.0f / 255.0f);
+    int64_t allocs = memory::stats().allocs;
+    model.forward(x, 1.0f / 255.0f);
+    assert(memory::stats().allocs == allocs);
+
+    std::cout << "methods test passed!" << std::endl;
+}
+
+void test_outliers() {
+    // samples with a few far values: min/max spends the 256 steps on them, the percentile
+    // clips them and keeps the typical inputs precise. (entropy sees no loss in the full
+    // range of values this evenly spaced, test_Observer checks it on a smooth bulk.)
+    const int K = 32, M = 8;
+    Tensor<float> w = pattern({M, K}, 8);
+    std::vector<Tensor<float>> samples = {outliers({256, K}, 1, 2999, 40.0f), outliers({256, K}, 2, 2999, 40.0f)};
+    Tensor<float> x = pattern({16, K}, 9);
+    Tensor<float> expected = nn::Linear<float>(K, M, Tensor<float>(w)).forward(x);
+
+    float errors[2];
+    for (auto method : {quant::CalibrationMethod::MinMax, quant::CalibrationMethod::Percentile}) {
+        nn::Sequential<float> model;
+        model.add(nn::QuantizedLinear(K, M, w));
+        nn::calibrate(model, samples, {method, 99.9f});
+        errors[(int)method] = maxError(model.forward(x), expected);
+    }
+    std::cout << "error: " << errors[0] << " min/max, " << errors[1] << " percentile" << std::endl;
+    assert(errors[1] * 4 < errors[0]);
+    std::cout << "outliers test passed!" << std::endl;
+}
+
+int main() {
+    test_static();
+    test_methods();
+    test_outliers();
+    return 0;
+}
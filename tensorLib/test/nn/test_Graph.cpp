@@ -0,0 +1,183 @@
+#include "Tensor.hpp"
+#include "Memory.hpp"
+#include "nn/Graph.hpp"
+#include "nn/modules.hpp"
+#include "../TestUtils.hpp"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+// conv -> relu -> maxpool -> conv -> relu -> flatten -> linear, with C_out conv channels.
+struct Model {
+    int C_in, C_out, H;
+    Tensor<float> w1, w2, fc;
+
+    Model(int C_in, int C_out, int H)
+        : C_in(C_in), C_out(C_out), H(H),
+          w1(pattern({C_out, C_in, 3, 3}, 1)),
+          w2(pattern({C_out, C_out, 3, 3}, 2)),
+          fc(pattern({10, C_out * (H / 2) * (H / 2)}, 3)) {}
+
+    void build(nn::Graph& g) const {
+        auto x = g.input();
+        auto h = g.maxPool2d(g.relu(g.conv2d(x, w1, 1, 1)), 2);
+        h = g.relu(g.conv2d(h, w2, 1, 1));
+        g.output(g.linear(g.flatten(h), fc));
+    }
+
+    Tensor<float> byHand(const Tensor<float>& x) const {
+        nn::Conv2d<float> conv1(C_in, C_out, 3, 1, 1, Tensor<float>(w1));
+        nn::Conv2d<float> conv2(C_out, C_out, 3, 1, 1, Tensor<float>(w2));
+        nn::ReLU<float> relu;
+        nn::MaxPool2d<float> pool(2);
+        nn::Linear<float> linear(C_out * (H / 2) * (H / 2), 10, Tensor<float>(fc));
+        auto h = relu.forward(conv2.forward(pool.forward(relu.forward(conv1.forward(x)))));
+        return linear.forward(h.view({x.shape()[0], C_out * (H / 2) * (H / 2)}));
+    }
+};
+
+void test_optimize() {
+    // 4 channels stay NCHW, 8 and 16 use the blocked layout.
+    for (int C_out : {4, 8, 16}) {
+        Model m(3, C_out, 8);
+        Tensor<float> x = pattern({5, 3, 8, 8}, 4);
+        Tensor<float> expected = m.byHand(x);
+
+        nn::Graph plain;
+        m.build(plain);
+        assertClose(plain.forward(x), expected, 1e-3f);
+        size_t plain_steps = plain.steps();
+
+        nn::Graph g;
+        m.build(g);
+        g.optimize();
+        assertClose(g.forward(x), expected, 1e-3f);
+        std::ostringstream os;
+        g.print(os);
+        std::cout << "C_out " << C_out << ": " << plain_steps << " steps, optimized " << g.steps() << std::endl
+                  << os.str();
+        // relu and pooling fused into the convolutions, the weight transpose folded away.
+        assert(plain_steps == 7);
+        assert(g.steps() == (C_out % 8 == 0 ? 4u : 3u));
+        assert(os.str().find("+relu +maxpool2") != std::string::npos);
+        assert((os.str().find("nchw8c") != std::string::npos) == (C_out % 8 == 0));
+
+        // each option on its own gives the same result.
+        for (int option = 0; option < 3; option++) {
+            nn::GraphOptions options;
+            options.fold_constants = option == 0;
+            options.fuse = option == 1;
+            options.select_layouts = option == 2;
+            nn::Graph partial;
+            m.build(partial);
+            partial.optimize(options);
+            assertClose(partial.forward(x), expected, 1e-3f);
+        }
+    }
+    std::cout << "optimize test passed!" << std::endl;
+}
+
+void test_constants() {
+    // (a^T)^T * b is computed once, in optimize.
+    Tensor<float> a = pattern({4, 6}, 5), b = pattern({4, 3}, 6);
+    nn::Graph g;
+    auto x = g.input();
+    auto folded = g.matmul(g.transpose(g.constant(a), 0, 1), g.constant(b));
+    g.output(g.relu(g.matmul(x, folded)));
+    g.optimize();
+
+    Tensor<float> input = pattern({5, 6}, 7);
+    Tensor<float> expected = input.matmul(a.transpose(0, 1).contiguous().matmul(b));
+    for (int i = 0; i < expected.num_elements; i++) {
+        expected.data_[i] = std::max(0.0f, expected.data_[i]);
+    }
+    assertClose(g.forward(input), expected, 1e-3f);
+    assert(g.steps() == 1);
+
+    // a graph of constants only.
+    nn::Graph c;
+    c.input();
+    c.output(c.transpose(c.constant(a), 0, 1));
+    c.optimize();
+    assertClose(c.forward(pattern({1}, 0)), a.transpose(0, 1).contiguous(), 1e-3f);
+    assert(c.steps() == 0);
+
+    std::cout << "constants test passed!" << std::endl;
+}
+
+void test_steady_state() {
+    Model m(1, 8, 12);
+    nn::Graph g;
+    m.build(g);
+    g.optimize();
+
+    Tensor<float> x = pattern({16, 1, 12, 12}, 8);
+    Tensor<float> expected = m.byHand(x);
+    g.forward(x);
+    int64_t allocs = memory::stats().allocs;
+    for (int i = 0; i < 3; i++) {
+        assertClose(g.forward(x), expected, 1e-3f);
+    }
+    assert(memory::stats().allocs == allocs);
+    std::cout << "arena: " << g.arenaBytes() << " bytes" << std::endl;
+
+    // uint8 pixels, scaled into the arena.
+    Tensor<uint8_t> p({3, 1, 12, 12});
+    Tensor<float> p_float({3, 1, 12, 12});
+    for (int i = 0; i < p.num_elements; i++) {
+        p.data_[i] = (i * 37) % 256;
+        p_float.data_[i] = p.data_[i] / 255.0f;
+    }
+    assertClose(g.forward(p, 1.0f / 255.0f), m.byHand(p_float), 1e-3f);
+
+    // another batch and back, and a copy of the result outliving the graph.
+    assertClose(g.forward(x), expected, 1e-3f);
+    Tensor<float> kept({1});
+    {
+        nn::Graph other;
+        m.build(other);
+        other.optimize();
+        kept = other.forward(x);
+    }
+    assertClose(kept, expected, 1e-3f);
+
+    std::cout << "steady state test passed!" << std::endl;
+}
+
+void test_errors() {
+    nn::Graph g;
+    auto x = g.input();
+    g.output(g.conv2d(x, pattern({4, 3, 3, 3}, 1), 1, 1));
+    try {
+        g.forward(pattern({2, 2, 8, 8}, 1));
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+    try {
+        g.input();
+        assert(false);
+    } catch (const std::invalid_argument&) {
+    }
+
+    // the MaxPool2d module on ints.
+    nn::MaxPool2d<int> pool(2);
+    Tensor<int> t({1, 1, 2, 4});
+    int values[] = {1, 5, 2, 0, 3, -1, 7, 4};
+    std::copy(values, values + 8, &t.data_[0]);
+    Tensor<int> y = pool.forward(t);
+    assert(y.shape() == std::vector<int>({1, 1, 1, 2}));
+    assert(y.data_[0] == 5 && y.data_[1] == 7);
+
+    std::cout << "errors test passed!" << std::endl;
+}
+
+int main() {
+    test_optimize();
+    test_constants();
+    test_steady_state();
+    test_errors();
+    return 0;
+}
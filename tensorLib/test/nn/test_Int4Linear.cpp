@@ -0,0 +1,85 @@
+#include "Tensor.hpp"
+#include "Memory.hpp"
+#include "Quantize.hpp"
+#include "nn/modules.hpp"
+#include "nn/Int4Linear.hpp"
+#include "nn/Sequential.hpp"
+#include "../TestUtils.hpp"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+void test_exact() {
+    // against the float Linear on the dequantized weight only float rounding is left.
+    // mostly positive weights, the asymmetric zero points sit low in [0, 15].
+    const int N = 5, K = 64, M = 11;
+    Tensor<float> w = shifted({M, K}, 1, -0.3f, 1.2f), b = pattern({M}, 2);
+    Tensor<float> x = pattern({N, K}, 3);
+    for (int group : {0, 16}) {
+        for (bool symmetric : {true, false}) {
+            nn::Int4Linear fc(K, M, w, b, {group, symmetric});
+            for (int32_t z : fc.weight().zero_points) assert(symmetric ? z == 8 : z < 5);
+            nn::Linear<float> reference(K, M, quant::dequantize(fc.weight()), Tensor<float>(b));
+            assert(maxError(fc.forward(x), reference.forward(x)) < 1e-4f);
+            assert(maxError(fc.forward(pixels({N, K}), 1.0f / 255.0f),
+                            reference.forward(pixels({N, K}), 1.0f / 255.0f)) < 1e-4f);
+        }
+    }
+    std::cout << "exact test passed!" << std::endl;
+}
+
+void test_accuracy() {
+    // 8x fewer weight bytes, smaller groups closer to the float weights.
+    const int N = 16, K = 256, M = 32;
+    Tensor<float> w = pattern({M, K}, 4);
+    for (int i = 0; i < M * K; i += 17) w.data_[i] *= 4.0f;
+    Tensor<float> x = pattern({N, K}, 5);
+    nn::Linear<float> fc(K, M, Tensor<float>(w));
+    Tensor<float> expected = fc.forward(x);
+
+    nn::Int4Linear per_row(K, M, w, {0, false}), grouped(K, M, w, {32, false});
+    assert(grouped.weight().values.num_elements * 8 == w.num_elements * 4);
+    float error_row = maxError(per_row.forward(x), expected), error_group = maxError(grouped.forward(x), expected);
+    std::cout << "max error: " << error_group << " groups of 32, " << error_row << " per row" << std::endl;
+    assert(error_group < error_row);
+
+    try {
+        nn::Int4Linear bad(K, M, w, {24, false});
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+    std::cout << "accuracy test passed!" << std::endl;
+}
+
+void test_sequential() {
+    const int K = 64;
+    Tensor<float> w = pattern({10, K}, 6);
+    nn::Sequential<float> model;
+    model.add(nn::Int4Linear(K, 10, w, {16, false})).add(nn::ReLU<float>());
+    nn::Int4Linear alone(K, 10, w, {16, false});
+
+    Tensor<uint8_t> x = pixels({20, K});
+    Tensor<float> expected = alone.forward(x, 1.0f / 255.0f);
+    model.forward(x, 1.0f / 255.0f);
+    int64_t allocs = memory::stats().allocs;
+    const Tensor<float>& y = model.forward(x, 1.0f / 255.0f);
+    assert(memory::stats().allocs == allocs);
+    for (int i = 0; i < y.num_elements; i++) {
+        assert(std::fabs(y.data_[i] - std::max(0.0f, expected.data_[i])) < 1e-5f);
+    }
+    // scratch for the scaled pixels only.
+    assert(alone.workspaceSize({20, K}) == 0 && alone.uint8WorkspaceSize({20, K}) == (size_t)20 * K);
+    size_t uint8_bytes = model.arenaBytes();
+    model.plan({20, K});
+    assert(model.arenaBytes() < uint8_bytes);
+    std::cout << "sequential test passed!" << std::endl;
+}
+
+int main() {
+    test_exact();
+    test_accuracy();
+    test_sequential();
+    return 0;
+}
@@ -0,0 +1,201 @@
+#include "Tensor.hpp"
+#include "Memory.hpp"
+#include "Quantize.hpp"
+#include "nn/modules.hpp"
+#include "nn/QuantizedConv2d.hpp"
+#include "nn/Sequential.hpp"
+#include "../TestUtils.hpp"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+// the float Conv2d on scale * (x - zero_point), with an optional ReLU.
+Tensor<float> reference(const Tensor<uint8_t>& x, float scale, int zero_point, const Tensor<float>& w,
+                        const Tensor<float>& b, int stride, int padding, bool relu) {
+    Tensor<float> xf(x.shape());
+    for (int i = 0; i < x.num_elements; i++) {
+        xf.data_[i] = scale * (x.data_[i] - zero_point);
+    }
+    int C_out = w.shape()[0], C_in = w.shape()[1], K = w.shape()[2];
+    nn::Conv2d<float> conv(C_in, C_out, K, stride, padding, Tensor<float>(w), Tensor<float>(b));
+    Tensor<float> y = conv.forward(xf);
+    for (int i = 0; relu && i < y.num_elements; i++) {
+        y.data_[i] = std::max(0.0f, y.data_[i]);
+    }
+    return y;
+}
+
+void test_exact() {
+    // against the float conv with the dequantized weight, padding holds the zero point
+    // and the corrections are exact, so only float rounding is left.
+    const int N = 3, C_in = 3, H = 9, W = 7, C_out = 5, K = 3;
+    Tensor<float> w = shifted({C_out, C_in, K, K}, 1, -0.3f, 1.2f);
+    Tensor<float> b = pattern({C_out}, 2);
+    Tensor<uint8_t> x = pixels({N, C_in, H, W});
+
+    for (bool symmetric : {true, false}) {
+        for (int stride : {1, 2}) {
+            for (int padding : {0, 1}) {
+                nn::QuantizedConv2d conv(C_in, C_out, K, stride, padding, w, b, {0, symmetric});
+                for (int32_t z : conv.weight().zero_points) assert(symmetric ? z == 0 : z < -50);
+                conv.setReLU(padding == 1);
+                Tensor<float> w_q = quant::dequantize(conv.weight()).view({C_out, C_in, K, K});
+                for (int zero_point : {0, 100}) {
+                    Tensor<float> y = conv.forward(x, 0.01f, zero_point);
+                    assert(maxError(y, reference(x, 0.01f, zero_point, w_q, b, stride, padding, padding == 1)) < 1e-3f);
+                }
+            }
+        }
+    }
+    std::cout << "exact test passed!" << std::endl;
+}
+
+void test_int8() {
+    // conv -> int8 -> conv, the first with a fused ReLU, against the float layers.
+    const int N = 2, H = 12, W = 10;
+    Tensor<float> w1 = pattern({8, 1, 3, 3}, 3), b1 = pattern({8}, 4);
+    Tensor<float> w2 = pattern({4, 8, 3, 3}, 5), b2 = pattern({4}, 6);
+    Tensor<uint8_t> x = pixels({N, 1, H, W});
+
+    nn::QuantizedConv2d conv1(1, 8, 3, 1, 1, w1, b1), conv2(8, 4, 3, 2, 1, w2, b2);
+    conv1.setReLU(true);
+    try {
+        conv1.forwardQuantized(x, 1.0f / 255.0f);
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+
+    Tensor<float> h = conv1.forward(x, 1.0f / 255.0f);
+    auto range = std::minmax_element(&h.data_[0], &h.data_[0] + h.num_elements);
+    assert(*range.first >= 0.0f);
+    conv1.setOutputParams(quant::chooseParams(*range.first, *range.second, -128, 127, false));
+    Tensor<int8_t> h_q = conv1.forwardQuantized(x, 1.0f / 255.0f);
+    assert(h_q.shape() == h.shape());
+    for (int i = 0; i < h.num_elements; i++) {
+        float back = h_q.scale * (h_q.data_[i] - h_q.zero_point);
+        assert(std::fabs(back - h.data_[i]) <= h_q.scale / 2 + 1e-5f);
+    }
+
+    // the int8 input is read as uint8 + 128, same result as its float value.
+    Tensor<float> h_back(h.shape());
+    for (int i = 0; i < h.num_elements; i++) {
+        h_back.data_[i] = h_q.scale * (h_q.data_[i] - h_q.zero_point);
+    }
+    nn::Conv2d<float> conv2_f(8, 4, 3, 2, 1, quant::dequantize(conv2.weight()).view({4, 8, 3, 3}), Tensor<float>(b2));
+    Tensor<float> y = conv2.forward(h_q);
+    assert(maxError(y, conv2_f.forward(h_back)) < 1e-3f);
+
+    conv2.setOutputParams({0.05f, -3});
+    Tensor<int8_t> y_q = conv2.forwardQuantized(h_q);
+    for (int i = 0; i < y.num_elements; i++) {
+        assert(std::fabs(0.05f * (y_q.data_[i] + 3) - y.data_[i]) <= 0.025f + 1e-4f);
+    }
+
+    // and the whole int8 path stays close to the float model.
+    nn::Conv2d<float> conv1_f(1, 8, 3, 1, 1, Tensor<float>(w1), Tensor<float>(b1));
+    nn::Conv2d<float> conv2_float(8, 4, 3, 2, 1, Tensor<float>(w2), Tensor<float>(b2));
+    Tensor<float> xf(x.shape());
+    for (int i = 0; i < x.num_elements; i++) xf.data_[i] = x.data_[i] / 255.0f;
+    Tensor<float> h_f = conv1_f.forward(xf);
+    for (int i = 0; i < h_f.num_elements; i++) h_f.data_[i] = std::max(0.0f, h_f.data_[i]);
+    float error = maxError(y, conv2_float.forward(h_f));
+    std::cout << "two layer int8 error: " << error << std::endl;
+    assert(error < 0.1f);
+
+    std::cout << "int8 test passed!" << std::endl;
+}
+
+void test_int8_chain() {
+    // the int8 output of a conv without fused ReLU has a zero point far from 0, ReLU,
+    // MaxPool2d and Flatten on it must agree with the float layers.
+    const int N = 2, C = 6, H = 10, W = 8;
+    Tensor<float> w = pattern({C, 1, 3, 3}, 8), b = pattern({C}, 9);
+    Tensor<uint8_t> x = pixels({N, 1, H, W});
+    nn::QuantizedConv2d conv(1, C, 3, 1, 1, w, b);
+    Tensor<float> h = conv.forward(x, 1.0f / 255.0f);
+    auto range = std::minmax_element(&h.data_[0], &h.data_[0] + h.num_elements);
+    auto params = quant::chooseParams(*range.first, *range.second, -128, 127, false);
+    assert(*range.first < 0.0f && params.zero_point != 0);
+    conv.setOutputParams(params);
+    Tensor<int8_t> h_q = conv.forwardQuantized(x, 1.0f / 255.0f);
+    assert(h_q.zero_point == params.zero_point);
+
+    nn::ReLU<int8_t> relu;
+    nn::MaxPool2d<int8_t> pool(2);
+    nn::Flatten<int8_t> flatten;
+    Tensor<int8_t> y_q = flatten.forward(pool.forward(relu.forward(h_q)));
+    assert(y_q.scale == params.scale && y_q.zero_point == params.zero_point);
+
+    // forward_into, ReLU in place as in a Sequential.
+    Tensor<int8_t> pooled(pool.outputShape(h_q.shape())), flat(flatten.outputShape(pooled.shape()));
+    relu.forward_into(h_q, h_q, nullptr);
+    pool.forward_into(h_q, pooled, nullptr);
+    flatten.forward_into(pooled, flat, nullptr);
+    assert(flat.scale == params.scale && flat.zero_point == params.zero_point);
+
+    nn::ReLU<float> relu_f;
+    nn::MaxPool2d<float> pool_f(2);
+    nn::Flatten<float> flatten_f;
+    Tensor<float> y = flatten_f.forward(pool_f.forward(relu_f.forward(h)));
+    assert(y_q.shape() == y.shape() && flat.shape() == y.shape());
+    for (int i = 0; i < y.num_elements; i++) {
+        assert(flat.data_[i] == y_q.data_[i]);
+        float back = y_q.scale * (y_q.data_[i] - y_q.zero_point);
+        assert(std::fabs(back - y.data_[i]) <= params.scale / 2 + 1e-5f);
+    }
+    std::cout << "int8 chain test passed!" << std::endl;
+}
+
+void test_errors() {
+    Tensor<float> w = pattern({2, 3, 3, 3}, 7);
+    try {
+        nn::QuantizedConv2d conv(3, 2, 3, 1, 0, w, {9, true});
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+    try {
+        nn::QuantizedConv2d conv(3, 2, 5, 1, 0, w);
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+    nn::QuantizedConv2d conv(3, 2, 3, 1, 0, w);
+    try {
+        conv.forward(pixels({2, 4, 5, 5}));
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+    std::cout << "errors test passed!" << std::endl;
+}
+
+void test_sequential() {
+    // a Module<float>, float input quantized per tensor, no allocation once planned.
+    Tensor<float> w = pattern({6, 2, 3, 3}, 8);
+    nn::Sequential<float> model;
+    model.add(nn::QuantizedConv2d(2, 6, 3, 1, 1, w)).add(nn::ReLU<float>());
+    nn::QuantizedConv2d alone(2, 6, 3, 1, 1, w);
+
+    Tensor<float> x = pattern({4, 2, 8, 8}, 9);
+    Tensor<float> expected = alone.forward(x);
+    model.forward(x);
+    int64_t allocs = memory::stats().allocs;
+    const Tensor<float>& y = model.forward(x);
+    assert(memory::stats().allocs == allocs);
+    for (int i = 0; i < y.num_elements; i++) {
+        assert(std::fabs(y.data_[i] - std::max(0.0f, expected.data_[i])) < 1e-5f);
+    }
+    std::cout << "sequential test passed!" << std::endl;
+}
+
+int main() {
+    test_exact();
+    test_int8();
+    test_int8_chain();
+    test_errors();
+    test_sequential();
+    return 0;
+}
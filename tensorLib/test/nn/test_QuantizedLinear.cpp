@@ -0,0 +1,256 @@
+#include "Tensor.hpp"
+#include "Memory.hpp"
+#include "Quantize.hpp"
+#include "nn/modules.hpp"
+#include "nn/QuantizedLinear.hpp"
+#include "nn/QuantizedConv2d.hpp"
+#include "nn/Sequential.hpp"
+#include "ThreadPool.hpp"
+#include "../TestUtils.hpp"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+// x (N, K) uint8 read as scale * (x - zero_point), times w^T.
+Tensor<float> reference(const Tensor<uint8_t>& x, float scale, int zero_point, const Tensor<float>& w) {
+    int N = x.shape()[0], K = x.shape()[1], M = w.shape()[0];
+    Tensor<float> y({N, M});
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < M; j++) {
+            double sum = 0;
+            for (int k = 0; k < K; k++) {
+                sum += scale * (x.data_[i * K + k] - zero_point) * (double)w.data_[j * K + k];
+            }
+            y.data_[i * M + j] = (float)sum;
+        }
+    }
+    return y;
+}
+
+void test_exact() {
+    // with the dequantized weight as reference the only error left is float rounding,
+    // so the zero point corrections must be exact. The weights are mostly positive, the
+    // asymmetric zero points far from 0.
+    const int N = 7, K = 64, M = 9;
+    Tensor<float> w = shifted({M, K}, 1, -0.3f, 1.2f);
+    Tensor<uint8_t> x = pixels({N, K});
+
+    for (int group : {0, 16}) {
+        for (bool symmetric : {true, false}) {
+            nn::QuantizedLinear fc(K, M, w, {group, symmetric});
+            for (int32_t z : fc.weight().zero_points) assert(symmetric ? z == 0 : z < -50);
+            Tensor<float> w_q = quant::dequantize(fc.weight());
+            for (int zero_point : {0, 100}) {
+                Tensor<float> y = fc.forward(x, 0.01f, zero_point);
+                assert(maxError(y, reference(x, 0.01f, zero_point, w_q)) < 1e-3f);
+            }
+        }
+    }
+    std::cout << "exact test passed!" << std::endl;
+}
+
+void test_predict() {
+    // the integer argmax against the argmax of the exact outputs, rows scaled apart so
+    // the multipliers matter. near ties are left out.
+    const int N = 64, K = 64, M = 9;
+    Tensor<float> w = pattern({M, K}, 7), b = pattern({M}, 8);
+    for (int j = 0; j < K; j++) {
+        w.data_[3 * K + j] *= 4.0f;
+        w.data_[5 * K + j] *= 0.25f;
+    }
+    Tensor<uint8_t> x({N, K});
+    for (int i = 0; i < x.num_elements; i++) x.data_[i] = (i * 53 + i / K * 11) % 256;
+
+    int checked = 0;
+    for (int group : {0, 16}) {
+        for (bool symmetric : {true, false}) {
+            nn::QuantizedLinear fc(K, M, w, b, {group, symmetric});
+            for (int zero_point : {0, 100}) {
+                Tensor<int> pred = fc.predict(x, 0.01f, zero_point);
+                Tensor<float> y = reference(x, 0.01f, zero_point, quant::dequantize(fc.weight()));
+                for (int i = 0; i < N; i++) {
+                    float* row = &y.data_[i * M];
+                    for (int j = 0; j < M; j++) row[j] += b.data_[j];
+                    int best = 0;
+                    for (int j = 1; j < M; j++) best = row[j] > row[best] ? j : best;
+                    float second = -1e30f;
+                    for (int j = 0; j < M; j++) second = j != best ? std::max(second, row[j]) : second;
+                    if (row[best] - second < 1e-3f) continue;
+                    assert(pred.data_[i] == best);
+                    checked++;
+                }
+            }
+        }
+    }
+    assert(checked > 7 * N);
+    std::cout << "predict test passed!" << std::endl;
+}
+
+void test_accuracy() {
+    // against the float Linear, per row scales beat the single Tensor::quantize scale.
+    const int N = 16, K = 128, M = 10;
+    Tensor<float> w = pattern({M, K}, 2);
+    for (int j = 0; j < K; j++) w.data_[j] *= 20.0f;
+    Tensor<float> b = pattern({M}, 3);
+    Tensor<uint8_t> x = pixels({N, K});
+
+    nn::Linear<float> fc(K, M, Tensor<float>(w), Tensor<float>(b));
+    Tensor<float> expected = fc.forward(x, 1.0f / 255.0f);
+
+    nn::QuantizedLinear q(K, M, w, b);
+    float error = maxError(q.forward(x, 1.0f / 255.0f), expected);
+
+    nn::Linear<int> whole(K, M, w.quantize());
+    Tensor<float> y_whole = whole.forward(x, 1.0f / 255.0f).dequantize();
+    for (int i = 0; i < y_whole.num_elements; i++) y_whole.data_[i] += b.data_[i % M];
+    float error_whole = maxError(y_whole, expected);
+    std::cout << "max error: " << error << " per row, " << error_whole << " per tensor" << std::endl;
+    assert(error < error_whole);
+
+    // float input, quantized per tensor, over a range that puts its zero point off center.
+    Tensor<float> xf = shifted({N, K}, 4, -0.2f, 1.5f);
+    Tensor<float> yf = fc.forward(xf);
+    float largest = 0;
+    for (int i = 0; i < yf.num_elements; i++) largest = std::max(largest, std::fabs(yf.data_[i]));
+    assert(maxError(q.forward(xf), yf) < 0.01f * largest);
+
+    std::cout << "accuracy test passed!" << std::endl;
+}
+
+void test_requantize() {
+    const int N = 5, K = 32, H = 12, M = 4;
+    Tensor<float> w1 = pattern({H, K}, 5), w2 = pattern({M, H}, 6);
+    Tensor<uint8_t> x = pixels({N, K});
+    nn::QuantizedLinear fc1(K, H, w1), fc2(H, M, w2);
+
+    try {
+        fc1.forwardQuantized(x, 1.0f / 255.0f);
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+
+    // output params from the float range, int8 out of the first into the second.
+    Tensor<float> h = fc1.forward(x, 1.0f / 255.0f);
+    auto range = std::minmax_element(&h.data_[0], &h.data_[0] + h.num_elements);
+    fc1.setOutputParams(quant::chooseParams(*range.first, *range.second, -128, 127, false));
+    Tensor<int8_t> h_q = fc1.forwardQuantized(x, 1.0f / 255.0f);
+    assert(h_q.shape() == h.shape());
+    for (int i = 0; i < h.num_elements; i++) {
+        float back = h_q.scale * (h_q.data_[i] - h_q.zero_point);
+        assert(std::fabs(back - h.data_[i]) <= h_q.scale / 2 + 1e-5f);
+    }
+
+    fc2.setOutputParams({0.05f, 3});
+    Tensor<int8_t> y_q = fc2.forwardQuantized(h_q);
+    Tensor<float> y = fc2.forward(h);
+    float error = 0;
+    for (int i = 0; i < y.num_elements; i++) {
+        error = std::max(error, std::fabs(y_q.scale * (y_q.data_[i] - y_q.zero_point) - y.data_[i]));
+    }
+    std::cout << "two layer int8 error: " << error << std::endl;
+    assert(error < 0.15f);
+
+    std::cout << "requantize test passed!" << std::endl;
+}
+
+void test_dynamic() {
+    // rows 100x apart: each quantized over its own range, exact against its own params.
+    const int K = 96, M = 12;
+    Tensor<float> w = pattern({M, K}, 8), b = pattern({M}, 9);
+    nn::QuantizedLinear dynamic(K, M, w, b, {0, true, true});
+    nn::QuantizedLinear whole(K, M, w, b);
+    Tensor<float> w_q = quant::dequantize(dynamic.weight());
+    nn::Linear<float> fc(K, M, Tensor<float>(w), Tensor<float>(b));
+
+    // fewer tiles than threads, then enough for a tile per thread.
+    int threads = parallel::numThreads();
+    parallel::setNumThreads(std::max(2, threads));
+    for (int N : {3, 256 * parallel::numThreads() + 5}) {
+        Tensor<float> x = pattern({N, K}, 10);
+        for (int i = 0; i < N; i++) {
+            float magnitude = i % 3 == 0 ? 0.01f : (i % 3 == 1 ? 1.0f : 100.0f);
+            for (int k = 0; k < K; k++) x.data_[i * K + k] *= magnitude;
+        }
+        Tensor<float> y = dynamic.forward(x);
+
+        Tensor<uint8_t> row_q({1, K});
+        for (int i = 0; i < N; i++) {
+            auto params = quant::chooseParamsU8(&x.data_[i * K], K);
+            quant::quantizeU8(&x.data_[i * K], K, params, &row_q.data_[0]);
+            Tensor<float> expected = reference(row_q, params.scale, params.zero_point, w_q);
+            float largest = 1e-3f;
+            for (int j = 0; j < M; j++) largest = std::max(largest, std::fabs(expected.data_[j]));
+            for (int j = 0; j < M; j++) {
+                assert(std::fabs(y.data_[i * M + j] - expected.data_[j] - b.data_[j]) < 1e-4f * largest);
+            }
+        }
+
+        // the small rows keep their precision, with one scale they drown in the large ones.
+        Tensor<float> y_f = fc.forward(x), y_whole = whole.forward(x);
+        float error = 0, error_whole = 0;
+        for (int j = 0; j < M; j++) {
+            error = std::max(error, std::fabs(y.data_[j] - y_f.data_[j]));
+            error_whole = std::max(error_whole, std::fabs(y_whole.data_[j] - y_f.data_[j]));
+        }
+        std::cout << "small row error: " << error << " per row, " << error_whole << " per tensor" << std::endl;
+        assert(error * 10 < error_whole);
+    }
+    parallel::setNumThreads(threads);
+
+    // static params win over the dynamic ones, with a step of 1 these all round to 0.
+    Tensor<float> x = pattern({2, K}, 11);
+    for (int i = 0; i < x.num_elements; i++) x.data_[i] *= 0.1f;
+    dynamic.setInputParams({1.0f, 0});
+    Tensor<float> y = dynamic.forward(x);
+    for (int i = 0; i < y.num_elements; i++) assert(std::fabs(y.data_[i] - b.data_[i % M]) < 1e-5f);
+
+    try {
+        nn::QuantizedConv2d conv(1, 1, 1, 1, 0, pattern({1, 1, 1, 1}, 1), {0, true, true});
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+    std::cout << "dynamic test passed!" << std::endl;
+}
+
+void test_sequential() {
+    // a Module<float>, planned like the others, no allocation once planned.
+    const int K = 64;
+    Tensor<float> w = pattern({10, K}, 7);
+    nn::Sequential<float> model;
+    model.add(nn::QuantizedLinear(K, 10, w)).add(nn::ReLU<float>());
+    nn::QuantizedLinear alone(K, 10, w);
+
+    Tensor<uint8_t> x = pixels({20, K});
+    Tensor<float> expected = alone.forward(x, 1.0f / 255.0f);
+    model.forward(x, 1.0f / 255.0f);
+    int64_t allocs = memory::stats().allocs;
+    const Tensor<float>& y = model.forward(x, 1.0f / 255.0f);
+    assert(memory::stats().allocs == allocs);
+    for (int i = 0; i < y.num_elements; i++) {
+        assert(std::fabs(y.data_[i] - std::max(0.0f, expected.data_[i])) < 1e-5f);
+    }
+
+    // per row, planned with room for the params of each row.
+    nn::Sequential<float> per_row;
+    per_row.add(nn::QuantizedLinear(K, 10, w, {0, true, true}));
+    Tensor<float> xf = pattern({20, K}, 12);
+    Tensor<float> expected_row = nn::QuantizedLinear(K, 10, w, {0, true, true}).forward(xf);
+    per_row.forward(xf);
+    allocs = memory::stats().allocs;
+    assert(maxError(per_row.forward(xf), expected_row) == 0.0f);
+    assert(memory::stats().allocs == allocs);
+    std::cout << "sequential test passed!" << std::endl;
+}
+
+int main() {
+    test_exact();
+    test_predict();
+    test_accuracy();
+    test_requantize();
+    test_dynamic();
+    test_sequential();
+    return 0;
+}
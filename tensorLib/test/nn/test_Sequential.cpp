@@ -0,0 +1,133 @@
+#include "Tensor.hpp"
+#include "Memory.hpp"
+#include "nn/modules.hpp"
+#include "nn/Sequential.hpp"
+#include "../TestUtils.hpp"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+// conv -> relu -> flatten -> linear, the MNIST conv model with a ReLU.
+nn::Sequential<float> convModel() {
+    nn::Sequential<float> model;
+    model.add(nn::Conv2d<float>(2, 3, 3, 1, 1, pattern({3, 2, 3, 3}, 1)))
+         .add(nn::ReLU<float>())
+         .add(nn::Flatten<float>())
+         .add(nn::Linear<float>(3 * 8 * 8, 5, pattern({5, 3 * 8 * 8}, 2)));
+    return model;
+}
+
+Tensor<float> byHand(const Tensor<float>& x) {
+    nn::Conv2d<float> conv(2, 3, 3, 1, 1, pattern({3, 2, 3, 3}, 1));
+    nn::ReLU<float> relu;
+    nn::Linear<float> fc(3 * 8 * 8, 5, pattern({5, 3 * 8 * 8}, 2));
+    int N = x.shape()[0];
+    return fc.forward(relu.forward(conv.forward(x)).view({N, 3 * 8 * 8}));
+}
+
+void test_forward() {
+    auto model = convModel();
+    assert(model.size() == 4);
+
+    Tensor<float> x = pattern({6, 2, 8, 8}, 3);
+    const Tensor<float>& y = model.forward(x);
+    assert(y.shape() == std::vector<int>({6, 5}));
+    assertClose(y, byHand(x));
+
+    // conv output, ReLU and Flatten share one buffer, the logits reuse the conv scratch.
+    std::cout << "arena: " << model.arenaBytes() << " bytes, " << model.naiveBytes() << " without reuse" << std::endl;
+    assert(model.arenaBytes() < model.naiveBytes());
+    assert(model.arenaBytes() < (6 * 3 * 64 + 6 * 5) * sizeof(float) + parallel::numThreads() * 18 * 64 * sizeof(float) + 256);
+
+    // uint8 input scaled in the first layer.
+    Tensor<uint8_t> p = pixels({6, 2, 8, 8});
+    Tensor<float> p_float({6, 2, 8, 8});
+    for (int i = 0; i < p.num_elements; i++) p_float.data_[i] = p.data_[i] / 255.0f;
+    assertClose(model.forward(p, 1.0f / 255.0f), byHand(p_float));
+
+    std::cout << "forward test passed!" << std::endl;
+}
+
+void test_steady_state() {
+    auto model = convModel();
+    Tensor<float> x = pattern({10, 2, 8, 8}, 4);
+    Tensor<float> expected = byHand(x);
+
+    model.forward(x);
+    int64_t allocs = memory::stats().allocs;
+    for (int i = 0; i < 3; i++) {
+        assertClose(model.forward(x), expected);
+    }
+    assert(memory::stats().allocs == allocs);
+
+    // another batch size is planned again, and back.
+    Tensor<float> small = pattern({3, 2, 8, 8}, 5);
+    assertClose(model.forward(small), byHand(small));
+    assertClose(model.forward(x), expected);
+
+    // a copy of the result keeps the arena alive.
+    Tensor<float> kept({1});
+    {
+        auto other = convModel();
+        kept = other.forward(x);
+    }
+    assertClose(kept, expected);
+
+    std::cout << "steady state test passed!" << std::endl;
+}
+
+void test_layers() {
+    // the static layers, and a layer shared by two models.
+    auto fc = std::make_shared<nn::StaticLinear<float, 2 * 8 * 8, 4>>(pattern({4, 2 * 8 * 8}, 6));
+    nn::Sequential<float> a, b;
+    a.add(nn::StaticConv2d<float, 1, 2, 3, 1, 1, 8, 8>(pattern({2, 1, 3, 3}, 7))).add(nn::Flatten<float>()).add(fc);
+    b.add(nn::Flatten<float>()).add(fc);
+
+    Tensor<float> x = pattern({5, 1, 8, 8}, 8);
+    nn::StaticConv2d<float, 1, 2, 3, 1, 1, 8, 8> conv(pattern({2, 1, 3, 3}, 7));
+    Tensor<float> features = conv.forward(x);
+    assertClose(a.forward(x), fc->forward(features.view({5, 2 * 8 * 8})));
+    assertClose(b.forward(features), a.forward(x));
+
+    // quantized weights, the result carries the scale.
+    Tensor<float> weight = pattern({3, 2 * 8 * 8}, 9);
+    nn::Sequential<int> q;
+    q.add(nn::Flatten<int>());
+    q.add(nn::Linear<int>(2 * 8 * 8, 3, weight.quantize()));
+    try {
+        q.forward(pixels({4, 2, 8, 8}), 1.0f / 255.0f);
+        assert(false);
+    } catch (const std::invalid_argument&) {
+    }
+
+    nn::Sequential<int> q2;
+    q2.add(nn::Linear<int>(2 * 8 * 8, 3, weight.quantize())).add(nn::ReLU<int>());
+    nn::Linear<int> fc_q(2 * 8 * 8, 3, weight.quantize());
+    Tensor<uint8_t> p = pixels({4, 2 * 8 * 8});
+    Tensor<int> expected = fc_q.forward(p, 1.0f / 255.0f);
+    const Tensor<int>& y = q2.forward(p, 1.0f / 255.0f);
+    for (int i = 0; i < y.num_elements; i++) {
+        assert(y.data_[i] == std::max(0, expected.data_[i]));
+    }
+    assert(y.scale == expected.scale);
+    assert(q2[0].name() == std::string("Linear"));
+
+    // shapes are checked when planning.
+    try {
+        a.forward(pattern({5, 1, 9, 9}, 1));
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+
+    std::cout << "layers test passed!" << std::endl;
+}
+
+int main() {
+    test_forward();
+    test_steady_state();
+    test_layers();
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include "Tensor.hpp"
 #include "nn/modules.hpp"
 #include <iostream>
+#include <cmath>
+#include <stdexcept>
 
 Tensor<int> originTensor(const std::vector<int>& shape) {
     Tensor<int> tensor(shape);
@@ -34,8 +36,91 @@ void test_Conv2d() {
     std::cout << "output: " << std::endl << output << std::endl;
 }
 
+Tensor<uint8_t> originPixels(const std::vector<int>& shape) {
+    Tensor<uint8_t> tensor(shape);
+
+    for(auto i=0; i<tensor.num_elements; i++)
+        tensor.data_[i] = (i * 37) % 256;
+
+    return tensor;
+}
+
+Tensor<float> normalize(const Tensor<uint8_t>& pixels) {
+    Tensor<float> tensor(pixels.shape());
+
+    for(auto i=0; i<tensor.num_elements; i++)
+        tensor.data_[i] = pixels.data_[i] / 255.0f;
+
+    return tensor;
+}
+
+/**
+ * uint8 input with the fused 1/255 scale should match the float input.
+ */
+void test_Linear_uint8() {
+    Tensor<uint8_t> input = originPixels({4, 6});
+    Tensor<float> weight({3, 6});
+    for(auto i=0; i<weight.num_elements; i++)
+        weight.data_[i] = (i % 5) * 0.25f - 0.5f;
+
+    nn::Linear<float> fc(6, 3, std::move(weight));
+    Tensor<float> expect = fc.forward(normalize(input));
+    Tensor<float> output = fc.forward(input, 1.0f / 255.0f);
+
+    for(auto i=0; i<output.num_elements; i++)
+        assert(fabs(output.data_[i] - expect.data_[i]) < 1e-5);
+
+    std::cout << "output: " << std::endl << output << std::endl;
+}
+
+void test_Conv2d_uint8() {
+    Tensor<uint8_t> input = originPixels({2, 2, 5, 5});
+    Tensor<float> weight({3, 2, 3, 3});
+    for(auto i=0; i<weight.num_elements; i++)
+        weight.data_[i] = (i % 7) * 0.125f - 0.25f;
+
+    nn::Conv2d<float> conv2d(2, 3, 3, 1, 1, std::move(weight));
+    Tensor<float> expect = conv2d.forward(normalize(input));
+    Tensor<float> output = conv2d.forward(input, 1.0f / 255.0f);
+
+    assert(output.shape() == expect.shape());
+    for(auto i=0; i<output.num_elements; i++)
+        assert(fabs(output.data_[i] - expect.data_[i]) < 1e-5);
+
+    std::cout << "output: " << std::endl << output << std::endl;
+}
+
+/**
+ * wrong weight or input shapes throw, also in builds without asserts.
+ */
+void test_Linear_shapes() {
+    try {
+        nn::Linear<float> bad(6, 3, Tensor<float>({6, 3}));
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+
+    nn::Linear<float> fc(6, 3, Tensor<float>({3, 6}));
+    try {
+        fc.forward(Tensor<float>({4, 5}));
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+    try {
+        fc.forward(Tensor<uint8_t>({4, 5}), 1.0f / 255.0f);
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+}
+
 int main() {
     // test_ReLU();
     test_Conv2d();
+    test_Linear_uint8();
+    test_Conv2d_uint8();
+    test_Linear_shapes();
     return 0;
 }
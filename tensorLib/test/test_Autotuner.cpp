@@ -0,0 +1,159 @@
+#include "Autotuner.hpp"
+#include "Tensor.hpp"
+#include "nn/modules.hpp"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+const std::string cachePath = "/tmp/test_tuning_cache/tuning.txt";
+
+static int countLines(const std::string& path, const std::string& pattern) {
+    std::ifstream file(path);
+    std::string line;
+    int count = 0;
+    while (std::getline(file, line)) {
+        if (line.find(pattern) != std::string::npos) count++;
+    }
+    return count;
+}
+
+void test_tune_and_reuse() {
+    std::remove(cachePath.c_str());
+    tuner::setCachePath(cachePath);
+    tuner::enable();
+    assert(tuner::size() == 0);
+
+    auto gemm = tuner::gemm(200, 30, 300, false);
+    auto gemm_nt = tuner::gemm(200, 30, 300, true);
+    auto conv = tuner::conv2d(16, 1, 28, 28, 4, 3, 1, 1);
+    assert(tuner::size() == 3);
+    assert(countLines(cachePath, "gemm 200x300x30") == 1);
+    assert(countLines(cachePath, "gemm_nt 200x300x30") == 1);
+    assert(countLines(cachePath, "conv2d 16x1x28x28 ->4 k3 s1 p1") == 1);
+
+    // a second lookup is served from memory, nothing is tuned or written again.
+    auto again = tuner::gemm(200, 30, 300, false);
+    assert(again.mc == gemm.mc && again.kc == gemm.kc && again.nc == gemm.nc && again.threads == gemm.threads);
+
+    // a new run: the winners come back from the file without tuning.
+    tuner::clear();
+    tuner::enable(false);
+    auto cached = tuner::gemm(200, 30, 300, false);
+    assert(cached.mc == gemm.mc && cached.kc == gemm.kc && cached.nc == gemm.nc && cached.threads == gemm.threads);
+    assert(tuner::gemm(200, 30, 300, true).threads == gemm_nt.threads);
+    auto cached_conv = tuner::conv2d(16, 1, 28, 28, 4, 3, 1, 1);
+    assert(cached_conv.algorithm == conv.algorithm && cached_conv.threads == conv.threads);
+
+    // unknown shapes use the defaults when tuning is disabled.
+    auto unknown = tuner::gemm(7, 7, 7, false);
+    assert(unknown.mc == 0 && unknown.kc == 0 && unknown.nc == 0 && unknown.threads == 0);
+    assert(tuner::size() == 3);
+
+    std::cout << "tune and reuse test passed!" << std::endl;
+}
+
+void test_other_hosts_kept() {
+    // an entry tuned on another CPU is kept when the file is rewritten, and not used here.
+    {
+        std::ofstream file(cachePath, std::ios::app);
+        file << "Some Other CPU\tavx2\t64\tgemm 9x9x9\tmc=8 kc=64 nc=64 threads=64" << std::endl;
+    }
+    tuner::clear();
+    tuner::enable();
+    auto config = tuner::gemm(9, 9, 9, false);
+    assert(config.threads != 64 || config.mc != 8);
+    assert(countLines(cachePath, "Some Other CPU") == 1);
+    assert(countLines(cachePath, "gemm 9x9x9") == 2);
+    tuner::enable(false);
+
+    std::cout << "other hosts test passed!" << std::endl;
+}
+
+void test_thread_cache() {
+    // this host's entry for a shape, rewritten with a known configuration into another file.
+    const std::string edited = "/tmp/test_tuning_cache/edited.txt", empty = "/tmp/test_tuning_cache/empty.txt";
+    std::string line;
+    {
+        std::ifstream file(cachePath);
+        std::string candidate;
+        while (std::getline(file, candidate)) {
+            if (candidate.find("\tgemm 200x300x30\t") != std::string::npos) line = candidate;
+        }
+    }
+    assert(!line.empty());
+    {
+        std::ofstream file(edited);
+        file << line.substr(0, line.rfind('\t')) << "\tmc=8 kc=64 nc=64 threads=1" << std::endl;
+    }
+    std::remove(empty.c_str());
+
+    // each switch of file is seen by a thread that looked the shape up before.
+    tuner::enable(false);
+    tuner::gemm(200, 30, 300, false);
+    tuner::setCachePath(edited);
+    assert(tuner::gemm(200, 30, 300, false).mc == 8);
+    std::thread other([]() {
+        for (int i = 0; i < 3; i++) {
+            auto config = tuner::gemm(200, 30, 300, false);
+            assert(config.mc == 8 && config.kc == 64 && config.nc == 64 && config.threads == 1);
+        }
+    });
+    other.join();
+    tuner::setCachePath(empty);
+    assert(tuner::gemm(200, 30, 300, false).mc == 0);
+
+    tuner::setCachePath(cachePath);
+    std::remove(edited.c_str());
+    std::cout << "thread cache test passed!" << std::endl;
+}
+
+void test_tuned_results() {
+    // the ops give the same results with the tuned configurations.
+    tuner::enable();
+    Tensor<float> a({64, 48}), b({48, 40});
+    for (int i = 0; i < 64; ++i) for (int j = 0; j < 48; ++j) a.setData({i, j}, (i + 2 * j) % 9 - 4.0f);
+    for (int i = 0; i < 48; ++i) for (int j = 0; j < 40; ++j) b.setData({i, j}, (3 * i + j) % 5 - 2.0f);
+    Tensor<float> c = a.matmul(b);
+    for (int i = 0; i < 64; i += 7)
+        for (int j = 0; j < 40; j += 3) {
+            float sum = 0;
+            for (int k = 0; k < 48; ++k) sum += a.getData({i, k}) * b.getData({k, j});
+            assert(c.getData({i, j}) == sum);
+        }
+
+    Tensor<uint8_t> x8({3, 2, 9, 9});
+    Tensor<float> x({3, 2, 9, 9});
+    for (int n = 0; n < 3; ++n)
+        for (int ci = 0; ci < 2; ++ci)
+            for (int h = 0; h < 9; ++h)
+                for (int w = 0; w < 9; ++w) {
+                    x8.setData({n, ci, h, w}, (n * 17 + ci * 5 + h * 3 + w) % 256);
+                    x.setData({n, ci, h, w}, (n * 17 + ci * 5 + h * 3 + w) % 256);
+                }
+    Tensor<float> weight({3, 2, 3, 3});
+    for (int co = 0; co < 3; ++co)
+        for (int ci = 0; ci < 2; ++ci)
+            for (int j = 0; j < 9; ++j) weight.setData({co, ci, j / 3, j % 3}, (co + ci + j) % 5 - 2.0f);
+    nn::Conv2d<float> conv(2, 3, 3, 2, 1, std::move(weight));
+    Tensor<float> y = conv.forward(x);
+    Tensor<float> y8 = conv.forward(x8, 1.0f);
+    for (int i = 0; i < y.shape()[0]; ++i)
+        for (int co = 0; co < 3; ++co)
+            for (int h = 0; h < y.shape()[2]; ++h)
+                for (int w = 0; w < y.shape()[3]; ++w) assert(y.getData({i, co, h, w}) == y8.getData({i, co, h, w}));
+    tuner::enable(false);
+
+    std::cout << "tuned results test passed!" << std::endl;
+}
+
+int main() {
+    test_tune_and_reuse();
+    test_other_hosts_kept();
+    test_thread_cache();
+    test_tuned_results();
+    std::remove(cachePath.c_str());
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "DataLoader.hpp"
+#include <cassert>
+#include <iostream>
+
+const int NUM_RECORDS = 1003;
+
+// image i is filled with i % 256, label i is i % 10, so a batch can be checked against its labels.
+void writeDataset(const std::string& imagePath, const std::string& labelPath) {
+    gzFile images = gzopen(imagePath.c_str(), "wb");
+    uint32_t header[4] = {__builtin_bswap32(0x803), __builtin_bswap32(NUM_RECORDS), __builtin_bswap32(4), __builtin_bswap32(3)};
+    gzwrite(images, header, sizeof(header));
+    for (int i = 0; i < NUM_RECORDS; i++) {
+        std::vector<uint8_t> image(12, i % 256);
+        gzwrite(images, image.data(), image.size());
+    }
+    gzclose(images);
+
+    gzFile labels = gzopen(labelPath.c_str(), "wb");
+    uint32_t labelHeader[2] = {__builtin_bswap32(0x801), __builtin_bswap32(NUM_RECORDS)};
+    gzwrite(labels, labelHeader, sizeof(labelHeader));
+    for (int i = 0; i < NUM_RECORDS; i++) {
+        uint8_t label = i % 10;
+        gzwrite(labels, &label, 1);
+    }
+    gzclose(labels);
+}
+
+void test_sequential() {
+    DataLoader<float> loader("/tmp/test_loader_images.gz", "/tmp/test_loader_labels.gz", 100, false, 3, 2);
+    assert(loader.num_batches() == 11);
+
+    int seen = 0;
+    while (auto batch = loader.next()) {
+        assert((batch->images.shape() == std::vector<int>{batch->size(), 4, 3}));
+        for (int i = 0; i < batch->size(); i++, seen++) {
+            assert(batch->images.getData({i, 3, 2}) == seen % 256);
+            assert(batch->labels.getData({i}) == seen % 10);
+        }
+    }
+    assert(seen == NUM_RECORDS);
+
+    std::cout << "sequential test passed!" << std::endl;
+}
+
+void test_shuffle() {
+    DataLoader<uint8_t> loader("/tmp/test_loader_images.gz", "/tmp/test_loader_labels.gz", 64, true, 2, 3, 42);
+
+    // every record is yielded exactly once, with its own label.
+    std::vector<int> count(256 * 10, 0);
+    int seen = 0, in_order = 0;
+    while (auto batch = loader.next()) {
+        for (int i = 0; i < batch->size(); i++, seen++) {
+            int pixel = batch->images.getData({i, 0, 0});
+            int label = batch->labels.getData({i});
+            count[pixel * 10 + label]++;
+            in_order += (pixel == seen % 256);
+        }
+    }
+    assert(seen == NUM_RECORDS);
+    for (int i = 0; i < NUM_RECORDS; i++) {
+        assert(count[(i % 256) * 10 + i % 10] > 0);
+    }
+    assert(in_order < NUM_RECORDS / 2);
+
+    std::cout << "shuffle test passed!" << std::endl;
+}
+
+void test_early_destroy() {
+    // destroying the loader with batches in flight should not hang.
+    DataLoader<float> loader("/tmp/test_loader_images.gz", "/tmp/test_loader_labels.gz", 10, false, 4, 4);
+    auto batch = loader.next();
+    assert(batch && batch->size() == 10);
+
+    std::cout << "early destroy test passed!" << std::endl;
+}
+
+int main() {
+    writeDataset("/tmp/test_loader_images.gz", "/tmp/test_loader_labels.gz");
+    test_sequential();
+    test_shuffle();
+    test_early_destroy();
+    return 0;
+}
@@ -0,0 +1,264 @@
+#include "Kernels.hpp"
+#include "CpuFeatures.hpp"
+#include "Tensor.hpp"
+#include "nn/modules.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+static std::vector<float> randomFloats(size_t n) {
+    std::vector<float> values(n);
+    for (auto& v : values) v = static_cast<float>(std::rand()) / RAND_MAX * 2.0f - 1.0f;
+    return values;
+}
+
+static bool close(const std::vector<float>& a, const std::vector<float>& b, float tol = 1e-4f) {
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::fabs(a[i] - b[i]) > tol * (1.0f + std::fabs(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// every variant the CPU runs gives the same results as a naive reference.
+void check_table(const kernels::KernelTable& k) {
+    // sizes not multiple of any vector width, larger than one GEMM block.
+    const int M = 67, K = 301, N = 531;
+    auto A = randomFloats(M * K), B = randomFloats(K * N), BT = randomFloats(N * K);
+
+    std::vector<float> C(M * N), ref(M * N);
+    k.gemm_f32(M, N, K, A.data(), K, B.data(), N, C.data(), N, kernels::GemmConfig{});
+    for (int i = 0; i < M; ++i)
+        for (int j = 0; j < N; ++j) {
+            double sum = 0;
+            for (int t = 0; t < K; ++t) sum += A[i * K + t] * B[t * N + j];
+            ref[i * N + j] = sum;
+        }
+    assert(close(C, ref));
+
+    k.gemm_nt_f32(M, N, K, A.data(), K, BT.data(), K, C.data(), N, kernels::GemmConfig{});
+    for (int i = 0; i < M; ++i)
+        for (int j = 0; j < N; ++j) {
+            double sum = 0;
+            for (int t = 0; t < K; ++t) sum += A[i * K + t] * BT[j * K + t];
+            ref[i * N + j] = sum;
+        }
+    assert(close(C, ref));
+
+    std::vector<uint8_t> A8(M * K);
+    std::vector<int32_t> B32(N * K), C32(M * N);
+    for (auto& v : A8) v = std::rand() % 256;
+    for (auto& v : B32) v = std::rand() % 255 - 127;
+    k.gemm_nt_u8i32(M, N, K, A8.data(), K, B32.data(), K, C32.data(), N);
+    k.gemm_nt_u8f32(M, N, K, A8.data(), K, BT.data(), K, C.data(), N, 0.5f);
+    for (int i = 0; i < M; ++i)
+        for (int j = 0; j < N; ++j) {
+            int32_t isum = 0;
+            double fsum = 0;
+            for (int t = 0; t < K; ++t) {
+                isum += A8[i * K + t] * B32[j * K + t];
+                fsum += A8[i * K + t] * BT[j * K + t];
+            }
+            assert(C32[i * N + j] == isum);
+            ref[i * N + j] = fsum * 0.5;
+        }
+    assert(close(C, ref, 1e-3f));
+
+    // signed int8 weights, the full [-128, 127] range.
+    std::vector<int8_t> B8(N * K);
+    for (auto& v : B8) v = (int8_t)(std::rand() % 256 - 128);
+    k.gemm_nt_u8s8i32(M, N, K, A8.data(), K, B8.data(), K, C32.data(), N);
+    for (int i = 0; i < M; ++i)
+        for (int j = 0; j < N; ++j) {
+            int32_t isum = 0;
+            for (int t = 0; t < K; ++t) isum += A8[i * K + t] * B8[j * K + t];
+            assert(C32[i * N + j] == isum);
+        }
+
+    // packed 4 bit weights, groups of 8 with their own scale and zero point, the first K4 columns of A.
+    const int GS = 8, K4 = K / GS * GS;
+    std::vector<uint8_t> B4(N * K4 / 2);
+    std::vector<float> scales4(N * K4 / GS);
+    std::vector<int32_t> zeros4(N * K4 / GS);
+    for (auto& v : B4) v = std::rand() % 256;
+    for (size_t g = 0; g < scales4.size(); ++g) {
+        scales4[g] = 0.01f * (1 + g % 7);
+        zeros4[g] = g % 16;
+    }
+    k.gemm_nt_f32_u4(M, N, K4, A.data(), K, B4.data(), K4 / 2, scales4.data(), zeros4.data(), GS, C.data(), N);
+    for (int i = 0; i < M; ++i)
+        for (int j = 0; j < N; ++j) {
+            double sum = 0;
+            for (int t = 0; t < K4; ++t) {
+                int g = t / GS, u = t % GS;
+                uint8_t byte = B4[j * K4 / 2 + g * GS / 2 + u % (GS / 2)];
+                int q = u < GS / 2 ? (byte & 0x0F) : (byte >> 4);
+                sum += A[i * K + t] * scales4[j * K4 / GS + g] * (q - zeros4[j * K4 / GS + g]);
+            }
+            ref[i * N + j] = sum;
+        }
+    assert(close(C, ref));
+
+    // sparse weights in 1x1, 1x4 and 4x4 blocks at random columns, N not a multiple of 4.
+    for (int shape : {0, 1, 2}) {
+        const int BR = shape == 2 ? 4 : 1, BC = shape == 0 ? 1 : 4, R = (N + BR - 1) / BR;
+        std::vector<int32_t> row_ptr = {0}, col_idx;
+        std::vector<float> dense(N * K, 0.0f), values;
+        for (int r = 0; r < R; ++r) {
+            for (int c = std::rand() % 7; c + BC <= K; c += BC + std::rand() % 9) {
+                col_idx.push_back(c);
+                for (int p = 0; p < BR; ++p)
+                    for (int q = 0; q < BC; ++q) {
+                        float v = r * BR + p < N ? randomFloats(1)[0] : 0.0f;
+                        values.push_back(v);
+                        if (r * BR + p < N) dense[(r * BR + p) * K + c + q] = v;
+                    }
+            }
+            row_ptr.push_back((int32_t)col_idx.size());
+        }
+        for (int rows : {1, M}) {
+            k.spmm_nt_f32(rows, N, A.data(), K, row_ptr.data(), col_idx.data(), values.data(), BR, BC, C.data(), N);
+            std::vector<float> out(C.begin(), C.begin() + rows * N), expected(rows * N);
+            for (int i = 0; i < rows; ++i)
+                for (int j = 0; j < N; ++j) {
+                    double sum = 0;
+                    for (int t = 0; t < K; ++t) sum += A[i * K + t] * dense[j * K + t];
+                    expected[i * N + j] = sum;
+                }
+            assert(close(out, expected));
+        }
+    }
+
+    // conv: im2col + gemm and the direct kernel agree, with padding and stride.
+    const int Ci = 3, H = 13, W = 11, Co = 4, KS = 3;
+    for (int stride : {1, 2}) {
+        for (int padding : {0, 1}) {
+            int Ho = (H + 2 * padding - KS) / stride + 1, Wo = (W + 2 * padding - KS) / stride + 1;
+            auto x = randomFloats(Ci * H * W), w = randomFloats(Co * Ci * KS * KS);
+            std::vector<float> cols(Ci * KS * KS * Ho * Wo), out(Co * Ho * Wo), direct(Co * Ho * Wo);
+            k.im2col_f32(x.data(), Ci, H, W, KS, stride, padding, cols.data());
+            k.gemm_f32(Co, Ho * Wo, Ci * KS * KS, w.data(), Ci * KS * KS, cols.data(), Ho * Wo, out.data(), Ho * Wo,
+                        kernels::GemmConfig{});
+            k.conv2d_direct_f32(x.data(), Ci, H, W, w.data(), Co, KS, stride, padding, direct.data());
+            assert(close(out, direct));
+
+            // im2row is the transposed im2col, XORed with flip, padded with pad (0x80 ^ 0x80 = 0).
+            std::vector<uint8_t> x8(Ci * H * W), rows(Ho * Wo * Ci * KS * KS);
+            std::vector<float> x8f(x8.size());
+            for (size_t i = 0; i < x8.size(); ++i) x8f[i] = x8[i] = std::rand() % 256;
+            k.im2col_f32(x8f.data(), Ci, H, W, KS, stride, padding, cols.data());
+            k.im2row_u8(x8.data(), Ci, H, W, KS, stride, padding, 0x80, 0x80, rows.data());
+            for (int p = 0; p < Ho * Wo; ++p)
+                for (int i = 0; i < Ci * KS * KS; ++i)
+                    assert((rows[p * Ci * KS * KS + i] ^ 0x80) == cols[i * Ho * Wo + p]);
+        }
+    }
+
+    auto x = randomFloats(1003);
+    double sum = 0;
+    for (auto v : x) sum += v;
+    assert(std::fabs(k.sum_f32(x.data(), x.size()) - sum) < 1e-3);
+
+    std::vector<float> y(x.size());
+    k.maximum_f32(x.data(), 0.0f, y.data(), x.size());
+    for (size_t i = 0; i < x.size(); ++i) assert(y[i] == (x[i] > 0 ? x[i] : 0.0f));
+
+    std::vector<int32_t> idx(59);
+    k.argmax_rows_f32(x.data(), 59, 17, 17, idx.data());
+    for (int i = 0; i < 59; ++i)
+        for (int j = 0; j < 17; ++j) assert(x[i * 17 + j] <= x[i * 17 + idx[i]]);
+
+    std::vector<uint8_t> pixels = {0, 1, 128, 255};
+    std::vector<float> scaled(4);
+    k.scale_u8_f32(pixels.data(), 1.0f / 255.0f, scaled.data(), 4);
+    assert(scaled[0] == 0.0f && std::fabs(scaled[3] - 1.0f) < 1e-6f);
+
+    // bias per row (conv channels) and per column (Linear features).
+    std::vector<float> rows(x.begin(), x.begin() + 59 * 17), cols = rows;
+    k.bias_add_f32(rows.data(), 59, 17, x.data() + 100, true);
+    k.bias_add_f32(cols.data(), 59, 17, x.data() + 100, false);
+    for (int i = 0; i < 59; ++i) {
+        for (int j = 0; j < 17; ++j) {
+            assert(rows[i * 17 + j] == x[i * 17 + j] + x[100 + i]);
+            assert(cols[i * 17 + j] == x[i * 17 + j] + x[100 + j]);
+        }
+    }
+
+    std::cout << k.name << " kernels test passed!" << std::endl;
+}
+
+void test_variants() {
+    assert(kernels::table(cpu::ISA::Scalar) != nullptr);
+    for (cpu::ISA isa : {cpu::ISA::Scalar, cpu::ISA::SSE42, cpu::ISA::AVX2, cpu::ISA::AVX512}) {
+        const kernels::KernelTable* t = kernels::table(isa);
+        if (t == nullptr) {
+            std::cout << cpu::isaName(isa) << " not available, skipped" << std::endl;
+            continue;
+        }
+        check_table(*t);
+    }
+    std::cout << "CPU: " << cpu::modelName() << ", active: " << cpu::isaName(kernels::activeISA()) << std::endl;
+}
+
+void test_dispatch() {
+    cpu::ISA initial = kernels::activeISA();
+    assert(kernels::setISA(cpu::ISA::Scalar));
+    assert(std::string(kernels::active().name) == "scalar");
+
+    // Tensor ops follow the selected variant and give the same results.
+    Tensor<float> a({37, 50}), b({50, 29});
+    for (int i = 0; i < 37; ++i) for (int j = 0; j < 50; ++j) a.setData({i, j}, (i * 7 + j) % 11 - 5.0f);
+    for (int i = 0; i < 50; ++i) for (int j = 0; j < 29; ++j) b.setData({i, j}, (i + j * 3) % 5 - 2.0f);
+    Tensor<float> scalar_result = a.matmul(b);
+
+    assert(kernels::setISA(cpu::best()));
+    Tensor<float> best_result = a.matmul(b);
+    // the values are small integers, exact in any summation order.
+    for (int i = 0; i < 37; ++i)
+        for (int j = 0; j < 29; ++j) assert(scalar_result.getData({i, j}) == best_result.getData({i, j}));
+
+    // a transposed right side takes the B^T kernel without a copy.
+    Tensor<float> bt = b.transpose(0, 1).contiguous();
+    Tensor<float> nt_result = a.matmul(bt.transpose(0, 1));
+    for (int i = 0; i < 37; ++i)
+        for (int j = 0; j < 29; ++j) assert(nt_result.getData({i, j}) == best_result.getData({i, j}));
+
+    kernels::setISA(initial);
+    std::cout << "dispatch test passed!" << std::endl;
+}
+
+void test_conv2d_float() {
+    // the im2col path against the uint8 direct path on the same integer pixels.
+    Tensor<uint8_t> x8({2, 1, 6, 5});
+    Tensor<float> x({2, 1, 6, 5});
+    for (int n = 0; n < 2; ++n)
+        for (int h = 0; h < 6; ++h)
+            for (int w = 0; w < 5; ++w) {
+                x8.setData({n, 0, h, w}, (n * 31 + h * 5 + w) % 256);
+                x.setData({n, 0, h, w}, (n * 31 + h * 5 + w) % 256);
+            }
+    Tensor<float> weight({2, 1, 3, 3});
+    for (int i = 0; i < 2; ++i)
+        for (int j = 0; j < 9; ++j) weight.setData({i, 0, j / 3, j % 3}, j - 4.0f + i);
+
+    nn::Conv2d<float> conv(1, 2, 3, 1, 1, std::move(weight));
+    Tensor<float> a = conv.forward(x);
+    Tensor<float> b = conv.forward(x8, 1.0f);
+    assert(a.shape() == b.shape());
+    for (int n = 0; n < 2; ++n)
+        for (int c = 0; c < 2; ++c)
+            for (int h = 0; h < 6; ++h)
+                for (int w = 0; w < 5; ++w) assert(a.getData({n, c, h, w}) == b.getData({n, c, h, w}));
+
+    std::cout << "conv2d float test passed!" << std::endl;
+}
+
+int main() {
+    test_variants();
+    test_dispatch();
+    test_conv2d_float();
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include "MappedFile.hpp"
+#include <cassert>
+#include <fstream>
+#include <iostream>
+
+void test_create_and_map() {
+    {
+        // write through a writable mapping, the data goes to the file.
+        Tensor<float> dump = createMappedTensor<float>("/tmp/test_mmap_tensor.bin", {100, 50});
+        for (int i = 0; i < dump.num_elements; i++) {
+            dump.data_[i] = i * 0.5f;
+        }
+    }
+
+    Tensor<float> a = mmapTensor<float>("/tmp/test_mmap_tensor.bin", {100, 50});
+    assert(a.getData({99, 49}) == (99 * 50 + 49) * 0.5f);
+
+    // views share the mapping, and keep it alive after a is gone.
+    Tensor<float> b = a.slice(10, 20, 0).select(1, 3);
+    a = mmapTensor<float>("/tmp/test_mmap_tensor.bin", {10}, 4 * 4000);
+    adviseTensor(b, MapAdvice::WillNeed);
+    assert(b.getData({0}) == (10 * 50 + 3) * 0.5f);
+    assert(a.getData({0}) == 4000 * 0.5f);
+
+    std::cout << "create and map test passed!" << std::endl;
+}
+
+void test_mmap_idx() {
+    std::ofstream file("/tmp/test_mmap.idx", std::ios::binary);
+    uint8_t header[16] = {0, 0, 0x08, 3, 0, 0, 0, 2, 0, 0, 0, 3, 0, 0, 0, 4};
+    file.write(reinterpret_cast<char*>(header), 16);
+    for (int i = 0; i < 24; i++) {
+        file.put(static_cast<char>(i * 10));
+    }
+    file.close();
+
+    Tensor<uint8_t> images = mmapIDX<uint8_t>("/tmp/test_mmap.idx");
+    assert((images.shape() == std::vector<int>{2, 3, 4}));
+    assert(images.getData({1, 2, 3}) == 230);
+
+    try {
+        mmapIDX<float>("/tmp/test_mmap.idx");
+        assert(false);
+    } catch (const std::runtime_error& e) {
+        std::cout << "mismatched type: " << e.what() << std::endl;
+    }
+
+    std::cout << "mmap IDX test passed!" << std::endl;
+}
+
+int main() {
+    test_create_and_map();
+    test_mmap_idx();
+    return 0;
+}
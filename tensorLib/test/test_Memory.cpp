@@ -0,0 +1,64 @@
+#include "Memory.hpp"
+#include "Profiler.hpp"
+#include "Tensor.hpp"
+#include "nn/modules.hpp"
+#include <cassert>
+#include <iostream>
+
+void test_live_and_peak() {
+    auto before = memory::stats();
+    {
+        Tensor<float> a({256, 256});
+        Tensor<float> b = a.slice(0, 10, 0); // a view, no new storage
+        auto during = memory::stats();
+        assert(during.live_bytes - before.live_bytes == 256 * 256 * 4);
+        assert(during.allocs - before.allocs == 1);
+
+        memory::resetPeak();
+        {
+            Tensor<int> c({1000});
+        }
+        assert(memory::stats().peak_bytes == during.live_bytes + 4000);
+    }
+    auto after = memory::stats();
+    assert(after.live_bytes == before.live_bytes);
+    assert(after.frees - before.frees == 2);
+
+    // borrowed memory is not counted.
+    float buffer[16];
+    Tensor<float> d = Tensor<float>::from_blob(buffer, {16});
+    assert(memory::stats().allocs == after.allocs);
+
+    std::cout << "live and peak test passed!" << std::endl;
+}
+
+void test_op_attribution() {
+    memory::enable();
+
+    // a dense weight, an all-zero one would take the sparse path.
+    Tensor<float> weight = zeros<float>({10, 64});
+    for (int i = 0; i < weight.num_elements; i++) weight.data_[i] = 1.0f;
+    nn::Linear<float> fc(64, 10, std::move(weight));
+    Tensor<float> input = zeros<float>({32, 64});
+    Tensor<float> output = fc.forward(input);
+
+    bool found = false;
+    for (auto& op : memory::byOp()) {
+        if (op.name == "matmul") {
+            // the output of matmul is still alive, held by output.
+            found = true;
+            assert(op.live_bytes == 32 * 10 * 4);
+        }
+    }
+    assert(found);
+
+    memory::printSummary(std::cout);
+    memory::enable(false);
+    std::cout << "op attribution test passed!" << std::endl;
+}
+
+int main() {
+    test_live_and_peak();
+    test_op_attribution();
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "MemoryPlan.hpp"
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+// no two buffers live at the same step may overlap in the arena.
+void checkDisjoint(const std::vector<memory::Buffer>& buffers, const memory::ArenaPlan& plan) {
+    assert(plan.offsets.size() == buffers.size());
+    for (size_t i = 0; i < buffers.size(); i++) {
+        assert(plan.offsets[i] % 64 == 0);
+        assert(plan.offsets[i] + buffers[i].bytes <= plan.arena_bytes);
+        for (size_t j = i + 1; j < buffers.size(); j++) {
+            bool live_together = buffers[i].first <= buffers[j].last && buffers[j].first <= buffers[i].last;
+            bool apart = plan.offsets[i] + buffers[i].bytes <= plan.offsets[j] ||
+                         plan.offsets[j] + buffers[j].bytes <= plan.offsets[i];
+            assert(!live_together || apart);
+        }
+    }
+}
+
+void test_chain() {
+    // a chain of layers, each activation read by the next one only: two buffers suffice.
+    std::vector<memory::Buffer> buffers = {{3136, 0, 1}, {3136, 1, 2}, {3136, 2, 3}, {3136, 3, 4}, {40, 4, 5}};
+    auto plan = memory::planArena(buffers);
+    checkDisjoint(buffers, plan);
+    assert(plan.arena_bytes == 2 * 3136);
+    assert(plan.naive_bytes == 4 * 3136 + 64);
+    std::cout << "chain: " << plan.arena_bytes << " of " << plan.naive_bytes << " bytes" << std::endl;
+    std::cout << "chain test passed!" << std::endl;
+}
+
+void test_gaps() {
+    // the small buffer goes into the gap left between the two big ones at step 2.
+    std::vector<memory::Buffer> buffers = {
+        {1000, 0, 1}, {4000, 0, 3}, {1000, 1, 2}, {512, 2, 2}, {256, 3, 3},
+    };
+    auto plan = memory::planArena(buffers);
+    checkDisjoint(buffers, plan);
+    assert(plan.offsets[1] == 0 && plan.offsets[0] == 4032 && plan.offsets[2] == 5056);
+    assert(plan.offsets[3] == 4032 && plan.offsets[4] == 4032);
+    assert(plan.arena_bytes == 6080);
+
+    // nothing live together, everything at 0.
+    std::vector<memory::Buffer> apart = {{100, 0, 0}, {200, 1, 1}, {300, 2, 2}};
+    plan = memory::planArena(apart);
+    checkDisjoint(apart, plan);
+    assert(plan.arena_bytes == 320);
+    for (size_t offset : plan.offsets) assert(offset == 0);
+
+    // everything live together, the sum.
+    std::vector<memory::Buffer> together = {{100, 0, 2}, {200, 0, 2}, {300, 0, 2}};
+    plan = memory::planArena(together);
+    checkDisjoint(together, plan);
+    assert(plan.arena_bytes == plan.naive_bytes);
+
+    assert(memory::planArena({}).arena_bytes == 0);
+    std::cout << "gaps test passed!" << std::endl;
+}
+
+int main() {
+    test_chain();
+    test_gaps();
+    return 0;
+}
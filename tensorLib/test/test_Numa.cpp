@@ -0,0 +1,135 @@
+#include "Numa.hpp"
+#include "ThreadPool.hpp"
+#include "Tensor.hpp"
+#include "nn/modules.hpp"
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+void test_topology() {
+    assert(numa::parseList("0") == std::vector<int>({0}));
+    assert(numa::parseList("0-3,8,10-11") == std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+    assert(numa::parseList("").empty());
+
+    std::vector<std::vector<int>> two_sockets = {{0, 1, 2}, {3, 4, 5}};
+    assert(numa::pinOrder(two_sockets, true) == std::vector<int>({0, 3, 1, 4, 2, 5}));
+    assert(numa::pinOrder(two_sockets, false) == std::vector<int>({0, 1, 2, 3, 4, 5}));
+    assert(numa::pinOrder({{0, 1, 2}, {3}}, true) == std::vector<int>({0, 3, 1, 2}));
+
+    int nodes = numa::nodeCount();
+    assert(nodes >= 1);
+    int node = numa::currentNode();
+    assert(node >= 0);
+    size_t cpus = 0;
+    for (int n = 0; n < nodes; n++) cpus += numa::nodeCPUs(n).size();
+    assert(cpus == parallel::availableCPUs().size());
+
+    auto pool = numa::nodePool(node);
+    assert(pool->size() == (int)numa::nodeCPUs(node).size());
+    parallel::PoolScope scope(*pool);
+    std::atomic<int> count{0};
+    parallel::parallel_for(0, 1000, 1, [&](int64_t begin, int64_t end) { count += end - begin; });
+    assert(count == 1000);
+
+    std::cout << nodes << " node(s), policy " << numa::policyName(numa::policy()) << std::endl;
+    std::cout << "topology test passed!" << std::endl;
+}
+
+void test_placement() {
+    numa::Policy initial = numa::policy();
+    numa::Policy p;
+    assert(numa::parsePolicy("interleave", p) && p == numa::Policy::Interleave);
+    assert(numa::parsePolicy("firsttouch", p) && p == numa::Policy::FirstTouch);
+    assert(!numa::parsePolicy("everywhere", p));
+
+    // large Tensors under every policy hold their values.
+    parallel::ThreadPool pool(4);
+    parallel::PoolScope scope(pool);
+    for (numa::Policy policy : {numa::Policy::Off, numa::Policy::FirstTouch, numa::Policy::Interleave}) {
+        numa::setPolicy(policy);
+        Tensor<float> t({1000, 784});
+        for (int i = 0; i < 1000; i += 37) t.setData({i, 5}, i * 0.5f);
+        for (int i = 0; i < 1000; i += 37) assert(t.getData({i, 5}) == i * 0.5f);
+    }
+    // first touch by a pinned pool's workers, and the fresh pages behind placed storage.
+    parallel::ThreadPool pinned(2, parallel::availableCPUs());
+    assert(pinned.pinned() && !pool.pinned());
+    {
+        parallel::PoolScope pinned_scope(pinned);
+        numa::setPolicy(numa::Policy::FirstTouch);
+        Tensor<float> t({1000, 784});
+        t.setData({999, 783}, 1.5f);
+        assert(t.getData({999, 783}) == 1.5f);
+    }
+    char* fresh = static_cast<char*>(numa::allocatePlaced(numa::PLACE_MIN_BYTES + 10));
+    assert(fresh != nullptr && (uintptr_t)fresh % 4096 == 0);
+    assert(fresh[0] == 0 && fresh[numa::PLACE_MIN_BYTES + 9] == 0);
+    numa::releasePlaced(fresh, numa::PLACE_MIN_BYTES + 10);
+    numa::setPolicy(initial);
+
+    // binding may be refused (no NUMA support, seccomp), the memory works either way.
+    auto block = numa::allocateOnNode(3 * 4096 + 100, 0);
+    for (int i = 0; i < 3 * 4096 + 100; i++) block[i] = (char)i;
+    bool bound = numa::bindToNode(block.get(), 3 * 4096, 0);
+    bool interleaved = numa::interleave(block.get(), 3 * 4096);
+    for (int i = 0; i < 3 * 4096 + 100; i++) assert(block[i] == (char)i);
+    std::cout << "mbind " << (bound && interleaved ? "supported" : "not permitted") << std::endl;
+
+    std::cout << "placement test passed!" << std::endl;
+}
+
+void test_replicas() {
+    std::vector<float> src(1000);
+    for (int i = 0; i < 1000; i++) src[i] = i * 0.25f;
+    numa::Replicas<float> replicas;
+    assert(replicas.empty());
+    replicas.build(src.data(), src.size());
+    assert(!replicas.empty());
+    const float* local = replicas.local();
+    assert(local != src.data());
+    for (int i = 0; i < 1000; i++) assert(local[i] == src[i]);
+
+    // Linear with per-node weights gives the same results as without.
+    Tensor<float> weight({10, 70});
+    for (int o = 0; o < 10; ++o) for (int k = 0; k < 70; ++k) weight.setData({o, k}, (o * 3 + k) % 7 - 3.0f);
+    Tensor<float> x({130, 70});
+    Tensor<uint8_t> x8({130, 70});
+    for (int n = 0; n < 130; ++n)
+        for (int k = 0; k < 70; ++k) {
+            x.setData({n, k}, (n + 5 * k) % 256);
+            x8.setData({n, k}, (n + 5 * k) % 256);
+        }
+    Tensor<int> weight_q = weight.quantize();
+
+    bool initial = numa::replicateWeights();
+    numa::setReplicateWeights(false);
+    nn::Linear<float> plain(70, 10, Tensor<float>(weight.contiguous()));
+    nn::Linear<int> plain_q(70, 10, Tensor<int>(weight_q));
+    numa::setReplicateWeights(true);
+    nn::Linear<float> replicated(70, 10, Tensor<float>(weight.contiguous()));
+    nn::Linear<int> replicated_q(70, 10, Tensor<int>(weight_q));
+    numa::setReplicateWeights(initial);
+
+    parallel::ThreadPool pool(3);
+    parallel::PoolScope scope(pool);
+    Tensor<float> a = plain.forward(x), b = replicated.forward(x);
+    Tensor<float> a8 = plain.forward(x8, 1.0f), b8 = replicated.forward(x8, 1.0f);
+    Tensor<int> aq = plain_q.forward(x8, 1.0f), bq = replicated_q.forward(x8, 1.0f);
+    assert(aq.scale == bq.scale);
+    for (int n = 0; n < 130; ++n)
+        for (int o = 0; o < 10; ++o) {
+            assert(a.getData({n, o}) == b.getData({n, o}));
+            assert(a8.getData({n, o}) == b8.getData({n, o}));
+            assert(aq.getData({n, o}) == bq.getData({n, o}));
+        }
+
+    std::cout << "replicas test passed!" << std::endl;
+}
+
+int main() {
+    test_topology();
+    test_placement();
+    test_replicas();
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include "Tensor.hpp"
+#include "Observer.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+// uniform in [0, 1), the same on every run.
+float uniform(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return (state >> 8) / 16777216.0f;
+}
+
+// roughly normal, mean 0 and deviation 1.
+std::vector<float> normal(size_t n, uint32_t seed) {
+    std::vector<float> x(n);
+    for (auto& v : x) {
+        float sum = 0;
+        for (int k = 0; k < 12; k++) sum += uniform(seed);
+        v = sum - 6.0f;
+    }
+    return x;
+}
+
+void test_minmax() {
+    quant::Observer observer;
+    quant::Params none = observer.params(quant::CalibrationMethod::MinMax, 0, 255, false);
+    assert(none.scale == 1.0f && none.zero_point == 0);
+
+    std::vector<float> x = {-1.0f, 0.5f, 3.0f};
+    observer.observe(x.data(), x.size());
+    auto r = observer.range(quant::CalibrationMethod::MinMax);
+    assert(r.first == -1.0f && r.second == 3.0f && observer.count() == 3);
+    quant::Params p = observer.params(quant::CalibrationMethod::MinMax, 0, 255, false);
+    assert(std::fabs(p.scale - 4.0f / 255) < 1e-7f && p.zero_point == 64);
+
+    // one sided values keep their zero point at qmin.
+    quant::Observer relu;
+    std::vector<float> positive = {0.0f, 2.0f, 1.0f};
+    relu.observe(positive.data(), positive.size());
+    assert(relu.params(quant::CalibrationMethod::MinMax, 0, 255, false).zero_point == 0);
+
+    try {
+        quant::Observer bad(0);
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+    std::cout << "minmax test passed!" << std::endl;
+}
+
+void test_percentile() {
+    // one outlier sets the whole range for min/max, not for the percentile.
+    uint32_t seed = 1;
+    Tensor<float> x({10001});
+    for (int i = 0; i < 10000; i++) x.data_[i] = uniform(seed);
+    x.data_[10000] = 1000.0f;
+
+    quant::Observer observer;
+    observer.observe(x);
+    assert(observer.range(quant::CalibrationMethod::MinMax).second == 1000.0f);
+    float hi = observer.range(quant::CalibrationMethod::Percentile, 256, 99.9f).second;
+    std::cout << "99.9th percentile: " << hi << std::endl;
+    assert(hi > 0.99f && hi < 2.0f);
+
+    // the same values in batches of a growing range, re-binned on the way.
+    quant::Observer batched;
+    for (int b = 0; b < 10; b++) {
+        std::vector<float> part(&x.data_[b * 1000], &x.data_[b * 1000] + 1000);
+        for (auto& v : part) v *= (b + 1) / 10.0f;
+        batched.observe(part.data(), part.size());
+    }
+    batched.observe(&x.data_[10000], 1);
+    assert(batched.count() == 10001 && batched.max() == 1000.0f);
+    float batched_hi = batched.range(quant::CalibrationMethod::Percentile, 256, 99.9f).second;
+    assert(batched_hi > 0.99f && batched_hi < 2.0f);
+
+    std::cout << "percentile test passed!" << std::endl;
+}
+
+void test_entropy() {
+    // a bell curve and a few far outliers: the threshold clips the outliers but keeps
+    // the bulk of the curve.
+    std::vector<float> x = normal(100000, 7);
+    for (int i = 0; i < 20; i++) x[i * 5000] = 40.0f;
+    quant::Observer observer;
+    observer.observe(x.data(), x.size());
+
+    auto r = observer.range(quant::CalibrationMethod::Entropy, 128);
+    std::cout << "entropy range: [" << r.first << ", " << r.second << "]" << std::endl;
+    assert(r.second > 2.5f && r.second < 20.0f);
+    assert(r.first == observer.min());
+
+    // the error over the bulk, less than with the full range.
+    auto error = [&](const quant::Params& p) {
+        double sum = 0;
+        for (float v : x) {
+            if (std::fabs(v) > 4.0f) continue;
+            int32_t q = quant::quantize(v, 1.0f / p.scale, p.zero_point, -128, 127);
+            sum += std::fabs(p.scale * (q - p.zero_point) - v);
+        }
+        return sum;
+    };
+    double entropy = error(observer.params(quant::CalibrationMethod::Entropy, -128, 127, true));
+    double minmax = error(observer.params(quant::CalibrationMethod::MinMax, -128, 127, true));
+    std::cout << "bulk error: " << entropy << " entropy, " << minmax << " minmax" << std::endl;
+    assert(entropy < minmax / 2);
+
+    std::cout << "entropy test passed!" << std::endl;
+}
+
+int main() {
+    test_minmax();
+    test_percentile();
+    test_entropy();
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "Profiler.hpp"
+#include "Tensor.hpp"
+#include "nn/modules.hpp"
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+void test_records() {
+    profiler::enable();
+    profiler::reset();
+
+    // a dense weight, an all-zero one would take the sparse path.
+    Tensor<float> weight = zeros<float>({10, 64});
+    for (int i = 0; i < weight.num_elements; i++) weight.data_[i] = 1.0f;
+    nn::Linear<float> fc(64, 10, std::move(weight));
+    Tensor<float> input = zeros<float>({32, 64});
+    fc.forward(input);
+
+    // the nested matmul and contiguous calls are recorded too.
+    auto records = profiler::records();
+    bool found = false;
+    for (auto& r : records) {
+        if (std::string(r.name) == "Linear") {
+            found = true;
+            assert(r.depth == 0);
+            assert(r.flops == 2.0 * 32 * 64 * 10);
+            assert(r.shapeString() == "[32,64] [10,64]");
+            assert(r.end_ns >= r.start_ns);
+        }
+    }
+    assert(found);
+
+    profiler::printSummary(std::cout);
+    std::cout << "records test passed!" << std::endl;
+}
+
+void test_disabled() {
+    profiler::reset();
+    profiler::enable(false);
+
+    Tensor<float> a = zeros<float>({4, 4});
+    a.matmul(a);
+    assert(profiler::records().empty());
+
+    std::cout << "disabled test passed!" << std::endl;
+}
+
+void test_threads_and_trace() {
+    profiler::reset();
+    profiler::enable();
+    profiler::setBufferCapacity(4);
+
+    auto work = [] {
+        Tensor<float> a = zeros<float>({8, 8});
+        for (int i = 0; i < 6; i++) {
+            a.matmul(a);
+        }
+    };
+    std::thread t1(work), t2(work);
+    t1.join();
+    t2.join();
+
+    // each thread keeps only its last 4 records.
+    assert(profiler::records().size() == 8);
+    assert(profiler::dropped() == 4);
+
+    std::ostringstream os;
+    profiler::writeChromeTrace(os);
+    assert(os.str().find("\"ph\":\"X\"") != std::string::npos);
+    std::cout << os.str().substr(0, 200) << std::endl;
+
+    profiler::setBufferCapacity(1 << 14);
+    std::cout << "threads and trace test passed!" << std::endl;
+}
+
+void test_counters() {
+    profiler::reset();
+    profiler::enable();
+
+    if (!profiler::enableCounters()) {
+        // not permitted here (perf_event_paranoid, container), the profiler still works.
+        std::cout << "perf counters unavailable: " << perf::status() << std::endl;
+        Tensor<float> a = zeros<float>({16, 16});
+        a.matmul(a);
+        assert(profiler::records().size() == 1 && profiler::records()[0].counters[perf::Cycles] == -1);
+        return;
+    }
+
+    Tensor<float> a = zeros<float>({64, 64});
+    a.matmul(a);
+    auto records = profiler::records();
+    assert(records.size() == 1);
+    if (perf::available(perf::Instructions)) {
+        assert(records[0].counters[perf::Instructions] > 64 * 64 * 64);
+    }
+
+    profiler::printSummary(std::cout);
+    profiler::enableCounters(false);
+    std::cout << "counters test passed!" << std::endl;
+}
+
+int main() {
+    test_records();
+    test_disabled();
+    test_threads_and_trace();
+    test_counters();
+    return 0;
+}
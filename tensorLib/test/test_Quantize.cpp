@@ -0,0 +1,146 @@
+#include "Tensor.hpp"
+#include "Quantize.hpp"
+#include "TestUtils.hpp"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+void test_rounding() {
+    // round to nearest, ties to even, saturated.
+    assert(quant::quantize(2.4f, 1.0f, 0, -128, 127) == 2);
+    assert(quant::quantize(2.6f, 1.0f, 0, -128, 127) == 3);
+    assert(quant::quantize(-2.6f, 1.0f, 0, -128, 127) == -3);
+    assert(quant::quantize(2.5f, 1.0f, 0, -128, 127) == 2);
+    assert(quant::quantize(1000.0f, 1.0f, 0, -128, 127) == 127);
+    assert(quant::quantize(-1000.0f, 1.0f, 10, 0, 255) == 0);
+
+    // 0 is exact, asymmetric ranges use all 256 steps.
+    auto p = quant::chooseParams(-0.5f, 1.5f, 0, 255, false);
+    assert(quant::quantize(0.0f, 1.0f / p.scale, p.zero_point, 0, 255) == p.zero_point);
+    assert(std::fabs(p.scale - 2.0f / 255) < 1e-7f);
+    auto s = quant::chooseParams(-0.5f, 1.5f, -128, 127, true);
+    assert(s.zero_point == 0 && std::fabs(s.scale - 1.5f / 127) < 1e-7f);
+    // only positive values, the range still holds 0.
+    auto positive = quant::chooseParams(2.0f, 4.0f, 0, 255, false);
+    assert(positive.zero_point == 0 && std::fabs(positive.scale - 4.0f / 255) < 1e-7f);
+
+    // Tensor::quantize rounds too.
+    Tensor<float> t({3});
+    t.data_[0] = 1.0f;
+    t.data_[1] = 0.5f / 127 * 1.2f;  // 0.6 of a step
+    t.data_[2] = -1.0f;
+    Tensor<int> q = t.quantize();
+    assert(q.data_[0] == 127 && q.data_[1] == 1 && q.data_[2] == -127);
+    Tensor<float> zeros({2});
+    zeros.data_[0] = zeros.data_[1] = 0.0f;
+    Tensor<int> zq = zeros.quantize();
+    assert(zq.scale == 1.0f && zq.data_[0] == 0);
+
+    std::cout << "rounding test passed!" << std::endl;
+}
+
+void test_weight() {
+    // rows of very different ranges: per row scales follow each of them.
+    Tensor<float> w = pattern({6, 32}, 1);
+    for (int j = 0; j < 32; j++) {
+        w.data_[j] *= 100.0f;
+        w.data_[5 * 32 + j] = w.data_[5 * 32 + j] * 0.01f + 0.02f;
+    }
+
+    auto per_row = quant::quantizeWeight(w);
+    assert(per_row.groups == 1 && per_row.group_size == 32 && per_row.scales.size() == 6);
+    Tensor<float> back = quant::dequantize(per_row);
+    for (int i = 0; i < 6; i++) {
+        for (int j = 0; j < 32; j++) {
+            assert(std::fabs(back.data_[i * 32 + j] - w.data_[i * 32 + j]) <= per_row.scales[i] / 2 + 1e-6f);
+        }
+    }
+    // against one scale for the whole matrix, the small rows are far more precise.
+    Tensor<int> whole = w.quantize();
+    Tensor<float> whole_back = whole.dequantize();
+    float row5 = 0, row5_whole = 0;
+    for (int j = 0; j < 32; j++) {
+        row5 = std::max(row5, std::fabs(back.data_[5 * 32 + j] - w.data_[5 * 32 + j]));
+        row5_whole = std::max(row5_whole, std::fabs(whole_back.data_[5 * 32 + j] - w.data_[5 * 32 + j]));
+    }
+    std::cout << "row 5 error: " << row5 << " per row, " << row5_whole << " per tensor" << std::endl;
+    assert(row5 * 100 < row5_whole);
+
+    // groups and asymmetric, the sums match the values.
+    auto grouped = quant::quantizeWeight(w, {8, false});
+    assert(grouped.groups == 4 && grouped.scales.size() == 24);
+    assert(maxError(quant::dequantize(grouped), w) <= maxError(back, w));
+    for (int g = 0; g < 24; g++) {
+        int sum = 0;
+        for (int k = 0; k < 8; k++) sum += grouped.values.data_[g * 8 + k];
+        assert(sum == grouped.sums[g]);
+    }
+    // the offset row is not centered on 0, asymmetric spends no steps below its minimum.
+    auto asym = quant::quantizeWeight(w, {0, false});
+    assert(asym.scales[5] < per_row.scales[5]);
+
+    try {
+        quant::quantizeWeight(w, {5, true});
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+
+    std::cout << "weight test passed!" << std::endl;
+}
+
+void test_int4() {
+    Tensor<float> w = pattern({6, 32}, 3);
+    for (int j = 0; j < 32; j++) w.data_[5 * 32 + j] = w.data_[5 * 32 + j] * 0.1f + 0.5f;
+
+    for (bool symmetric : {true, false}) {
+        auto q = quant::quantizeWeight4(w, {8, symmetric});
+        assert(q.groups == 4 && q.values.shape() == std::vector<int>({6, 16}) && q.scales.size() == 24);
+        Tensor<float> back = quant::dequantize(q);
+        for (int i = 0; i < 6 * 32; i++) {
+            assert(std::fabs(back.data_[i] - w.data_[i]) <= q.scales[i / 8] / 2 + 1e-6f);
+        }
+        for (int g = 0; g < 24; g++) {
+            // symmetric groups sit on zero point 8.
+            assert(!symmetric ? (q.zero_points[g] >= 0 && q.zero_points[g] <= 15) : q.zero_points[g] == 8);
+        }
+    }
+    // byte t of a group holds columns t (low) and t + 4 (high).
+    Tensor<float> ramp({1, 8});
+    const float steps[8] = {0, 2, 4, 6, 8, 10, 12, 15};
+    for (int j = 0; j < 8; j++) ramp.data_[j] = steps[j];
+    auto packed = quant::quantizeWeight4(ramp, {0, false});
+    assert(packed.zero_points[0] == 0 && packed.scales[0] == 1.0f);
+    assert((packed.values.data_[1] & 0x0F) == 2 && (packed.values.data_[1] >> 4) == 10);
+
+    try {
+        quant::quantizeWeight4(pattern({2, 9}, 1));
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+    std::cout << "int4 test passed!" << std::endl;
+}
+
+void test_activations() {
+    // mostly positive, the zero point well below the middle of [0, 255].
+    Tensor<float> x = shifted({100}, 2, -0.3f, 2.7f);
+    auto params = quant::chooseParamsU8(&x.data_[0], 100);
+    assert(params.zero_point > 15 && params.zero_point < 40);
+    std::vector<uint8_t> q(100);
+    quant::quantizeU8(&x.data_[0], 100, params, q.data());
+    for (int i = 0; i < 100; i++) {
+        float back = params.scale * ((int)q[i] - params.zero_point);
+        assert(std::fabs(back - x.data_[i]) <= params.scale / 2 + 1e-6f);
+    }
+    std::cout << "activations test passed!" << std::endl;
+}
+
+int main() {
+    test_rounding();
+    test_weight();
+    test_int4();
+    test_activations();
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "Tensor.hpp"
+#include "Memory.hpp"
+#include "Sparse.hpp"
+#include "nn/modules.hpp"
+#include "nn/Sequential.hpp"
+#include "TestUtils.hpp"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+void test_storage() {
+    // 9 x 10: the last 4 wide block of a row starts at column 6, the last 4x4 block row
+    // has a single row.
+    Tensor<float> w = pattern({9, 10}, 1);
+    const float threshold = 0.3f;
+    Tensor<float> expected = pattern({9, 10}, 1);
+    for (int i = 0; i < expected.num_elements; i++) {
+        if (std::fabs(expected.data_[i]) <= threshold) expected.data_[i] = 0.0f;
+    }
+    for (auto format : {sparse::Format::CSR, sparse::Format::Block1x4, sparse::Format::Block4x4}) {
+        auto m = sparse::fromDense(w, format, threshold);
+        assert(m.row_ptr.size() == (size_t)(9 + m.block_rows - 1) / m.block_rows + 1);
+        assert(m.values.size() == m.blocks() * m.block_rows * m.block_cols);
+        for (int32_t c : m.col_idx) assert(c + m.block_cols <= 10);
+        assert(maxError(sparse::toDense(m), expected) == 0.0f);
+    }
+    auto csr = sparse::fromDense(w, sparse::Format::CSR, threshold);
+    assert(csr.values.size() == (size_t)std::round((1.0 - sparse::sparsity(w, threshold)) * w.num_elements));
+
+    try {
+        sparse::fromDense(pattern({3, 10}, 1), sparse::Format::Block4x4);
+        assert(false);
+    } catch (const std::invalid_argument& e) {
+        std::cout << "expected error: " << e.what() << std::endl;
+    }
+    std::cout << "storage test passed!" << std::endl;
+}
+
+void test_format() {
+    // scattered zeros keep every block of 4 around, zeros in 1x4 runs or 4x4 tiles favour
+    // the blocks of their shape.
+    Tensor<float> scattered = pruned({64, 128}, 2, 20, 1, 1), runs = pruned({64, 128}, 5, 8, 1, 4),
+                  tiled = pruned({64, 128}, 3, 3, 4, 4);
+    assert(sparse::chooseFormat(scattered) == sparse::Format::CSR);
+    assert(sparse::chooseFormat(runs) == sparse::Format::Block1x4);
+    assert(sparse::chooseFormat(tiled) == sparse::Format::Block4x4);
+    assert(sparse::relativeCost(scattered, sparse::Format::CSR) < 1.0);
+    assert(sparse::relativeCost(pattern({64, 128}, 4), sparse::Format::Block4x4) >= 1.0);
+    std::cout << "format test passed!" << std::endl;
+}
+
+void test_linear() {
+    const int N = 13, K = 128, M = 66;
+    Tensor<float> x = pattern({N, K}, 5), b = pattern({M}, 6);
+    Tensor<uint8_t> pixels({N, K});
+    for (int i = 0; i < pixels.num_elements; i++) pixels.data_[i] = (i * 37) % 256;
+
+    struct Case {
+        Tensor<float> w;
+        bool sparse;
+        sparse::Format format;
+    };
+    std::vector<Case> cases = {{pruned({M, K}, 7, 20, 1, 1), true, sparse::Format::CSR},
+                               {pruned({M, K}, 12, 8, 1, 4), true, sparse::Format::Block1x4},
+                               {pruned({M, K}, 8, 3, 4, 4), true, sparse::Format::Block4x4},
+                               {pattern({M, K}, 9), false, sparse::Format::CSR}};
+    for (auto& c : cases) {
+        nn::Linear<float> fc(K, M, Tensor<float>(c.w), Tensor<float>(b));
+        assert(fc.sparseWeight().empty() == !c.sparse);
+        if (c.sparse) assert(fc.sparseWeight().format == c.format);
+
+        sparse::setMinSparsity(2.0);
+        nn::Linear<float> dense(K, M, Tensor<float>(c.w), Tensor<float>(b));
+        sparse::setMinSparsity(0.5);
+        assert(dense.sparseWeight().empty());
+        assert(maxError(fc.forward(x), dense.forward(x)) < 1e-4f);
+        assert(maxError(fc.forward(pixels, 1.0f / 255.0f), dense.forward(pixels, 1.0f / 255.0f)) < 1e-4f);
+    }
+
+    // any weight in any format on request, pruned at the threshold.
+    Tensor<float> w = pattern({M, K}, 10);
+    nn::Linear<float> fc(K, M, Tensor<float>(w));
+    fc.sparsify(sparse::Format::Block1x4, 0.5f);
+    for (int i = 0; i < w.num_elements; i++) {
+        if (std::fabs(w.data_[i]) <= 0.5f) w.data_[i] = 0.0f;
+    }
+    nn::Linear<float> reference(K, M, std::move(w));
+    assert(maxError(fc.forward(x), reference.forward(x)) < 1e-4f);
+    std::cout << "linear test passed!" << std::endl;
+}
+
+void test_sequential() {
+    const int K = 64;
+    Tensor<float> w = pruned({10, K}, 11, 20, 1, 1);
+    nn::Sequential<float> model;
+    model.add(nn::Linear<float>(K, 10, Tensor<float>(w))).add(nn::ReLU<float>());
+    nn::Linear<float> alone(K, 10, Tensor<float>(w));
+    assert(!alone.sparseWeight().empty());
+    // the pixels are scaled to float in scratch, float input is read as it is.
+    assert(alone.workspaceSize({20, K}) == 0 && alone.uint8WorkspaceSize({20, K}) == (size_t)20 * K);
+
+    Tensor<uint8_t> x({20, K});
+    for (int i = 0; i < x.num_elements; i++) x.data_[i] = (i * 37) % 256;
+    Tensor<float> expected = alone.forward(x, 1.0f / 255.0f);
+    model.forward(x, 1.0f / 255.0f);
+    int64_t allocs = memory::stats().allocs;
+    const Tensor<float>& y = model.forward(x, 1.0f / 255.0f);
+    assert(memory::stats().allocs == allocs);
+    for (int i = 0; i < y.num_elements; i++) {
+        assert(std::fabs(y.data_[i] - std::max(0.0f, expected.data_[i])) < 1e-5f);
+    }
+    size_t uint8_bytes = model.arenaBytes();
+    model.plan({20, K});
+    assert(model.arenaBytes() < uint8_bytes);
+    std::cout << "sequential test passed!" << std::endl;
+}
+
+int main() {
+    test_storage();
+    test_format();
+    test_linear();
+    test_sequential();
+    return 0;
+}
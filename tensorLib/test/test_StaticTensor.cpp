@@ -0,0 +1,151 @@
+#include "StaticTensor.hpp"
+#include "Tensor.hpp"
+#include "nn/modules.hpp"
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+void test_layout() {
+    using T = StaticTensor<float, 2, 3, 4>;
+    static_assert(T::ndim == 3 && T::num_elements == 24, "");
+    static_assert(T::strides()[0] == 12 && T::strides()[1] == 4 && T::strides()[2] == 1, "");
+    assert(T::shape() == std::vector<int>({2, 3, 4}));
+
+    T t;
+    for (int i = 0; i < 24; ++i) assert(t[i] == 0.0f);
+    t(1, 2, 3) = 5.0f;
+    assert(t[23] == 5.0f);
+
+    // the view shares the storage both ways.
+    Tensor<float> view = t.view();
+    assert(view.shape() == T::shape());
+    assert(view.getData({1, 2, 3}) == 5.0f);
+    view.setData({0, 1, 2}, 7.0f);
+    assert(t(0, 1, 2) == 7.0f);
+
+    std::cout << "layout test passed!" << std::endl;
+}
+
+void test_from_tensor() {
+    Tensor<float> a({3, 4});
+    for (int i = 0; i < 3; ++i) for (int j = 0; j < 4; ++j) a.setData({i, j}, i * 4 + j);
+
+    auto s = StaticTensor<float, 3, 4>::fromTensor(a);
+    for (int i = 0; i < 3; ++i) for (int j = 0; j < 4; ++j) assert(s(i, j) == a.getData({i, j}));
+
+    // a non-contiguous view is gathered element by element.
+    auto st = StaticTensor<float, 4, 3>::fromTensor(a.transpose(0, 1));
+    for (int i = 0; i < 4; ++i) for (int j = 0; j < 3; ++j) assert(st(i, j) == a.getData({j, i}));
+
+    // and a slice keeps its offset.
+    auto row = StaticTensor<float, 1, 4>::fromTensor(a.slice(2, 3, 0));
+    assert(row(0, 0) == 8.0f && row(0, 3) == 11.0f);
+
+    bool thrown = false;
+    try {
+        StaticTensor<float, 4, 4>::fromTensor(a);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::cout << "from tensor test passed!" << std::endl;
+}
+
+void test_matmul() {
+    StaticTensor<float, 5, 7> a;
+    StaticTensor<float, 7, 3> b;
+    for (int i = 0; i < 35; ++i) a[i] = i % 5 - 2.0f;
+    for (int i = 0; i < 21; ++i) b[i] = i % 3 - 1.0f;
+
+    auto c = static_kernels::matmul(a, b);
+    Tensor<float> ref = a.view().matmul(b.view());
+    for (int i = 0; i < 5; ++i)
+        for (int j = 0; j < 3; ++j) assert(c(i, j) == ref.getData({i, j}));
+
+    std::cout << "matmul test passed!" << std::endl;
+}
+
+void test_linear() {
+    // 37 features: one tail past the vector lanes. the whole batch takes the GEMM,
+    // the slice below the fixed-size loops.
+    const int N = 40;
+    Tensor<float> weight({10, 37});
+    for (int o = 0; o < 10; ++o) for (int k = 0; k < 37; ++k) weight.setData({o, k}, (o * 3 + k) % 7 - 3.0f);
+    Tensor<uint8_t> x8({N, 37});
+    Tensor<float> x({N, 37});
+    for (int n = 0; n < N; ++n)
+        for (int k = 0; k < 37; ++k) {
+            x8.setData({n, k}, (n * 13 + k * 5) % 256);
+            x.setData({n, k}, (n * 13 + k * 5) % 256);
+        }
+
+    nn::StaticLinear<float, 37, 10> fixed(weight);
+    nn::Linear<float> dynamic(37, 10, Tensor<float>(weight.contiguous()));
+    Tensor<float> a = fixed.forward(x);
+    Tensor<float> b = dynamic.forward(x);
+    Tensor<float> c = fixed.forward(x8, 1.0f);
+    assert(a.shape() == b.shape());
+    // integer values, exact in any summation order.
+    for (int n = 0; n < N; ++n)
+        for (int o = 0; o < 10; ++o) {
+            assert(a.getData({n, o}) == b.getData({n, o}));
+            assert(c.getData({n, o}) == b.getData({n, o}));
+        }
+
+    // a slice of the batch, rows at an offset.
+    Tensor<float> part = fixed.forward(x.slice(3, 7, 0));
+    for (int n = 0; n < 4; ++n)
+        for (int o = 0; o < 10; ++o) assert(part.getData({n, o}) == b.getData({n + 3, o}));
+
+    std::cout << "linear test passed!" << std::endl;
+}
+
+template <int Stride, int Padding>
+void check_conv2d() {
+    const int N = 3;
+    Tensor<float> weight({2, 3, 3, 3});
+    for (int co = 0; co < 2; ++co)
+        for (int ci = 0; ci < 3; ++ci)
+            for (int j = 0; j < 9; ++j) weight.setData({co, ci, j / 3, j % 3}, (co + 2 * ci + j) % 5 - 2.0f);
+    Tensor<uint8_t> x8({N, 3, 8, 7});
+    Tensor<float> x({N, 3, 8, 7});
+    for (int n = 0; n < N; ++n)
+        for (int ci = 0; ci < 3; ++ci)
+            for (int h = 0; h < 8; ++h)
+                for (int w = 0; w < 7; ++w) {
+                    x8.setData({n, ci, h, w}, (n * 29 + ci * 7 + h * 3 + w) % 256);
+                    x.setData({n, ci, h, w}, (n * 29 + ci * 7 + h * 3 + w) % 256);
+                }
+
+    nn::StaticConv2d<float, 3, 2, 3, Stride, Padding, 8, 7> fixed(weight);
+    Tensor<float> w_copy = weight.view({2, 3, 3, 3});
+    nn::Conv2d<float> dynamic(3, 2, 3, Stride, Padding, std::move(w_copy));
+    Tensor<float> a = fixed.forward(x);
+    Tensor<float> b = dynamic.forward(x);
+    Tensor<float> c = fixed.forward(x8, 1.0f);
+    assert(a.shape() == b.shape() && c.shape() == b.shape());
+    for (int n = 0; n < N; ++n)
+        for (int co = 0; co < 2; ++co)
+            for (int h = 0; h < b.shape()[2]; ++h)
+                for (int w = 0; w < b.shape()[3]; ++w) {
+                    assert(a.getData({n, co, h, w}) == b.getData({n, co, h, w}));
+                    assert(c.getData({n, co, h, w}) == b.getData({n, co, h, w}));
+                }
+}
+
+void test_conv2d() {
+    check_conv2d<1, 1>();
+    check_conv2d<1, 0>();
+    check_conv2d<2, 1>();
+    std::cout << "conv2d test passed!" << std::endl;
+}
+
+int main() {
+    test_layout();
+    test_from_tensor();
+    test_matmul();
+    test_linear();
+    test_conv2d();
+    return 0;
+}
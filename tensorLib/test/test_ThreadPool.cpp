@@ -0,0 +1,206 @@
+#include "ThreadPool.hpp"
+#include "Tensor.hpp"
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+void test_parallel_for() {
+    parallel::ThreadPool pool(4);
+    parallel::PoolScope scope(pool);
+    assert(parallel::numThreads() == 4);
+
+    // every index exactly once, for ranges smaller and larger than the pool.
+    for (int n : {1, 3, 4, 17, 1000}) {
+        std::vector<std::atomic<int>> hits(n);
+        std::atomic<int> max_index{0};
+        parallel::parallel_for(0, n, 1, [&](int64_t begin, int64_t end) {
+            int index = parallel::threadIndex();
+            int prev = max_index.load();
+            while (index > prev && !max_index.compare_exchange_weak(prev, index)) {}
+            for (int64_t i = begin; i < end; i++) hits[i]++;
+        });
+        for (int i = 0; i < n; i++) assert(hits[i] == 1);
+        assert(max_index < 4);
+    }
+
+    // uneven chunks: the expensive ones at the front are stolen, the result is the same.
+    std::vector<double> values(64);
+    parallel::parallel_for(0, 64, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; i++) {
+            double v = 0;
+            for (int k = 0; k < (i < 8 ? 200000 : 10); k++) v += 1.0;
+            values[i] = v;
+        }
+    });
+    for (int i = 0; i < 64; i++) assert(values[i] == (i < 8 ? 200000 : 10));
+
+    // at most max_threads take part.
+    std::atomic<int> over{0};
+    parallel::parallel_for(0, 100, 1, [&](int64_t, int64_t) {
+        if (parallel::threadIndex() >= 2) over++;
+    }, 2);
+    assert(over == 0);
+
+    // a grain larger than the range runs on the calling thread.
+    std::thread::id caller = std::this_thread::get_id();
+    parallel::parallel_for(0, 10, 100, [&](int64_t begin, int64_t end) {
+        assert(begin == 0 && end == 10);
+        assert(std::this_thread::get_id() == caller);
+    });
+
+    std::cout << "parallel_for test passed!" << std::endl;
+}
+
+void test_nested() {
+    parallel::ThreadPool pool(3);
+    parallel::PoolScope scope(pool);
+
+    std::vector<std::atomic<int>> hits(20 * 30);
+    parallel::parallel_for(0, 20, 1, [&](int64_t b0, int64_t b1) {
+        for (int64_t i = b0; i < b1; i++) {
+            int outer = parallel::threadIndex();
+            // runs inline, the outer index is back afterwards.
+            parallel::parallel_for(0, 30, 1, [&](int64_t c0, int64_t c1) {
+                assert(parallel::threadIndex() == 0);
+                for (int64_t j = c0; j < c1; j++) hits[i * 30 + j]++;
+            });
+            assert(parallel::threadIndex() == outer);
+        }
+    });
+    for (auto& h : hits) assert(h == 1);
+
+    std::cout << "nested test passed!" << std::endl;
+}
+
+void test_parallel_reduce() {
+    std::vector<float> x(100003);
+    for (size_t i = 0; i < x.size(); i++) x[i] = 1.0f / (1 + i % 97);
+
+    auto sum = [&]() {
+        return parallel::parallel_reduce((int64_t)0, (int64_t)x.size(), 1000, 0.0f,
+            [&](int64_t begin, int64_t end) {
+                float s = 0;
+                for (int64_t i = begin; i < end; i++) s += x[i];
+                return s;
+            },
+            [](float a, float b) { return a + b; });
+    };
+
+    // the same parts combined in the same order on any pool, bit for bit.
+    float reference;
+    {
+        parallel::ThreadPool pool(1);
+        parallel::PoolScope scope(pool);
+        reference = sum();
+    }
+    for (int threads : {2, 3, 8}) {
+        parallel::ThreadPool pool(threads);
+        parallel::PoolScope scope(pool);
+        assert(sum() == reference);
+    }
+
+    assert(parallel::parallel_reduce(5, 5, 1, 42, [](int64_t, int64_t) { return 0; },
+                                     [](int a, int b) { return a + b; }) == 42);
+
+    std::cout << "parallel_reduce test passed!" << std::endl;
+}
+
+void test_concurrent_callers() {
+    // two threads sharing one pool, and two threads with a pool each.
+    parallel::ThreadPool shared(4);
+    auto work = [](parallel::ThreadPool& pool, std::atomic<long>& total) {
+        parallel::PoolScope scope(pool);
+        for (int r = 0; r < 50; r++) {
+            parallel::parallel_for(0, 1000, 10, [&](int64_t begin, int64_t end) { total += end - begin; });
+        }
+    };
+    std::atomic<long> a{0}, b{0};
+    std::thread t1(work, std::ref(shared), std::ref(a));
+    std::thread t2(work, std::ref(shared), std::ref(b));
+    t1.join();
+    t2.join();
+    assert(a == 50 * 1000 && b == 50 * 1000);
+
+    std::vector<int> cpus = parallel::availableCPUs();
+    assert(!cpus.empty());
+    parallel::ThreadPool pinned_a(2, {cpus.front()}), pinned_b(2, {cpus.back()});
+    std::atomic<long> c{0}, d{0};
+    std::thread t3(work, std::ref(pinned_a), std::ref(c));
+    std::thread t4(work, std::ref(pinned_b), std::ref(d));
+    t3.join();
+    t4.join();
+    assert(c == 50 * 1000 && d == 50 * 1000);
+
+    std::cout << "concurrent callers test passed!" << std::endl;
+}
+
+void test_exceptions() {
+    parallel::ThreadPool pool(4);
+    parallel::PoolScope scope(pool);
+    bool thrown = false;
+    try {
+        parallel::parallel_for(0, 100, 1, [&](int64_t begin, int64_t) {
+            if (begin == 0) throw std::runtime_error("chunk failed");
+        });
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // the pool still works.
+    std::atomic<int> count{0};
+    parallel::parallel_for(0, 100, 1, [&](int64_t begin, int64_t end) { count += end - begin; });
+    assert(count == 100);
+
+    std::cout << "exceptions test passed!" << std::endl;
+}
+
+void test_kernels() {
+    // the Tensor ops give the same results on one thread and on a pool.
+    Tensor<float> a({300, 200}), b({200, 150});
+    for (int i = 0; i < 300; ++i) for (int j = 0; j < 200; ++j) a.setData({i, j}, (i * 7 + j) % 11 - 5.0f);
+    for (int i = 0; i < 200; ++i) for (int j = 0; j < 150; ++j) b.setData({i, j}, (i + j * 3) % 5 - 2.0f);
+
+    Tensor<float> serial({1});
+    {
+        parallel::ThreadPool pool(1);
+        parallel::PoolScope scope(pool);
+        serial = a.matmul(b);
+    }
+    parallel::ThreadPool pool(4);
+    parallel::PoolScope scope(pool);
+    Tensor<float> threaded = a.matmul(b);
+    for (int i = 0; i < 300; ++i)
+        for (int j = 0; j < 150; ++j) assert(serial.getData({i, j}) == threaded.getData({i, j}));
+
+    std::cout << "kernels test passed!" << std::endl;
+}
+
+void test_restart() {
+    // new workers, same size, e.g. after perf::open().
+    parallel::setNumThreads(3);
+    parallel::restartDefaultPool();
+    assert(parallel::numThreads() == 3);
+
+    std::vector<std::atomic<int>> hits(50);
+    parallel::parallel_for(0, 50, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; i++) hits[i]++;
+    });
+    for (int i = 0; i < 50; i++) assert(hits[i] == 1);
+
+    std::cout << "restart test passed!" << std::endl;
+}
+
+int main() {
+    test_parallel_for();
+    test_nested();
+    test_parallel_reduce();
+    test_concurrent_callers();
+    test_exceptions();
+    test_kernels();
+    test_restart();
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include "readIDX.hpp"
+#include "readMNIST.hpp"
+#include <cassert>
+#include <iostream>
+
+// write a big-endian IDX file, compressed with gzip when the path ends with .gz
+template <typename Src>
+void writeIDX(const std::string& path, IDXType type, const std::vector<int>& shape, const std::vector<Src>& values) {
+    gzFile file = gzopen(path.c_str(), path.size() > 3 && path.substr(path.size() - 3) == ".gz" ? "wb" : "wbT");
+    uint8_t magic[4] = {0, 0, static_cast<uint8_t>(type), static_cast<uint8_t>(shape.size())};
+    gzwrite(file, magic, 4);
+    for (auto dim : shape) {
+        uint32_t be = __builtin_bswap32(static_cast<uint32_t>(dim));
+        gzwrite(file, &be, 4);
+    }
+    for (auto value : values) {
+        uint8_t bytes[sizeof(Src)];
+        std::memcpy(bytes, &value, sizeof(Src));
+        for (size_t i = 0; i < sizeof(Src) / 2; ++i) {
+            std::swap(bytes[i], bytes[sizeof(Src) - 1 - i]);
+        }
+        gzwrite(file, bytes, sizeof(Src));
+    }
+    gzclose(file);
+}
+
+void test_uint8_images() {
+    // 3 images of 4 x 5, not 28 x 28
+    std::vector<uint8_t> pixels(3 * 4 * 5);
+    for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = static_cast<uint8_t>(i * 4);
+    writeIDX("/tmp/test_idx_images.gz", IDXType::UInt8, {3, 4, 5}, pixels);
+
+    Tensor<uint8_t> raw = readIDX<uint8_t>("/tmp/test_idx_images.gz");
+    assert((raw.shape() == std::vector<int>{3, 4, 5}));
+    assert(raw.getData({2, 3, 4}) == pixels.back());
+
+    Tensor<float> images = readMNISTImages<float>("/tmp/test_idx_images.gz");
+    assert((images.shape() == std::vector<int>{3, 20}));
+    assert(images.getData({1, 0}) == pixels[20] / 255.0f);
+
+    // same shape, but not uint8 pixels
+    writeIDX<float>("/tmp/test_idx_float_images.gz", IDXType::Float32, {1, 2, 2}, {0.5f, 1.0f, 2.0f, 300.0f});
+    // uint8, but one flat image
+    writeIDX("/tmp/test_idx_flat_images.gz", IDXType::UInt8, {60}, pixels);
+    for (const char* path : {"/tmp/test_idx_float_images.gz", "/tmp/test_idx_flat_images.gz"}) {
+        try {
+            readMNISTImages<float>(path);
+            assert(false);
+        } catch (const std::runtime_error& e) {
+            std::cout << "rejected " << path << ": " << e.what() << std::endl;
+        }
+    }
+
+    std::cout << "uint8 images test passed!" << std::endl;
+}
+
+void test_dtypes() {
+    writeIDX<int16_t>("/tmp/test_idx_int16", IDXType::Int16, {2, 2}, {-300, 1, 2, 300});
+    Tensor<int> a = readIDX<int>("/tmp/test_idx_int16");
+    assert(a.getData({0, 0}) == -300 && a.getData({1, 1}) == 300);
+
+    writeIDX<int32_t>("/tmp/test_idx_int32.gz", IDXType::Int32, {3}, {-70000, 0, 70000});
+    Tensor<int> b = readMNISTLabels<int>("/tmp/test_idx_int32.gz");
+    assert(b.getData({0}) == -70000 && b.getData({2}) == 70000);
+
+    writeIDX<float>("/tmp/test_idx_float.gz", IDXType::Float32, {1, 2, 1, 2}, {0.5f, -1.5f, 2.25f, 3.0f});
+    Tensor<float> c = readIDX<float>("/tmp/test_idx_float.gz");
+    assert(c.shape().size() == 4 && c.getData({0, 1, 0, 0}) == 2.25f);
+
+    writeIDX<double>("/tmp/test_idx_double.gz", IDXType::Float64, {2}, {1e-3, -7.0});
+    Tensor<double> d = readIDX<double>("/tmp/test_idx_double.gz");
+    assert(d.getData({0}) == 1e-3 && d.getData({1}) == -7.0);
+
+    writeIDX<int8_t>("/tmp/test_idx_int8.gz", IDXType::Int8, {2}, {-128, 127});
+    Tensor<int8_t> e = readIDX<int8_t>("/tmp/test_idx_int8.gz");
+    assert(e.getData({0}) == -128 && e.getData({1}) == 127);
+
+    std::cout << "dtype test passed!" << std::endl;
+}
+
+void test_truncated() {
+    gzFile file = gzopen("/tmp/test_idx_truncated.gz", "wb");
+    uint8_t header[8] = {0, 0, 0x08, 1, 0, 0, 0, 100};
+    gzwrite(file, header, 8);
+    gzwrite(file, header, 8); // only 8 of 100 bytes
+    gzclose(file);
+
+    try {
+        readIDX<uint8_t>("/tmp/test_idx_truncated.gz");
+        assert(false);
+    } catch (const std::runtime_error& e) {
+        std::cout << "truncated file: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    test_uint8_images();
+    test_dtypes();
+    test_truncated();
+    return 0;
+}
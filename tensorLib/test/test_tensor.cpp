@@ -341,6 +341,29 @@ void test_select() {
     std::cout << "t: " << std::endl << t << std::endl;
 }
 
+void test_from_blob() {
+    // borrowed stack memory, a column major 2 x 3 matrix.
+    int buffer[6] = {0, 3, 1, 4, 2, 5};
+    Tensor<int> a = Tensor<int>::from_blob(buffer, {2, 3}, {1, 2});
+    assert(a.getData({0, 2}) == 2 && a.getData({1, 0}) == 3);
+
+    buffer[5] = 50;
+    assert(a.getData({1, 2}) == 50);
+
+    // adopted memory, freed by the deleter when the last view goes away.
+    static bool freed = false;
+    {
+        float* heap = new float[4]{1, 2, 3, 4};
+        Tensor<float> b = Tensor<float>::from_blob(heap, {4}, {}, [](float* p) { delete[] p; freed = true; });
+        Tensor<float> c = b.slice(2, 4, 0);
+        b = Tensor<float>({1});
+        assert(!freed && c.getData({1}) == 4);
+    }
+    assert(freed);
+
+    std::cout << "a: " << std::endl << a << std::endl;
+}
+
 int main() {
     // test_construct();
     // test_getData();
@@ -355,4 +378,5 @@ int main() {
     // test_sum();
     // test_elementwise_mul();
     test_select();
+    test_from_blob();
 }